@@ -0,0 +1,32 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../exporters/arrow_export.cpp \
+../exporters/decoded_batch.cpp \
+../exporters/fastq_exporter.cpp \
+../exporters/sam_exporter.cpp 
+
+OBJS += \
+./exporters/arrow_export.o \
+./exporters/decoded_batch.o \
+./exporters/fastq_exporter.o \
+./exporters/sam_exporter.o 
+
+CPP_DEPS += \
+./exporters/arrow_export.d \
+./exporters/decoded_batch.d \
+./exporters/fastq_exporter.d \
+./exporters/sam_exporter.d 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+exporters/%.o: ../exporters/%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: Cross G++ Compiler'
+	g++ -std=c++0x -I/usr/local/include/ -I/usr/local/opt/zstd/include/ -I/usr/local/opt/openssl/include/ -O3 -march=native -mtune=native -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
@@ -0,0 +1,45 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../importers/annotation_importer.cpp \
+../importers/bam_importer.cpp \
+../importers/bgzf_reader.cpp \
+../importers/fastq_importer.cpp \
+../importers/reference_importer.cpp \
+../importers/sam_importer.cpp \
+../importers/text_reader.cpp \
+../importers/vcf_importer.cpp 
+
+OBJS += \
+./importers/annotation_importer.o \
+./importers/bam_importer.o \
+./importers/bgzf_reader.o \
+./importers/fastq_importer.o \
+./importers/reference_importer.o \
+./importers/sam_importer.o \
+./importers/text_reader.o \
+./importers/vcf_importer.o 
+
+CPP_DEPS += \
+./importers/annotation_importer.d \
+./importers/bam_importer.d \
+./importers/bgzf_reader.d \
+./importers/fastq_importer.d \
+./importers/reference_importer.d \
+./importers/sam_importer.d \
+./importers/text_reader.d \
+./importers/vcf_importer.d 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+importers/%.o: ../importers/%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: Cross G++ Compiler'
+	g++ -std=c++0x -I/usr/local/include/ -I/usr/local/opt/zstd/include/ -I/usr/local/opt/openssl/include/ -O3 -march=native -mtune=native -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
@@ -4,5 +4,5 @@
 
 USER_OBJS :=
 
-LIBS := -lzstd -lgtest -lcrypto
+LIBS := -lzstd -lz -lgtest -lcrypto
 
@@ -24,6 +24,8 @@ CPP_DEPS :=
 # Every subdirectory with source files must be described here
 SUBDIRS := \
 . \
+exporters \
+importers \
 third_party/xxhash \
 transform \
 
@@ -6,8 +6,10 @@
 CPP_SRCS += \
 ../bloom_filter.cpp \
 ../buffer.cpp \
+../checksum.cpp \
 ../column_dictionary.cpp \
 ../column_store.cpp \
+../genotype_index.cpp \
 ../main.cpp \
 ../memory_pool.cpp \
 ../table.cpp \
@@ -16,8 +18,10 @@ CPP_SRCS += \
 OBJS += \
 ./bloom_filter.o \
 ./buffer.o \
+./checksum.o \
 ./column_dictionary.o \
 ./column_store.o \
+./genotype_index.o \
 ./main.o \
 ./memory_pool.o \
 ./table.o \
@@ -26,8 +30,10 @@ OBJS += \
 CPP_DEPS += \
 ./bloom_filter.d \
 ./buffer.d \
+./checksum.d \
 ./column_dictionary.d \
 ./column_store.d \
+./genotype_index.d \
 ./main.d \
 ./memory_pool.d \
 ./table.d \
@@ -4,28 +4,37 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../transform/codec_tuner.cpp \
 ../transform/compressor.cpp \
 ../transform/dictionary_builder.cpp \
 ../transform/encoder.cpp \
 ../transform/fastdelta.cpp \
 ../transform/range_coder.cpp \
-../transform/transformer.cpp 
+../transform/reference_sequence.cpp \
+../transform/transformer.cpp \
+../transform/zstd_dictionary.cpp 
 
 OBJS += \
+./transform/codec_tuner.o \
 ./transform/compressor.o \
 ./transform/dictionary_builder.o \
 ./transform/encoder.o \
 ./transform/fastdelta.o \
 ./transform/range_coder.o \
-./transform/transformer.o 
+./transform/reference_sequence.o \
+./transform/transformer.o \
+./transform/zstd_dictionary.o 
 
 CPP_DEPS += \
+./transform/codec_tuner.d \
 ./transform/compressor.d \
 ./transform/dictionary_builder.d \
 ./transform/encoder.d \
 ./transform/fastdelta.d \
 ./transform/range_coder.d \
-./transform/transformer.d 
+./transform/reference_sequence.d \
+./transform/transformer.d \
+./transform/zstd_dictionary.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -117,6 +117,18 @@ public:
 
     void UnsafeSetLength(const int64_t length){ size_ = length; }
 
+    /// \brief Exchange the underlying buffer with the provided buffer
+    ///
+    /// Used to hand over the output of a codec without copying it.
+    /// \param[in,out] buffer buffer to take ownership of; receives the previous buffer
+    /// \param[in] length number of valid bytes in the new buffer
+    void Swap(std::shared_ptr<ResizableBuffer>& buffer, const int64_t length) {
+        buffer_.swap(buffer);
+        capacity_ = buffer_.get() != nullptr ? buffer_->capacity() : 0;
+        data_ = buffer_.get() != nullptr ? buffer_->mutable_data() : nullptr;
+        size_ = length;
+    }
+
     int64_t capacity() const { return capacity_; }
     int64_t length() const { return size_; }
     const uint8_t* data() const { return data_; }
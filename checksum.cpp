@@ -0,0 +1,190 @@
+#include <cstring>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#include "third_party/xxhash/xxhash.h"
+#include "transform/variant_digest_manager.h"
+#include "checksum.h"
+
+// Reflected CRC32C (Castagnoli) polynomial.
+#define PIL_CRC32C_POLY 0x82F63B78
+// Block lengths for the three interleaved hardware streams. Inputs are first
+// consumed in blocks of 3*LONG and then 3*SHORT bytes.
+#define PIL_CRC32C_LONG  8192
+#define PIL_CRC32C_SHORT 256
+
+namespace pil {
+namespace Checksum {
+
+// Multiply a 32x32 matrix over GF(2) with a vector.
+static uint32_t Gf2MatrixTimes(const uint32_t* mat, uint32_t vec) {
+    uint32_t sum = 0;
+    while(vec) {
+        if(vec & 1) sum ^= *mat;
+        vec >>= 1;
+        ++mat;
+    }
+    return(sum);
+}
+
+static void Gf2MatrixSquare(uint32_t* square, const uint32_t* mat) {
+    for(int i = 0; i < 32; ++i) square[i] = Gf2MatrixTimes(mat, mat[i]);
+}
+
+// Construct the operator that appends n_zeros zero bytes (a power of two) to
+// a CRC in byte-wise lookup tables.
+static void Crc32cZerosTables(uint32_t tables[4][256], uint32_t n_zeros) {
+    uint32_t even[32], odd[32];
+
+    // Operator for a single zero bit.
+    odd[0] = PIL_CRC32C_POLY;
+    uint32_t row = 1;
+    for(int i = 1; i < 32; ++i) {
+        odd[i] = row;
+        row <<= 1;
+    }
+    Gf2MatrixSquare(even, odd); // 2 zero bits
+    Gf2MatrixSquare(odd, even); // 4 zero bits
+
+    // Square until the operator covers n_zeros bytes.
+    const uint32_t* op = nullptr;
+    while(true) {
+        Gf2MatrixSquare(even, odd);
+        n_zeros >>= 1;
+        if(n_zeros == 0) { op = even; break; }
+        Gf2MatrixSquare(odd, even);
+        n_zeros >>= 1;
+        if(n_zeros == 0) { op = odd; break; }
+    }
+
+    for(uint32_t i = 0; i < 256; ++i) {
+        tables[0][i] = Gf2MatrixTimes(op, i);
+        tables[1][i] = Gf2MatrixTimes(op, i << 8);
+        tables[2][i] = Gf2MatrixTimes(op, i << 16);
+        tables[3][i] = Gf2MatrixTimes(op, i << 24);
+    }
+}
+
+struct Crc32cTables {
+    Crc32cTables() {
+        for(uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for(int j = 0; j < 8; ++j) crc = (crc & 1) ? (crc >> 1) ^ PIL_CRC32C_POLY : crc >> 1;
+            bytes[i] = crc;
+        }
+        Crc32cZerosTables(zeros_long,  PIL_CRC32C_LONG);
+        Crc32cZerosTables(zeros_short, PIL_CRC32C_SHORT);
+    }
+
+    static inline uint32_t Shift(const uint32_t tables[4][256], const uint32_t crc) {
+        return(tables[0][crc & 0xFF] ^ tables[1][(crc >> 8) & 0xFF] ^
+               tables[2][(crc >> 16) & 0xFF] ^ tables[3][crc >> 24]);
+    }
+
+    uint32_t bytes[256];
+    uint32_t zeros_long[4][256];
+    uint32_t zeros_short[4][256];
+};
+
+static const Crc32cTables& GetCrc32cTables() {
+    static const Crc32cTables tables;
+    return(tables);
+}
+
+#if defined(__SSE4_2__)
+// Consume n_blocks * 3 * block bytes as three independent streams that are
+// combined by shifting the preceding CRC over the following block.
+static inline const uint8_t* Crc32cInterleaved(const uint8_t* next, uint64_t& n_data, uint64_t& crc0,
+                                               const uint32_t block, const uint32_t zeros[4][256])
+{
+    while(n_data >= 3 * block) {
+        uint64_t crc1 = 0, crc2 = 0;
+        const uint8_t* end = next + block;
+        do {
+            uint64_t w0, w1, w2;
+            memcpy(&w0, next, sizeof(uint64_t));
+            memcpy(&w1, next + block, sizeof(uint64_t));
+            memcpy(&w2, next + 2 * block, sizeof(uint64_t));
+            crc0 = _mm_crc32_u64(crc0, w0);
+            crc1 = _mm_crc32_u64(crc1, w1);
+            crc2 = _mm_crc32_u64(crc2, w2);
+            next += sizeof(uint64_t);
+        } while(next < end);
+        crc0 = Crc32cTables::Shift(zeros, crc0) ^ crc1;
+        crc0 = Crc32cTables::Shift(zeros, crc0) ^ crc2;
+        next += 2 * block;
+        n_data -= 3 * block;
+    }
+    return(next);
+}
+#endif
+
+uint32_t Crc32c(const uint8_t* data, const uint64_t n_data, const uint32_t crc) {
+    const Crc32cTables& tables = GetCrc32cTables();
+    const uint8_t* next = data;
+    uint64_t n = n_data;
+
+#if defined(__SSE4_2__)
+    uint64_t crc0 = ~crc;
+    // Align to 8 bytes.
+    while(n && (reinterpret_cast<uintptr_t>(next) & 7) != 0) {
+        crc0 = _mm_crc32_u8(crc0, *next++);
+        --n;
+    }
+
+    next = Crc32cInterleaved(next, n, crc0, PIL_CRC32C_LONG,  tables.zeros_long);
+    next = Crc32cInterleaved(next, n, crc0, PIL_CRC32C_SHORT, tables.zeros_short);
+
+    while(n >= sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, next, sizeof(uint64_t));
+        crc0 = _mm_crc32_u64(crc0, w);
+        next += sizeof(uint64_t);
+        n -= sizeof(uint64_t);
+    }
+    while(n) {
+        crc0 = _mm_crc32_u8(crc0, *next++);
+        --n;
+    }
+    return(~static_cast<uint32_t>(crc0));
+#else
+    uint32_t crc0 = ~crc;
+    while(n--) crc0 = tables.bytes[(crc0 ^ *next++) & 0xFF] ^ (crc0 >> 8);
+    return(~crc0);
+#endif
+}
+
+int Compute(const PIL_CHECKSUM_TYPE type, const uint8_t* data, const uint64_t n_data, uint8_t* dst) {
+    memset(dst, 0, PIL_CHECKSUM_LENGTH);
+
+    switch(type) {
+    case(PIL_CHECKSUM_NONE): break;
+    case(PIL_CHECKSUM_MD5): Digest::GenerateMd5(data, n_data, dst); break;
+    case(PIL_CHECKSUM_CRC32C): {
+        const uint32_t crc = Crc32c(data, n_data);
+        memcpy(dst, &crc, sizeof(uint32_t));
+        break;
+    }
+    case(PIL_CHECKSUM_XXH3): {
+        const uint64_t hash = XXH3_64bits(data, n_data);
+        memcpy(dst, &hash, sizeof(uint64_t));
+        break;
+    }
+    default: return(-1);
+    }
+
+    return(1);
+}
+
+bool Verify(const PIL_CHECKSUM_TYPE type, const uint8_t* data, const uint64_t n_data, const uint8_t* expected) {
+    if(type == PIL_CHECKSUM_NONE) return(true);
+
+    uint8_t digest[PIL_CHECKSUM_LENGTH];
+    if(Compute(type, data, n_data, digest) < 0) return(false);
+    return(memcmp(digest, expected, PIL_CHECKSUM_LENGTH) == 0);
+}
+
+}
+}
@@ -0,0 +1,49 @@
+#ifndef CHECKSUM_H_
+#define CHECKSUM_H_
+
+#include <cstdint>
+
+#include "pil.h"
+
+namespace pil {
+
+// Width of the checksum fields in ColumnStore and TransformMeta.
+#define PIL_CHECKSUM_LENGTH 16
+
+namespace Checksum {
+
+/**<
+ * Compute the CRC32C (Castagnoli) of the provided data. Uses the SSE4.2
+ * crc32 instruction on three interleaved streams if available and a
+ * table-driven implementation otherwise.
+ * @param data   Source data.
+ * @param n_data Number of bytes in the source.
+ * @param crc    CRC of preceding data for incremental use.
+ * @return       Returns the CRC32C.
+ */
+uint32_t Crc32c(const uint8_t* data, const uint64_t n_data, const uint32_t crc = 0);
+
+/**<
+ * Compute the digest of the provided data with the given algorithm and
+ * store it in dst. Digests shorter than PIL_CHECKSUM_LENGTH are stored
+ * little-endian and zero-padded.
+ * @param type   Checksum algorithm.
+ * @param data   Source data.
+ * @param n_data Number of bytes in the source.
+ * @param dst    Destination with room for PIL_CHECKSUM_LENGTH bytes.
+ * @return       Returns 1 if successful or -1 if the algorithm is unknown.
+ */
+int Compute(const PIL_CHECKSUM_TYPE type, const uint8_t* data, const uint64_t n_data, uint8_t* dst);
+
+/**<
+ * Recompute the digest of the provided data and compare it to `expected`.
+ * Data without a checksum (PIL_CHECKSUM_NONE) always verifies.
+ * @return Returns TRUE if the digests match or FALSE otherwise.
+ */
+bool Verify(const PIL_CHECKSUM_TYPE type, const uint8_t* data, const uint64_t n_data, const uint8_t* expected);
+
+}
+
+}
+
+#endif /* CHECKSUM_H_ */
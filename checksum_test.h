@@ -0,0 +1,77 @@
+#ifndef CHECKSUM_TEST_H_
+#define CHECKSUM_TEST_H_
+
+#include <random>
+#include <vector>
+#include <cstring>
+
+#include "checksum.h"
+#include <gtest/gtest.h>
+
+namespace pil {
+
+// Bit-wise reference implementation of CRC32C.
+static uint32_t ChecksumTestCrc32c(const uint8_t* data, const uint32_t n_data) {
+    uint32_t crc = 0xFFFFFFFF;
+    for(uint32_t i = 0; i < n_data; ++i) {
+        crc ^= data[i];
+        for(int j = 0; j < 8; ++j) crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+    }
+    return(~crc);
+}
+
+TEST(ChecksumTests, Crc32c) {
+    const std::string check = "123456789";
+    ASSERT_EQ(0xE3069283, Checksum::Crc32c(reinterpret_cast<const uint8_t*>(check.data()), check.size()));
+    ASSERT_EQ(0, Checksum::Crc32c(nullptr, 0));
+
+    // Lengths covering the interleaved block sizes at unaligned offsets.
+    std::mt19937 eng(1234);
+    std::uniform_int_distribution<uint32_t> distr(0, 255);
+    std::vector<uint8_t> data(3 * 8192 * 2 + 3 * 256 + 77);
+    for(size_t i = 0; i < data.size(); ++i) data[i] = distr(eng);
+
+    const uint32_t lengths[] = {1, 7, 8, 100, 3*256, 3*256 + 13, 3*8192, 3*8192 + 3*256 + 5};
+    for(uint32_t offset = 0; offset < 3; ++offset) {
+        for(uint32_t l : lengths) {
+            ASSERT_EQ(ChecksumTestCrc32c(&data[offset], l), Checksum::Crc32c(&data[offset], l));
+        }
+    }
+
+    // Incremental use.
+    const uint32_t n = data.size() - 3;
+    const uint32_t crc = Checksum::Crc32c(&data[0], 1000);
+    ASSERT_EQ(ChecksumTestCrc32c(&data[0], n), Checksum::Crc32c(&data[1000], n - 1000, crc));
+}
+
+TEST(ChecksumTests, ComputeVerify) {
+    std::vector<uint8_t> data(10000);
+    for(size_t i = 0; i < data.size(); ++i) data[i] = i * 31;
+
+    const PIL_CHECKSUM_TYPE types[] = {PIL_CHECKSUM_MD5, PIL_CHECKSUM_CRC32C, PIL_CHECKSUM_XXH3};
+    for(PIL_CHECKSUM_TYPE type : types) {
+        uint8_t digest[PIL_CHECKSUM_LENGTH];
+        ASSERT_EQ(1, Checksum::Compute(type, &data[0], data.size(), digest));
+        ASSERT_EQ(true, Checksum::Verify(type, &data[0], data.size(), digest));
+        data[5000] ^= 1;
+        ASSERT_EQ(false, Checksum::Verify(type, &data[0], data.size(), digest));
+        data[5000] ^= 1;
+    }
+
+    // Short digests are zero-padded.
+    uint8_t digest[PIL_CHECKSUM_LENGTH];
+    uint8_t zeros[PIL_CHECKSUM_LENGTH]; memset(zeros, 0, PIL_CHECKSUM_LENGTH);
+    ASSERT_EQ(1, Checksum::Compute(PIL_CHECKSUM_CRC32C, &data[0], data.size(), digest));
+    ASSERT_EQ(0, memcmp(&digest[4], zeros, PIL_CHECKSUM_LENGTH - 4));
+    ASSERT_EQ(1, Checksum::Compute(PIL_CHECKSUM_XXH3, &data[0], data.size(), digest));
+    ASSERT_EQ(0, memcmp(&digest[8], zeros, PIL_CHECKSUM_LENGTH - 8));
+
+    // No checksum.
+    ASSERT_EQ(1, Checksum::Compute(PIL_CHECKSUM_NONE, &data[0], data.size(), digest));
+    ASSERT_EQ(0, memcmp(digest, zeros, PIL_CHECKSUM_LENGTH));
+    ASSERT_EQ(true, Checksum::Verify(PIL_CHECKSUM_NONE, &data[0], data.size(), digest));
+}
+
+}
+
+#endif /* CHECKSUM_TEST_H_ */
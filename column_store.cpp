@@ -6,16 +6,18 @@ namespace pil {
 int ColumnStore::Serialize(std::ostream& stream) {
    stream.write(reinterpret_cast<char*>(&have_dictionary), sizeof(bool));
    stream.write(reinterpret_cast<char*>(&n_records), sizeof(uint32_t));
-   stream.write(reinterpret_cast<char*>(&n_elements), sizeof(uint32_t));
+   stream.write(reinterpret_cast<char*>(&n_elements), sizeof(uint64_t));
    stream.write(reinterpret_cast<char*>(&n_null), sizeof(uint32_t));
-   stream.write(reinterpret_cast<char*>(&uncompressed_size), sizeof(uint32_t));
-   stream.write(reinterpret_cast<char*>(&compressed_size),   sizeof(uint32_t));
+   stream.write(reinterpret_cast<char*>(&uncompressed_size), sizeof(uint64_t));
+   stream.write(reinterpret_cast<char*>(&compressed_size),   sizeof(uint64_t));
+   stream.write(reinterpret_cast<char*>(&offset_width), sizeof(uint8_t));
    stream.write(reinterpret_cast<char*>(&nullity_u), sizeof(uint32_t));
    stream.write(reinterpret_cast<char*>(&nullity_c), sizeof(uint32_t));
+   uint8_t n_type = nullity_type;
+   stream.write(reinterpret_cast<char*>(&n_type), sizeof(uint8_t));
 
-   // Nullity vector
-   //const uint32_t n_nullity = std::ceil((float)n / 32);
-   if(nullity.get() != nullptr) {
+   // Nullity vector: nothing is stored if all records are valid or null.
+   if(nullity.get() != nullptr && nullity_c) {
        const uint32_t* nulls = reinterpret_cast<const uint32_t*>(nullity->mutable_data());
        stream.write(reinterpret_cast<const char*>(nulls), nullity_c);
    }
@@ -32,8 +34,10 @@ int ColumnStore::Serialize(std::ostream& stream) {
    stream.write(reinterpret_cast<char*>(&n_transforms), sizeof(uint32_t));
    for(int i = 0; i < n_transforms; ++i) transformation_args[i]->Serialize(stream);
 
-   // Write md5 checksum of uncompressed data
-   stream.write(reinterpret_cast<char*>(md5_checksum), 16);
+   // Write the checksum of uncompressed data and its algorithm.
+   uint8_t c_type = checksum_type;
+   stream.write(reinterpret_cast<char*>(&c_type), sizeof(uint8_t));
+   stream.write(reinterpret_cast<char*>(checksum), PIL_CHECKSUM_LENGTH);
 
    // If the data has been transformed we write out the compressed data
    // otherwise we write out the uncompressed data.
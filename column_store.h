@@ -8,12 +8,15 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <limits>
 
 #include "pil.h"
 #include "buffer_builder.h"
 #include "transform/transform_meta.h"
 #include "column_dictionary.h"
 #include "bloom_filter.h"
+#include "nullity_bitmap.h"
+#include "checksum.h"
 
 #include <bitset>
 
@@ -30,22 +33,25 @@ public:
         have_dictionary(false), have_bloom(false),
         n_records(0), n_elements(0), n_null(0), uncompressed_size(0), compressed_size(0),
         m_nullity(0), nullity_u(0), nullity_c(0),
-        pool_(pool)
+        nullity_type(PIL_NULLITY_BITMAP), expected_records(0), offset_width(0),
+        pool_(pool), buffer(pool),
+        checksum_type(PIL_CHECKSUM_CRC32C)
     {
-        memset(md5_checksum, 0, 16);
+        memset(checksum, 0, PIL_CHECKSUM_LENGTH);
     }
 
     uint32_t size() const { return n_records; }
 
-    uint32_t GetMemoryUsage() const {
-        uint32_t ret = uncompressed_size + nullity_u;
+    uint64_t GetMemoryUsage() const {
+        uint64_t ret = uncompressed_size + nullity_u;
         if(have_dictionary) ret += dictionary->GetUncompressedSize();
         return(ret);
     }
 
     uint8_t* mutable_data() { return buffer.mutable_data(); }
 
-    void ComputeChecksum() { Digest::GenerateMd5(mutable_data(), uncompressed_size, md5_checksum); }
+    void ComputeChecksum() { Checksum::Compute(checksum_type, mutable_data(), uncompressed_size, checksum); }
+    bool VerifyChecksum() { return(Checksum::Verify(checksum_type, mutable_data(), uncompressed_size, checksum)); }
 
     // PrettyPrint representation of array suitable for debugging.
     std::string ToString() const {
@@ -56,7 +62,7 @@ public:
             ret += "Nullity: no\n";
         } else {
             ret += "Nullity: yes\n";
-            ret += "\tCompressed: " + std::to_string(nullity_c) + " b, Uncompressed: " + std::to_string(nullity_u) + " b\n";
+            ret += "\tCompressed: " + std::to_string(nullity_c) + " b, Uncompressed: " + std::to_string(nullity_u) + " b, Type: " + std::to_string(nullity_type) + "\n";
         }
 
         if(have_dictionary) {
@@ -79,9 +85,9 @@ public:
         if(transformation_args.size()) {
             ret += "Transformations: " + std::to_string(transformation_args.size()) + "\n";
             for(int i = 0; i < transformation_args.size(); ++i) {
-                ret += "\t" + PIL_TRANSFORM_TYPE_STRING[transformation_args[i]->ctype] + ": " + std::to_string(transformation_args[i]->u_sz) + "->" + std::to_string(transformation_args[i]->c_sz) + " MD5: ";
-                for(int j = 0; j < 16; ++j) {
-                    ret += std::to_string(transformation_args[i]->md5_checksum[j]);
+                ret += "\t" + PIL_TRANSFORM_TYPE_STRING[transformation_args[i]->ctype] + ": " + std::to_string(transformation_args[i]->u_sz) + "->" + std::to_string(transformation_args[i]->c_sz) + " " + PIL_CHECKSUM_TYPE_STRING[transformation_args[i]->checksum_type] + ": ";
+                for(int j = 0; j < PIL_CHECKSUM_LENGTH; ++j) {
+                    ret += std::to_string(transformation_args[i]->checksum[j]);
                 }
                 ret += '\n';
             }
@@ -100,13 +106,101 @@ public:
     int Deserialize(std::ostream& stream);
 
     // Check if the given element is valid by looking up that bit in the bitmap.
-    bool IsValid(const uint32_t p) { return(reinterpret_cast<uint32_t*>(nullity->mutable_data())[p / 32] & (1 << (p % 32))); }
+    // The bitmap is only allocated once a null value is seen.
+    bool IsValid(const uint32_t p) {
+        if(nullity.get() == nullptr) return(true);
+        return(reinterpret_cast<uint32_t*>(nullity->mutable_data())[p / 32] & (1 << (p % 32)));
+    }
+
+    /**<
+     * Grow the Nullity bitmap to hold at least n_bits bits. The first
+     * allocation is sized to `expected_records` and the bitmap doubles
+     * in size afterwards. Added bits are unset.
+     * @param n_bits Number of bits required.
+     * @return       Returns 1 if successful or -1 otherwise.
+     */
+    int ReserveNullity(const uint32_t n_bits) {
+        if(nullity.get() != nullptr && n_bits <= m_nullity) return(1);
+
+        uint32_t m = std::max<uint32_t>(std::max<uint32_t>(n_bits, expected_records), 2 * m_nullity);
+        m = (m + 511) / 512 * 512; // whole 64-byte blocks
+        const uint32_t n_old = (nullity.get() == nullptr) ? 0 : m_nullity / 8;
+        const uint32_t n_new = m / 8;
+
+        if(nullity.get() == nullptr) {
+            if(AllocateResizableBuffer(pool_, n_new, &nullity) != 1) return(-1);
+        } else {
+            if(nullity->Resize(n_new, false) != 1) return(-1);
+        }
+        memset(nullity->mutable_data() + n_old, 0, n_new - n_old);
+        m_nullity = m;
+        return(1);
+    }
+
+    // Number of valid records in the (uncompressed) Nullity bitmap.
+    uint32_t CountValid() const {
+        if(nullity.get() == nullptr) return(n_records);
+        return(NullityBitmap::CountValid(reinterpret_cast<const uint32_t*>(nullity->data()), n_records));
+    }
+
+    // Record and byte counts of a ColumnStore at a point in time.
+    struct Mark {
+        uint32_t n_records, n_null;
+        uint64_t n_elements, uncompressed_size, length;
+        uint8_t offset_width;
+    };
+
+    Mark GetMark() const {
+        Mark mark;
+        mark.n_records = n_records;
+        mark.n_null = n_null;
+        mark.n_elements = n_elements;
+        mark.uncompressed_size = uncompressed_size;
+        mark.length = buffer.length();
+        mark.offset_width = offset_width;
+        return(mark);
+    }
+
+    /**<
+     * Remove every record added since the Mark was taken, including a record
+     * that was only partially added because an allocation failed. Buffers
+     * keep their capacity.
+     * @param mark Mark taken by GetMark.
+     */
+    void Rollback(const Mark& mark) {
+        // Offsets widened to 64 bits since the Mark are narrowed again.
+        if(offset_width == sizeof(uint64_t) && mark.offset_width == sizeof(uint32_t)) {
+            const uint64_t* src = reinterpret_cast<const uint64_t*>(mutable_data());
+            uint32_t* dst = reinterpret_cast<uint32_t*>(mutable_data());
+            for(uint32_t i = 0; i < mark.n_records; ++i) dst[i] = src[i];
+        }
+
+        // Clear the validity bits of the removed records. Bit i of a Tensor
+        // offset column belongs to record i rather than to offset i.
+        if(nullity.get() != nullptr) {
+            uint32_t* bits = reinterpret_cast<uint32_t*>(nullity->mutable_data());
+            const uint32_t from = mark.n_records - (mark.offset_width != 0 && mark.n_records != 0);
+            for(uint32_t p = from; p < n_records && p < m_nullity; ++p) bits[p / 32] &= ~(1u << (p % 32));
+        }
+
+        n_records = mark.n_records;
+        n_null = mark.n_null;
+        n_elements = mark.n_elements;
+        uncompressed_size = mark.uncompressed_size;
+        buffer.UnsafeSetLength(mark.length);
+        offset_width = mark.offset_width;
+    }
 
 public:
     bool have_dictionary, have_bloom;
-    uint32_t n_records, n_elements, n_null;
-    uint32_t uncompressed_size, compressed_size;
+    uint32_t n_records;
+    uint64_t n_elements;
+    uint32_t n_null;
+    uint64_t uncompressed_size, compressed_size;
     uint32_t m_nullity, nullity_u, nullity_c; // nullity_u is not required as we can compute it. but is convenient to have during deserialization
+    PIL_NULLITY_TYPE nullity_type; // Stored representation of the Nullity bitmap.
+    uint32_t expected_records; // Number of records expected in the batch: used to size the Nullity bitmap.
+    uint8_t offset_width; // Bytes per value (4 or 8) if this column holds Tensor offsets or 0 otherwise.
 
     // Any memory is owned by the respective Buffer instance (or its parents).
     MemoryPool* pool_;
@@ -115,7 +209,8 @@ public:
     std::shared_ptr<ColumnDictionary> dictionary; // Dictionary used for predicate pushdown
     std::shared_ptr<BlockSplitBloomFilter> bloom; // Bloom filter used for predicate pushdown
     std::vector< std::shared_ptr<TransformMeta> > transformation_args; // Every transform MUST store a value.
-    uint8_t md5_checksum[16]; // **uncompressed** checksum
+    PIL_CHECKSUM_TYPE checksum_type; // Algorithm used for this store and its transforms.
+    uint8_t checksum[PIL_CHECKSUM_LENGTH]; // **uncompressed** checksum
 };
 
 template <class T>
@@ -129,29 +224,28 @@ public:
      * the correct position is set.
      * @param yes    Logical flag set to TRUE if the data is VALID or FALSE otherwise.
      * @param adjust Adjust the record count downward by this value.
-     * @return       Return 1.
+     * @return       Return 1 if successful or -1 if the bitmap cannot be grown.
      */
     int AppendValidity(const bool yes, const int32_t adjust = 0) {
-        if(nullity.get() == nullptr) {
-            assert(AllocateResizableBuffer(pool_, 16384*sizeof(uint32_t), &nullity) == 1);
-            //nullity->ZeroPadding();
-            memset(nullity->mutable_data(), 0, sizeof(uint32_t)*16384);
-            m_nullity = 16384 * 32; // 32 bits for every integer used in the Nullity bitmap
-        }
+        const uint32_t p = n_records - adjust;
 
-        if(n_records == m_nullity) {
-            assert(nullity->Resize(m_nullity + 16384*sizeof(uint32_t)) == 1);
-            nullity->ZeroPadding();
-            m_nullity += 16384 * 32;
+        // The Nullity bitmap is materialized once the first null value is
+        // seen: every preceding record is valid.
+        if(nullity.get() == nullptr) {
+            if(yes) return 1;
+            if(ReserveNullity(p + 1) != 1) return(-1);
+            NullityBitmap::Fill(reinterpret_cast<uint32_t*>(nullity->mutable_data()), p, true);
+        } else if(p >= m_nullity) {
+            if(ReserveNullity(p + 1) != 1) return(-1);
         }
 
         n_null += (yes == false);
-        reinterpret_cast<uint32_t*>(nullity->mutable_data())[(n_records - adjust) / 32] |= (yes << ((n_records - adjust) % 32));
+        reinterpret_cast<uint32_t*>(nullity->mutable_data())[p / 32] |= ((uint32_t)yes << (p % 32));
         return 1;
     }
 
     int Append(const T value) {
-        buffer.Append(reinterpret_cast<const uint8_t*>(&value), sizeof(T));
+        if(buffer.Append(reinterpret_cast<const uint8_t*>(&value), sizeof(T)) != 1) return(-1);
         ++n_records;
         ++n_elements;
         uncompressed_size += sizeof(T);
@@ -159,7 +253,7 @@ public:
     }
 
     int Append(const T* value, uint32_t n_values) {
-        buffer.Append(reinterpret_cast<const uint8_t*>(value), sizeof(T)*n_values);
+        if(buffer.Append(reinterpret_cast<const uint8_t*>(value), sizeof(T)*n_values) != 1) return(-1);
         n_records += n_values;
         n_elements += n_values;
         uncompressed_size += n_values * sizeof(T);
@@ -167,7 +261,7 @@ public:
     }
 
     int Append(const std::vector<T>& values) {
-        buffer.Append(reinterpret_cast<const uint8_t*>(&values[0]), sizeof(T)*values.size());
+        if(buffer.Append(reinterpret_cast<const uint8_t*>(&values[0]), sizeof(T)*values.size()) != 1) return(-1);
         n_records += values.size();
         n_elements += values.size();
         uncompressed_size += values.size() * sizeof(T);
@@ -175,7 +269,7 @@ public:
     }
 
     int AppendArray(const T* value, uint32_t n_values) {
-        buffer.Append(reinterpret_cast<const uint8_t*>(value), sizeof(T)*n_values);
+        if(buffer.Append(reinterpret_cast<const uint8_t*>(value), sizeof(T)*n_values) != 1) return(-1);
         ++n_records;
         n_elements += n_values;
         uncompressed_size += n_values * sizeof(T);
@@ -183,13 +277,35 @@ public:
     }
 
     int AppendArray(const std::vector<T>& values) {
-        buffer.Append(reinterpret_cast<const uint8_t*>(&values[0]), sizeof(T)*values.size());
+        if(buffer.Append(reinterpret_cast<const uint8_t*>(&values[0]), sizeof(T)*values.size()) != 1) return(-1);
         ++n_records;
         n_elements += values.size();
         uncompressed_size += values.size() * sizeof(T);
         return(1);
     }
 
+    /**<
+     * Reserve room for an array of n_values values at the end of the buffer
+     * and return a writable pointer to it. The values become part of the
+     * column once they are committed with CommitArray.
+     * @param n_values Number of values to reserve.
+     * @return         Returns a pointer to the reserved values or nullptr otherwise.
+     */
+    T* ReserveArray(uint32_t n_values) {
+        if(buffer.Reserve(sizeof(T)*n_values, true) != 1) return(nullptr);
+        return(reinterpret_cast<T*>(buffer.mutable_data() + buffer.length()));
+    }
+
+    // Commit an array of n_values values written into memory returned by
+    // ReserveArray. Equivalent to AppendArray without copying.
+    int CommitArray(uint32_t n_values) {
+        buffer.UnsafeAdvance(sizeof(T)*n_values);
+        ++n_records;
+        n_elements += n_values;
+        uncompressed_size += n_values * sizeof(T);
+        return(1);
+    }
+
     const T* data() const { return reinterpret_cast<const T*>(buffer.data()); }
 };
 
@@ -205,14 +321,23 @@ public:
 class ColumnSet {
 public:
     explicit ColumnSet(MemoryPool* pool = default_memory_pool()) :
-        n(0)
+        n(0), expected_records(0), checksum_type(PIL_CHECKSUM_CRC32C), pool_(pool)
     {
+        memset(checksum, 0, PIL_CHECKSUM_LENGTH);
+    }
+
+    // Construct a ColumnStore for this set.
+    std::shared_ptr<ColumnStore> NewColumnStore() const {
+        std::shared_ptr<ColumnStore> cstore = std::make_shared<ColumnStore>(pool_);
+        cstore->expected_records = expected_records;
+        cstore->checksum_type = checksum_type;
+        return(cstore);
     }
 
     size_t size() const { return(columns.size()); }
 
-    uint32_t GetMemoryUsage() const {
-        uint32_t total = 0;
+    uint64_t GetMemoryUsage() const {
+        uint64_t total = 0;
         for(size_t i = 0; i < size(); ++i)
             total += columns[i]->GetMemoryUsage();
 
@@ -221,7 +346,7 @@ public:
 
     void clear() {
         n = 0;
-        memset(md5_checksum, 0, 16);
+        memset(checksum, 0, PIL_CHECKSUM_LENGTH);
         columns.clear();
     }
 
@@ -237,9 +362,39 @@ public:
         return(1);
     }
 
+    // Marks of every ColumnStore in the set at a point in time.
+    struct Mark {
+        uint32_t n;
+        std::vector<ColumnStore::Mark> columns;
+    };
+
+    // Take a Mark in place such that its storage is reused.
+    void GetMark(Mark& mark) const {
+        mark.n = n;
+        mark.columns.resize(columns.size());
+        for(size_t i = 0; i < columns.size(); ++i) mark.columns[i] = columns[i]->GetMark();
+    }
+
+    /**<
+     * Remove every record added since the Mark was taken. The appends of the
+     * builders below return -1 if memory cannot be allocated, for example
+     * when a MemoryBudget limit is reached, and may have added part of the
+     * record to some ColumnStores by then: rolling back restores the set.
+     * ColumnStores added since the Mark are removed.
+     * @param mark Mark taken by GetMark.
+     */
+    void Rollback(const Mark& mark) {
+        columns.resize(mark.columns.size());
+        n = mark.n;
+        for(size_t i = 0; i < columns.size(); ++i) columns[i]->Rollback(mark.columns[i]);
+    }
+
 public:
     uint32_t n;
-    uint8_t md5_checksum[16]; // checksum of the checksum vector -> md5(&checksums, n); this check is to guarantee there is no reordering of the set
+    uint32_t expected_records; // Number of records expected in the batch.
+    PIL_CHECKSUM_TYPE checksum_type; // Checksum algorithm for new ColumnStores.
+    MemoryPool* pool_; // Pool for the buffers of new ColumnStores.
+    uint8_t checksum[PIL_CHECKSUM_LENGTH]; // checksum of the checksum vector -> checksum(&checksums, n); this check is to guarantee there is no reordering of the set
     std::vector< std::shared_ptr<ColumnStore> > columns;
 };
 
@@ -251,18 +406,16 @@ public:
     int Append(const T value) {
         // Check if columns[0] is set
         if(columns.size() == 0) {
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
+            columns.push_back( NewColumnStore() );
             ++n;
         }
 
-        std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[0])->AppendValidity(true);
-        int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[0])->Append(value);
-        assert(ret == 1);
+        if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[0])->AppendValidity(true) != 1) return(-1);
+        if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[0])->Append(value) != 1) return(-1);
 
         for(uint32_t i = 1; i < columns.size(); ++i){
-            std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0);
-            assert(ret == 1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false) != 1) return(-1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0) != 1) return(-1);
         }
 
         return(1);
@@ -273,7 +426,7 @@ public:
         if(n < values.size()) {
             const int start_size = columns.size();
             for(int i = start_size; i < values.size(); ++i, ++n)
-                columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
+                columns.push_back( NewColumnStore() );
 
             assert(n >= values.size());
 
@@ -281,23 +434,20 @@ public:
             // Pad every column added this way.
             for(int i = start_size; i < values.size(); ++i) {
                 for(int j = 0; j < padding_to; ++j){
-                   std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false);
-                   int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0);
-                   assert(ret == 1);
+                   if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false) != 1) return(-1);
+                   if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0) != 1) return(-1);
                 }
             }
         }
 
         for(int i = 0; i < values.size(); ++i){
-            std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(true);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(values[i]);
-            assert(ret == 1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(true) != 1) return(-1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(values[i]) != 1) return(-1);
         }
 
         for(int i = values.size(); i < columns.size(); ++i){
-            std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0);
-            assert(ret == 1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false) != 1) return(-1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0) != 1) return(-1);
         }
 
         return(1);
@@ -308,7 +458,7 @@ public:
         if((int)n < n_values){
             const int start_size = columns.size();
             for(int i = start_size; i < n_values; ++i, ++n)
-                columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
+                columns.push_back( NewColumnStore() );
 
             assert((int)n >= n_values);
 
@@ -316,23 +466,20 @@ public:
             // Pad every column added this way.
             for(int i = start_size; i < n_values; ++i) {
                 for(uint32_t j = 0; j < padding_to; ++j) {
-                   std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false);
-                   int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0);
-                   assert(ret == 1);
+                   if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false) != 1) return(-1);
+                   if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0) != 1) return(-1);
                 }
             }
         }
 
         for(int i = 0; i < n_values; ++i) {
-            std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(true);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(value[i]);
-            assert(ret == 1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(true) != 1) return(-1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(value[i]) != 1) return(-1);
         }
 
         for(uint32_t i = n_values; i < columns.size(); ++i){
-            std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0);
-            assert(ret == 1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false) != 1) return(-1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0) != 1) return(-1);
         }
 
         return(1);
@@ -344,14 +491,13 @@ public:
      */
     int PadNull() {
         if(columns.size() == 0) {
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
+            columns.push_back( NewColumnStore() );
             ++n;
         }
 
         for(uint32_t i = 0; i < columns.size(); ++i) {
-            std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0);
-            assert(ret == 1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->AppendValidity(false) != 1) return(-1);
+            if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[i])->Append(0) != 1) return(-1);
         }
         return(1);
     }
@@ -371,125 +517,86 @@ public:
     explicit ColumnSetBuilderTensor(MemoryPool* pool = default_memory_pool()) : ColumnSet(pool){}
 
     int Append(const T value) {
-        // Check if columns[0] is set
-        if(columns.size() == 0) {
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
-            n += 2;
-        }
-        assert(n == 2);
-
-        // If this is the first value added to the ColumnSet then we add an addition
-        // 0 to the start such to support constant time lookup. This will resulting
-        // in this column being n + 1 length.
-        // We do NOT care about the Nullity vector for the data column as it has no meaning.
-        if(columns[0]->n_records == 0) {
-            std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->AppendValidity(true);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(0);
-            assert(ret == 1);
-            ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(1);
-            assert(ret == 1);
-        } else {
-            const uint32_t n_recs = columns[0]->n_records;
-            assert(n_recs != 0);
-            const uint32_t cum = reinterpret_cast<uint32_t*>(columns[0]->mutable_data())[n_recs - 1];
-            std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->AppendValidity(true, 1);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(cum + 1);
-            assert(ret == 1);
-        }
+        if(AppendOffset(true, 1) != 1) return(-1);
 
-        int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[1])->Append(value);
-        assert(ret == 1);
+        if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[1])->Append(value) != 1) return(-1);
 
         return(1);
     }
 
     int Append(const std::vector<T>& values) {
-        if(columns.size() == 0) {
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
-            n += 2;
-        }
-        assert(n == 2);
+        if(AppendOffset(true, values.size()) != 1) return(-1);
 
-        if(columns[0]->n_records == 0) {
-            std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->AppendValidity(true);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(0);
-            assert(ret == 1);
-            ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(values.size());
-            assert(ret == 1);
-        } else {
-            const uint32_t n_recs = columns[0]->n_records;
-            assert(n_recs != 0);
-            const uint32_t cum = reinterpret_cast<uint32_t*>(columns[0]->mutable_data())[n_recs - 1];
-            std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->AppendValidity(true, 1);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(cum + values.size());
-            assert(ret == 1);
-        }
-
-        int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[1])->AppendArray(values.data(), values.size());
-        assert(ret == 1);
+        if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[1])->AppendArray(values.data(), values.size()) != 1) return(-1);
 
         return(1);
     }
 
     int Append(const T* value, int n_values) {
-        if(columns.size() == 0) {
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
-            n += 2;
-        }
-        assert(n == 2);
-
-        if(columns[0]->n_records == 0) {
-            std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->AppendValidity(true);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(0);
-            assert(ret == 1);
-            ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(n_values);
-            assert(ret == 1);
-        } else {
-            const uint32_t n_recs = columns[0]->n_records;
-            assert(n_recs != 0);
-            const uint32_t cum = reinterpret_cast<uint32_t*>(columns[0]->mutable_data())[n_recs - 1];
-            std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->AppendValidity(true, 1);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(cum + n_values);
-            assert(ret == 1);
-        }
+        if(AppendOffset(true, n_values) != 1) return(-1);
 
         assert(n_values > 0);
-        int ret = std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[1])->AppendArray(value, n_values);
-        assert(ret == 1);
+        if(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[1])->AppendArray(value, n_values) != 1) return(-1);
 
         return(1);
     }
 
+    /**<
+     * Reserve room for a record of n_values values in the data column and
+     * return a writable pointer to it such that parsers can write values in
+     * place. The record is added by a subsequent call to Commit and no
+     * other record may be added in between.
+     * @param n_values Number of values to reserve.
+     * @return         Returns a pointer to the reserved values or nullptr otherwise.
+     */
+    T* Reserve(const uint32_t n_values) {
+        InitColumns();
+        return(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[1])->ReserveArray(n_values));
+    }
+
+    /**<
+     * Add a record of n_values values written into memory returned by
+     * Reserve.
+     * @param n_values Number of values written: at most the number reserved.
+     * @return         Returns 1 if successful or -1 otherwise.
+     */
+    int Commit(const uint32_t n_values) {
+        if(AppendOffset(true, n_values) != 1) return(-1);
+        return(std::static_pointer_cast< ColumnStoreBuilder<T> >(columns[1])->CommitArray(n_values));
+    }
+
     /**<
      * Padding a Tensor-style ColumnStore simply involves adding an offset of 0 and
      * setting the appropriate Null-vector bit.
      * @return
      */
     int PadNull() {
-        if(columns.size() == 0) {
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
-            columns.push_back( std::make_shared<ColumnStore>(pil::default_memory_pool()) );
-            n += 2;
-        }
-        assert(n == 2);
+        if(AppendOffset(false, 0) != 1) return(-1);
+        return(1);
+    }
 
-        if(columns[0]->n_records == 0) {
-            std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->AppendValidity(false);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(0);
-            assert(ret == 1);
-            ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(0);
-            assert(ret == 1);
-        } else {
-            const uint32_t n_recs = columns[0]->n_records;
-            assert(n_recs != 0);
-            const uint32_t cum = reinterpret_cast<uint32_t*>(columns[0]->mutable_data())[n_recs - 1];
-            std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->AppendValidity(false);
-            int ret = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(columns[0])->Append(cum + 0);
-            assert(ret == 1);
-        }
+    /**<
+     * Promote the offsets in columns[0] from 32-bit to 64-bit integers. This
+     * happens automatically once the number of values in the batch no longer
+     * fits in 32 bits and holds for the remainder of the batch.
+     * @return Returns 1 if successful or -1 otherwise.
+     */
+    int WidenOffsets() {
+        std::shared_ptr<ColumnStore> offsets = columns[0];
+        if(offsets->offset_width == sizeof(uint64_t)) return(1);
+
+        const uint32_t n_offsets = offsets->n_records;
+        if(offsets->buffer.Reserve(n_offsets * sizeof(uint32_t), true) != 1) return(-1);
+
+        // Widen in place from the back such that no value is overwritten
+        // before it is read.
+        const uint32_t* src = reinterpret_cast<const uint32_t*>(offsets->mutable_data());
+        uint64_t* dst = reinterpret_cast<uint64_t*>(offsets->mutable_data());
+        for(int64_t i = (int64_t)n_offsets - 1; i >= 0; --i) dst[i] = src[i];
+
+        offsets->buffer.UnsafeSetLength(n_offsets * sizeof(uint64_t));
+        offsets->uncompressed_size = n_offsets * sizeof(uint64_t);
+        offsets->offset_width = sizeof(uint64_t);
         return(1);
     }
 
@@ -500,6 +607,50 @@ public:
 
         return(lengths);
     }
+
+private:
+    // Add the offset and data columns if this is the first record.
+    void InitColumns() {
+        if(columns.size() == 0) {
+            columns.push_back( NewColumnStore() );
+            columns.push_back( NewColumnStore() );
+            columns[0]->offset_width = sizeof(uint32_t);
+            n += 2;
+        }
+        assert(n == 2);
+    }
+
+    /**<
+     * Append the cumulative offset of a record with n_values values to
+     * columns[0] and set its validity. If this is the first record then an
+     * additional 0 is added to the start such to support constant time
+     * lookup: the offsets are n + 1 long. We do NOT care about the Nullity
+     * vector for the data column as it has no meaning.
+     * @param valid    Logical flag set to TRUE if the record is VALID or FALSE otherwise.
+     * @param n_values Number of values in the record.
+     * @return         Returns 1 if successful or -1 otherwise.
+     */
+    int AppendOffset(const bool valid, const uint64_t n_values) {
+        InitColumns();
+
+        std::shared_ptr<ColumnStore> offsets = columns[0];
+        if(offsets->n_records == 0) {
+            if(std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(offsets)->Append(0) != 1) return(-1);
+        }
+        if(std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(offsets)->AppendValidity(valid, 1) != 1) return(-1);
+
+        const uint32_t n_recs = offsets->n_records;
+        if(offsets->offset_width == sizeof(uint32_t)) {
+            const uint64_t cum = reinterpret_cast<const uint32_t*>(offsets->mutable_data())[n_recs - 1] + n_values;
+            if(cum <= std::numeric_limits<uint32_t>::max())
+                return(std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(offsets)->Append(cum));
+
+            if(WidenOffsets() != 1) return(-1);
+        }
+
+        const uint64_t cum = reinterpret_cast<const uint64_t*>(offsets->mutable_data())[n_recs - 1] + n_values;
+        return(std::static_pointer_cast< ColumnStoreBuilder<uint64_t> >(offsets)->Append(cum));
+    }
 };
 
 }
@@ -55,6 +55,37 @@ TEST(ColumnStoreTests, NullityHuge) {
     for(int i = 500001; i < 500001+500000; ++i) ASSERT_EQ(true, builder.IsValid(i));
 }
 
+TEST(ColumnStoreTests, NullityLazy) {
+    ColumnStoreBuilder<uint32_t> builder;
+    builder.expected_records = 1000;
+    for(int i = 0; i < 100; ++i){
+        ASSERT_EQ(1, builder.AppendValidity(true, 0));
+        ++builder.n_records;
+    }
+    // No bitmap is allocated while every record is valid.
+    ASSERT_EQ(nullptr, builder.nullity.get());
+    ASSERT_EQ(0, builder.n_null);
+    ASSERT_EQ(true, builder.IsValid(50));
+
+    // The first null backfills the preceding records and sizes the bitmap
+    // to the expected number of records.
+    ASSERT_EQ(1, builder.AppendValidity(false, 0));
+    ++builder.n_records;
+    ASSERT_NE(nullptr, builder.nullity.get());
+    ASSERT_GE(builder.m_nullity, 1000);
+    ASSERT_EQ(1, builder.n_null);
+    for(int i = 0; i < 2000; ++i) {
+        ASSERT_EQ(1, builder.AppendValidity(i % 3 != 0, 0));
+        ++builder.n_records;
+    }
+
+    for(int i = 0; i < 100; ++i) ASSERT_EQ(true, builder.IsValid(i));
+    ASSERT_EQ(false, builder.IsValid(100));
+    for(int i = 0; i < 2000; ++i) ASSERT_EQ(i % 3 != 0, builder.IsValid(101 + i));
+    ASSERT_EQ(1 + 667, builder.n_null);
+    ASSERT_EQ(builder.n_records - builder.n_null, builder.CountValid());
+}
+
 TEST(ColumnStoreTests, RangeInsert) {
     ColumnStoreBuilder<uint32_t> builder;
     uint32_t vals[] = {241, 10, 9, 42, 137};
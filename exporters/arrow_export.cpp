@@ -0,0 +1,223 @@
+#include <string>
+#include <vector>
+
+#include "arrow_export.h"
+
+namespace pil {
+
+// Producer data of an exported ArrowSchema: the strings and child pointers
+// it refers to.
+struct ArrowSchemaData {
+    std::string format, name;
+    std::vector<ArrowSchema*> children;
+};
+
+// Producer data of an exported ArrowArray: the buffer and child pointers it
+// refers to and a reference to the ColumnSet holding the buffers.
+struct ArrowArrayData {
+    std::shared_ptr<ColumnSet> cset;
+    std::vector<const void*> buffers;
+    std::vector<ArrowArray*> children;
+};
+
+// Exported in place of unallocated buffers: consumers may expect non-null
+// buffers and its zeros are a valid offset for empty arrays.
+alignas(64) static const uint8_t ARROW_EMPTY_BUFFER[64] = {0};
+
+const char* ArrowFormat(const PIL_PRIMITIVE_TYPE ptype) {
+    switch(ptype) {
+    case(PIL_TYPE_INT8):   return("c");
+    case(PIL_TYPE_UINT8):  return("C");
+    case(PIL_TYPE_INT16):  return("s");
+    case(PIL_TYPE_UINT16): return("S");
+    case(PIL_TYPE_INT32):  return("i");
+    case(PIL_TYPE_UINT32): return("I");
+    case(PIL_TYPE_INT64):  return("l");
+    case(PIL_TYPE_UINT64): return("L");
+    case(PIL_TYPE_FLOAT):  return("f");
+    case(PIL_TYPE_DOUBLE): return("g");
+    default: return(nullptr); // Booleans are stored as bytes rather than bits.
+    }
+}
+
+static void ArrowReleaseSchema(ArrowSchema* schema) {
+    if(schema->release == nullptr) return;
+    ArrowSchemaData* data = reinterpret_cast<ArrowSchemaData*>(schema->private_data);
+    for(size_t i = 0; i < data->children.size(); ++i) {
+        // Children may have been moved out and released by the consumer.
+        if(data->children[i]->release != nullptr) data->children[i]->release(data->children[i]);
+        delete data->children[i];
+    }
+    delete data;
+    schema->release = nullptr;
+}
+
+static void ArrowReleaseArray(ArrowArray* array) {
+    if(array->release == nullptr) return;
+    ArrowArrayData* data = reinterpret_cast<ArrowArrayData*>(array->private_data);
+    for(size_t i = 0; i < data->children.size(); ++i) {
+        if(data->children[i]->release != nullptr) data->children[i]->release(data->children[i]);
+        delete data->children[i];
+    }
+    delete data;
+    array->release = nullptr;
+}
+
+static void ArrowInitSchema(ArrowSchema* schema, const std::string& format, const std::string& name) {
+    ArrowSchemaData* data = new ArrowSchemaData();
+    data->format = format;
+    data->name = name;
+
+    schema->format = data->format.c_str();
+    schema->name = data->name.c_str();
+    schema->metadata = nullptr;
+    schema->flags = ARROW_FLAG_NULLABLE;
+    schema->n_children = 0;
+    schema->children = nullptr;
+    schema->dictionary = nullptr;
+    schema->release = &ArrowReleaseSchema;
+    schema->private_data = data;
+}
+
+static ArrowSchema* ArrowAddChild(ArrowSchema* schema) {
+    ArrowSchemaData* data = reinterpret_cast<ArrowSchemaData*>(schema->private_data);
+    data->children.push_back(new ArrowSchema());
+    data->children.back()->release = nullptr;
+    schema->n_children = data->children.size();
+    schema->children = &data->children[0];
+    return(data->children.back());
+}
+
+static void ArrowInitArray(ArrowArray* array, std::shared_ptr<ColumnSet> cset, const int64_t length, const int64_t null_count) {
+    ArrowArrayData* data = new ArrowArrayData();
+    data->cset = cset;
+
+    array->length = length;
+    array->null_count = null_count;
+    array->offset = 0;
+    array->n_buffers = 0;
+    array->n_children = 0;
+    array->buffers = nullptr;
+    array->children = nullptr;
+    array->dictionary = nullptr;
+    array->release = &ArrowReleaseArray;
+    array->private_data = data;
+}
+
+static void ArrowAddBuffer(ArrowArray* array, const void* buffer) {
+    ArrowArrayData* data = reinterpret_cast<ArrowArrayData*>(array->private_data);
+    data->buffers.push_back(buffer);
+    array->n_buffers = data->buffers.size();
+    array->buffers = &data->buffers[0];
+}
+
+static ArrowArray* ArrowAddChild(ArrowArray* array) {
+    ArrowArrayData* data = reinterpret_cast<ArrowArrayData*>(array->private_data);
+    data->children.push_back(new ArrowArray());
+    data->children.back()->release = nullptr;
+    array->n_children = data->children.size();
+    array->children = &data->children[0];
+    return(data->children.back());
+}
+
+// Data of a ColumnStore or a placeholder if it holds no data.
+static const void* ArrowData(const std::shared_ptr<ColumnStore>& cstore) {
+    const void* data = cstore->mutable_data();
+    return(data == nullptr ? ARROW_EMPTY_BUFFER : data);
+}
+
+// The Nullity bitmap is a vector of 32-bit words with record p at bit p % 32
+// of word p / 32, which matches the byte and bit order of Arrow validity
+// bitmaps on little-endian hosts.
+static const void* ArrowValidity(const std::shared_ptr<ColumnStore>& cstore) {
+    if(cstore->nullity.get() == nullptr || cstore->n_null == 0) return(nullptr);
+    return(cstore->nullity->mutable_data());
+}
+
+// Export the first `length` values of a ColumnStore as a primitive array.
+static void ArrowExportPrimitive(std::shared_ptr<ColumnSet> cset, const uint32_t column, const int64_t length,
+                                 const char* format, const std::string& name, ArrowSchema* schema, ArrowArray* array)
+{
+    const std::shared_ptr<ColumnStore>& cstore = cset->columns[column];
+    ArrowInitSchema(schema, format, name);
+    const void* validity = ArrowValidity(cstore);
+    ArrowInitArray(array, cset, length, validity == nullptr ? 0 : cstore->n_null);
+    ArrowAddBuffer(array, validity);
+    ArrowAddBuffer(array, ArrowData(cstore));
+}
+
+int ExportArrowColumn(const DecodedBatch::Column& column, const uint32_t n_records, ArrowSchema* schema, ArrowArray* array) {
+    schema->release = nullptr;
+    array->release = nullptr;
+
+    const char* format = ArrowFormat(column.field.ptype);
+    const std::shared_ptr<ColumnSet>& cset = column.cset;
+    if(format == nullptr || cset.get() == nullptr || cset->columns.size() == 0) return(-1);
+    const std::string& name = column.field.field_name;
+
+    if(column.field.cstore == PIL_CSTORE_COLUMN) {
+        for(size_t i = 0; i < cset->columns.size(); ++i) {
+            if(cset->columns[i]->n_records != n_records) return(-1);
+        }
+        if(cset->columns.size() == 1) {
+            ArrowExportPrimitive(cset, 0, n_records, format, name, schema, array);
+            return(1);
+        }
+
+        // Every stride is stored in its own ColumnStore: a struct array
+        // shares them as they are, unlike a fixed-size list.
+        ArrowInitSchema(schema, "+s", name);
+        ArrowInitArray(array, cset, n_records, 0);
+        ArrowAddBuffer(array, nullptr);
+        for(size_t i = 0; i < cset->columns.size(); ++i)
+            ArrowExportPrimitive(cset, i, n_records, format, std::to_string(i), ArrowAddChild(schema), ArrowAddChild(array));
+        return(1);
+    }
+
+    if(column.field.cstore != PIL_CSTORE_TENSOR || cset->columns.size() != 2) return(-1);
+    const std::shared_ptr<ColumnStore>& offsets = cset->columns[0];
+    if(offsets->n_records != (uint64_t)n_records + 1) return(-1);
+    const bool wide = (offsets->offset_width == sizeof(uint64_t));
+    const void* validity = ArrowValidity(offsets);
+
+    if(column.field.ptype == PIL_TYPE_UINT8) {
+        ArrowInitSchema(schema, wide ? "Z" : "z", name);
+        ArrowInitArray(array, cset, n_records, validity == nullptr ? 0 : offsets->n_null);
+        ArrowAddBuffer(array, validity);
+        ArrowAddBuffer(array, ArrowData(offsets));
+        ArrowAddBuffer(array, ArrowData(cset->columns[1]));
+        return(1);
+    }
+
+    ArrowInitSchema(schema, wide ? "+L" : "+l", name);
+    ArrowInitArray(array, cset, n_records, validity == nullptr ? 0 : offsets->n_null);
+    ArrowAddBuffer(array, validity);
+    ArrowAddBuffer(array, ArrowData(offsets));
+    // The values ColumnStore counts records rather than values.
+    const int64_t n_values = wide ? reinterpret_cast<const uint64_t*>(offsets->mutable_data())[n_records]
+                                  : reinterpret_cast<const uint32_t*>(offsets->mutable_data())[n_records];
+    ArrowExportPrimitive(cset, 1, n_values, format, "item", ArrowAddChild(schema), ArrowAddChild(array));
+    return(1);
+}
+
+int ExportArrowBatch(const DecodedBatch& batch, ArrowSchema* schema, ArrowArray* array) {
+    schema->release = nullptr;
+    array->release = nullptr;
+    if(batch.IsCurrent() == false) return(-1);
+
+    ArrowInitSchema(schema, "+s", "");
+    schema->flags = 0;
+    ArrowInitArray(array, nullptr, batch.n_records, 0);
+    ArrowAddBuffer(array, nullptr);
+
+    for(size_t i = 0; i < batch.columns.size(); ++i) {
+        if(ExportArrowColumn(batch.columns[i], batch.n_records, ArrowAddChild(schema), ArrowAddChild(array)) != 1) {
+            schema->release(schema);
+            array->release(array);
+            return(-1);
+        }
+    }
+    return(1);
+}
+
+}
@@ -0,0 +1,103 @@
+#ifndef EXPORTERS_ARROW_EXPORT_H_
+#define EXPORTERS_ARROW_EXPORT_H_
+
+#include <cstdint>
+
+#include "decoded_batch.h"
+
+// Structures of the Arrow C Data Interface as given by its specification.
+// The guard is shared with Arrow's own abi.h such that either definition
+// can be included first.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C" {
+
+struct ArrowSchema {
+    // Array type description
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+struct ArrowArray {
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+}
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+namespace pil {
+
+/**<
+ * Arrow format string of a primitive type.
+ * @param ptype Primitive type.
+ * @return      Returns the format string or nullptr if the type has no Arrow layout in Pil.
+ */
+const char* ArrowFormat(const PIL_PRIMITIVE_TYPE ptype);
+
+/**<
+ * Export a Field of a decoded RecordBatch through the Arrow C Data
+ * Interface. Column-model Fields with a single ColumnStore become primitive
+ * arrays and Fields with several ColumnStores (fixed strides) become struct
+ * arrays with one child per ColumnStore named by its index. Tensor-model
+ * Fields become binary arrays for PIL_TYPE_UINT8 and list arrays of the
+ * primitive type otherwise: the large variants if the offsets are 64-bit.
+ *
+ * The Arrow buffers point into the ColumnStores: the offsets, values and
+ * Nullity bitmaps already have the Arrow layout (64-byte aligned, offsets
+ * starting at 0, validity bits in little-endian order) and are not copied.
+ * The exported arrays hold references to the ColumnSets, but the memory is
+ * allocated from the arena of the Table, which is reset by the next
+ * FinalizeBatch: the arrays are invalid from then on and must be released
+ * before the RecordBatch is finalized or the Table destroyed.
+ * @param column    Source Field.
+ * @param n_records Number of records in the RecordBatch.
+ * @param schema    Destination ArrowSchema, released by the consumer.
+ * @param array     Destination ArrowArray, released by the consumer.
+ * @return          Returns 1 if successful or -1 if the Field cannot be exported.
+ */
+int ExportArrowColumn(const DecodedBatch::Column& column, const uint32_t n_records, ArrowSchema* schema, ArrowArray* array);
+
+/**<
+ * Export a decoded RecordBatch as an Arrow struct array with one child per
+ * Field (see ExportArrowColumn): the C Data Interface representation of a
+ * record batch that engines such as DuckDB and Polars import. The same
+ * lifetime as in ExportArrowColumn applies to the whole batch.
+ * @param batch  Source DecodedBatch.
+ * @param schema Destination ArrowSchema, released by the consumer.
+ * @param array  Destination ArrowArray, released by the consumer.
+ * @return       Returns 1 if successful or -1 if the batch has been finalized or a Field cannot be exported.
+ */
+int ExportArrowBatch(const DecodedBatch& batch, ArrowSchema* schema, ArrowArray* array);
+
+}
+
+#endif /* EXPORTERS_ARROW_EXPORT_H_ */
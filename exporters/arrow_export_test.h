@@ -0,0 +1,134 @@
+#ifndef EXPORTERS_ARROW_EXPORT_TEST_H_
+#define EXPORTERS_ARROW_EXPORT_TEST_H_
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+#include "arrow_export.h"
+
+namespace pil {
+
+// Read a validity bit as an Arrow consumer does.
+static bool ArrowTestValid(const ArrowArray* array, const int64_t i) {
+    if(array->buffers[0] == nullptr) return(true);
+    return((reinterpret_cast<const uint8_t*>(array->buffers[0])[i / 8] >> (i % 8)) & 1);
+}
+
+TEST(ExporterTests, ArrowExportBatch) {
+    const uint32_t n_records = 1000;
+    TableConstructor table;
+    table.batch_size = 1000000;
+    RecordBuilder rbuild;
+    for(uint32_t i = 0; i < n_records; ++i) {
+        if(i % 7 != 1) rbuild.Add<int32_t>("POS", PIL_TYPE_INT32, i);
+        rbuild.Add<double>("SCORE", PIL_TYPE_DOUBLE, i / 2.0);
+        const std::string name = "record" + std::to_string(i);
+        rbuild.AddArray<uint8_t>("NAME", PIL_TYPE_UINT8, reinterpret_cast<const uint8_t*>(name.data()), name.size());
+        if(i % 3 == 0) rbuild.AddArray<int16_t>("DEPTHS", PIL_TYPE_INT16, std::vector<int16_t>(i % 5 + 1, -(int16_t)i));
+        rbuild.Add<int32_t>("PAIR", PIL_TYPE_INT32, std::vector<int32_t>({(int32_t)i, (int32_t)i + 1}));
+        ASSERT_EQ(1, table.Append(rbuild));
+    }
+
+    DecodedBatch batch;
+    ASSERT_EQ(1, batch.FromTable(table));
+    ArrowSchema schema;
+    ArrowArray array;
+    ASSERT_EQ(1, ExportArrowBatch(batch, &schema, &array));
+    ASSERT_STREQ("+s", schema.format);
+    ASSERT_EQ(5, schema.n_children);
+    ASSERT_EQ(5, array.n_children);
+    ASSERT_EQ(n_records, array.length);
+
+    // Primitive array sharing the values and Nullity bitmap.
+    ASSERT_STREQ("POS", schema.children[0]->name);
+    ASSERT_STREQ("i", schema.children[0]->format);
+    const ArrowArray* pos = array.children[0];
+    ASSERT_EQ(2, pos->n_buffers);
+    ASSERT_EQ(batch.Find("POS")->cset->columns[0]->mutable_data(), pos->buffers[1]);
+    ASSERT_EQ((n_records + 5) / 7, pos->null_count);
+    for(uint32_t i = 0; i < n_records; ++i) {
+        ASSERT_EQ(i % 7 != 1, ArrowTestValid(pos, i));
+        if(i % 7 != 1) {
+            ASSERT_EQ(i, reinterpret_cast<const int32_t*>(pos->buffers[1])[i]);
+        }
+    }
+    ASSERT_STREQ("g", schema.children[1]->format);
+    ASSERT_EQ(0, array.children[1]->null_count);
+    ASSERT_EQ(nullptr, array.children[1]->buffers[0]);
+
+    // Binary array from a UINT8 Tensor.
+    ASSERT_STREQ("z", schema.children[2]->format);
+    const ArrowArray* names = array.children[2];
+    ASSERT_EQ(3, names->n_buffers);
+    const int32_t* offsets = reinterpret_cast<const int32_t*>(names->buffers[1]);
+    ASSERT_EQ(0, offsets[0]);
+    ASSERT_EQ("record999", std::string(reinterpret_cast<const char*>(names->buffers[2]) + offsets[999], offsets[1000] - offsets[999]));
+
+    // List array from a sparse INT16 Tensor.
+    ASSERT_STREQ("+l", schema.children[3]->format);
+    ASSERT_STREQ("s", schema.children[3]->children[0]->format);
+    const ArrowArray* depths = array.children[3];
+    ASSERT_EQ(n_records - (n_records + 2) / 3, depths->null_count);
+    ASSERT_FALSE(ArrowTestValid(depths, 1));
+    ASSERT_TRUE(ArrowTestValid(depths, 3));
+    offsets = reinterpret_cast<const int32_t*>(depths->buffers[1]);
+    ASSERT_EQ(4, offsets[4] - offsets[3]);
+    ASSERT_EQ(offsets[n_records], depths->children[0]->length);
+    ASSERT_EQ(-3, reinterpret_cast<const int16_t*>(depths->children[0]->buffers[1])[offsets[3]]);
+
+    // Struct array with one child per stride.
+    ASSERT_STREQ("+s", schema.children[4]->format);
+    ASSERT_EQ(2, array.children[4]->n_children);
+    ASSERT_STREQ("1", schema.children[4]->children[1]->name);
+    ASSERT_EQ(11, reinterpret_cast<const int32_t*>(array.children[4]->children[1]->buffers[1])[10]);
+
+    // Children moved out by the consumer are released on their own.
+    ArrowArray moved = *array.children[2];
+    array.children[2]->release = nullptr;
+    array.release(&array);
+    ASSERT_EQ(nullptr, array.release);
+    moved.release(&moved);
+    schema.release(&schema);
+    ASSERT_EQ(nullptr, schema.release);
+
+    // Finalizing the RecordBatch resets the arena holding its buffers.
+    ASSERT_TRUE(batch.IsCurrent());
+    ASSERT_EQ(1, table.FinalizeBatch(table.meta_data.batches.size() - 1));
+    ASSERT_FALSE(batch.IsCurrent());
+    ASSERT_EQ(-1, ExportArrowBatch(batch, &schema, &array));
+    ASSERT_EQ(nullptr, schema.release);
+    ASSERT_EQ(nullptr, array.release);
+}
+
+TEST(ExporterTests, ArrowExportColumn) {
+    // 64-bit offsets map to the large variants.
+    DecodedBatch::Column column;
+    column.field.field_name = "LONG";
+    column.field.cstore = PIL_CSTORE_TENSOR;
+    column.field.ptype = PIL_TYPE_UINT8;
+    std::shared_ptr< ColumnSetBuilderTensor<uint8_t> > cset = std::make_shared< ColumnSetBuilderTensor<uint8_t> >();
+    cset->Append(std::vector<uint8_t>({'a', 'b'}));
+    cset->PadNull();
+    ASSERT_EQ(1, cset->WidenOffsets());
+    column.cset = cset;
+
+    ArrowSchema schema;
+    ArrowArray array;
+    ASSERT_EQ(1, ExportArrowColumn(column, 2, &schema, &array));
+    ASSERT_STREQ("Z", schema.format);
+    ASSERT_EQ(1, array.null_count);
+    ASSERT_EQ(2, reinterpret_cast<const int64_t*>(array.buffers[1])[2]);
+    schema.release(&schema);
+    array.release(&array);
+
+    column.field.ptype = PIL_TYPE_INT32;
+    ASSERT_EQ(-1, ExportArrowColumn(column, 3, &schema, &array));
+    ASSERT_EQ(nullptr, array.release);
+    column.field.ptype = PIL_TYPE_BOOLEAN;
+    ASSERT_EQ(-1, ExportArrowColumn(column, 2, &schema, &array));
+    ASSERT_EQ(nullptr, schema.release);
+}
+
+}
+
+#endif /* EXPORTERS_ARROW_EXPORT_TEST_H_ */
@@ -0,0 +1,32 @@
+#include "decoded_batch.h"
+
+namespace pil {
+
+int DecodedBatch::FromTable(const TableConstructor& table) {
+    clear();
+    if(table.meta_data.batches.size() == 0) return(-1);
+
+    const RecordBatch& batch = *table.meta_data.batches.back();
+    n_records = batch.n_rec;
+    table_ = &table;
+    n_finalized_ = table.n_finalized;
+    for(size_t i = 0; i < batch.local_dict.size(); ++i) {
+        if(i >= table.build_csets.size() || table.build_csets[i].get() == nullptr) return(-1);
+        if(table.build_csets[i]->size() == 0) continue;
+
+        Column column;
+        column.field = table.field_dict.dict[batch.local_dict[i]];
+        column.cset = table.build_csets[i];
+        map_[column.field.field_name] = columns.size();
+        columns.push_back(column);
+    }
+    return(1);
+}
+
+const DecodedBatch::Column* DecodedBatch::Find(const std::string& field_name) const {
+    std::unordered_map<std::string, uint32_t>::const_iterator it = map_.find(field_name);
+    if(it == map_.end()) return(nullptr);
+    return(&columns[it->second]);
+}
+
+}
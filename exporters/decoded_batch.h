@@ -0,0 +1,95 @@
+#ifndef EXPORTERS_DECODED_BATCH_H_
+#define EXPORTERS_DECODED_BATCH_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../table.h"
+
+namespace pil {
+
+// A RecordBatch in its decoded representation: the plain ColumnSets of every
+// Field in the batch together with the Field types. Column-model Fields hold
+// one value per record in columns[0] and Tensor-model Fields hold the record
+// offsets in columns[0] and the values in columns[1]. Records are valid
+// unless cleared in the nullity bitmap of columns[0].
+//
+// Exporters only read from a DecodedBatch such that several threads can
+// format disjoint ranges of records at the same time.
+class DecodedBatch {
+public:
+    struct Column {
+        // Returns TRUE if the record holds a value.
+        bool IsValid(const uint32_t record) const { return(cset->columns[0]->IsValid(record)); }
+
+        // Returns a pointer to the values of a Column-model Field.
+        template <class T>
+        const T* values() const { return(reinterpret_cast<const T*>(cset->columns[0]->mutable_data())); }
+
+        // Returns a pointer to the values of a Tensor-model Field.
+        template <class T>
+        const T* tensor_values() const { return(reinterpret_cast<const T*>(cset->columns[1]->mutable_data())); }
+
+        // Offset of the first value of a record in a Tensor-model Field.
+        // The record ends at offset(record + 1).
+        uint64_t offset(const uint32_t record) const {
+            if(cset->columns[0]->offset_width == sizeof(uint64_t))
+                return(reinterpret_cast<const uint64_t*>(cset->columns[0]->mutable_data())[record]);
+            return(reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data())[record]);
+        }
+
+        DictionaryFieldType field;
+        std::shared_ptr<ColumnSet> cset;
+    };
+
+public:
+    DecodedBatch() : n_records(0), table_(nullptr), n_finalized_(0){}
+
+    /**<
+     * Take the ColumnSets of the RecordBatch under construction in a Table
+     * before it is finalized. The ColumnSets are shared, not copied: they
+     * must not be appended to while the DecodedBatch is in use and the
+     * DecodedBatch must not outlive the Table. Their buffers are allocated
+     * from the arena of the Table, which is reset by the next FinalizeBatch:
+     * the DecodedBatch is invalid from then on (see IsCurrent).
+     * @param table Source TableConstructor.
+     * @return      Returns 1 if successful or -1 if the Table holds no RecordBatch.
+     */
+    int FromTable(const TableConstructor& table);
+
+    /**<
+     * Check that the RecordBatch taken by FromTable has not been finalized
+     * since. Exporters refuse batches that are no longer current.
+     * @return Returns TRUE if the buffers are still valid or FALSE otherwise.
+     */
+    bool IsCurrent() const { return(table_ == nullptr || table_->n_finalized == n_finalized_); }
+
+    /**<
+     * Find a Field by name.
+     * @param field_name Name of the Field.
+     * @return           Returns a pointer to the Column or nullptr if the Field is not in the batch.
+     */
+    const Column* Find(const std::string& field_name) const;
+
+    void clear() {
+        n_records = 0;
+        columns.clear();
+        map_.clear();
+        table_ = nullptr;
+        n_finalized_ = 0;
+    }
+
+public:
+    uint32_t n_records;
+    std::vector<Column> columns;
+
+private:
+    std::unordered_map<std::string, uint32_t> map_;
+    const TableConstructor* table_; // Source Table or nullptr if the columns were set directly.
+    uint64_t n_finalized_; // TableConstructor::n_finalized when the batch was taken.
+};
+
+}
+
+#endif /* EXPORTERS_DECODED_BATCH_H_ */
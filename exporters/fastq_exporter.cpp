@@ -0,0 +1,121 @@
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+#include "fastq_exporter.h"
+
+// Batches with fewer records are formatted by a single thread.
+#define PIL_FASTQ_EXPORT_MIN_PARALLEL 4096
+
+namespace pil {
+
+FastqExporter::FastqExporter() :
+    n_threads(1), name_field("NAME"), bases_field("BASES"), qual_field("QUAL"),
+    columns_{nullptr, nullptr, nullptr}
+{
+}
+
+int FastqExporter::Open(const std::string& path) {
+    if(stream_.is_open()) stream_.close();
+    stream_.open(path, std::ios::binary);
+    return(stream_.good() ? 1 : -1);
+}
+
+int FastqExporter::Close() {
+    if(stream_.is_open() == false) return(-1);
+    stream_.flush();
+    const bool good = stream_.good();
+    stream_.close();
+    return(good ? 1 : -1);
+}
+
+uint64_t FastqExporter::MaxLength(const uint32_t from, const uint32_t to) const {
+    // Header and separator characters, newlines and the qualities written
+    // in place of missing ones.
+    uint64_t n_bytes = 6 * (uint64_t)(to - from);
+    for(int i = 0; i < 3; ++i) n_bytes += columns_[i]->offset(to) - columns_[i]->offset(from);
+    n_bytes += columns_[1]->offset(to) - columns_[1]->offset(from);
+    return(n_bytes);
+}
+
+uint64_t FastqExporter::Format(const uint32_t from, const uint32_t to, uint8_t* dst) const {
+    const uint8_t* names = columns_[0]->tensor_values<uint8_t>();
+    const uint8_t* bases = columns_[1]->tensor_values<uint8_t>();
+    const uint8_t* quals = columns_[2]->tensor_values<uint8_t>();
+
+    uint8_t* out = dst;
+    for(uint32_t i = from; i < to; ++i) {
+        const uint64_t name_offset = columns_[0]->offset(i);
+        const uint64_t l_name = columns_[0]->offset(i + 1) - name_offset;
+        *out++ = '@';
+        memcpy(out, names + name_offset, l_name);
+        out += l_name;
+        *out++ = '\n';
+
+        // A single `*` denotes missing bases or qualities in SAM and BAM.
+        const uint64_t bases_offset = columns_[1]->offset(i);
+        uint64_t l_seq = columns_[1]->offset(i + 1) - bases_offset;
+        if(l_seq == 1 && bases[bases_offset] == '*') l_seq = 0;
+        memcpy(out, bases + bases_offset, l_seq);
+        out += l_seq;
+        *out++ = '\n';
+        *out++ = '+';
+        *out++ = '\n';
+
+        const uint64_t qual_offset = columns_[2]->offset(i);
+        const uint64_t l_qual = columns_[2]->offset(i + 1) - qual_offset;
+        if(l_qual == l_seq) memcpy(out, quals + qual_offset, l_seq);
+        else memset(out, '!', l_seq);
+        out += l_seq;
+        *out++ = '\n';
+    }
+    return(out - dst);
+}
+
+int64_t FastqExporter::Write(const DecodedBatch& batch) {
+    if(stream_.is_open() == false) return(-1);
+    if(batch.IsCurrent() == false) return(-1);
+
+    const std::string* field_names[3] = {&name_field, &bases_field, &qual_field};
+    for(int i = 0; i < 3; ++i) {
+        columns_[i] = batch.Find(*field_names[i]);
+        if(columns_[i] == nullptr) return(-1);
+        if(columns_[i]->field.cstore != PIL_CSTORE_TENSOR || columns_[i]->field.ptype != PIL_TYPE_UINT8) return(-1);
+    }
+    if(batch.n_records == 0) return(0);
+
+    // Format ranges of records in parallel into buffers that are large
+    // enough for the range such that no formatting step reallocates.
+    const uint32_t n_parts = batch.n_records < PIL_FASTQ_EXPORT_MIN_PARALLEL ? 1 : std::max(1u, n_threads);
+    if(buffers_.size() < n_parts) buffers_.resize(n_parts);
+    const uint32_t part_size = batch.n_records / n_parts;
+    std::vector<uint32_t> bounds(n_parts + 1, batch.n_records);
+    for(uint32_t p = 0; p < n_parts; ++p) bounds[p] = p * part_size;
+
+    std::vector<int64_t> lengths(n_parts);
+    std::vector<std::thread> threads;
+    for(uint32_t p = 0; p < n_parts; ++p) {
+        if(n_parts == 1) lengths[p] = FormatPart(bounds[p], bounds[p + 1], p);
+        else threads.push_back(std::thread([this, &lengths, &bounds, p]() { lengths[p] = FormatPart(bounds[p], bounds[p + 1], p); }));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    for(uint32_t p = 0; p < n_parts; ++p) {
+        if(lengths[p] < 0) return(-1);
+    }
+
+    for(uint32_t p = 0; p < n_parts; ++p)
+        stream_.write(reinterpret_cast<const char*>(buffers_[p]->mutable_data()), lengths[p]);
+
+    if(stream_.good() == false) return(-2);
+    return(batch.n_records);
+}
+
+int64_t FastqExporter::FormatPart(const uint32_t from, const uint32_t to, const uint32_t part) {
+    const uint64_t n_bytes = MaxLength(from, to);
+    if(buffers_[part].get() == nullptr) {
+        if(AllocateResizableBuffer(thread_local_memory_pool(), n_bytes, &buffers_[part]) != 1) return(-1);
+    } else if(buffers_[part]->Resize(n_bytes, false) != 1) return(-1);
+    return(Format(from, to, buffers_[part]->mutable_data()));
+}
+
+}
@@ -0,0 +1,80 @@
+#ifndef EXPORTERS_FASTQ_EXPORTER_H_
+#define EXPORTERS_FASTQ_EXPORTER_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "../buffer.h"
+#include "decoded_batch.h"
+
+namespace pil {
+
+// Export the NAME, BASES and QUAL Fields of decoded RecordBatches as FASTQ.
+// The records of a batch are split into ranges that are formatted by several
+// threads into buffers sized for the worst case up front, and the buffers are
+// then written in order. Missing qualities (null or `*`) are written as `!`.
+//
+// Example usage:
+//
+// FastqExporter exporter;
+// exporter.n_threads = 4;
+// exporter.Open("reads.fq");
+// DecodedBatch batch;
+// batch.FromTable(table);
+// exporter.Write(batch);
+// exporter.Close();
+class FastqExporter {
+public:
+    FastqExporter();
+
+    /**<
+     * Open the output file.
+     * @param path Path to the FASTQ file.
+     * @return     Returns 1 if successful or -1 otherwise.
+     */
+    int Open(const std::string& path);
+
+    /**<
+     * Format and write every record of a decoded RecordBatch.
+     * @param batch Source DecodedBatch.
+     * @return      Returns the number of records written, -1 if the output is not open, the batch has been finalized, or a Field is missing or has the wrong type, or -2 if writing failed.
+     */
+    int64_t Write(const DecodedBatch& batch);
+
+    /**<
+     * Flush and close the output file.
+     * @return Returns 1 if successful or -1 otherwise.
+     */
+    int Close();
+
+private:
+    /**<
+     * Format the records [from, to) into `dst`, which holds at least
+     * MaxLength(from, to) bytes.
+     * @return Returns the number of bytes written.
+     */
+    uint64_t Format(const uint32_t from, const uint32_t to, uint8_t* dst) const;
+    uint64_t MaxLength(const uint32_t from, const uint32_t to) const;
+
+    /**<
+     * Size the output buffer of a thread for the records [from, to) and
+     * format them into it. Run by the formatting thread itself such that
+     * the buffer is drawn from its thread_local_memory_pool().
+     * @return Returns the number of bytes written or -1 if the buffer cannot be allocated.
+     */
+    int64_t FormatPart(const uint32_t from, const uint32_t to, const uint32_t part);
+
+public:
+    uint32_t n_threads; // Threads used to format batches.
+    std::string name_field, bases_field, qual_field;
+
+private:
+    std::ofstream stream_;
+    const DecodedBatch::Column* columns_[3]; // Name, bases and qualities of the current batch.
+    std::vector< std::shared_ptr<ResizableBuffer> > buffers_; // Output buffer of every thread.
+};
+
+}
+
+#endif /* EXPORTERS_FASTQ_EXPORTER_H_ */
@@ -0,0 +1,344 @@
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+
+#include "sam_exporter.h"
+
+// Batches with fewer records are formatted by a single thread.
+#define PIL_SAM_EXPORT_MIN_PARALLEL 4096
+
+// Upper bound of the length of a formatted aux value: integers take at
+// most 11 characters and floats printed with "%g" at most 13.
+#define PIL_SAM_EXPORT_MAX_VALUE 24
+
+namespace pil {
+
+// Mandatory Fields in SAM order with their storage model and type.
+static const char* SAM_EXPORT_FIELDS[11] = {"NAME", "FLAG", "RNAME", "POS", "MAPQ", "CIGAR", "RNEXT", "PNEXT", "TLEN", "BASES", "QUAL"};
+static const PIL_CSTORE_TYPE SAM_EXPORT_CSTORES[11] = {PIL_CSTORE_TENSOR, PIL_CSTORE_COLUMN, PIL_CSTORE_COLUMN, PIL_CSTORE_COLUMN, PIL_CSTORE_COLUMN, PIL_CSTORE_TENSOR,
+                                                       PIL_CSTORE_COLUMN, PIL_CSTORE_COLUMN, PIL_CSTORE_COLUMN, PIL_CSTORE_TENSOR, PIL_CSTORE_TENSOR};
+static const PIL_PRIMITIVE_TYPE SAM_EXPORT_PTYPES[11] = {PIL_TYPE_UINT8, PIL_TYPE_UINT16, PIL_TYPE_UINT32, PIL_TYPE_UINT32, PIL_TYPE_UINT8, PIL_TYPE_UINT8,
+                                                         PIL_TYPE_UINT32, PIL_TYPE_INT32, PIL_TYPE_INT32, PIL_TYPE_UINT8, PIL_TYPE_UINT8};
+
+// SAM type of a primitive type or 0 if there is none.
+static char SamPrimitiveToType(const PIL_PRIMITIVE_TYPE ptype) {
+    switch(ptype) {
+    case(PIL_TYPE_INT8):   return('c');
+    case(PIL_TYPE_UINT8):  return('C');
+    case(PIL_TYPE_INT16):  return('s');
+    case(PIL_TYPE_UINT16): return('S');
+    case(PIL_TYPE_INT32):  return('i');
+    case(PIL_TYPE_UINT32): return('I');
+    case(PIL_TYPE_FLOAT):  return('f');
+    default: return(0);
+    }
+}
+
+static inline uint8_t* SamFormatUnsigned(uint64_t value, uint8_t* dst) {
+    uint8_t digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while(value);
+    while(n) *dst++ = digits[--n];
+    return(dst);
+}
+
+static inline uint8_t* SamFormatSigned(const int64_t value, uint8_t* dst) {
+    if(value >= 0) return(SamFormatUnsigned(value, dst));
+    *dst++ = '-';
+    return(SamFormatUnsigned(0 - (uint64_t)value, dst));
+}
+
+// Format the value at offset i of an array of the given primitive type.
+static inline uint8_t* SamFormatValue(const uint8_t* data, const uint64_t i, const PIL_PRIMITIVE_TYPE ptype, uint8_t* dst) {
+    switch(ptype) {
+    case(PIL_TYPE_INT8):   return(SamFormatSigned(reinterpret_cast<const int8_t*>(data)[i], dst));
+    case(PIL_TYPE_UINT8):  return(SamFormatUnsigned(data[i], dst));
+    case(PIL_TYPE_INT16):  return(SamFormatSigned(reinterpret_cast<const int16_t*>(data)[i], dst));
+    case(PIL_TYPE_UINT16): return(SamFormatUnsigned(reinterpret_cast<const uint16_t*>(data)[i], dst));
+    case(PIL_TYPE_INT32):  return(SamFormatSigned(reinterpret_cast<const int32_t*>(data)[i], dst));
+    case(PIL_TYPE_UINT32): return(SamFormatUnsigned(reinterpret_cast<const uint32_t*>(data)[i], dst));
+    case(PIL_TYPE_FLOAT):
+        return(dst + snprintf(reinterpret_cast<char*>(dst), PIL_SAM_EXPORT_MAX_VALUE, "%g", reinterpret_cast<const float*>(data)[i]));
+    default: return(dst);
+    }
+}
+
+// Write a text Field or `*` if the record holds no text.
+static inline uint8_t* SamFormatText(const DecodedBatch::Column* column, const uint32_t i, uint8_t* dst) {
+    if(column == nullptr || column->IsValid(i) == false || column->offset(i + 1) == column->offset(i)) {
+        *dst++ = '*';
+        return(dst);
+    }
+    const uint64_t offset = column->offset(i);
+    const uint64_t length = column->offset(i + 1) - offset;
+    memcpy(dst, column->tensor_values<uint8_t>() + offset, length);
+    return(dst + length);
+}
+
+// Value of a scalar mandatory Field or the default value if it is missing.
+template <class T>
+static inline T SamLoadField(const DecodedBatch::Column* column, const uint32_t i, const T missing) {
+    if(column == nullptr) return(missing);
+    if(column->IsValid(i) == false) return(0);
+    return(column->values<T>()[i]);
+}
+
+SamExporter::SamExporter() :
+    n_threads(1), write_header(true), max_rname_(1), has_aux_types_(false),
+    columns_{nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}
+{
+}
+
+int SamExporter::Open(const std::string& path, const FileMetaData& meta_data) {
+    rnames_.clear();
+    aux_types_.clear();
+    max_rname_ = 1;
+
+    const std::string* names = meta_data.GetKeyValue(PIL_SAM_RNAME_KEY);
+    if(names != nullptr) {
+        size_t begin = 0;
+        for(size_t end = names->find('\n'); end != std::string::npos; end = names->find('\n', begin)) {
+            rnames_.push_back(names->substr(begin, end - begin));
+            max_rname_ = std::max<uint32_t>(max_rname_, end - begin);
+            begin = end + 1;
+        }
+    }
+
+    const std::string* types = meta_data.GetKeyValue(PIL_SAM_AUX_KEY);
+    has_aux_types_ = (types != nullptr);
+    if(types != nullptr) {
+        size_t begin = 0;
+        for(size_t end = types->find('\n'); end != std::string::npos; end = types->find('\n', begin)) {
+            const size_t tab = types->find('\t', begin);
+            if(tab == std::string::npos || tab > end) return(-1);
+            aux_types_.push_back(std::make_pair(types->substr(begin, tab - begin), types->substr(tab + 1, end - tab - 1)));
+            begin = end + 1;
+        }
+    }
+
+    if(stream_.is_open()) stream_.close();
+    stream_.open(path, std::ios::binary);
+    if(stream_.good() == false) return(-1);
+
+    const std::string* header = meta_data.GetKeyValue(PIL_SAM_HEADER_KEY);
+    if(write_header && header != nullptr) stream_.write(header->data(), header->size());
+    return(stream_.good() ? 1 : -1);
+}
+
+int SamExporter::Close() {
+    if(stream_.is_open() == false) return(-1);
+    stream_.flush();
+    const bool good = stream_.good();
+    stream_.close();
+    return(good ? 1 : -1);
+}
+
+int SamExporter::SetFields(const DecodedBatch& batch) {
+    for(int i = 0; i < 11; ++i) {
+        columns_[i] = batch.Find(SAM_EXPORT_FIELDS[i]);
+        if(columns_[i] == nullptr) continue;
+        if(columns_[i]->field.cstore != SAM_EXPORT_CSTORES[i] || columns_[i]->field.ptype != SAM_EXPORT_PTYPES[i]) return(-1);
+    }
+
+    aux_.clear();
+    if(has_aux_types_) {
+        for(size_t i = 0; i < aux_types_.size(); ++i) {
+            const std::string& spec = aux_types_[i].second;
+            AuxField aux;
+            aux.column = batch.Find(aux_types_[i].first);
+            if(aux.column == nullptr) continue;
+            if(aux_types_[i].first.size() < 2 || spec.size() == 0 || spec.size() > 2) return(-1);
+
+            memcpy(aux.tag, aux_types_[i].first.data(), 2);
+            aux.type = spec.back();
+            aux.b_array = (spec.size() == 2);
+            if(aux.b_array && spec[0] != 'B') return(-1);
+
+            const bool is_array = aux.b_array || aux.type == 'Z' || aux.type == 'H';
+            if(aux.column->field.ptype != SamTypeToPrimitive(aux.type)) return(-1);
+            if(aux.column->field.cstore != (is_array ? PIL_CSTORE_TENSOR : PIL_CSTORE_COLUMN)) return(-1);
+            aux_.push_back(aux);
+        }
+        return(1);
+    }
+
+    // Recognise aux Fields by their names: a tag optionally followed by
+    // its type (see SamAuxFields).
+    for(size_t i = 0; i < batch.columns.size(); ++i) {
+        const DecodedBatch::Column& column = batch.columns[i];
+        const std::string& name = column.field.field_name;
+        if(name.size() < 2 || (name.size() > 2 && name[2] != ':')) continue;
+        if(isalpha(name[0]) == false || isalnum(name[1]) == false) continue;
+
+        bool mandatory = false;
+        for(int j = 0; j < 11; ++j) mandatory |= (&column == columns_[j]);
+        if(mandatory) continue;
+
+        AuxField aux;
+        memcpy(aux.tag, name.data(), 2);
+        aux.column = &column;
+        aux.type = SamPrimitiveToType(column.field.ptype);
+        if(aux.type == 0) continue;
+        aux.b_array = false;
+        if(column.field.cstore == PIL_CSTORE_TENSOR) {
+            if(aux.type == 'C') aux.type = 'Z';
+            else aux.b_array = true;
+        }
+        aux_.push_back(aux);
+    }
+    return(1);
+}
+
+uint64_t SamExporter::MaxLength(const uint32_t from, const uint32_t to) const {
+    const uint64_t n_records = to - from;
+    // Tabs and newline, `*` for missing text, FLAG, POS, MAPQ, PNEXT, TLEN
+    // and the reference names.
+    uint64_t n_bytes = n_records * (12 + 4 + 5 + 10 + 3 + 11 + 11 + 2 * max_rname_);
+    for(int i = 0; i < 11; ++i) {
+        if(columns_[i] != nullptr && SAM_EXPORT_CSTORES[i] == PIL_CSTORE_TENSOR)
+            n_bytes += columns_[i]->offset(to) - columns_[i]->offset(from);
+    }
+
+    // Tab, "TG:B:t" and the value of scalars or the values of arrays.
+    for(size_t a = 0; a < aux_.size(); ++a) {
+        n_bytes += n_records * (7 + PIL_SAM_EXPORT_MAX_VALUE);
+        if(aux_[a].column->field.cstore == PIL_CSTORE_TENSOR) {
+            const uint64_t n_values = aux_[a].column->offset(to) - aux_[a].column->offset(from);
+            n_bytes += n_values * (aux_[a].b_array ? 1 + PIL_SAM_EXPORT_MAX_VALUE : 1);
+        }
+    }
+    return(n_bytes);
+}
+
+uint8_t* SamExporter::FormatName(const uint32_t rname, uint8_t* dst) const {
+    if(rname >= rnames_.size() || rnames_[rname].size() == 0) {
+        *dst++ = '*';
+        return(dst);
+    }
+    memcpy(dst, rnames_[rname].data(), rnames_[rname].size());
+    return(dst + rnames_[rname].size());
+}
+
+uint64_t SamExporter::Format(const uint32_t from, const uint32_t to, uint8_t* dst) const {
+    uint8_t* out = dst;
+    for(uint32_t i = from; i < to; ++i) {
+        out = SamFormatText(columns_[0], i, out);
+        *out++ = '\t';
+        out = SamFormatUnsigned(SamLoadField<uint16_t>(columns_[1], i, 4), out);
+        *out++ = '\t';
+        const uint32_t rname = SamLoadField<uint32_t>(columns_[2], i, UINT32_MAX);
+        out = FormatName(rname, out);
+        *out++ = '\t';
+        out = SamFormatUnsigned(SamLoadField<uint32_t>(columns_[3], i, 0), out);
+        *out++ = '\t';
+        out = SamFormatUnsigned(SamLoadField<uint8_t>(columns_[4], i, 0), out);
+        *out++ = '\t';
+        out = SamFormatText(columns_[5], i, out);
+        *out++ = '\t';
+        // The mate reference is abbreviated as `=` if equal to the reference
+        // as in `samtools view`.
+        const uint32_t rnext = SamLoadField<uint32_t>(columns_[6], i, UINT32_MAX);
+        if(rnext == rname && rname < rnames_.size() && rnames_[rname] != "*") *out++ = '=';
+        else out = FormatName(rnext, out);
+        *out++ = '\t';
+        out = SamFormatSigned(SamLoadField<int32_t>(columns_[7], i, 0), out);
+        *out++ = '\t';
+        out = SamFormatSigned(SamLoadField<int32_t>(columns_[8], i, 0), out);
+        *out++ = '\t';
+        out = SamFormatText(columns_[9], i, out);
+        *out++ = '\t';
+        out = SamFormatText(columns_[10], i, out);
+
+        for(size_t a = 0; a < aux_.size(); ++a) {
+            const AuxField& aux = aux_[a];
+            if(aux.column->IsValid(i) == false) continue;
+
+            *out++ = '\t';
+            *out++ = aux.tag[0];
+            *out++ = aux.tag[1];
+            *out++ = ':';
+            const PIL_PRIMITIVE_TYPE ptype = aux.column->field.ptype;
+            if(aux.column->field.cstore == PIL_CSTORE_COLUMN) {
+                if(aux.type == 'A') {
+                    *out++ = 'A';
+                    *out++ = ':';
+                    *out++ = aux.column->values<uint8_t>()[i];
+                    continue;
+                }
+                // Integers of every width are written as `i`.
+                *out++ = aux.type == 'f' ? 'f' : 'i';
+                *out++ = ':';
+                out = SamFormatValue(aux.column->cset->columns[0]->mutable_data(), i, ptype, out);
+                continue;
+            }
+
+            const uint64_t offset = aux.column->offset(i);
+            const uint64_t n_values = aux.column->offset(i + 1) - offset;
+            if(aux.b_array == false) {
+                *out++ = aux.type;
+                *out++ = ':';
+                memcpy(out, aux.column->tensor_values<uint8_t>() + offset, n_values);
+                out += n_values;
+                continue;
+            }
+
+            *out++ = 'B';
+            *out++ = ':';
+            *out++ = aux.type;
+            const uint8_t* values = aux.column->cset->columns[1]->mutable_data();
+            for(uint64_t j = offset; j < offset + n_values; ++j) {
+                *out++ = ',';
+                out = SamFormatValue(values, j, ptype, out);
+            }
+        }
+        *out++ = '\n';
+    }
+    return(out - dst);
+}
+
+int64_t SamExporter::Write(const DecodedBatch& batch) {
+    if(stream_.is_open() == false) return(-1);
+    if(batch.IsCurrent() == false) return(-1);
+    if(SetFields(batch) != 1) return(-1);
+    if(batch.n_records == 0) return(0);
+
+    // Format ranges of records in parallel into buffers that are large
+    // enough for the range such that no formatting step reallocates.
+    const uint32_t n_parts = batch.n_records < PIL_SAM_EXPORT_MIN_PARALLEL ? 1 : std::max(1u, n_threads);
+    if(buffers_.size() < n_parts) buffers_.resize(n_parts);
+    const uint32_t part_size = batch.n_records / n_parts;
+    std::vector<uint32_t> bounds(n_parts + 1, batch.n_records);
+    for(uint32_t p = 0; p < n_parts; ++p) bounds[p] = p * part_size;
+
+    std::vector<int64_t> lengths(n_parts);
+    std::vector<std::thread> threads;
+    for(uint32_t p = 0; p < n_parts; ++p) {
+        if(n_parts == 1) lengths[p] = FormatPart(bounds[p], bounds[p + 1], p);
+        else threads.push_back(std::thread([this, &lengths, &bounds, p]() { lengths[p] = FormatPart(bounds[p], bounds[p + 1], p); }));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    for(uint32_t p = 0; p < n_parts; ++p) {
+        if(lengths[p] < 0) return(-1);
+    }
+
+    for(uint32_t p = 0; p < n_parts; ++p)
+        stream_.write(reinterpret_cast<const char*>(buffers_[p]->mutable_data()), lengths[p]);
+
+    if(stream_.good() == false) return(-2);
+    return(batch.n_records);
+}
+
+int64_t SamExporter::FormatPart(const uint32_t from, const uint32_t to, const uint32_t part) {
+    const uint64_t n_bytes = MaxLength(from, to);
+    if(buffers_[part].get() == nullptr) {
+        if(AllocateResizableBuffer(thread_local_memory_pool(), n_bytes, &buffers_[part]) != 1) return(-1);
+    } else if(buffers_[part]->Resize(n_bytes, false) != 1) return(-1);
+    return(Format(from, to, buffers_[part]->mutable_data()));
+}
+
+}
@@ -0,0 +1,103 @@
+#ifndef EXPORTERS_SAM_EXPORTER_H_
+#define EXPORTERS_SAM_EXPORTER_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "../buffer.h"
+#include "../importers/sam_importer.h"
+#include "decoded_batch.h"
+
+namespace pil {
+
+// Export decoded RecordBatches written by the SAM or BAM importers as SAM
+// text. The header and the RNAME dictionary are read from the Table meta
+// data and the SAM type of every aux Field from PIL_SAM_AUX_KEY. Without that
+// key, aux Fields are recognised by their tag names and their types are
+// derived from the primitive types. Integer aux values are written with type
+// `i` as in `samtools view`, and aux tags are written in the order their
+// Fields were first seen rather than in the order of every input record.
+//
+// Missing mandatory Fields are written as `*` or 0 (4 for FLAG) such that
+// reads imported from FASTQ can be written as unaligned SAM. As with
+// FastqExporter, ranges of records are formatted by several threads into
+// buffers sized for the worst case and written in order.
+class SamExporter {
+public:
+    // Aux Field of the current batch.
+    struct AuxField {
+        char tag[2];
+        char type; // SAM type with B arrays given by their subtype.
+        bool b_array;
+        const DecodedBatch::Column* column;
+    };
+
+public:
+    SamExporter();
+
+    /**<
+     * Open the output file and write the header.
+     * @param path      Path to the SAM file.
+     * @param meta_data Meta data of the exported Table.
+     * @return          Returns 1 if successful or -1 otherwise.
+     */
+    int Open(const std::string& path, const FileMetaData& meta_data);
+
+    /**<
+     * Format and write every record of a decoded RecordBatch.
+     * @param batch Source DecodedBatch.
+     * @return      Returns the number of records written, -1 if the output is not open, the batch has been finalized, or a Field has the wrong type, or -2 if writing failed.
+     */
+    int64_t Write(const DecodedBatch& batch);
+
+    /**<
+     * Flush and close the output file.
+     * @return Returns 1 if successful or -1 otherwise.
+     */
+    int Close();
+
+private:
+    /**<
+     * Resolve the mandatory and aux Fields of a batch.
+     * @return Returns 1 if successful or -1 if a Field has the wrong type.
+     */
+    int SetFields(const DecodedBatch& batch);
+
+    /**<
+     * Format the records [from, to) into `dst`, which holds at least
+     * MaxLength(from, to) bytes.
+     * @return Returns the number of bytes written.
+     */
+    uint64_t Format(const uint32_t from, const uint32_t to, uint8_t* dst) const;
+    uint64_t MaxLength(const uint32_t from, const uint32_t to) const;
+
+    /**<
+     * Size the output buffer of a thread for the records [from, to) and
+     * format them into it. Run by the formatting thread itself such that
+     * the buffer is drawn from its thread_local_memory_pool().
+     * @return Returns the number of bytes written or -1 if the buffer cannot be allocated.
+     */
+    int64_t FormatPart(const uint32_t from, const uint32_t to, const uint32_t part);
+
+    // Write a reference name or `*` if the identifier is unknown.
+    uint8_t* FormatName(const uint32_t rname, uint8_t* dst) const;
+
+public:
+    uint32_t n_threads; // Threads used to format batches.
+    bool write_header; // Write the header lines in Open.
+
+private:
+    std::ofstream stream_;
+    std::vector<std::string> rnames_; // Reference names in identifier order.
+    uint32_t max_rname_; // Longest reference name.
+    std::vector< std::pair<std::string, std::string> > aux_types_; // Field name and type from PIL_SAM_AUX_KEY.
+    bool has_aux_types_;
+    const DecodedBatch::Column* columns_[11]; // Mandatory Fields of the current batch in SAM order.
+    std::vector<AuxField> aux_;
+    std::vector< std::shared_ptr<ResizableBuffer> > buffers_; // Output buffer of every thread.
+};
+
+}
+
+#endif /* EXPORTERS_SAM_EXPORTER_H_ */
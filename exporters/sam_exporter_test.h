@@ -0,0 +1,182 @@
+#ifndef EXPORTERS_SAM_EXPORTER_TEST_H_
+#define EXPORTERS_SAM_EXPORTER_TEST_H_
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include "../importers/fastq_importer.h"
+#include "../importers/sam_importer.h"
+#include "fastq_exporter.h"
+#include "sam_exporter.h"
+
+namespace pil {
+
+static std::string ExporterTestRead(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return(ss.str());
+}
+
+// Transform every Field of the current RecordBatch as FinalizeBatch does
+// and restore it with the matching inverse. Fields without transformations
+// are compressed with ZSTD.
+static void ExporterTestTransformRoundTrip(TableConstructor& table) {
+    const RecordBatch& batch = *table.meta_data.batches.back();
+    Transformer& transformer = table.transformer;
+    for(size_t i = 0; i < table.build_csets.size(); ++i) {
+        std::shared_ptr<ColumnSet> cset = table.build_csets[i];
+        if(cset->size() == 0) continue;
+        DictionaryFieldType field = table.field_dict.dict[batch.local_dict[i]];
+        if(field.transforms.size() == 0) field.transforms.push_back(PIL_COMPRESS_ZSTD);
+        ASSERT_GT(transformer.Transform(cset, field), 0) << field.field_name;
+
+        if(field.cstore == PIL_CSTORE_COLUMN) {
+            for(size_t j = 0; j < cset->size(); ++j) {
+                ASSERT_EQ(PIL_COMPRESS_ZSTD, cset->columns[j]->transformation_args.back()->ctype) << field.field_name;
+                ASSERT_GE(static_cast<ZstdCompressor*>(&transformer)->Decompress(cset->columns[j], cset->columns[j]->transformation_args.back()), 0) << field.field_name;
+            }
+            continue;
+        }
+
+        switch(cset->columns[1]->transformation_args.back()->ctype) {
+        case(PIL_COMPRESS_ZSTD):
+            ASSERT_GT(static_cast<Compressor*>(&transformer)->DecompressStrides(cset, field), 0) << field.field_name;
+            ASSERT_GE(static_cast<ZstdCompressor*>(&transformer)->Decompress(cset->columns[1], cset->columns[1]->transformation_args.back()), 0) << field.field_name;
+            break;
+        case(PIL_COMPRESS_RC_QUAL):
+            ASSERT_GT(static_cast<Compressor*>(&transformer)->DecompressStrides(cset, field), 0) << field.field_name;
+            ASSERT_GT(static_cast<QualityCompressor*>(&transformer)->Decompress(cset, field.cstore), 0) << field.field_name;
+            break;
+        case(PIL_COMPRESS_RC_BASES):
+            ASSERT_GT(static_cast<SequenceCompressor*>(&transformer)->Decompress(cset, field), 0) << field.field_name;
+            break;
+        case(PIL_COMPRESS_RC_ILLUMINA_NAME):
+            ASSERT_GT(static_cast<NameCompressor*>(&transformer)->Decompress(cset, field), 0) << field.field_name;
+            break;
+        default: FAIL() << field.field_name;
+        }
+        ASSERT_GT(static_cast<ZstdCompressor*>(&transformer)->DecompressNullity(cset->columns[0]), 0) << field.field_name;
+    }
+}
+
+TEST(ExporterTests, FastqRoundTrip) {
+    const std::string fastq_path = "pil_fastq_export_test.fq";
+    const std::string out_path = "pil_fastq_export_test.out.fq";
+    std::string text;
+    for(uint32_t i = 0; i < 10000; ++i) {
+        const uint32_t l_seq = 50 + i % 101;
+        text += "@read" + std::to_string(i) + " 1:N:0:ACGT\n";
+        for(uint32_t j = 0; j < l_seq; ++j) text += "ACGTN"[(i + j) % 5];
+        text += "\n+\n";
+        for(uint32_t j = 0; j < l_seq; ++j) text += (char)('!' + (i * j) % 41);
+        text += "\n";
+    }
+    {
+        std::ofstream f(fastq_path, std::ios::binary);
+        f << text;
+    }
+
+    TableConstructor table;
+    table.batch_size = 1000000;
+    FastqImporter importer;
+    ASSERT_EQ(10000, importer.Import(fastq_path, table));
+    ExporterTestTransformRoundTrip(table);
+
+    DecodedBatch batch;
+    ASSERT_EQ(1, batch.FromTable(table));
+    ASSERT_EQ(10000, batch.n_records);
+
+    FastqExporter exporter;
+    exporter.n_threads = 4;
+    ASSERT_EQ(1, exporter.Open(out_path));
+    ASSERT_EQ(10000, exporter.Write(batch));
+    ASSERT_EQ(1, exporter.Close());
+    ASSERT_EQ(text, ExporterTestRead(out_path));
+
+    // Every Field is required.
+    exporter.qual_field = "MISSING";
+    ASSERT_EQ(1, exporter.Open(out_path));
+    ASSERT_EQ(-1, exporter.Write(batch));
+    ASSERT_EQ(1, exporter.Close());
+
+    std::remove(fastq_path.c_str());
+    std::remove(out_path.c_str());
+}
+
+TEST(ExporterTests, SamRoundTrip) {
+    const std::string sam_path = "pil_sam_export_test.sam";
+    const std::string out_path = "pil_sam_export_test.out.sam";
+    const uint32_t n_reads = 10000;
+    std::stringstream text;
+    text << "@HD\tVN:1.6\tSO:coordinate\n@SQ\tSN:chr2\tLN:1000000\n@SQ\tSN:chr1\tLN:1000000\n";
+    for(uint32_t i = 0; i < n_reads; ++i) {
+        if(i % 1000 == 999) {
+            text << "unmapped" << i << "\t4\t*\t0\t0\t*\t*\t0\t0\t*\t*\n";
+            continue;
+        }
+        const char* rname = (i % 3 == 0) ? "chr1" : (i % 3 == 1) ? "chr2" : "chrUn";
+        text << "read" << i << "\t" << (i % 4) * 16 << "\t" << rname << "\t" << i + 1 << "\t60\t4M1I3M\t=\t" << i + 100 << "\t" << -(int)i << "\tACGTACGT\tFFFFFFFF";
+        text << "\tNM:i:" << (int)(i % 5) - 2 << "\tXA:Z:alt " << i << "\tBC:B:s,-1," << i % 100 << ",3\tXF:f:1.5\tXC:A:x";
+        if(i == 7) text << "\tXH:H:1AE301\tUI:i:4000000000\tNM:Z:text";
+        text << "\n";
+    }
+    {
+        std::ofstream f(sam_path, std::ios::binary);
+        f << text.str();
+    }
+
+    TableConstructor table;
+    table.batch_size = 1000000;
+    SamImporter importer;
+    importer.n_threads = 4;
+    ASSERT_EQ(n_reads, importer.Import(sam_path, table));
+    ASSERT_EQ("NM\ti\nXA\tZ\nBC\tBs\nXF\tf\nXC\tA\nXH\tH\nUI\tI\nNM:Z\tZ\n", *table.meta_data.GetKeyValue(PIL_SAM_AUX_KEY));
+    ExporterTestTransformRoundTrip(table);
+
+    DecodedBatch batch;
+    ASSERT_EQ(1, batch.FromTable(table));
+
+    SamExporter exporter;
+    exporter.n_threads = 4;
+    ASSERT_EQ(1, exporter.Open(out_path, table.meta_data));
+    ASSERT_EQ(n_reads, exporter.Write(batch));
+    ASSERT_EQ(1, exporter.Close());
+    ASSERT_EQ(text.str(), ExporterTestRead(out_path));
+
+    // Without the aux types, A is written as an integer and H as a string
+    // and tags are written in the order of the Fields in the batch.
+    FileMetaData meta_data;
+    meta_data.SetKeyValue(PIL_SAM_RNAME_KEY, *table.meta_data.GetKeyValue(PIL_SAM_RNAME_KEY));
+    ASSERT_EQ(1, exporter.Open(out_path, meta_data));
+    ASSERT_EQ(n_reads, exporter.Write(batch));
+    ASSERT_EQ(1, exporter.Close());
+    std::ifstream f(out_path, std::ios::binary);
+    std::string line;
+    for(int i = 0; i < 8; ++i) std::getline(f, line);
+    ASSERT_EQ("read7\t48\tchr2\t8\t60\t4M1I3M\t=\t107\t-7\tACGTACGT\tFFFFFFFF\tXA:Z:alt 7\tBC:B:s,-1,7,3\tNM:i:0\tXF:f:1.5\tXC:i:120\tXH:Z:1AE301\tNM:Z:text\tUI:i:4000000000", line);
+
+    // FASTQ reads are written as unaligned records.
+    TableConstructor table2;
+    FastqImporter fastq_importer;
+    {
+        std::ofstream f2(sam_path, std::ios::binary);
+        f2 << "@r1\nACGT\n+\nIIII\n";
+    }
+    ASSERT_EQ(1, fastq_importer.Import(sam_path, table2));
+    DecodedBatch batch2;
+    ASSERT_EQ(1, batch2.FromTable(table2));
+    ASSERT_EQ(1, exporter.Open(out_path, table2.meta_data));
+    ASSERT_EQ(1, exporter.Write(batch2));
+    ASSERT_EQ(1, exporter.Close());
+    ASSERT_EQ("r1\t4\t*\t0\t0\t*\t*\t0\t0\tACGT\tIIII\n", ExporterTestRead(out_path));
+
+    std::remove(sam_path.c_str());
+    std::remove(out_path.c_str());
+}
+
+}
+
+#endif /* EXPORTERS_SAM_EXPORTER_TEST_H_ */
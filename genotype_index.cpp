@@ -0,0 +1,244 @@
+#include <algorithm>
+
+#include "genotype_index.h"
+
+namespace pil {
+
+// WAH word layout.
+#define PIL_WAH_ONES    0x7FFFFFFFU // All-one 31-bit group.
+#define PIL_WAH_FILL    0x80000000U // Fill word flag.
+#define PIL_WAH_MAX_RUN 0x3FFFFFFFU // Maximum number of groups in a fill word.
+
+// Cursor over the 31-bit groups of a WahBitmap: a fill word is visited as a
+// single run of n_left identical groups.
+struct WahCursor {
+    WahCursor(const std::vector<uint32_t>& words) : words(words), i(0), n_left(0), group(0) { Load(); }
+
+    void Load() {
+        if(i >= words.size()) { n_left = 0; return; }
+        const uint32_t w = words[i];
+        if(w & PIL_WAH_FILL) {
+            group  = ((w >> 30) & 1) ? PIL_WAH_ONES : 0;
+            n_left = w & PIL_WAH_MAX_RUN;
+        } else {
+            group  = w;
+            n_left = 1;
+        }
+    }
+
+    void Advance(const uint32_t n) {
+        n_left -= n;
+        if(n_left == 0) { ++i; Load(); }
+    }
+
+    const std::vector<uint32_t>& words;
+    size_t i;
+    uint32_t n_left, group;
+};
+
+void WahBitmap::AppendRun(const uint32_t group, uint32_t n_groups) {
+    if(n_groups == 0) return;
+    if(group != 0 && group != PIL_WAH_ONES) {
+        words.insert(words.end(), n_groups, group);
+        return;
+    }
+
+    // Extend the previous fill word of the same bit.
+    const uint32_t fill = PIL_WAH_FILL | ((group & 1) << 30);
+    if(words.size() && (words.back() & ~PIL_WAH_MAX_RUN) == fill) {
+        const uint32_t n = std::min(n_groups, PIL_WAH_MAX_RUN - (words.back() & PIL_WAH_MAX_RUN));
+        words.back() += n;
+        n_groups -= n;
+    }
+
+    while(n_groups) {
+        const uint32_t n = std::min(n_groups, PIL_WAH_MAX_RUN);
+        words.push_back(fill | n);
+        n_groups -= n;
+    }
+}
+
+void WahBitmap::AppendGroup(const uint32_t group, const uint32_t n) {
+    AppendRun(group & (PIL_WAH_ONES >> (31 - n)), 1);
+    n_bits += n;
+}
+
+uint32_t WahBitmap::Count() const {
+    uint32_t n = 0;
+    for(size_t i = 0; i < words.size(); ++i) {
+        if(words[i] & PIL_WAH_FILL) {
+            if((words[i] >> 30) & 1) n += 31 * (words[i] & PIL_WAH_MAX_RUN);
+        } else n += __builtin_popcount(words[i]);
+    }
+    return(n);
+}
+
+uint32_t WahBitmap::Positions(std::vector<uint32_t>& positions) const {
+    positions.clear();
+    uint32_t base = 0;
+    for(size_t i = 0; i < words.size(); ++i) {
+        if(words[i] & PIL_WAH_FILL) {
+            const uint32_t n = 31 * (words[i] & PIL_WAH_MAX_RUN);
+            if((words[i] >> 30) & 1) {
+                for(uint32_t j = 0; j < n; ++j) positions.push_back(base + j);
+            }
+            base += n;
+        } else {
+            uint32_t w = words[i];
+            while(w) {
+                positions.push_back(base + __builtin_ctz(w));
+                w &= w - 1;
+            }
+            base += 31;
+        }
+    }
+    return(positions.size());
+}
+
+template <class Op>
+WahBitmap WahBitmap::Combine(const WahBitmap& a, const WahBitmap& b, Op op) {
+    WahBitmap out;
+    WahCursor ca(a.words), cb(b.words);
+    // Runs longer than one group only occur when both cursors are in fills.
+    while(ca.n_left && cb.n_left) {
+        const uint32_t n = std::min(ca.n_left, cb.n_left);
+        out.AppendRun(op(ca.group, cb.group) & PIL_WAH_ONES, n);
+        ca.Advance(n);
+        cb.Advance(n);
+    }
+    out.n_bits = std::min(a.n_bits, b.n_bits);
+    return(out);
+}
+
+WahBitmap WahBitmap::And(const WahBitmap& a, const WahBitmap& b) {
+    return(Combine(a, b, [](uint32_t x, uint32_t y) { return(x & y); }));
+}
+
+WahBitmap WahBitmap::Or(const WahBitmap& a, const WahBitmap& b) {
+    return(Combine(a, b, [](uint32_t x, uint32_t y) { return(x | y); }));
+}
+
+WahBitmap WahBitmap::AndNot(const WahBitmap& a, const WahBitmap& b) {
+    return(Combine(a, b, [](uint32_t x, uint32_t y) { return(x & ~y); }));
+}
+
+int WahBitmap::Serialize(std::ostream& stream) const {
+    uint32_t n_words = words.size();
+    stream.write(reinterpret_cast<const char*>(&n_bits), sizeof(uint32_t));
+    stream.write(reinterpret_cast<const char*>(&n_words), sizeof(uint32_t));
+    stream.write(reinterpret_cast<const char*>(words.data()), n_words*sizeof(uint32_t));
+    return(stream.good());
+}
+
+int WahBitmap::Deserialize(std::istream& stream) {
+    uint32_t n_words = 0;
+    stream.read(reinterpret_cast<char*>(&n_bits), sizeof(uint32_t));
+    stream.read(reinterpret_cast<char*>(&n_words), sizeof(uint32_t));
+    if(stream.good() == false) return(-1);
+    words.resize(n_words);
+    stream.read(reinterpret_cast<char*>(words.data()), n_words*sizeof(uint32_t));
+    return(stream.good() ? 1 : -1);
+}
+
+// Genotype class of a sample from the set of haplotype codes it carries
+// (bit c set for code c: 0 REF, 1 ALT, 2 missing, 3 end of vector).
+static inline uint8_t GenotypeClass(const uint32_t seen) {
+    static const uint8_t classes[4] = {PIL_GT_CLASS_MISSING, PIL_GT_CLASS_HOM_REF, PIL_GT_CLASS_HOM_ALT, PIL_GT_CLASS_HET};
+    if(seen & 4) return(PIL_GT_CLASS_MISSING);
+    return(classes[seen & 3]);
+}
+
+int GenotypeIndex::Build(std::shared_ptr<ColumnSet> cset, const uint32_t n_samples, const uint32_t ploidy) {
+    if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-1);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-1);
+    if(cset->columns[0]->n_records == 0) return(-1);
+    if(cset->columns[0]->offset_width != sizeof(uint32_t)) return(-2);
+    if(n_samples == 0) return(-3);
+
+    this->n_samples = n_samples;
+    n_sites = cset->columns[0]->n_records - 1;
+    bitmaps.assign(4*n_samples, WahBitmap());
+
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data());
+    const uint8_t* data = cset->columns[1]->mutable_data();
+
+    // Classes of the two samples of a byte of a diploid site.
+    uint8_t nibble_class[16];
+    for(uint32_t i = 0; i < 16; ++i)
+        nibble_class[i] = GenotypeClass((1 << (i & 3)) | (1 << (i >> 2)));
+
+    // Bits of 31 consecutive sites are collected per sample and class and
+    // appended as one group.
+    std::vector<uint32_t> groups(4*n_samples, 0);
+    int n_indexed = 0;
+    for(uint32_t i = 0; i < n_sites; ++i) {
+        const uint8_t* site = &data[offsets[i]];
+        const uint32_t n_bytes = offsets[i + 1] - offsets[i];
+        const uint32_t p = ploidy ? ploidy : 4*n_bytes / n_samples;
+        const uint32_t bit = 1U << (i % 31);
+
+        if(p != 0 && ((uint64_t)p*n_samples + 3) / 4 == n_bytes) {
+            if(p == 2) {
+                for(uint32_t s = 0; s < n_samples; s += 2) {
+                    groups[4*s + nibble_class[site[s >> 1] & 0xF]] |= bit;
+                    if(s + 1 < n_samples) groups[4*(s + 1) + nibble_class[site[s >> 1] >> 4]] |= bit;
+                }
+            } else {
+                for(uint32_t s = 0; s < n_samples; ++s) {
+                    uint32_t seen = 0;
+                    for(uint32_t h = s*p; h < (s + 1)*p; ++h)
+                        seen |= 1 << ((site[h >> 2] >> ((h & 3) << 1)) & 3);
+                    groups[4*s + GenotypeClass(seen)] |= bit;
+                }
+            }
+            ++n_indexed;
+        }
+
+        if(i % 31 == 30 || i + 1 == n_sites) {
+            for(size_t k = 0; k < groups.size(); ++k) {
+                bitmaps[k].AppendGroup(groups[k], i % 31 + 1);
+                groups[k] = 0;
+            }
+        }
+    }
+
+    return(n_indexed);
+}
+
+WahBitmap GenotypeIndex::AllOf(const std::vector<uint32_t>& samples, const uint8_t gt_class) const {
+    if(samples.size() == 0) return(WahBitmap());
+    WahBitmap out = Get(samples[0], gt_class);
+    for(size_t i = 1; i < samples.size(); ++i)
+        out = WahBitmap::And(out, Get(samples[i], gt_class));
+    return(out);
+}
+
+WahBitmap GenotypeIndex::AnyOf(const std::vector<uint32_t>& samples, const uint8_t gt_class) const {
+    if(samples.size() == 0) return(WahBitmap());
+    WahBitmap out = Get(samples[0], gt_class);
+    for(size_t i = 1; i < samples.size(); ++i)
+        out = WahBitmap::Or(out, Get(samples[i], gt_class));
+    return(out);
+}
+
+int GenotypeIndex::Serialize(std::ostream& stream) const {
+    stream.write(reinterpret_cast<const char*>(&n_samples), sizeof(uint32_t));
+    stream.write(reinterpret_cast<const char*>(&n_sites), sizeof(uint32_t));
+    for(size_t i = 0; i < bitmaps.size(); ++i)
+        bitmaps[i].Serialize(stream);
+    return(stream.good());
+}
+
+int GenotypeIndex::Deserialize(std::istream& stream) {
+    stream.read(reinterpret_cast<char*>(&n_samples), sizeof(uint32_t));
+    stream.read(reinterpret_cast<char*>(&n_sites), sizeof(uint32_t));
+    if(stream.good() == false) return(-1);
+    bitmaps.resize(4*n_samples);
+    for(size_t i = 0; i < bitmaps.size(); ++i) {
+        if(bitmaps[i].Deserialize(stream) < 0) return(-1);
+    }
+    return(1);
+}
+
+}
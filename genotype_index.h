@@ -0,0 +1,138 @@
+#ifndef GENOTYPE_INDEX_H_
+#define GENOTYPE_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include "column_store.h"
+
+namespace pil {
+
+// Genotype classes of a sample at a site. Haplotypes padded with the end of
+// vector code are ignored: a haploid ALT call at a diploid site is HOM_ALT.
+#define PIL_GT_CLASS_HOM_REF 0
+#define PIL_GT_CLASS_HET     1
+#define PIL_GT_CLASS_HOM_ALT 2
+#define PIL_GT_CLASS_MISSING 3
+
+/**<
+ * Word-Aligned Hybrid (WAH) compressed bitmap. Bits are grouped into 31-bit
+ * groups stored in 32-bit words: a literal word (MSB 0) holds one group
+ * verbatim and a fill word (MSB 1) holds a run of identical all-zero or
+ * all-one groups with the fill bit at bit 30 and the number of groups in the
+ * lower 30 bits. Bitwise operations run directly on the compressed words and
+ * skip over fills.
+ */
+class WahBitmap {
+public:
+    WahBitmap() : n_bits(0){}
+
+    /**<
+     * Append a group of bits. Only the last group of a bitmap may hold fewer
+     * than 31 bits.
+     * @param group  Bits to append with the first bit in the lowest bit.
+     * @param n      Number of bits in the group.
+     */
+    void AppendGroup(const uint32_t group, const uint32_t n = 31);
+
+    /**<
+     * Number of set bits.
+     * @return Returns the population count of the bitmap.
+     */
+    uint32_t Count() const;
+
+    /**<
+     * Decode the positions of the set bits in increasing order.
+     * @param positions Destination vector of positions.
+     * @return          Returns the number of set bits.
+     */
+    uint32_t Positions(std::vector<uint32_t>& positions) const;
+
+    // Bitwise operations of two bitmaps with the same number of bits.
+    static WahBitmap And(const WahBitmap& a, const WahBitmap& b);
+    static WahBitmap Or(const WahBitmap& a, const WahBitmap& b);
+    static WahBitmap AndNot(const WahBitmap& a, const WahBitmap& b);
+
+    int Serialize(std::ostream& stream) const;
+    int Deserialize(std::istream& stream);
+
+    inline size_t size() const { return(words.size()); }
+
+private:
+    // Append n_groups copies of a full 31-bit group.
+    void AppendRun(const uint32_t group, uint32_t n_groups);
+
+    template <class Op>
+    static WahBitmap Combine(const WahBitmap& a, const WahBitmap& b, Op op);
+
+public:
+    uint32_t n_bits;
+    std::vector<uint32_t> words;
+};
+
+// Parameters of the genotype index. The index is built for the tensor Field
+// `field_name` holding one packed 2-bit haplotype vector per site (see
+// VcfImporter). `n_samples` is required and is set by the VCF importer.
+struct GenotypeIndexOptions {
+    GenotypeIndexOptions() :
+        enabled(false), field_name("GT"), n_samples(0), ploidy(0)
+    {}
+
+    bool enabled;
+    std::string field_name;
+    uint32_t n_samples;
+    uint32_t ploidy; // Haplotypes per sample or 0 to derive it from the length of every vector.
+};
+
+/**<
+ * Individual-centric genotype index of a RecordBatch (GQT-style): one WAH
+ * bitmap over the sites of the batch for every sample and genotype class.
+ * Queries such as "sites where every sample in S is heterozygous" are
+ * answered by combining bitmaps without decoding the genotype matrix.
+ *
+ * Sites are read from a Tensor-model ColumnSet of packed haplotypes with 2
+ * bits per haplotype in sample-major order. Unless it is provided, the ploidy
+ * of a site is derived from the length of its vector, which is unambiguous
+ * for 4 or more samples. Sites without a vector of a matching length (for
+ * example multi-allelic sites stored elsewhere) have no bit set in any
+ * bitmap.
+ */
+class GenotypeIndex {
+public:
+    GenotypeIndex() : n_samples(0), n_sites(0){}
+
+    /**<
+     * Build the bitmaps from the untransformed genotype ColumnSet of a batch.
+     * @param cset      Source Tensor-model ColumnSet of packed haplotypes.
+     * @param n_samples Number of samples per site.
+     * @param ploidy    Haplotypes per sample or 0 to derive it for every site.
+     * @return          Returns the number of indexed sites or a negative value otherwise.
+     */
+    int Build(std::shared_ptr<ColumnSet> cset, const uint32_t n_samples, const uint32_t ploidy = 0);
+
+    inline const WahBitmap& Get(const uint32_t sample, const uint8_t gt_class) const { return(bitmaps[4*sample + gt_class]); }
+
+    /**<
+     * Sites where every (AllOf) or at least one (AnyOf) of the provided
+     * samples has the given genotype class.
+     * @param samples  Non-empty set of sample offsets.
+     * @param gt_class Genotype class (PIL_GT_CLASS_*).
+     * @return         Returns a bitmap over the sites of the batch.
+     */
+    WahBitmap AllOf(const std::vector<uint32_t>& samples, const uint8_t gt_class) const;
+    WahBitmap AnyOf(const std::vector<uint32_t>& samples, const uint8_t gt_class) const;
+
+    int Serialize(std::ostream& stream) const;
+    int Deserialize(std::istream& stream);
+
+public:
+    uint32_t n_samples, n_sites;
+    std::vector<WahBitmap> bitmaps; // 4 bitmaps per sample in PIL_GT_CLASS_* order.
+};
+
+}
+
+#endif /* GENOTYPE_INDEX_H_ */
@@ -0,0 +1,156 @@
+#ifndef GENOTYPE_INDEX_TEST_H_
+#define GENOTYPE_INDEX_TEST_H_
+
+#include <random>
+#include <sstream>
+
+#include "genotype_index.h"
+#include "table.h"
+#include <gtest/gtest.h>
+
+namespace pil {
+
+// Encode a dense bit vector into a WahBitmap.
+static WahBitmap WahTestEncode(const std::vector<bool>& bits) {
+    WahBitmap out;
+    for(size_t i = 0; i < bits.size(); i += 31) {
+        uint32_t group = 0;
+        const uint32_t n = std::min<size_t>(31, bits.size() - i);
+        for(uint32_t j = 0; j < n; ++j) group |= (uint32_t)bits[i + j] << j;
+        out.AppendGroup(group, n);
+    }
+    return(out);
+}
+
+static void WahTestCompare(const std::vector<bool>& truth, const WahBitmap& bitmap) {
+    std::vector<uint32_t> expected, positions;
+    for(size_t i = 0; i < truth.size(); ++i) if(truth[i]) expected.push_back(i);
+    ASSERT_EQ(truth.size(), bitmap.n_bits);
+    ASSERT_EQ(expected.size(), bitmap.Count());
+    ASSERT_EQ(expected.size(), bitmap.Positions(positions));
+    ASSERT_EQ(expected, positions);
+}
+
+TEST(WahBitmapTests, Operations) {
+    std::mt19937 rng(7);
+    const uint32_t n_bits = 100003;
+
+    // Sparse bits, long runs of ones and random bits.
+    std::vector< std::vector<bool> > truth(3, std::vector<bool>(n_bits));
+    bool run = false;
+    for(uint32_t i = 0; i < n_bits; ++i) {
+        if(rng() % 5000 == 0) run = !run;
+        truth[0][i] = (rng() % 1000 == 0);
+        truth[1][i] = run;
+        truth[2][i] = rng() & 1;
+    }
+
+    std::vector<WahBitmap> bitmaps;
+    for(int k = 0; k < 3; ++k) {
+        bitmaps.push_back(WahTestEncode(truth[k]));
+        WahTestCompare(truth[k], bitmaps.back());
+    }
+    ASSERT_LT(bitmaps[0].size(), n_bits / 31 / 4);
+    ASSERT_LT(bitmaps[1].size(), n_bits / 31 / 20);
+
+    for(int a = 0; a < 3; ++a) {
+        for(int b = 0; b < 3; ++b) {
+            std::vector<bool> t_and(n_bits), t_or(n_bits), t_andnot(n_bits);
+            for(uint32_t i = 0; i < n_bits; ++i) {
+                t_and[i] = truth[a][i] && truth[b][i];
+                t_or[i] = truth[a][i] || truth[b][i];
+                t_andnot[i] = truth[a][i] && !truth[b][i];
+            }
+            WahTestCompare(t_and, WahBitmap::And(bitmaps[a], bitmaps[b]));
+            WahTestCompare(t_or, WahBitmap::Or(bitmaps[a], bitmaps[b]));
+            WahTestCompare(t_andnot, WahBitmap::AndNot(bitmaps[a], bitmaps[b]));
+        }
+    }
+
+    std::stringstream ss;
+    ASSERT_EQ(1, bitmaps[2].Serialize(ss));
+    WahBitmap copy;
+    ASSERT_EQ(1, copy.Deserialize(ss));
+    ASSERT_EQ(bitmaps[2].words, copy.words);
+    WahTestCompare(truth[2], copy);
+}
+
+TEST(GenotypeIndexTests, BuildAndQuery) {
+    std::mt19937 rng(11);
+    const uint32_t n_samples = 9, n_sites = 5000;
+
+    TableConstructor table;
+    table.genotype_index_options.enabled = true;
+    table.genotype_index_options.n_samples = n_samples;
+    RecordBuilder rbuild;
+
+    // Haplotype codes: 0 REF, 1 ALT, 2 missing, 3 end of vector.
+    std::vector<uint8_t> classes(n_sites * n_samples, 255);
+    for(uint32_t i = 0; i < n_sites; ++i) {
+        rbuild.Add<uint32_t>("POS", PIL_TYPE_UINT32, i);
+        // Every 50th site has no packed genotypes.
+        if(i % 50 != 49) {
+            uint8_t* gt = table.ReserveArray<uint8_t>(rbuild, "GT", PIL_TYPE_UINT8, (2 * n_samples + 3) / 4);
+            ASSERT_TRUE(gt != nullptr);
+            memset(gt, 0, (2 * n_samples + 3) / 4);
+            for(uint32_t s = 0; s < n_samples; ++s) {
+                uint32_t a = (rng() % 10 == 0), b = (rng() % 10 == 0);
+                if(s == 3) a = b = 0;
+                if(s != 3 && rng() % 100 == 0) a = 2;
+                if(s == 8 && i % 7 == 0) b = 3; // haploid
+                gt[(2 * s) / 4] |= a << (((2 * s) % 4) * 2);
+                gt[(2 * s + 1) / 4] |= b << (((2 * s + 1) % 4) * 2);
+
+                uint8_t c = PIL_GT_CLASS_HET;
+                if(a == 2) c = PIL_GT_CLASS_MISSING;
+                else if(b == 3 || a == b) c = (a == 0 ? PIL_GT_CLASS_HOM_REF : PIL_GT_CLASS_HOM_ALT);
+                classes[i * n_samples + s] = c;
+            }
+        }
+        ASSERT_EQ(1, table.Append(rbuild));
+    }
+    ASSERT_EQ(1, table.FinalizeBatch(0));
+
+    std::shared_ptr<GenotypeIndex> index = table.meta_data.batches[0]->genotype_index;
+    ASSERT_TRUE(index.get() != nullptr);
+    ASSERT_EQ(n_sites, index->n_sites);
+    ASSERT_EQ(4 * n_samples, index->bitmaps.size());
+
+    // Every bitmap matches the classes and unindexed sites have no class.
+    for(uint32_t s = 0; s < n_samples; ++s) {
+        for(uint8_t c = 0; c < 4; ++c) {
+            std::vector<bool> truth(n_sites);
+            for(uint32_t i = 0; i < n_sites; ++i) truth[i] = (classes[i * n_samples + s] == c);
+            WahTestCompare(truth, index->Get(s, c));
+        }
+    }
+    ASSERT_EQ(n_sites - n_sites / 50, index->Get(3, PIL_GT_CLASS_HOM_REF).Count());
+
+    // Sites where samples 0 and 1 are both heterozygous or either is missing.
+    const std::vector<uint32_t> query = {0, 1};
+    uint32_t n_het = 0, n_missing = 0;
+    for(uint32_t i = 0; i < n_sites; ++i) {
+        n_het += (classes[i * n_samples] == PIL_GT_CLASS_HET && classes[i * n_samples + 1] == PIL_GT_CLASS_HET);
+        n_missing += (classes[i * n_samples] == PIL_GT_CLASS_MISSING || classes[i * n_samples + 1] == PIL_GT_CLASS_MISSING);
+    }
+    ASSERT_EQ(n_het, index->AllOf(query, PIL_GT_CLASS_HET).Count());
+    ASSERT_EQ(n_missing, index->AnyOf(query, PIL_GT_CLASS_MISSING).Count());
+
+    std::stringstream ss;
+    ASSERT_EQ(1, index->Serialize(ss));
+    GenotypeIndex copy;
+    ASSERT_EQ(1, copy.Deserialize(ss));
+    ASSERT_EQ(n_samples, copy.n_samples);
+    ASSERT_EQ(index->AllOf(query, PIL_GT_CLASS_HET).words, copy.AllOf(query, PIL_GT_CLASS_HET).words);
+
+    // The index is optional.
+    TableConstructor table2;
+    rbuild.Add<uint32_t>("POS", PIL_TYPE_UINT32, 1);
+    ASSERT_EQ(1, table2.Append(rbuild));
+    ASSERT_EQ(1, table2.FinalizeBatch(0));
+    ASSERT_TRUE(table2.meta_data.batches[0]->genotype_index.get() == nullptr);
+}
+
+}
+
+#endif /* GENOTYPE_INDEX_TEST_H_ */
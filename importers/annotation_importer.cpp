@@ -0,0 +1,465 @@
+#include <cstring>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+
+#include "annotation_importer.h"
+
+// Blocks with fewer lines are parsed by a single thread.
+#define PIL_ANNOTATION_MIN_PARALLEL 1024
+
+namespace pil {
+
+// Append a value to the data buffer of a Chunk.
+template <class T>
+static inline void AnnotationPushValue(PoolBytes& data, const T value) {
+    const size_t offset = data.size();
+    data.resize(offset + sizeof(T));
+    memcpy(&data[offset], &value, sizeof(T));
+}
+
+// BED track and browser lines are part of the header.
+static bool AnnotationIsTrackLine(const char* line, const uint32_t l_line) {
+    for(const char* prefix : {"track", "browser"}) {
+        const uint32_t l_prefix = strlen(prefix);
+        if(l_line >= l_prefix && strncmp(line, prefix, l_prefix) == 0 &&
+           (l_line == l_prefix || line[l_prefix] == ' ' || line[l_prefix] == '\t'))
+            return(true);
+    }
+    return(false);
+}
+
+static inline bool AnnotationIsFasta(const char* line, const uint32_t l_line) {
+    return(l_line >= 7 && strncmp(line, "##FASTA", 7) == 0);
+}
+
+// Parse a score or NaN for '.'.
+static bool AnnotationParseScore(const char* begin, const char* end, float& out) {
+    if(end - begin == 1 && *begin == '.') {
+        out = std::numeric_limits<float>::quiet_NaN();
+        return(true);
+    }
+    if(begin == end) return(false);
+    char* parsed = nullptr;
+    out = strtof(begin, &parsed);
+    return(parsed == end);
+}
+
+// Parse a comma-separated list of non-negative int32 values with an optional
+// trailing comma into the data buffer.
+static bool AnnotationParseList(const char* begin, const char* end, PoolBytes& data, uint32_t& n_values) {
+    n_values = 0;
+    if(begin != end && end[-1] == ',') --end;
+    while(begin < end) {
+        const char* value_end = std::find(begin, end, ',');
+        int64_t x = 0;
+        if(ParseInteger(begin, value_end, x) == false || x < 0 || x > INT32_MAX) return(false);
+        AnnotationPushValue<int32_t>(data, x);
+        ++n_values;
+        begin = value_end + 1;
+    }
+    return(true);
+}
+
+static inline int AnnotationHexDigit(const char c) {
+    if(c >= '0' && c <= '9') return(c - '0');
+    if(c >= 'a' && c <= 'f') return(c - 'a' + 10);
+    if(c >= 'A' && c <= 'F') return(c - 'A' + 10);
+    return(-1);
+}
+
+// Write a text field directly into its ColumnSet.
+static int AnnotationAppendText(TableConstructor& table, RecordBuilder& rbuild, const std::string& field_name,
+                                const char* text, const uint32_t l_text)
+{
+    uint8_t* dst = table.ReserveArray<uint8_t>(rbuild, field_name, PIL_TYPE_UINT8, l_text);
+    if(dst == nullptr) return(l_text ? -1 : 1);
+    memcpy(dst, text, l_text);
+    return(1);
+}
+
+AnnotationImporter::AnnotationImporter() :
+    format(PIL_ANNOTATION_AUTO), n_threads(1), block_size(16 << 20), set_fields(true), format_(PIL_ANNOTATION_AUTO)
+{
+}
+
+int AnnotationImporter::SetFields(TableConstructor& table) {
+    std::vector<PIL_COMPRESSION_TYPE> ctypes;
+    ctypes.push_back(PIL_ENCODE_DELTA);
+    ctypes.push_back(PIL_COMPRESS_ZSTD);
+    if(table.SetField("START", PIL_TYPE_INT64, ctypes) < 0) return(-1);
+    if(table.SetField("END", PIL_TYPE_INT64, ctypes) < 0) return(-1);
+
+    return(1);
+}
+
+PIL_ANNOTATION_FORMAT AnnotationImporter::DetectFormat(const std::string& path) {
+    std::string name = path;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if(name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0) name.resize(name.size() - 4);
+
+    const size_t dot = name.rfind('.');
+    if(dot == std::string::npos) return(PIL_ANNOTATION_AUTO);
+    const std::string ext = name.substr(dot + 1);
+    if(ext == "bed") return(PIL_ANNOTATION_BED);
+    if(ext == "gtf" || ext == "gtf2") return(PIL_ANNOTATION_GTF);
+    if(ext == "gff" || ext == "gff3") return(PIL_ANNOTATION_GFF3);
+    return(PIL_ANNOTATION_AUTO);
+}
+
+uint32_t AnnotationImporter::InternName(const char* name, const uint32_t l_name) {
+    const std::string s(name, l_name);
+    std::unordered_map<std::string, uint32_t>::const_iterator it = chrom_map_.find(s);
+    if(it != chrom_map_.end()) return(it->second);
+
+    const uint32_t id = chrom_dict.size();
+    chrom_map_[s] = id;
+    chrom_dict.push_back(s);
+    return(id);
+}
+
+const std::string& AnnotationImporter::AttributeField(const char* key, const uint32_t l_key) {
+    const std::string s(key, l_key);
+    std::unordered_map<std::string, std::string>::const_iterator it = attr_fields_.find(s);
+    if(it != attr_fields_.end()) return(it->second);
+    return(attr_fields_[s] = "ATTR:" + s);
+}
+
+bool AnnotationImporter::ParseBed(const char* line, const uint32_t l_line, Feature& feature, Chunk& chunk) const {
+    if(feature.n_columns < 3) return(false);
+    // Column k spans [tabs[k-1] + 1, tabs[k]).
+    const uint32_t* tabs = feature.tabs;
+    if(ParseInteger(line + tabs[0] + 1, line + tabs[1], feature.start) == false || feature.start < 0) return(false);
+    if(ParseInteger(line + tabs[1] + 1, line + tabs[2], feature.end) == false || feature.end < feature.start) return(false);
+
+    if(feature.n_columns >= 5 && AnnotationParseScore(line + tabs[3] + 1, line + tabs[4], feature.score) == false) return(false);
+    if(feature.n_columns >= 6) {
+        if(tabs[5] - tabs[4] != 2) return(false);
+        feature.strand = line[tabs[4] + 1];
+        if(feature.strand != '+' && feature.strand != '-' && feature.strand != '.') return(false);
+    }
+    if(feature.n_columns >= 7 && ParseInteger(line + tabs[5] + 1, line + tabs[6], feature.thick_start) == false) return(false);
+    if(feature.n_columns >= 8 && ParseInteger(line + tabs[6] + 1, line + tabs[7], feature.thick_end) == false) return(false);
+
+    if(feature.n_columns >= 9) {
+        // itemRgb is 0 or r,g,b.
+        const char* begin = line + tabs[7] + 1;
+        const char* end = line + tabs[8];
+        uint32_t n_values = 0;
+        while(true) {
+            const char* value_end = std::find(begin, end, ',');
+            int64_t x = 0;
+            if(ParseInteger(begin, value_end, x) == false || x < 0 || x > 255) return(false);
+            feature.rgb = (feature.rgb << 8) | x;
+            ++n_values;
+            if(value_end == end) break;
+            begin = value_end + 1;
+        }
+        if(n_values != 1 && n_values != 3) return(false);
+    }
+
+    if(feature.n_columns >= 10) {
+        if(feature.n_columns < 12) return(false);
+        int64_t n_blocks = 0;
+        if(ParseInteger(line + tabs[8] + 1, line + tabs[9], n_blocks) == false || n_blocks < 0) return(false);
+
+        uint32_t n_sizes = 0, n_starts = 0;
+        feature.block_offset = chunk.data.size();
+        if(AnnotationParseList(line + tabs[9] + 1, line + tabs[10], chunk.data, n_sizes) == false) return(false);
+        if(AnnotationParseList(line + tabs[10] + 1, line + tabs[11], chunk.data, n_starts) == false) return(false);
+        if(n_sizes != n_blocks || n_starts != n_blocks) return(false);
+        feature.n_blocks = n_blocks;
+    }
+    return(true);
+}
+
+bool AnnotationImporter::ParseAttributes(const char* begin, const char* end, const char* line, Chunk& chunk) const {
+    if(end - begin == 1 && *begin == '.') return(true);
+
+    const size_t first = chunk.attributes.size();
+    std::string value;
+    while(begin < end) {
+        // GTF values may be quoted and contain semicolons.
+        const char* token_end = begin;
+        bool quoted = false;
+        for(; token_end < end && (quoted || *token_end != ';'); ++token_end)
+            quoted ^= (format_ == PIL_ANNOTATION_GTF && *token_end == '"');
+
+        const char* key = begin;
+        while(key < token_end && *key == ' ') ++key;
+        const char* key_end = key;
+        value.clear();
+        if(format_ == PIL_ANNOTATION_GTF) {
+            const char* last = token_end;
+            while(last > key && last[-1] == ' ') --last;
+            if(key == last) { begin = token_end + 1; continue; }
+            key_end = std::find(key, last, ' ');
+            const char* v = key_end;
+            while(v < last && *v == ' ') ++v;
+            if(last - v >= 2 && *v == '"' && last[-1] == '"') { ++v; --last; }
+            value.assign(v, last);
+        } else {
+            if(key == token_end) { begin = token_end + 1; continue; }
+            key_end = std::find(key, token_end, '=');
+            if(key_end == token_end) return(false);
+            for(const char* v = key_end + 1; v < token_end; ++v) {
+                int hi = -1, lo = -1;
+                if(*v == '%' && token_end - v >= 3 && (hi = AnnotationHexDigit(v[1])) >= 0 && (lo = AnnotationHexDigit(v[2])) >= 0) {
+                    value += (char)((hi << 4) | lo);
+                    v += 2;
+                } else value += *v;
+            }
+        }
+        if(key == key_end) return(false);
+
+        // Values of repeated keys are joined by commas.
+        Attribute* a = nullptr;
+        for(size_t k = first; k < chunk.attributes.size(); ++k) {
+            const Attribute& prev = chunk.attributes[k];
+            if(prev.key_length == key_end - key && strncmp(line + prev.key_begin, key, prev.key_length) == 0) {
+                a = &chunk.attributes[k];
+                break;
+            }
+        }
+        if(a != nullptr) {
+            const uint64_t offset = chunk.data.size();
+            chunk.data.insert(chunk.data.end(), chunk.data.begin() + a->offset, chunk.data.begin() + a->offset + a->n_value);
+            chunk.data.push_back(',');
+            a->offset = offset;
+            a->n_value += 1 + value.size();
+        } else {
+            Attribute attr;
+            attr.key_begin = key - line;
+            attr.key_length = key_end - key;
+            attr.offset = chunk.data.size();
+            attr.n_value = value.size();
+            chunk.attributes.push_back(attr);
+        }
+        chunk.data.insert(chunk.data.end(), value.begin(), value.end());
+        begin = token_end + 1;
+    }
+    return(true);
+}
+
+bool AnnotationImporter::ParseGff(const char* line, const uint32_t l_line, Feature& feature, Chunk& chunk) const {
+    if(feature.n_columns != 9) return(false);
+    const uint32_t* tabs = feature.tabs;
+
+    // 1-based closed intervals are stored as 0-based half-open intervals.
+    // Zero-length features have an end preceding their start.
+    if(ParseInteger(line + tabs[2] + 1, line + tabs[3], feature.start) == false || feature.start < 1) return(false);
+    if(ParseInteger(line + tabs[3] + 1, line + tabs[4], feature.end) == false || feature.end < feature.start - 1) return(false);
+    --feature.start;
+
+    if(AnnotationParseScore(line + tabs[4] + 1, line + tabs[5], feature.score) == false) return(false);
+    if(tabs[6] - tabs[5] != 2) return(false);
+    feature.strand = line[tabs[5] + 1];
+    if(feature.strand != '+' && feature.strand != '-' && feature.strand != '.' && feature.strand != '?') return(false);
+
+    if(tabs[7] - tabs[6] != 2) return(false);
+    const char phase = line[tabs[6] + 1];
+    if(phase == '.') feature.phase = -1;
+    else if(phase >= '0' && phase <= '2') feature.phase = phase - '0';
+    else return(false);
+
+    feature.attr_offset = chunk.attributes.size();
+    if(ParseAttributes(line + tabs[7] + 1, line + tabs[8], line, chunk) == false) return(false);
+    feature.n_attr = chunk.attributes.size() - feature.attr_offset;
+    return(true);
+}
+
+uint32_t AnnotationImporter::ParseLines(const uint32_t from, const uint32_t to, Chunk& chunk) const {
+    for(uint32_t i = from; i < to; ++i) {
+        const char* line = reader_.line(i);
+        const uint32_t l_line = reader_.line_length(i);
+        if(l_line == 0) continue;
+        if(line[0] == '#') {
+            // Sequences following a ##FASTA directive are not features.
+            if(format_ == PIL_ANNOTATION_GFF3 && AnnotationIsFasta(line, l_line)) {
+                chunk.stop = i + 1;
+                return(to);
+            }
+            continue;
+        }
+        if(format_ == PIL_ANNOTATION_BED && AnnotationIsTrackLine(line, l_line)) continue;
+
+        // Only the tabs of the first 12 columns are located: further BED
+        // columns are kept as text.
+        Feature feature;
+        memset(&feature, 0, sizeof(Feature));
+        feature.line = i;
+        feature.strand = '.';
+        feature.phase = -1;
+        feature.score = std::numeric_limits<float>::quiet_NaN();
+        const char* end = line + l_line;
+        const char* p = line;
+        uint32_t n_tabs = 0;
+        while(n_tabs < 12) {
+            const char* tab = reinterpret_cast<const char*>(memchr(p, '\t', end - p));
+            if(tab == nullptr) break;
+            feature.tabs[n_tabs++] = tab - line;
+            p = tab + 1;
+        }
+        feature.n_columns = n_tabs + 1;
+        if(n_tabs < 12) feature.tabs[n_tabs] = l_line;
+
+        // The dictionary is read-only while threads are parsing: names that
+        // are not in it are interned when appending.
+        std::unordered_map<std::string, uint32_t>::const_iterator it = chrom_map_.find(std::string(line, feature.tabs[0]));
+        feature.chrom = it == chrom_map_.end() ? -1 : it->second;
+
+        if(format_ == PIL_ANNOTATION_BED) {
+            if(ParseBed(line, l_line, feature, chunk) == false) return(i);
+        } else {
+            if(ParseGff(line, l_line, feature, chunk) == false) return(i);
+        }
+        chunk.features.push_back(feature);
+    }
+    return(to);
+}
+
+int AnnotationImporter::AppendChunk(const Chunk& chunk, TableConstructor& table, RecordBuilder& rbuild) {
+    for(size_t r = 0; r < chunk.features.size(); ++r) {
+        const Feature& f = chunk.features[r];
+        const char* line = reader_.line(f.line);
+        const uint32_t* tabs = f.tabs;
+
+        const uint32_t chrom = f.chrom >= 0 ? f.chrom : InternName(line, tabs[0]);
+        rbuild.Add<uint32_t>("RNAME", PIL_TYPE_UINT32, chrom);
+        rbuild.Add<int64_t>("START", PIL_TYPE_INT64, f.start);
+        rbuild.Add<int64_t>("END", PIL_TYPE_INT64, f.end);
+
+        if(format_ == PIL_ANNOTATION_BED) {
+            // Optional columns are only stored if present.
+            if(f.n_columns >= 4 && AnnotationAppendText(table, rbuild, "NAME", line + tabs[2] + 1, tabs[3] - tabs[2] - 1) != 1) return(-1);
+            if(f.n_columns >= 5) rbuild.Add<float>("SCORE", PIL_TYPE_FLOAT, f.score);
+            if(f.n_columns >= 6) rbuild.Add<uint8_t>("STRAND", PIL_TYPE_UINT8, f.strand);
+            if(f.n_columns >= 7) rbuild.Add<int64_t>("THICK_START", PIL_TYPE_INT64, f.thick_start);
+            if(f.n_columns >= 8) rbuild.Add<int64_t>("THICK_END", PIL_TYPE_INT64, f.thick_end);
+            if(f.n_columns >= 9) rbuild.Add<uint32_t>("ITEM_RGB", PIL_TYPE_UINT32, f.rgb);
+            if(f.n_columns >= 12) {
+                const int32_t* blocks = reinterpret_cast<const int32_t*>(&chunk.data[f.block_offset]);
+                int32_t* dst = table.ReserveArray<int32_t>(rbuild, "BLOCK_SIZES", PIL_TYPE_INT32, f.n_blocks);
+                if(dst == nullptr && f.n_blocks) return(-1);
+                if(f.n_blocks) memcpy(dst, blocks, f.n_blocks * sizeof(int32_t));
+                dst = table.ReserveArray<int32_t>(rbuild, "BLOCK_STARTS", PIL_TYPE_INT32, f.n_blocks);
+                if(dst == nullptr && f.n_blocks) return(-1);
+                if(f.n_blocks) memcpy(dst, blocks + f.n_blocks, f.n_blocks * sizeof(int32_t));
+            }
+            if(f.n_columns > 12) {
+                const uint32_t l_line = reader_.line_length(f.line);
+                if(AnnotationAppendText(table, rbuild, "EXTRA", line + tabs[11] + 1, l_line - tabs[11] - 1) != 1) return(-1);
+            }
+        } else {
+            if(AnnotationAppendText(table, rbuild, "SOURCE", line + tabs[0] + 1, tabs[1] - tabs[0] - 1) != 1) return(-1);
+            if(AnnotationAppendText(table, rbuild, "FEATURE", line + tabs[1] + 1, tabs[2] - tabs[1] - 1) != 1) return(-1);
+            rbuild.Add<float>("SCORE", PIL_TYPE_FLOAT, f.score);
+            rbuild.Add<uint8_t>("STRAND", PIL_TYPE_UINT8, f.strand);
+            rbuild.Add<int8_t>("PHASE", PIL_TYPE_INT8, f.phase);
+
+            for(uint32_t k = f.attr_offset; k < f.attr_offset + f.n_attr; ++k) {
+                const Attribute& a = chunk.attributes[k];
+                const std::string& field_name = AttributeField(line + a.key_begin, a.key_length);
+                if(AnnotationAppendText(table, rbuild, field_name, reinterpret_cast<const char*>(&chunk.data[a.offset]), a.n_value) != 1) return(-1);
+            }
+        }
+
+        if(table.Append(rbuild) != 1) return(-1);
+    }
+    return(1);
+}
+
+int64_t AnnotationImporter::Import(const std::string& path, TableConstructor& table) {
+    format_ = format == PIL_ANNOTATION_AUTO ? DetectFormat(path) : format;
+    if(format_ == PIL_ANNOTATION_AUTO) return(-1);
+    if(set_fields && SetFields(table) < 0) return(-1);
+
+    reader_.block_size = block_size;
+    reader_.n_threads = n_threads;
+    if(reader_.Open(path) != 1) return(-1);
+
+    header.clear();
+    chrom_dict.clear();
+    chrom_map_.clear();
+    attr_fields_.clear();
+
+    RecordBuilder rbuild;
+    int64_t n_features = 0;
+    bool in_header = true, done = false;
+    while(done == false) {
+        const int64_t n_lines = reader_.Next(1);
+        if(n_lines == 0) break;
+        if(n_lines < 0) { reader_.Close(); return(-2); }
+
+        // Header lines precede the features.
+        uint32_t first = 0;
+        while(in_header && first < n_lines) {
+            const char* line = reader_.line(first);
+            const uint32_t l_line = reader_.line_length(first);
+            if(l_line && line[0] != '#' && (format_ != PIL_ANNOTATION_BED || AnnotationIsTrackLine(line, l_line) == false)) {
+                in_header = false;
+                break;
+            }
+            if(l_line && format_ == PIL_ANNOTATION_GFF3 && AnnotationIsFasta(line, l_line)) {
+                in_header = false;
+                done = true;
+                break;
+            }
+            if(l_line) {
+                header.append(line, l_line);
+                header += '\n';
+            }
+            ++first;
+        }
+        if(done) break;
+
+        // Parse ranges of lines in parallel.
+        const uint32_t n_body = n_lines - first;
+        const uint32_t n_parts = n_body < PIL_ANNOTATION_MIN_PARALLEL ? 1 : std::max(1u, n_threads);
+        if(chunks_.size() < n_parts) chunks_.resize(n_parts);
+        std::vector<uint32_t> results(n_parts);
+        std::vector<uint32_t> ends(n_parts);
+        const uint32_t part_size = n_body / n_parts;
+        std::vector<std::thread> threads;
+        for(uint32_t p = 0; p < n_parts; ++p) {
+            const uint32_t from = first + p * part_size;
+            ends[p] = p + 1 == n_parts ? n_lines : from + part_size;
+            chunks_[p].clear();
+            if(n_parts == 1) results[p] = ParseLines(from, ends[p], chunks_[p]);
+            else threads.push_back(std::thread([this, &results, &ends, p, from]() { results[p] = ParseLines(from, ends[p], chunks_[p]); }));
+        }
+        for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+        // Ranges following a ##FASTA directive are ignored.
+        uint32_t n_used = n_parts;
+        for(uint32_t p = 0; p < n_parts; ++p) {
+            if(results[p] != ends[p]) {
+                std::cerr << "malformed annotation line: " << std::string(reader_.line(results[p]), std::min<uint32_t>(256, reader_.line_length(results[p]))) << std::endl;
+                reader_.Close();
+                return(-3);
+            }
+            if(chunks_[p].stop) {
+                n_used = p + 1;
+                done = true;
+                break;
+            }
+        }
+
+        for(uint32_t p = 0; p < n_used; ++p) {
+            if(AppendChunk(chunks_[p], table, rbuild) != 1) { reader_.Close(); return(-4); }
+            n_features += chunks_[p].features.size();
+        }
+    }
+    reader_.Close();
+
+    std::string names;
+    for(size_t i = 0; i < chrom_dict.size(); ++i) { names += chrom_dict[i]; names += '\n'; }
+    table.meta_data.SetKeyValue(PIL_ANNOTATION_CHROM_KEY, names);
+    table.meta_data.SetKeyValue(PIL_ANNOTATION_HEADER_KEY, header);
+    table.meta_data.SetIntervalKey("RNAME", "START", "END");
+
+    return(n_features);
+}
+
+}
@@ -0,0 +1,151 @@
+#ifndef IMPORTERS_ANNOTATION_IMPORTER_H_
+#define IMPORTERS_ANNOTATION_IMPORTER_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../table.h"
+#include "text_reader.h"
+
+namespace pil {
+
+// Keys of the header lines and the contig dictionary in FileMetaData. The
+// dictionary holds one name per line in identifier order.
+#define PIL_ANNOTATION_HEADER_KEY "ANNOTATION_HEADER"
+#define PIL_ANNOTATION_CHROM_KEY  "ANNOTATION_CHROM"
+
+typedef enum {
+    PIL_ANNOTATION_AUTO, // Detected from the file extension.
+    PIL_ANNOTATION_BED,
+    PIL_ANNOTATION_GTF,
+    PIL_ANNOTATION_GFF3
+} PIL_ANNOTATION_FORMAT;
+
+// Import BED, GTF2 and GFF3 annotation files into a TableConstructor. Blocks
+// of lines are split into ranges that are parsed by several threads and the
+// features are then appended in order.
+//
+// Every format stores its intervals as RNAME (uint32 identifiers interned in
+// order of appearance), START and END (int64, 0-based and half-open: GTF and
+// GFF3 starts are shifted down by one), STRAND (the strand character) and
+// SCORE (float, NaN if missing). These three Fields are marked as the
+// interval key of the file (see FileMetaData::SetIntervalKey).
+//
+// BED files additionally store NAME, THICK_START, THICK_END, ITEM_RGB
+// (0x00RRGGBB) and the BLOCK_SIZES and BLOCK_STARTS int32 tensors for the
+// columns that are present, and any further columns as text in EXTRA. GTF and
+// GFF3 files store SOURCE, FEATURE and PHASE (int8, -1 if missing), and every
+// attribute in a sparse text Field named "ATTR:<key>". GTF values are
+// unquoted, GFF3 values are percent-decoded and the values of repeated keys
+// are joined by commas.
+//
+// Comment, track and browser lines preceding the features are kept as the
+// header and other comment lines are skipped. A GFF3 ##FASTA directive ends
+// the features.
+class AnnotationImporter {
+public:
+    // Attribute parsed by a worker thread. The decoded value is stored in the
+    // thread's data buffer.
+    struct Attribute {
+        uint32_t key_begin, key_length; // Key in the line.
+        uint64_t offset;
+        uint32_t n_value;
+    };
+
+    // Feature parsed by a worker thread. Text fields are located through the
+    // tab offsets of the line.
+    struct Feature {
+        uint32_t line;
+        uint32_t n_columns;
+        uint32_t tabs[12]; // Offset of the tab (or line end) after the first 12 columns.
+        int32_t chrom; // Identifier or -1 if not in the dictionary.
+        int64_t start, end;
+        float score;
+        uint8_t strand;
+        int8_t phase;
+        int64_t thick_start, thick_end;
+        uint32_t rgb;
+        uint32_t n_blocks;
+        uint64_t block_offset; // Sizes followed by starts in the data buffer.
+        uint32_t attr_offset, n_attr;
+    };
+
+    // Output of a worker thread.
+    struct Chunk {
+        void clear() { features.clear(); attributes.clear(); data.clear(); stop = 0; }
+
+        std::vector<Feature> features;
+        std::vector<Attribute> attributes;
+        PoolBytes data; // Drawn from the MemoryPool of the parsing thread.
+        uint32_t stop; // Line of a ##FASTA directive plus one, or 0.
+    };
+
+public:
+    AnnotationImporter();
+
+    /**<
+     * Import every feature of the annotation file into the provided Table.
+     * The header lines and the contig dictionary are stored in the Table
+     * meta data. The Table is not finalized.
+     * @param path  Path to the annotation file.
+     * @param table Destination TableConstructor with an open output stream.
+     * @return      Returns the number of features imported or a negative value if the file is malformed.
+     */
+    int64_t Import(const std::string& path, TableConstructor& table);
+
+    /**<
+     * Register the Fields with their default transformations: START and END
+     * are delta encoded and compressed with Zstd. Fields that already exist
+     * in the Table are left untouched.
+     * @param table Destination TableConstructor.
+     * @return      Returns 1 if successful or a negative value otherwise.
+     */
+    static int SetFields(TableConstructor& table);
+
+    /**<
+     * Detect the format of a file from its extension (.bed, .gtf, .gff or
+     * .gff3 with an optional .txt suffix).
+     * @param path Path to the annotation file.
+     * @return     Returns the format or PIL_ANNOTATION_AUTO if unknown.
+     */
+    static PIL_ANNOTATION_FORMAT DetectFormat(const std::string& path);
+
+private:
+    uint32_t InternName(const char* name, const uint32_t l_name);
+    const std::string& AttributeField(const char* key, const uint32_t l_key);
+
+    /**<
+     * Parse the lines [from, to) of the current block into a Chunk.
+     * @return Returns the first malformed line or `to` otherwise.
+     */
+    uint32_t ParseLines(const uint32_t from, const uint32_t to, Chunk& chunk) const;
+    bool ParseBed(const char* line, const uint32_t l_line, Feature& feature, Chunk& chunk) const;
+    bool ParseGff(const char* line, const uint32_t l_line, Feature& feature, Chunk& chunk) const;
+    bool ParseAttributes(const char* begin, const char* end, const char* line, Chunk& chunk) const;
+
+    /**<
+     * Append the features of a parsed Chunk to the Table.
+     * @return Returns 1 if successful or -1 otherwise.
+     */
+    int AppendChunk(const Chunk& chunk, TableConstructor& table, RecordBuilder& rbuild);
+
+public:
+    PIL_ANNOTATION_FORMAT format; // Input format or PIL_ANNOTATION_AUTO.
+    uint32_t n_threads; // Threads used to index and parse blocks.
+    size_t block_size; // Bytes read per block.
+    bool set_fields; // Call SetFields before importing.
+    std::string header; // Header lines including newlines.
+    std::vector<std::string> chrom_dict; // Contig names in identifier order.
+
+private:
+    PIL_ANNOTATION_FORMAT format_; // Format of the current file.
+    TextReader reader_;
+    std::unordered_map<std::string, uint32_t> chrom_map_;
+    std::unordered_map<std::string, std::string> attr_fields_;
+    std::vector<Chunk> chunks_;
+};
+
+}
+
+#endif /* IMPORTERS_ANNOTATION_IMPORTER_H_ */
@@ -0,0 +1,161 @@
+#ifndef IMPORTERS_ANNOTATION_IMPORTER_TEST_H_
+#define IMPORTERS_ANNOTATION_IMPORTER_TEST_H_
+
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+
+#include <gtest/gtest.h>
+#include "annotation_importer.h"
+
+namespace pil {
+
+// Text value of a record in a Tensor-model ColumnSet.
+static std::string AnnotationTestText(std::shared_ptr<ColumnSet> cset, const uint32_t i) {
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data());
+    return(std::string(reinterpret_cast<const char*>(cset->columns[1]->mutable_data()) + offsets[i], offsets[i + 1] - offsets[i]));
+}
+
+TEST(ImporterTests, BedImport) {
+    const std::string bed_path = "pil_annotation_import_test.bed";
+    const std::string path = "pil_annotation_import_test.pil";
+    const uint32_t n_features = 3000;
+    {
+        std::ofstream f(bed_path, std::ios::binary);
+        f << "browser position chr7:127471196-127495720\ntrack name=\"test\" itemRgb=\"On\"\n#comment\n";
+        for(uint32_t i = 0; i < n_features; ++i) {
+            f << "chr" << 1 + i % 3 << "\t" << 10000000000LL + 100 * i << "\t" << 10000000000LL + 100 * i + 50 << "\tgene" << i
+              << "\t" << i % 1000 << "\t" << (i % 2 ? '-' : '+') << "\t" << 10000000000LL + 100 * i + 5 << "\t" << 10000000000LL + 100 * i + 45
+              << "\t" << (i % 5 ? "255,0,128" : "0") << "\t2\t10,20,\t0,30,\n";
+        }
+        // Extra columns.
+        f << "chrM\t0\t16569\t.\t.\t.\t0\t16569\t0\t1\t16569\t0\tx\ty\r\n";
+    }
+
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+    table.batch_size = 1000000;
+
+    AnnotationImporter importer;
+    importer.n_threads = 4;
+    ASSERT_EQ(n_features + 1, importer.Import(bed_path, table));
+    ASSERT_EQ(n_features + 1, table.meta_data.batches.back()->n_rec);
+    ASSERT_EQ("chr1\nchr2\nchr3\nchrM\n", *table.meta_data.GetKeyValue(PIL_ANNOTATION_CHROM_KEY));
+    ASSERT_EQ(0, table.meta_data.GetKeyValue(PIL_ANNOTATION_HEADER_KEY)->find("browser"));
+
+    std::string contig, start, end;
+    ASSERT_TRUE(table.meta_data.GetIntervalKey(contig, start, end));
+    ASSERT_EQ("RNAME", contig);
+    ASSERT_EQ("START", start);
+    ASSERT_EQ("END", end);
+    ASSERT_EQ(PIL_TYPE_INT64, table.field_dict.dict[table.field_dict.Find("START")].ptype);
+
+    const int64_t* starts = reinterpret_cast<const int64_t*>(table.GetBatchColumnSet("START")->columns[0]->mutable_data());
+    const int64_t* ends = reinterpret_cast<const int64_t*>(table.GetBatchColumnSet("END")->columns[0]->mutable_data());
+    const uint32_t* rnames = reinterpret_cast<const uint32_t*>(table.GetBatchColumnSet("RNAME")->columns[0]->mutable_data());
+    const float* scores = reinterpret_cast<const float*>(table.GetBatchColumnSet("SCORE")->columns[0]->mutable_data());
+    const uint8_t* strands = table.GetBatchColumnSet("STRAND")->columns[0]->mutable_data();
+    const uint32_t* rgb = reinterpret_cast<const uint32_t*>(table.GetBatchColumnSet("ITEM_RGB")->columns[0]->mutable_data());
+    for(uint32_t i = 0; i < n_features; i += 111) {
+        ASSERT_EQ(i % 3, rnames[i]);
+        ASSERT_EQ(10000000000LL + 100 * i, starts[i]);
+        ASSERT_EQ(10000000000LL + 100 * i + 50, ends[i]);
+        ASSERT_EQ(i % 1000, scores[i]);
+        ASSERT_EQ(i % 2 ? '-' : '+', strands[i]);
+        ASSERT_EQ(i % 5 ? 0xFF0080 : 0, rgb[i]);
+        ASSERT_EQ("gene" + std::to_string(i), AnnotationTestText(table.GetBatchColumnSet("NAME"), i));
+    }
+    ASSERT_TRUE(std::isnan(scores[n_features]));
+    ASSERT_EQ(16569, ends[n_features]);
+
+    std::shared_ptr<ColumnSet> sizes = table.GetBatchColumnSet("BLOCK_SIZES");
+    const uint32_t* size_offsets = reinterpret_cast<const uint32_t*>(sizes->columns[0]->mutable_data());
+    const int32_t* size_values = reinterpret_cast<const int32_t*>(sizes->columns[1]->mutable_data());
+    ASSERT_EQ(2, size_offsets[11] - size_offsets[10]);
+    ASSERT_EQ(20, size_values[size_offsets[10] + 1]);
+    std::shared_ptr<ColumnSet> block_starts = table.GetBatchColumnSet("BLOCK_STARTS");
+    ASSERT_EQ(30, reinterpret_cast<const int32_t*>(block_starts->columns[1]->mutable_data())[1]);
+    ASSERT_EQ("x\ty", AnnotationTestText(table.GetBatchColumnSet("EXTRA"), n_features));
+
+    // Coordinates are delta encoded when the batch is finalized.
+    ASSERT_EQ(PIL_ENCODE_DELTA, table.field_dict.dict[table.field_dict.Find("START")].transforms[0]);
+    ASSERT_EQ(1, table.FinalizeBatch(0));
+    table.out_stream.close();
+
+    // Block counts must match the block lists.
+    {
+        std::ofstream f(bed_path, std::ios::binary);
+        f << "chr1\t0\t100\tx\t0\t+\t0\t100\t0\t2\t10,\t0,\n";
+    }
+    TableConstructor table2;
+    ASSERT_EQ(-3, importer.Import(bed_path, table2));
+
+    std::remove(bed_path.c_str());
+    std::remove(path.c_str());
+}
+
+TEST(ImporterTests, GtfGff3Import) {
+    const std::string gtf_path = "pil_annotation_import_test.gtf";
+    const std::string gff_path = "pil_annotation_import_test.gff3";
+    {
+        std::ofstream f(gtf_path, std::ios::binary);
+        f << "#!genome-build GRCh38\n";
+        f << "1\thavana\tgene\t11869\t14409\t.\t+\t.\tgene_id \"ENSG00000223972\"; gene_name \"DDX11L1\"; tag \"a;b\"; tag \"basic\";\n";
+        f << "1\thavana\tCDS\t12010\t12057\t0.5\t-\t2\tgene_id \"ENSG00000223972\"; exon_number 1;\n";
+    }
+
+    TableConstructor table;
+    AnnotationImporter importer;
+    ASSERT_EQ(2, importer.Import(gtf_path, table));
+    ASSERT_EQ("#!genome-build GRCh38\n", *table.meta_data.GetKeyValue(PIL_ANNOTATION_HEADER_KEY));
+    const int64_t* starts = reinterpret_cast<const int64_t*>(table.GetBatchColumnSet("START")->columns[0]->mutable_data());
+    const int64_t* ends = reinterpret_cast<const int64_t*>(table.GetBatchColumnSet("END")->columns[0]->mutable_data());
+    ASSERT_EQ(11868, starts[0]);
+    ASSERT_EQ(14409, ends[0]);
+    ASSERT_EQ("CDS", AnnotationTestText(table.GetBatchColumnSet("FEATURE"), 1));
+    ASSERT_EQ("havana", AnnotationTestText(table.GetBatchColumnSet("SOURCE"), 0));
+    const int8_t* phases = reinterpret_cast<const int8_t*>(table.GetBatchColumnSet("PHASE")->columns[0]->mutable_data());
+    ASSERT_EQ(-1, phases[0]);
+    ASSERT_EQ(2, phases[1]);
+    ASSERT_EQ("ENSG00000223972", AnnotationTestText(table.GetBatchColumnSet("ATTR:gene_id"), 1));
+    ASSERT_EQ("a;b,basic", AnnotationTestText(table.GetBatchColumnSet("ATTR:tag"), 0));
+    ASSERT_EQ("1", AnnotationTestText(table.GetBatchColumnSet("ATTR:exon_number"), 1));
+    // Attributes are sparse.
+    ASSERT_EQ(0, AnnotationTestText(table.GetBatchColumnSet("ATTR:gene_name"), 1).size());
+
+    {
+        std::ofstream f(gff_path, std::ios::binary);
+        f << "##gff-version 3\n";
+        f << "ctg123\t.\tgene\t1000\t9000\t.\t+\t.\tID=gene00001;Name=EDEN%3B1%2C2;Alias=a;Alias=b\n";
+        f << "###\n";
+        f << "ctg124\t.\tinsertion\t200\t199\t.\t?\t.\t.\n";
+        f << "##FASTA\n>ctg123\nACGT\n";
+    }
+
+    TableConstructor table2;
+    ASSERT_EQ(2, importer.Import(gff_path, table2));
+    starts = reinterpret_cast<const int64_t*>(table2.GetBatchColumnSet("START")->columns[0]->mutable_data());
+    ends = reinterpret_cast<const int64_t*>(table2.GetBatchColumnSet("END")->columns[0]->mutable_data());
+    ASSERT_EQ(199, starts[1]);
+    ASSERT_EQ(199, ends[1]);
+    ASSERT_EQ('?', table2.GetBatchColumnSet("STRAND")->columns[0]->mutable_data()[1]);
+    ASSERT_EQ("EDEN;1,2", AnnotationTestText(table2.GetBatchColumnSet("ATTR:Name"), 0));
+    ASSERT_EQ("a,b", AnnotationTestText(table2.GetBatchColumnSet("ATTR:Alias"), 0));
+    ASSERT_EQ("ctg123\nctg124\n", *table2.meta_data.GetKeyValue(PIL_ANNOTATION_CHROM_KEY));
+
+    // GFF3 attributes require a value.
+    {
+        std::ofstream f(gff_path, std::ios::binary);
+        f << "ctg123\t.\tgene\t1000\t9000\t.\t+\t.\tID\n";
+    }
+    TableConstructor table3;
+    ASSERT_EQ(-3, importer.Import(gff_path, table3));
+
+    std::remove(gtf_path.c_str());
+    std::remove(gff_path.c_str());
+}
+
+}
+
+#endif /* IMPORTERS_ANNOTATION_IMPORTER_TEST_H_ */
@@ -0,0 +1,277 @@
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "bam_importer.h"
+
+namespace pil {
+
+// Decoding tables of the 4-bit bases and of the CIGAR operations.
+static const char* const BAM_SEQ_CHARS = "=ACMGRSVTWYHKDBN";
+static const char* const BAM_CIGAR_CHARS = "MIDNSHP=X";
+
+// Size of the fixed part of a record following block_size.
+#define PIL_BAM_FIXED_SIZE 32
+
+template <class T>
+static inline T BamLoad(const uint8_t* p) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    return(value);
+}
+
+// Size of a scalar of a BAM aux type or 0 for unknown types.
+static inline uint32_t BamTypeSize(const char type) {
+    switch(type) {
+    case('A'): case('c'): case('C'): return(1);
+    case('s'): case('S'): return(2);
+    case('i'): case('I'): case('f'): return(4);
+    default: return(0);
+    }
+}
+
+// Integer value of a scalar of a BAM integer type.
+static inline int64_t BamLoadInteger(const uint8_t* p, const char type) {
+    switch(type) {
+    case('c'): return(BamLoad<int8_t>(p));
+    case('C'): return(BamLoad<uint8_t>(p));
+    case('s'): return(BamLoad<int16_t>(p));
+    case('S'): return(BamLoad<uint16_t>(p));
+    case('i'): return(BamLoad<int32_t>(p));
+    default:   return(BamLoad<uint32_t>(p));
+    }
+}
+
+// Write a text field directly into its ColumnSet.
+static int BamAppendText(TableConstructor& table, RecordBuilder& rbuild, const char* field_name,
+                         const char* text, const uint32_t l_text)
+{
+    uint8_t* dst = table.ReserveArray<uint8_t>(rbuild, field_name, PIL_TYPE_UINT8, l_text);
+    if(dst == nullptr) return(l_text ? -1 : 1);
+    memcpy(dst, text, l_text);
+    return(1);
+}
+
+BamImporter::BamImporter() :
+    n_threads(1), blocks_per_batch(256), set_fields(true), unmapped_id_(-1)
+{
+}
+
+int BamImporter::ReadHeader() {
+    uint8_t magic[4];
+    if(reader_.Read(magic, 4) != 4 || memcmp(magic, "BAM\1", 4) != 0) return(-3);
+
+    int32_t l_text = 0;
+    if(reader_.Read(&l_text, sizeof(int32_t)) != sizeof(int32_t) || l_text < 0) return(-3);
+    header.resize(l_text);
+    if(reader_.Read(&header[0], l_text) != l_text) return(-3);
+    // The text may be padded with NUL characters.
+    header.resize(strnlen(header.data(), header.size()));
+
+    int32_t n_ref = 0;
+    if(reader_.Read(&n_ref, sizeof(int32_t)) != sizeof(int32_t) || n_ref < 0) return(-3);
+    std::string name;
+    for(int32_t i = 0; i < n_ref; ++i) {
+        int32_t l_name = 0, l_ref = 0;
+        if(reader_.Read(&l_name, sizeof(int32_t)) != sizeof(int32_t) || l_name <= 0) return(-3);
+        name.resize(l_name);
+        if(reader_.Read(&name[0], l_name) != l_name) return(-3);
+        if(reader_.Read(&l_ref, sizeof(int32_t)) != sizeof(int32_t)) return(-3);
+        rname_dict.push_back(name.substr(0, l_name - 1));
+    }
+    return(1);
+}
+
+int64_t BamImporter::ReferenceId(const int32_t ref_id) {
+    if(ref_id >= 0) return(ref_id < (int64_t)rname_dict.size() ? ref_id : -1);
+    if(unmapped_id_ < 0) {
+        unmapped_id_ = rname_dict.size();
+        rname_dict.push_back("*");
+    }
+    return(unmapped_id_);
+}
+
+int BamImporter::AppendAux(const uint8_t* data, const uint8_t* end, TableConstructor& table, RecordBuilder& rbuild) {
+    while(data < end) {
+        if(end - data < 4) return(-3);
+        const char* tag = reinterpret_cast<const char*>(data);
+        char type = data[2];
+        const uint8_t* value = data + 3;
+
+        bool is_array = false;
+        uint32_t n_values = 1;
+        uint8_t scalar[sizeof(uint32_t)];
+        const uint8_t* values = value;
+        switch(type) {
+        case('c'): case('C'): case('s'): case('S'): case('i'): case('I'): {
+            // Integers are stored as in text SAM: `i` or `I` above INT32_MAX.
+            if(end - value < BamTypeSize(type)) return(-3);
+            const int64_t v = BamLoadInteger(value, type);
+            data = value + BamTypeSize(type);
+            type = v > INT32_MAX ? 'I' : 'i';
+            if(type == 'i') { const int32_t x = v; memcpy(scalar, &x, sizeof(int32_t)); }
+            else { const uint32_t x = v; memcpy(scalar, &x, sizeof(uint32_t)); }
+            values = scalar;
+            break;
+        }
+        case('A'): case('f'):
+            if(end - value < BamTypeSize(type)) return(-3);
+            data = value + BamTypeSize(type);
+            break;
+        case('Z'): case('H'): {
+            const uint8_t* nul = reinterpret_cast<const uint8_t*>(memchr(value, 0, end - value));
+            if(nul == nullptr) return(-3);
+            is_array = true;
+            n_values = nul - value;
+            data = nul + 1;
+            break;
+        }
+        case('B'): {
+            if(end - value < 5) return(-3);
+            type = value[0];
+            const uint32_t size = BamTypeSize(type);
+            if(size == 0 || type == 'A') return(-3);
+            n_values = BamLoad<uint32_t>(value + 1);
+            values = value + 5;
+            if((uint64_t)(end - values) < (uint64_t)n_values * size) return(-3);
+            is_array = true;
+            data = values + n_values * size;
+            break;
+        }
+        default: return(-3);
+        }
+
+        const std::string& field_name = aux_fields_.FieldName(tag, type, is_array);
+        if(AppendSamAux(table, rbuild, field_name, type, is_array, n_values, values) != 1) return(-4);
+    }
+    return(1);
+}
+
+int BamImporter::AppendRecord(const uint8_t* data, const uint32_t l_data, TableConstructor& table, RecordBuilder& rbuild) {
+    if(l_data < PIL_BAM_FIXED_SIZE) return(-3);
+
+    const int32_t ref_id      = BamLoad<int32_t>(data);
+    const int32_t pos         = BamLoad<int32_t>(data + 4);
+    const uint8_t l_read_name = data[8];
+    const uint8_t mapq        = data[9];
+    const uint16_t n_cigar_op = BamLoad<uint16_t>(data + 12);
+    const uint16_t flag       = BamLoad<uint16_t>(data + 14);
+    const int32_t l_seq       = BamLoad<int32_t>(data + 16);
+    const int32_t next_ref_id = BamLoad<int32_t>(data + 20);
+    const int32_t next_pos    = BamLoad<int32_t>(data + 24);
+    const int32_t tlen        = BamLoad<int32_t>(data + 28);
+
+    if(l_read_name == 0 || l_seq < 0 || pos < -1 || next_pos < -1) return(-3);
+    const uint64_t l_var = (uint64_t)l_read_name + 4 * n_cigar_op + (l_seq + 1) / 2 + l_seq;
+    if(PIL_BAM_FIXED_SIZE + l_var > l_data) return(-3);
+
+    const int64_t rname = ReferenceId(ref_id);
+    const int64_t rnext = ReferenceId(next_ref_id);
+    if(rname < 0 || rnext < 0) return(-3);
+
+    const uint8_t* read_name = data + PIL_BAM_FIXED_SIZE;
+    const uint8_t* cigar = read_name + l_read_name;
+    const uint8_t* seq   = cigar + 4 * n_cigar_op;
+    const uint8_t* qual  = seq + (l_seq + 1) / 2;
+    const uint8_t* aux   = qual + l_seq;
+
+    if(BamAppendText(table, rbuild, "NAME", reinterpret_cast<const char*>(read_name), l_read_name - 1) != 1) return(-4);
+    rbuild.Add<uint16_t>("FLAG", PIL_TYPE_UINT16, flag);
+    rbuild.Add<uint32_t>("RNAME", PIL_TYPE_UINT32, rname);
+    rbuild.Add<uint32_t>("POS", PIL_TYPE_UINT32, pos + 1);
+    rbuild.Add<uint8_t>("MAPQ", PIL_TYPE_UINT8, mapq);
+
+    cigar_.clear();
+    for(uint32_t i = 0; i < n_cigar_op; ++i) {
+        const uint32_t op = BamLoad<uint32_t>(cigar + 4 * i);
+        if((op & 0xF) > 8) return(-3);
+        cigar_ += std::to_string(op >> 4);
+        cigar_ += BAM_CIGAR_CHARS[op & 0xF];
+    }
+    if(n_cigar_op == 0) cigar_ = "*";
+    if(BamAppendText(table, rbuild, "CIGAR", cigar_.data(), cigar_.size()) != 1) return(-4);
+
+    rbuild.Add<uint32_t>("RNEXT", PIL_TYPE_UINT32, rnext);
+    rbuild.Add<int32_t>("PNEXT", PIL_TYPE_INT32, next_pos + 1);
+    rbuild.Add<int32_t>("TLEN", PIL_TYPE_INT32, tlen);
+
+    // Bases and qualities are decoded in place. Missing values are `*`.
+    // Decoded bases include `=` and IUPAC codes: SamImporter::SetFields
+    // stores them with ZSTD rather than the base range coder.
+    if(l_seq == 0) {
+        if(BamAppendText(table, rbuild, "BASES", "*", 1) != 1) return(-4);
+        if(BamAppendText(table, rbuild, "QUAL", "*", 1) != 1) return(-4);
+    } else {
+        uint8_t* bases = table.ReserveArray<uint8_t>(rbuild, "BASES", PIL_TYPE_UINT8, l_seq);
+        if(bases == nullptr) return(-4);
+        for(int32_t i = 0; i < l_seq; ++i)
+            bases[i] = BAM_SEQ_CHARS[(seq[i >> 1] >> ((~i & 1) << 2)) & 0xF];
+
+        if(qual[0] == 0xFF) {
+            if(BamAppendText(table, rbuild, "QUAL", "*", 1) != 1) return(-4);
+        } else {
+            uint8_t* quals = table.ReserveArray<uint8_t>(rbuild, "QUAL", PIL_TYPE_UINT8, l_seq);
+            if(quals == nullptr) return(-4);
+            for(int32_t i = 0; i < l_seq; ++i) quals[i] = qual[i] + 33;
+        }
+    }
+
+    const int ret = AppendAux(aux, data + l_data, table, rbuild);
+    if(ret != 1) return(ret);
+
+    if(table.Append(rbuild) != 1) return(-4);
+    return(1);
+}
+
+int64_t BamImporter::Import(const std::string& path, TableConstructor& table) {
+    if(set_fields && SamImporter::SetFields(table) < 0) return(-1);
+
+    reader_.n_threads = n_threads;
+    reader_.blocks_per_batch = blocks_per_batch;
+    if(reader_.Open(path) != 1) return(-1);
+
+    header.clear();
+    rname_dict.clear();
+    unmapped_id_ = -1;
+    aux_fields_.clear();
+
+    int ret = ReadHeader();
+    if(ret != 1) { reader_.Close(); return(ret); }
+
+    RecordBuilder rbuild;
+    int64_t n_records = 0;
+    while(true) {
+        uint32_t l_data = 0;
+        const int64_t n_read = reader_.Read(&l_data, sizeof(uint32_t));
+        if(n_read == 0) break;
+        if(n_read < 0) { reader_.Close(); return(-2); }
+        if(n_read != sizeof(uint32_t)) { reader_.Close(); return(-3); }
+
+        if(record_.size() < l_data) record_.resize(l_data);
+        const int64_t n_record = reader_.Read(record_.data(), l_data);
+        if(n_record < 0) { reader_.Close(); return(-2); }
+        if(n_record != l_data) { reader_.Close(); return(-3); }
+
+        ret = AppendRecord(record_.data(), l_data, table, rbuild);
+        if(ret != 1) {
+            std::cerr << "malformed BAM record: " << n_records << std::endl;
+            reader_.Close();
+            return(ret);
+        }
+        ++n_records;
+    }
+    reader_.Close();
+
+    std::string names;
+    for(size_t i = 0; i < rname_dict.size(); ++i) {
+        names += rname_dict[i];
+        names += '\n';
+    }
+    table.meta_data.SetKeyValue(PIL_SAM_HEADER_KEY, header);
+    table.meta_data.SetKeyValue(PIL_SAM_RNAME_KEY, names);
+    table.meta_data.SetKeyValue(PIL_SAM_AUX_KEY, aux_fields_.Serialize());
+
+    return(n_records);
+}
+
+}
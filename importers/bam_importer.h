@@ -0,0 +1,75 @@
+#ifndef IMPORTERS_BAM_IMPORTER_H_
+#define IMPORTERS_BAM_IMPORTER_H_
+
+#include <string>
+#include <vector>
+
+#include "../table.h"
+#include "bgzf_reader.h"
+#include "sam_importer.h"
+
+namespace pil {
+
+// Import BAM files into a TableConstructor. BGZF blocks are inflated in
+// parallel by a BgzfReader and the binary records are decoded directly into
+// the Fields written by SamImporter without any text parsing: integers are
+// copied from the fixed-size record prefix and aux values are read in their
+// binary types.
+//
+// To remain interchangeable with imported SAM files, CIGAR operations and
+// 4-bit encoded bases are converted to text, qualities are offset by 33,
+// and integer aux types (c, C, s, S, i, I) are stored as `i` or as `I` for
+// values larger than INT32_MAX. RNAME and RNEXT hold the reference
+// identifiers of the BAM header, followed by `*` for unmapped records.
+class BamImporter {
+public:
+    BamImporter();
+
+    /**<
+     * Import every record of the BAM file into the provided Table. The
+     * header text and reference names are stored in the Table meta data
+     * under PIL_SAM_HEADER_KEY and PIL_SAM_RNAME_KEY. The Table is not
+     * finalized.
+     * @param path  Path to the BAM file.
+     * @param table Destination TableConstructor with an open output stream.
+     * @return      Returns the number of records imported or a negative value if the file is malformed.
+     */
+    int64_t Import(const std::string& path, TableConstructor& table);
+
+private:
+    /**<
+     * Read the BAM header and the reference dictionary.
+     * @return Returns 1 if successful or a negative value otherwise.
+     */
+    int ReadHeader();
+
+    /**<
+     * Append a single record to the Table.
+     * @param data   Record following its block_size prefix.
+     * @param l_data Length of the record.
+     * @return       Returns 1 if successful, -3 if the record is malformed, or -4 if it could not be appended.
+     */
+    int AppendRecord(const uint8_t* data, const uint32_t l_data, TableConstructor& table, RecordBuilder& rbuild);
+    int AppendAux(const uint8_t* data, const uint8_t* end, TableConstructor& table, RecordBuilder& rbuild);
+
+    // Identifier of a reference or of `*` for unmapped (negative) identifiers.
+    int64_t ReferenceId(const int32_t ref_id);
+
+public:
+    uint32_t n_threads; // Threads used to inflate BGZF blocks.
+    uint32_t blocks_per_batch; // BGZF blocks inflated per batch.
+    bool set_fields; // Call SamImporter::SetFields before importing.
+    std::string header; // Header text.
+    std::vector<std::string> rname_dict; // Reference names in identifier order.
+
+private:
+    BgzfReader reader_;
+    int64_t unmapped_id_; // Identifier of `*` or -1 if not yet added.
+    SamAuxFields aux_fields_;
+    std::vector<uint8_t> record_;
+    std::string cigar_;
+};
+
+}
+
+#endif /* IMPORTERS_BAM_IMPORTER_H_ */
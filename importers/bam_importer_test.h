@@ -0,0 +1,219 @@
+#ifndef IMPORTERS_BAM_IMPORTER_TEST_H_
+#define IMPORTERS_BAM_IMPORTER_TEST_H_
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <zlib.h>
+#include <gtest/gtest.h>
+#include "bam_importer.h"
+
+namespace pil {
+
+template <class T>
+static void BamTestPush(std::string& s, const T value) {
+    s.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Write uncompressed data as BGZF blocks of at most block_size bytes
+// followed by the empty EOF block.
+static void BamTestWriteBgzf(const std::string& path, const std::string& data, const uint32_t block_size) {
+    std::ofstream f(path, std::ios::binary);
+    std::vector<uint8_t> out(PIL_BGZF_MAX_BLOCK_SIZE);
+    for(size_t offset = 0; offset <= data.size(); offset += block_size) {
+        const uint32_t n = std::min<size_t>(block_size, data.size() - offset);
+        z_stream zs;
+        memset(&zs, 0, sizeof(z_stream));
+        deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data() + offset));
+        zs.avail_in = n;
+        zs.next_out = out.data();
+        zs.avail_out = out.size();
+        deflate(&zs, Z_FINISH);
+        const uint32_t l_deflate = zs.total_out;
+        deflateEnd(&zs);
+
+        std::string block = std::string("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0", 16);
+        BamTestPush<uint16_t>(block, 12 + 6 + l_deflate + 8 - 1);
+        block.append(reinterpret_cast<const char*>(out.data()), l_deflate);
+        BamTestPush<uint32_t>(block, crc32(0, reinterpret_cast<const Bytef*>(data.data() + offset), n));
+        BamTestPush<uint32_t>(block, n);
+        f.write(block.data(), block.size());
+        if(n == 0) break;
+    }
+}
+
+TEST(ImporterTests, BamImport) {
+    const std::string bam_path = "pil_bam_import_test.bam";
+    const std::string path = "pil_bam_import_test.pil";
+    const uint32_t n_reads = 10000;
+
+    std::string bam("BAM\1", 4);
+    const std::string text = "@HD\tVN:1.6\n@SQ\tSN:chr2\tLN:1000000\n@SQ\tSN:chr1\tLN:1000000\n";
+    BamTestPush<int32_t>(bam, text.size());
+    bam += text;
+    BamTestPush<int32_t>(bam, 2);
+    BamTestPush<int32_t>(bam, 5); bam.append("chr2", 5); BamTestPush<int32_t>(bam, 1000000);
+    BamTestPush<int32_t>(bam, 5); bam.append("chr1", 5); BamTestPush<int32_t>(bam, 1000000);
+
+    for(uint32_t i = 0; i < n_reads; ++i) {
+        const std::string name = "read" + std::to_string(i);
+        const bool unmapped = i % 10 == 9;
+        std::string rec;
+        BamTestPush<int32_t>(rec, unmapped ? -1 : i % 2);
+        BamTestPush<int32_t>(rec, unmapped ? -1 : i);
+        BamTestPush<uint8_t>(rec, name.size() + 1);
+        BamTestPush<uint8_t>(rec, 60);
+        BamTestPush<uint16_t>(rec, 0);
+        BamTestPush<uint16_t>(rec, unmapped ? 0 : 2);
+        BamTestPush<uint16_t>(rec, unmapped ? 4 : (i % 4) * 16);
+        BamTestPush<int32_t>(rec, 8);
+        BamTestPush<int32_t>(rec, unmapped ? -1 : i % 2);
+        BamTestPush<int32_t>(rec, unmapped ? -1 : i + 99);
+        BamTestPush<int32_t>(rec, -(int32_t)i);
+        rec.append(name.c_str(), name.size() + 1);
+        if(unmapped == false) {
+            BamTestPush<uint32_t>(rec, (6 << 4) | 0); // 6M
+            BamTestPush<uint32_t>(rec, (2 << 4) | 4); // 2S
+        }
+        rec += std::string("\x12\x48\x12\x48", 4); // ACGTACGT
+        if(unmapped) rec += std::string(8, '\xff');
+        else for(uint32_t k = 0; k < 8; ++k) rec += (char)(37 + k % 2);
+
+        rec += "NMC"; BamTestPush<uint8_t>(rec, i % 5);
+        rec += "XAZ"; rec += "alt" + std::to_string(i); rec += '\0';
+        rec += "BCBs"; BamTestPush<uint32_t>(rec, 3); BamTestPush<int16_t>(rec, -1); BamTestPush<int16_t>(rec, i % 100); BamTestPush<int16_t>(rec, 3);
+        rec += "XFf"; BamTestPush<float>(rec, 1.5f);
+        rec += "XIS"; BamTestPush<uint16_t>(rec, 60000);
+        rec += "XUI"; BamTestPush<uint32_t>(rec, 3000000000u);
+
+        BamTestPush<uint32_t>(bam, rec.size());
+        bam += rec;
+    }
+    // Small blocks such that records span blocks and batches.
+    BamTestWriteBgzf(bam_path, bam, 4000);
+
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+    table.batch_size = 1000000;
+
+    BamImporter importer;
+    importer.n_threads = 4;
+    importer.blocks_per_batch = 16;
+    ASSERT_EQ(n_reads, importer.Import(bam_path, table));
+    ASSERT_EQ(n_reads, table.meta_data.batches.back()->n_rec);
+
+    ASSERT_EQ(text, *table.meta_data.GetKeyValue(PIL_SAM_HEADER_KEY));
+    ASSERT_EQ("chr2\nchr1\n*\n", *table.meta_data.GetKeyValue(PIL_SAM_RNAME_KEY));
+
+    const uint32_t* rname = reinterpret_cast<const uint32_t*>(table.GetBatchColumnSet("RNAME")->columns[0]->mutable_data());
+    ASSERT_EQ(0, rname[0]);
+    ASSERT_EQ(1, rname[1]);
+    ASSERT_EQ(2, rname[9]);
+    const uint32_t* pos = reinterpret_cast<const uint32_t*>(table.GetBatchColumnSet("POS")->columns[0]->mutable_data());
+    ASSERT_EQ(1235, pos[1234]);
+    ASSERT_EQ(0, pos[9]);
+    const int32_t* tlen = reinterpret_cast<const int32_t*>(table.GetBatchColumnSet("TLEN")->columns[0]->mutable_data());
+    ASSERT_EQ(-9999, tlen[9999]);
+
+    // Text fields are decoded from their binary representations.
+    std::shared_ptr<ColumnSet> cigar = table.GetBatchColumnSet("CIGAR");
+    const uint32_t* cigar_offsets = reinterpret_cast<const uint32_t*>(cigar->columns[0]->mutable_data());
+    const char* cigar_data = reinterpret_cast<const char*>(cigar->columns[1]->mutable_data());
+    ASSERT_EQ("6M2S", std::string(cigar_data + cigar_offsets[0], cigar_offsets[1] - cigar_offsets[0]));
+    ASSERT_EQ("*", std::string(cigar_data + cigar_offsets[9], cigar_offsets[10] - cigar_offsets[9]));
+
+    std::shared_ptr<ColumnSet> bases = table.GetBatchColumnSet("BASES");
+    ASSERT_EQ("ACGTACGT", std::string(reinterpret_cast<const char*>(bases->columns[1]->mutable_data()) + 8 * 1234, 8));
+    std::shared_ptr<ColumnSet> qual = table.GetBatchColumnSet("QUAL");
+    const uint32_t* qual_offsets = reinterpret_cast<const uint32_t*>(qual->columns[0]->mutable_data());
+    const char* qual_data = reinterpret_cast<const char*>(qual->columns[1]->mutable_data());
+    ASSERT_EQ("FGFGFGFG", std::string(qual_data + qual_offsets[0], 8));
+    ASSERT_EQ("*", std::string(qual_data + qual_offsets[9], qual_offsets[10] - qual_offsets[9]));
+
+    // Integer aux types are stored as in imported SAM files.
+    ASSERT_EQ(PIL_TYPE_INT32, table.field_dict.dict[table.field_dict.Find("NM")].ptype);
+    ASSERT_EQ(PIL_TYPE_INT32, table.field_dict.dict[table.field_dict.Find("XI")].ptype);
+    ASSERT_EQ(PIL_TYPE_UINT32, table.field_dict.dict[table.field_dict.Find("XU")].ptype);
+    ASSERT_EQ(PIL_TYPE_UINT8, table.field_dict.dict[table.field_dict.Find("XA")].ptype);
+    ASSERT_EQ(PIL_CSTORE_TENSOR, table.field_dict.dict[table.field_dict.Find("XA")].cstore);
+    ASSERT_EQ(PIL_TYPE_INT16, table.field_dict.dict[table.field_dict.Find("BC")].ptype);
+    ASSERT_EQ(PIL_TYPE_FLOAT, table.field_dict.dict[table.field_dict.Find("XF")].ptype);
+
+    const int32_t* nm = reinterpret_cast<const int32_t*>(table.GetBatchColumnSet("NM")->columns[0]->mutable_data());
+    ASSERT_EQ(4, nm[1234]);
+    const uint32_t* xu = reinterpret_cast<const uint32_t*>(table.GetBatchColumnSet("XU")->columns[0]->mutable_data());
+    ASSERT_EQ(3000000000u, xu[n_reads - 1]);
+    std::shared_ptr<ColumnSet> bc = table.GetBatchColumnSet("BC");
+    const int16_t* bc_values = reinterpret_cast<const int16_t*>(bc->columns[1]->mutable_data());
+    ASSERT_EQ(3 * n_reads, bc->columns[1]->n_elements);
+    ASSERT_EQ(34, bc_values[3 * 1234 + 1]);
+    table.out_stream.close();
+
+    // Corrupted blocks are rejected.
+    {
+        std::fstream f(bam_path, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(100);
+        f.put('\0');
+    }
+    TableConstructor table2;
+    ASSERT_GT(0, importer.Import(bam_path, table2));
+
+    std::remove(bam_path.c_str());
+    std::remove(path.c_str());
+}
+
+TEST(ImporterTests, BamImportNonAcgtBases) {
+    const std::string bam_path = "pil_bam_import_bases_test.bam";
+
+    std::string bam("BAM\1", 4);
+    BamTestPush<int32_t>(bam, 0);
+    BamTestPush<int32_t>(bam, 0);
+
+    // Every 4-bit code of "=ACMGRSVTWYHKDBN", a missing SEQ and '=' bases.
+    const std::string seqs[3] = {"=ACMGRSVTWYHKDBN", "", "ACGT=N="};
+    const std::string codes = "=ACMGRSVTWYHKDBN";
+    std::vector<std::string> expected;
+    for(uint32_t i = 0; i < 999; ++i) {
+        const std::string& seq = seqs[i % 3];
+        const std::string name = "read" + std::to_string(i);
+        std::string rec;
+        BamTestPush<int32_t>(rec, -1);
+        BamTestPush<int32_t>(rec, -1);
+        BamTestPush<uint8_t>(rec, name.size() + 1);
+        BamTestPush<uint8_t>(rec, 0);
+        BamTestPush<uint16_t>(rec, 0);
+        BamTestPush<uint16_t>(rec, 0);
+        BamTestPush<uint16_t>(rec, 4);
+        BamTestPush<int32_t>(rec, seq.size());
+        BamTestPush<int32_t>(rec, -1);
+        BamTestPush<int32_t>(rec, -1);
+        BamTestPush<int32_t>(rec, 0);
+        rec.append(name.c_str(), name.size() + 1);
+        for(size_t k = 0; k < seq.size(); k += 2) {
+            const uint8_t hi = codes.find(seq[k]);
+            const uint8_t lo = (k + 1 < seq.size()) ? codes.find(seq[k + 1]) : 0;
+            rec += (char)((hi << 4) | lo);
+        }
+        rec += std::string(seq.size(), '\xff');
+
+        BamTestPush<uint32_t>(bam, rec.size());
+        bam += rec;
+        expected.push_back(seq.size() ? seq : "*");
+    }
+    BamTestWriteBgzf(bam_path, bam, 4000);
+
+    TableConstructor table;
+    BamImporter importer;
+    importer.n_threads = 2;
+    ASSERT_EQ(999, importer.Import(bam_path, table));
+    SamTestBasesRoundTrip(table, expected);
+
+    std::remove(bam_path.c_str());
+}
+
+}
+
+#endif /* IMPORTERS_BAM_IMPORTER_TEST_H_ */
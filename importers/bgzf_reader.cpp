@@ -0,0 +1,154 @@
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+#include <zlib.h>
+
+#include "bgzf_reader.h"
+
+namespace pil {
+
+// Little-endian loads from the block headers.
+static inline uint32_t BgzfLoad16(const uint8_t* p) { return(p[0] | (p[1] << 8)); }
+static inline uint32_t BgzfLoad32(const uint8_t* p) { return(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24)); }
+
+BgzfReader::BgzfReader(const uint32_t n_threads, const uint32_t blocks_per_batch) :
+    n_threads(n_threads), blocks_per_batch(blocks_per_batch), eof_(true), n_buffer_(0), pos_(0)
+{
+}
+
+BgzfReader::~BgzfReader() { Close(); }
+
+int BgzfReader::Open(const std::string& path) {
+    Close();
+    stream_.open(path, std::ios::binary | std::ios::in);
+    if(stream_.good() == false) return(-1);
+    eof_ = false;
+    return(1);
+}
+
+void BgzfReader::Close() {
+    if(stream_.is_open()) stream_.close();
+    eof_ = true;
+    n_buffer_ = 0;
+    pos_ = 0;
+}
+
+int64_t BgzfReader::Read(void* dst, const size_t n_bytes) {
+    uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+    size_t n_read = 0;
+    while(n_read < n_bytes) {
+        if(pos_ == n_buffer_) {
+            const int64_t ret = ReadBatch();
+            if(ret < 0) return(ret);
+            if(ret == 0) break;
+        }
+        const size_t n_copy = std::min(n_bytes - n_read, n_buffer_ - pos_);
+        memcpy(out + n_read, &buffer_[pos_], n_copy);
+        pos_ += n_copy;
+        n_read += n_copy;
+    }
+    return(n_read);
+}
+
+int64_t BgzfReader::ReadBatch() {
+    n_buffer_ = 0;
+    pos_ = 0;
+
+    // Batches consisting of empty blocks (such as the EOF marker) are skipped.
+    while(n_buffer_ == 0) {
+        if(eof_) return(0);
+
+        compressed_.clear();
+        compressed_.reserve(blocks_per_batch * PIL_BGZF_MAX_BLOCK_SIZE);
+        block_offsets_.assign(1, 0);
+        data_offsets_.assign(1, 0);
+        block_crc_.clear();
+
+        for(uint32_t b = 0; b < blocks_per_batch; ++b) {
+            // Fixed gzip header: ID1 ID2 CM FLG MTIME(4) XFL OS XLEN(2).
+            uint8_t header[12];
+            stream_.read(reinterpret_cast<char*>(header), 12);
+            if(stream_.gcount() == 0) { eof_ = true; break; }
+            if(stream_.gcount() != 12) return(-1);
+            if(header[0] != 31 || header[1] != 139 || header[2] != 8 || (header[3] & 4) == 0) return(-2);
+
+            // The BC extra subfield holds the total block size minus 1.
+            const uint32_t xlen = BgzfLoad16(&header[10]);
+            uint8_t extra[PIL_BGZF_MAX_BLOCK_SIZE];
+            stream_.read(reinterpret_cast<char*>(extra), xlen);
+            if(stream_.gcount() != xlen) return(-1);
+            uint32_t block_size = 0;
+            for(uint32_t i = 0; i + 4 <= xlen; ) {
+                const uint32_t slen = BgzfLoad16(&extra[i + 2]);
+                if(extra[i] == 66 && extra[i + 1] == 67 && slen == 2 && i + 6 <= xlen) block_size = BgzfLoad16(&extra[i + 4]) + 1;
+                i += 4 + slen;
+            }
+            if(block_size < 12 + xlen + 8) return(-2);
+
+            // Deflate data followed by CRC32 and ISIZE.
+            const uint32_t n_data = block_size - 12 - xlen - 8;
+            const size_t offset = compressed_.size();
+            compressed_.resize(offset + n_data);
+            stream_.read(reinterpret_cast<char*>(&compressed_[offset]), n_data);
+            uint8_t footer[8];
+            stream_.read(reinterpret_cast<char*>(footer), 8);
+            if(stream_.good() == false) return(-1);
+
+            const uint32_t isize = BgzfLoad32(&footer[4]);
+            if(isize > PIL_BGZF_MAX_BLOCK_SIZE) return(-2);
+            block_crc_.push_back(BgzfLoad32(&footer[0]));
+            block_offsets_.push_back(compressed_.size());
+            data_offsets_.push_back(data_offsets_.back() + isize);
+        }
+
+        const uint32_t n_blocks = block_crc_.size();
+        n_buffer_ = data_offsets_.back();
+        if(buffer_.size() < n_buffer_) buffer_.resize(n_buffer_);
+
+        // Inflate one range of blocks per thread.
+        const uint32_t n_parts = std::max(1u, std::min(n_threads, n_blocks));
+        if(n_parts == 1) {
+            if(InflateBlocks(0, n_blocks) != 1) return(-3);
+        } else {
+            std::vector<int> results(n_parts);
+            std::vector<std::thread> threads;
+            for(uint32_t p = 0; p < n_parts; ++p) {
+                const uint32_t from = (uint64_t)n_blocks * p / n_parts;
+                const uint32_t to = (uint64_t)n_blocks * (p + 1) / n_parts;
+                threads.push_back(std::thread([this, &results, p, from, to]() { results[p] = InflateBlocks(from, to); }));
+            }
+            for(uint32_t p = 0; p < n_parts; ++p) threads[p].join();
+            for(uint32_t p = 0; p < n_parts; ++p) {
+                if(results[p] != 1) return(-3);
+            }
+        }
+    }
+
+    return(n_buffer_);
+}
+
+int BgzfReader::InflateBlocks(const uint32_t from, const uint32_t to) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(z_stream));
+    if(inflateInit2(&zs, -15) != Z_OK) return(-1);
+
+    int ret_status = 1;
+    for(uint32_t i = from; i < to; ++i) {
+        const uint32_t isize = data_offsets_[i + 1] - data_offsets_[i];
+        if(isize == 0) continue;
+
+        inflateReset(&zs);
+        zs.next_in   = &compressed_[block_offsets_[i]];
+        zs.avail_in  = block_offsets_[i + 1] - block_offsets_[i];
+        zs.next_out  = &buffer_[data_offsets_[i]];
+        zs.avail_out = isize;
+        if(inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.total_out != isize) { ret_status = -1; break; }
+        if(crc32(0, &buffer_[data_offsets_[i]], isize) != block_crc_[i]) { ret_status = -1; break; }
+    }
+
+    inflateEnd(&zs);
+    return(ret_status);
+}
+
+}
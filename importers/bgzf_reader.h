@@ -0,0 +1,68 @@
+#ifndef IMPORTERS_BGZF_READER_H_
+#define IMPORTERS_BGZF_READER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+
+namespace pil {
+
+// Maximum size of a BGZF block and of its uncompressed payload.
+#define PIL_BGZF_MAX_BLOCK_SIZE 65536
+
+// Sequential reader of BGZF files (the blocked gzip format used by BAM).
+// Batches of blocks are read from disk and inflated by several threads,
+// one block per task, into a contiguous buffer that is read from in order.
+class BgzfReader {
+public:
+    BgzfReader(const uint32_t n_threads = 1, const uint32_t blocks_per_batch = 256);
+    ~BgzfReader();
+
+    /**<
+     * Open a BGZF file for reading.
+     * @param path Path to the file.
+     * @return     Returns 1 if successful or -1 otherwise.
+     */
+    int Open(const std::string& path);
+    void Close();
+
+    /**<
+     * Copy the next n_bytes uncompressed bytes into dst.
+     * @param dst     Destination with room for n_bytes bytes.
+     * @param n_bytes Number of bytes to read.
+     * @return        Returns the number of bytes read, which is smaller than n_bytes only at the end of the file, or a negative value if a block is malformed.
+     */
+    int64_t Read(void* dst, const size_t n_bytes);
+
+private:
+    /**<
+     * Read and inflate the next batch of blocks into the buffer.
+     * @return Returns the number of uncompressed bytes, 0 at the end of the file, or a negative value on error.
+     */
+    int64_t ReadBatch();
+
+    /**<
+     * Inflate the blocks [from, to) of the current batch.
+     * @return Returns 1 if successful or -1 if a block is corrupted.
+     */
+    int InflateBlocks(const uint32_t from, const uint32_t to);
+
+public:
+    uint32_t n_threads;
+    uint32_t blocks_per_batch;
+
+private:
+    std::ifstream stream_;
+    bool eof_;
+    std::vector<uint8_t> compressed_; // Raw deflate data of the current batch.
+    std::vector<uint64_t> block_offsets_; // Offset of each block in compressed_ (n_blocks + 1).
+    std::vector<uint64_t> data_offsets_; // Offset of each block in buffer_ (n_blocks + 1).
+    std::vector<uint32_t> block_crc_; // CRC32 of each uncompressed block.
+    std::vector<uint8_t> buffer_; // Uncompressed data of the current batch.
+    size_t n_buffer_, pos_;
+};
+
+}
+
+#endif /* IMPORTERS_BGZF_READER_H_ */
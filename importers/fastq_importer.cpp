@@ -0,0 +1,113 @@
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+#include "fastq_importer.h"
+
+// Blocks with fewer records are validated by a single thread.
+#define PIL_FASTQ_MIN_PARALLEL 16384
+
+namespace pil {
+
+FastqImporter::FastqImporter() :
+    n_threads(1), block_size(16 << 20), set_fields(true),
+    name_field("NAME"), bases_field("BASES"), qual_field("QUAL")
+{
+}
+
+int FastqImporter::SetFields(TableConstructor& table) const {
+    std::vector<PIL_COMPRESSION_TYPE> ctypes;
+    ctypes.push_back(PIL_COMPRESS_RC_QUAL);
+    if(table.SetField(qual_field, PIL_TYPE_BYTE_ARRAY, PIL_TYPE_UINT8, ctypes) < 0) return(-1);
+
+    ctypes.clear();
+    ctypes.push_back(PIL_COMPRESS_RC_BASES);
+    if(table.SetField(bases_field, PIL_TYPE_BYTE_ARRAY, PIL_TYPE_UINT8, ctypes) < 0) return(-1);
+
+    ctypes.clear();
+    ctypes.push_back(PIL_COMPRESS_RC_ILLUMINA_NAME);
+    if(table.SetField(name_field, PIL_TYPE_BYTE_ARRAY, PIL_TYPE_UINT8, ctypes) < 0) return(-1);
+
+    return(1);
+}
+
+uint32_t FastqImporter::Validate(const uint32_t from, const uint32_t to) const {
+    for(uint32_t i = from; i < to; ++i) {
+        const uint32_t l = 4 * i;
+        if(reader_.line_length(l) == 0 || reader_.line(l)[0] != '@') return(i);
+        if(reader_.line_length(l + 2) == 0 || reader_.line(l + 2)[0] != '+') return(i);
+        if(reader_.line_length(l + 1) != reader_.line_length(l + 3)) return(i);
+    }
+    return(to);
+}
+
+int64_t FastqImporter::Import(const std::string& path, TableConstructor& table) {
+    if(set_fields && SetFields(table) < 0) return(-1);
+
+    reader_.block_size = block_size;
+    reader_.n_threads = n_threads;
+    if(reader_.Open(path) != 1) return(-1);
+
+    RecordBuilder rbuild;
+    int64_t n_records = 0;
+    while(true) {
+        const int64_t n_lines = reader_.Next(4);
+        if(n_lines == 0) break;
+        if(n_lines < 0) { reader_.Close(); return(-2); }
+        const uint32_t n_block = n_lines / 4;
+
+        // Validate the records in parallel before appending them in order.
+        uint32_t first_invalid = n_block;
+        const uint32_t n_parts = n_block < PIL_FASTQ_MIN_PARALLEL ? 1 : std::max(1u, n_threads);
+        if(n_parts == 1) {
+            first_invalid = Validate(0, n_block);
+        } else {
+            std::vector<uint32_t> results(n_parts);
+            std::vector<std::thread> threads;
+            const uint32_t part_size = n_block / n_parts;
+            for(uint32_t p = 0; p < n_parts; ++p) {
+                const uint32_t from = p * part_size;
+                const uint32_t to = p + 1 == n_parts ? n_block : from + part_size;
+                threads.push_back(std::thread([this, &results, p, from, to]() { results[p] = Validate(from, to); }));
+            }
+            for(uint32_t p = 0; p < n_parts; ++p) threads[p].join();
+            for(uint32_t p = 0; p < n_parts; ++p) {
+                const uint32_t to = p + 1 == n_parts ? n_block : (p + 1) * part_size;
+                if(results[p] != to) { first_invalid = results[p]; break; }
+            }
+        }
+        if(first_invalid != n_block) {
+            std::cerr << "malformed FASTQ record: " << n_records + first_invalid << std::endl;
+            reader_.Close();
+            return(-3);
+        }
+
+        // Names (without the leading '@'), bases and qualities are written
+        // directly into the ColumnSets.
+        for(uint32_t i = 0; i < n_block; ++i) {
+            const uint32_t l = 4 * i;
+            const uint32_t l_name = reader_.line_length(l) - 1;
+            const uint32_t l_seq = reader_.line_length(l + 1);
+
+            uint8_t* dst = table.ReserveArray<uint8_t>(rbuild, name_field, PIL_TYPE_UINT8, l_name);
+            if(dst == nullptr && l_name) { reader_.Close(); return(-4); }
+            if(l_name) memcpy(dst, reader_.line(l) + 1, l_name);
+
+            dst = table.ReserveArray<uint8_t>(rbuild, bases_field, PIL_TYPE_UINT8, l_seq);
+            if(dst == nullptr && l_seq) { reader_.Close(); return(-4); }
+            if(l_seq) memcpy(dst, reader_.line(l + 1), l_seq);
+
+            dst = table.ReserveArray<uint8_t>(rbuild, qual_field, PIL_TYPE_UINT8, l_seq);
+            if(dst == nullptr && l_seq) { reader_.Close(); return(-4); }
+            if(l_seq) memcpy(dst, reader_.line(l + 3), l_seq);
+
+            if(table.Append(rbuild) != 1) { reader_.Close(); return(-4); }
+        }
+        n_records += n_block;
+    }
+
+    reader_.Close();
+    return(n_records);
+}
+
+}
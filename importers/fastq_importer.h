@@ -0,0 +1,66 @@
+#ifndef IMPORTERS_FASTQ_IMPORTER_H_
+#define IMPORTERS_FASTQ_IMPORTER_H_
+
+#include <string>
+
+#include "../table.h"
+#include "text_reader.h"
+
+namespace pil {
+
+// Import FASTQ files into a TableConstructor. The input is read in blocks
+// of whole records whose line boundaries are located and validated by
+// several threads. Read names are stored in the NAME Field and bases and
+// qualities are written in place into the BASES and QUAL Fields (see
+// TableConstructor::ReserveArray).
+//
+// Example usage:
+//
+// FastqImporter importer;
+// importer.n_threads = 4;
+// int64_t n_records = importer.Import("reads.fq", table);
+// table.Finalize();
+class FastqImporter {
+public:
+    FastqImporter();
+
+    /**<
+     * Import every record of the FASTQ file into the provided Table. The
+     * Table is not finalized.
+     * @param path  Path to the FASTQ file.
+     * @param table Destination TableConstructor with an open output stream.
+     * @return      Returns the number of records imported or a negative value if the file is malformed.
+     */
+    int64_t Import(const std::string& path, TableConstructor& table);
+
+    /**<
+     * Register the Fields with their default transformations: the CRAM-style
+     * range coders for the bases, qualities and Illumina read names. Fields
+     * that already exist in the Table are left untouched.
+     * @param table Destination TableConstructor.
+     * @return      Returns 1 if successful or a negative value otherwise.
+     */
+    int SetFields(TableConstructor& table) const;
+
+private:
+    /**<
+     * Check the records [from, to) of the current block: headers start with
+     * '@', separators with '+', and the bases and qualities are of equal
+     * length.
+     * @return Returns the first malformed record or `to` otherwise.
+     */
+    uint32_t Validate(const uint32_t from, const uint32_t to) const;
+
+public:
+    uint32_t n_threads; // Threads used to index and validate blocks.
+    size_t block_size; // Bytes read per block.
+    bool set_fields; // Call SetFields before importing.
+    std::string name_field, bases_field, qual_field;
+
+private:
+    TextReader reader_;
+};
+
+}
+
+#endif /* IMPORTERS_FASTQ_IMPORTER_H_ */
@@ -0,0 +1,109 @@
+#ifndef IMPORTERS_FASTQ_IMPORTER_TEST_H_
+#define IMPORTERS_FASTQ_IMPORTER_TEST_H_
+
+#include <cstdio>
+#include <fstream>
+
+#include <gtest/gtest.h>
+#include "fastq_importer.h"
+
+namespace pil {
+
+TEST(ImporterTests, FindNewlines) {
+    std::string text;
+    for(int i = 0; i < 200; ++i) text += std::string(i % 37, 'A') + "\n";
+    text += "tail";
+
+    std::vector<uint32_t> expected;
+    for(size_t i = 0; i < text.size(); ++i) {
+        if(text[i] == '\n') expected.push_back(i + 5);
+    }
+    std::vector<uint32_t> found;
+    FindNewlines(text.data(), text.size(), 5, found);
+    ASSERT_EQ(expected, found);
+}
+
+TEST(ImporterTests, TextReaderCarriesLines) {
+    const std::string path = "pil_text_reader_test.txt";
+    {
+        std::ofstream f(path, std::ios::binary);
+        for(int i = 0; i < 1000; ++i) f << "line" << i << "\r\n";
+        f << "last";
+    }
+
+    // Blocks smaller than a line group grow to hold one.
+    TextReader reader(8, 2);
+    ASSERT_EQ(1, reader.Open(path));
+    int n_lines = 0;
+    int64_t ret = 0;
+    while((ret = reader.Next(7)) > 0) {
+        ASSERT_EQ(0, ret % 7);
+        for(uint32_t i = 0; i < reader.size(); ++i, ++n_lines) {
+            const std::string expected = n_lines == 1000 ? "last" : "line" + std::to_string(n_lines);
+            ASSERT_EQ(expected, std::string(reader.line(i), reader.line_length(i)));
+        }
+    }
+    ASSERT_EQ(0, ret);
+    ASSERT_EQ(1001, n_lines);
+
+    // The trailing incomplete group is reported.
+    ASSERT_EQ(1, reader.Open(path));
+    while((ret = reader.Next(4)) > 0) {}
+    ASSERT_EQ(-3, ret);
+
+    std::remove(path.c_str());
+}
+
+TEST(ImporterTests, FastqImport) {
+    const std::string fastq_path = "pil_fastq_import_test.fq";
+    const std::string path = "pil_fastq_import_test.pil";
+    const uint32_t n_reads = 40000;
+    {
+        std::ofstream f(fastq_path, std::ios::binary);
+        for(uint32_t i = 0; i < n_reads; ++i) {
+            const std::string bases(50 + i % 50, "ACGT"[i % 4]);
+            f << "@read:" << i << "\n" << bases << "\n+\n" << std::string(bases.size(), 'F') << "\n";
+        }
+    }
+
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+    table.batch_size = 1000000;
+
+    // Blocks are large enough to be indexed and validated in parallel.
+    FastqImporter importer;
+    importer.n_threads = 4;
+    importer.block_size = 4 << 20;
+    ASSERT_EQ(n_reads, importer.Import(fastq_path, table));
+    ASSERT_EQ(1, table.meta_data.batches.size());
+    ASSERT_EQ(n_reads, table.meta_data.batches.back()->n_rec);
+    ASSERT_EQ(1, table.field_dict.dict[table.field_dict.Find("BASES")].transforms.size());
+
+    std::shared_ptr<ColumnSet> names = table.GetBatchColumnSet("NAME");
+    std::shared_ptr<ColumnSet> bases = table.GetBatchColumnSet("BASES");
+    const uint32_t* name_offsets = reinterpret_cast<const uint32_t*>(names->columns[0]->mutable_data());
+    const uint32_t* base_offsets = reinterpret_cast<const uint32_t*>(bases->columns[0]->mutable_data());
+    for(uint32_t i = 0; i < n_reads; i += 997) {
+        const std::string name(reinterpret_cast<const char*>(names->columns[1]->mutable_data()) + name_offsets[i], name_offsets[i + 1] - name_offsets[i]);
+        ASSERT_EQ("read:" + std::to_string(i), name);
+        ASSERT_EQ(50 + i % 50, base_offsets[i + 1] - base_offsets[i]);
+        ASSERT_EQ("ACGT"[i % 4], bases->columns[1]->mutable_data()[base_offsets[i]]);
+    }
+    table.out_stream.close();
+
+    // Bases and qualities of different lengths are rejected.
+    {
+        std::ofstream f(fastq_path, std::ios::binary);
+        f << "@a\nACGT\n+\nFFFF\n@b\nACGT\n+\nFFF\n";
+    }
+    TableConstructor table2;
+    ASSERT_EQ(-3, importer.Import(fastq_path, table2));
+
+    std::remove(fastq_path.c_str());
+    std::remove(path.c_str());
+}
+
+}
+
+#endif /* IMPORTERS_FASTQ_IMPORTER_TEST_H_ */
@@ -0,0 +1,266 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "reference_importer.h"
+
+// Signature of UCSC 2bit files in native and swapped byte order.
+#define PIL_2BIT_SIGNATURE         0x1A412743U
+#define PIL_2BIT_SIGNATURE_SWAPPED 0x4327411AU
+
+namespace pil {
+
+// Reader of the little- or big-endian integers of a 2bit file.
+struct TwoBitStream {
+    TwoBitStream(std::ifstream& stream, const bool swap) : stream(stream), swap(swap){}
+
+    uint32_t ReadU32() {
+        uint32_t v = 0;
+        stream.read(reinterpret_cast<char*>(&v), sizeof(uint32_t));
+        return(swap ? __builtin_bswap32(v) : v);
+    }
+
+    uint64_t ReadU64() {
+        uint64_t v = 0;
+        stream.read(reinterpret_cast<char*>(&v), sizeof(uint64_t));
+        return(swap ? __builtin_bswap64(v) : v);
+    }
+
+    // Read n (start, size) exception blocks sorted by start.
+    bool ReadRuns(std::vector< std::pair<uint32_t, uint32_t> >& runs) {
+        const uint32_t n = ReadU32();
+        if(stream.good() == false || n > (1U << 30)) return(false);
+        runs.resize(n);
+        for(uint32_t i = 0; i < n; ++i) runs[i].first = ReadU32();
+        for(uint32_t i = 0; i < n; ++i) runs[i].second = ReadU32();
+        std::sort(runs.begin(), runs.end());
+        return(stream.good());
+    }
+
+    std::ifstream& stream;
+    const bool swap;
+};
+
+// Clip the exception blocks of a 2bit sequence to [from, from + n) as pairs
+// relative to `from`. Runs ending before `from` are skipped by advancing `k`.
+static void TwoBitClipRuns(const std::vector< std::pair<uint32_t, uint32_t> >& runs, size_t& k,
+                           const uint32_t from, const uint32_t n, std::vector<uint32_t>& out)
+{
+    out.clear();
+    while(k < runs.size() && (uint64_t)runs[k].first + runs[k].second <= from) ++k;
+    for(size_t j = k; j < runs.size() && runs[j].first < (uint64_t)from + n; ++j) {
+        const uint64_t begin = std::max<uint64_t>(runs[j].first, from);
+        const uint64_t end = std::min<uint64_t>((uint64_t)runs[j].first + runs[j].second, (uint64_t)from + n);
+        if(begin >= end) continue;
+        out.push_back(begin - from);
+        out.push_back(end - begin);
+    }
+}
+
+ReferenceImporter::ReferenceImporter() :
+    format(PIL_REFERENCE_AUTO), n_threads(1), block_size(16 << 20), block_bases(PIL_REFERENCE_BLOCK_BASES), set_fields(true)
+{
+}
+
+int ReferenceImporter::SetFields(TableConstructor& table) {
+    std::vector<PIL_COMPRESSION_TYPE> ctypes;
+    ctypes.push_back(PIL_ENCODE_DELTA);
+    ctypes.push_back(PIL_COMPRESS_ZSTD);
+    if(table.SetField("START", PIL_TYPE_INT64, ctypes) < 0) return(-1);
+    if(table.SetField("END", PIL_TYPE_INT64, ctypes) < 0) return(-1);
+
+    return(1);
+}
+
+PIL_REFERENCE_FORMAT ReferenceImporter::DetectFormat(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    if(f.good() == false) return(PIL_REFERENCE_AUTO);
+    uint32_t signature = 0;
+    f.read(reinterpret_cast<char*>(&signature), sizeof(uint32_t));
+    if(f.good() && (signature == PIL_2BIT_SIGNATURE || signature == PIL_2BIT_SIGNATURE_SWAPPED))
+        return(PIL_REFERENCE_2BIT);
+    return(PIL_REFERENCE_FASTA);
+}
+
+int ReferenceImporter::AppendBlock(const uint32_t n_bases, TableConstructor& table, RecordBuilder& rbuild) {
+    const uint32_t contig_id = reference->contigs.size() - 1;
+    const int64_t start = reference->contigs.back().length;
+    if(reference->AddBlock(packed_.data(), n_bases, n_runs_, mask_runs_) != 1) return(-1);
+
+    rbuild.Add<uint32_t>("RNAME", PIL_TYPE_UINT32, contig_id);
+    rbuild.Add<int64_t>("START", PIL_TYPE_INT64, start);
+    rbuild.Add<int64_t>("END", PIL_TYPE_INT64, start + n_bases);
+
+    const uint32_t n_bytes = (n_bases + 3) / 4;
+    uint8_t* bases = table.ReserveArray<uint8_t>(rbuild, "BASES", PIL_TYPE_UINT8, n_bytes);
+    if(bases == nullptr) return(-1);
+    memcpy(bases, packed_.data(), n_bytes);
+
+    // Exceptions are sparse.
+    if(n_runs_.size()) {
+        uint32_t* dst = table.ReserveArray<uint32_t>(rbuild, "N_RUNS", PIL_TYPE_UINT32, n_runs_.size());
+        if(dst == nullptr) return(-1);
+        memcpy(dst, n_runs_.data(), n_runs_.size() * sizeof(uint32_t));
+    }
+    if(mask_runs_.size()) {
+        uint32_t* dst = table.ReserveArray<uint32_t>(rbuild, "MASK_RUNS", PIL_TYPE_UINT32, mask_runs_.size());
+        if(dst == nullptr) return(-1);
+        memcpy(dst, mask_runs_.data(), mask_runs_.size() * sizeof(uint32_t));
+    }
+
+    if(table.Append(rbuild) != 1) return(-1);
+    return(1);
+}
+
+int64_t ReferenceImporter::ImportFasta(const std::string& path, TableConstructor& table, RecordBuilder& rbuild) {
+    reader_.block_size = block_size;
+    reader_.n_threads = n_threads;
+    if(reader_.Open(path) != 1) return(-1);
+
+    // Bases of the current contig that do not fill a block yet.
+    std::string pending;
+    int64_t n_blocks = 0;
+    while(true) {
+        const int64_t n_lines = reader_.Next(1);
+        if(n_lines == 0) break;
+        if(n_lines < 0) { reader_.Close(); return(-2); }
+
+        for(uint32_t i = 0; i < n_lines; ++i) {
+            const char* line = reader_.line(i);
+            const uint32_t l_line = reader_.line_length(i);
+            if(l_line == 0 || line[0] == ';') continue;
+
+            if(line[0] == '>') {
+                if(pending.size()) {
+                    PackedReference::PackBases(pending.data(), pending.size(), packed_.data(), n_runs_, mask_runs_);
+                    if(AppendBlock(pending.size(), table, rbuild) != 1) { reader_.Close(); return(-4); }
+                    ++n_blocks;
+                    pending.clear();
+                }
+
+                // The name ends at the first whitespace.
+                uint32_t l_name = 1;
+                while(l_name < l_line && line[l_name] != ' ' && line[l_name] != '\t') ++l_name;
+                if(l_name == 1 || reference->AddContig(std::string(line + 1, l_name - 1)) < 0) {
+                    std::cerr << "malformed or duplicated FASTA contig: " << std::string(line, std::min<uint32_t>(256, l_line)) << std::endl;
+                    reader_.Close();
+                    return(-3);
+                }
+                continue;
+            }
+            if(reference->contigs.size() == 0) { reader_.Close(); return(-3); }
+
+            // Full blocks are packed as soon as they are complete.
+            pending.append(line, l_line);
+            if(pending.size() >= block_bases) {
+                size_t offset = 0;
+                for(; offset + block_bases <= pending.size(); offset += block_bases) {
+                    PackedReference::PackBases(pending.data() + offset, block_bases, packed_.data(), n_runs_, mask_runs_);
+                    if(AppendBlock(block_bases, table, rbuild) != 1) { reader_.Close(); return(-4); }
+                    ++n_blocks;
+                }
+                pending.erase(0, offset);
+            }
+        }
+    }
+    reader_.Close();
+
+    if(pending.size()) {
+        PackedReference::PackBases(pending.data(), pending.size(), packed_.data(), n_runs_, mask_runs_);
+        if(AppendBlock(pending.size(), table, rbuild) != 1) return(-4);
+        ++n_blocks;
+    }
+    return(n_blocks);
+}
+
+int64_t ReferenceImporter::Import2bit(const std::string& path, TableConstructor& table, RecordBuilder& rbuild) {
+    std::ifstream f(path, std::ios::binary);
+    if(f.good() == false) return(-1);
+
+    uint32_t signature = 0;
+    f.read(reinterpret_cast<char*>(&signature), sizeof(uint32_t));
+    TwoBitStream stream(f, signature == PIL_2BIT_SIGNATURE_SWAPPED);
+    const uint32_t version = stream.ReadU32();
+    const uint32_t n_sequences = stream.ReadU32();
+    stream.ReadU32(); // reserved
+    if(f.good() == false || version > 1) return(-3);
+
+    // Version 1 files have 64-bit sequence offsets.
+    std::vector< std::pair<std::string, uint64_t> > index(n_sequences);
+    for(uint32_t i = 0; i < n_sequences; ++i) {
+        uint8_t l_name = 0;
+        f.read(reinterpret_cast<char*>(&l_name), sizeof(uint8_t));
+        index[i].first.resize(l_name);
+        f.read(&index[i].first[0], l_name);
+        index[i].second = version == 1 ? stream.ReadU64() : stream.ReadU32();
+        if(f.good() == false) return(-3);
+    }
+
+    // Bases are packed as T, C, A, G with the first base in the highest bits:
+    // translate every byte to the ACGT order with the first base in the
+    // lowest bits.
+    static const uint8_t codes[4] = {3, 1, 0, 2};
+    uint8_t translate[256];
+    for(uint32_t v = 0; v < 256; ++v) {
+        translate[v] = 0;
+        for(uint32_t k = 0; k < 4; ++k) translate[v] |= codes[(v >> (6 - 2*k)) & 3] << (2*k);
+    }
+
+    std::vector< std::pair<uint32_t, uint32_t> > n_blocks_2bit, mask_blocks_2bit;
+    std::vector<uint8_t> dna;
+    int64_t n_blocks = 0;
+    for(uint32_t i = 0; i < n_sequences; ++i) {
+        f.seekg(index[i].second);
+        const uint32_t n_bases = stream.ReadU32();
+        if(stream.ReadRuns(n_blocks_2bit) == false || stream.ReadRuns(mask_blocks_2bit) == false) return(-3);
+        stream.ReadU32(); // reserved
+        dna.resize((n_bases + 3) / 4);
+        f.read(reinterpret_cast<char*>(dna.data()), dna.size());
+        if(f.good() == false) return(-3);
+        if(reference->AddContig(index[i].first) < 0) return(-3);
+
+        // Blocks start at byte boundaries as block_bases is a multiple of 4.
+        size_t k_n = 0, k_mask = 0;
+        for(uint32_t from = 0; from < n_bases; from += block_bases) {
+            const uint32_t n = std::min(block_bases, n_bases - from);
+            const uint32_t n_bytes = (n + 3) / 4;
+            for(uint32_t b = 0; b < n_bytes; ++b) packed_[b] = translate[dna[from / 4 + b]];
+            // Padding bases of the last byte are cleared as in PackBases.
+            if(n & 3) packed_[n_bytes - 1] &= (1 << (2 * (n & 3))) - 1;
+
+            TwoBitClipRuns(n_blocks_2bit, k_n, from, n, n_runs_);
+            TwoBitClipRuns(mask_blocks_2bit, k_mask, from, n, mask_runs_);
+            if(AppendBlock(n, table, rbuild) != 1) return(-4);
+            ++n_blocks;
+        }
+    }
+    return(n_blocks);
+}
+
+int64_t ReferenceImporter::Import(const std::string& path, TableConstructor& table) {
+    if(block_bases == 0 || block_bases % 4) return(-1);
+    const PIL_REFERENCE_FORMAT fmt = format == PIL_REFERENCE_AUTO ? DetectFormat(path) : format;
+    if(fmt == PIL_REFERENCE_AUTO) return(-1);
+    if(set_fields && SetFields(table) < 0) return(-1);
+
+    reference = std::make_shared<PackedReference>(block_bases);
+    packed_.resize(block_bases / 4);
+
+    RecordBuilder rbuild;
+    const int64_t n_blocks = fmt == PIL_REFERENCE_2BIT ? Import2bit(path, table, rbuild) : ImportFasta(path, table, rbuild);
+    if(n_blocks < 0) return(n_blocks);
+
+    std::string contigs;
+    for(size_t i = 0; i < reference->contigs.size(); ++i) {
+        contigs += reference->contigs[i].name + '\t' + std::to_string(reference->contigs[i].length);
+        contigs += '\n';
+    }
+    table.meta_data.SetKeyValue(PIL_REFERENCE_CONTIGS_KEY, contigs);
+    table.meta_data.SetKeyValue(PIL_REFERENCE_BLOCK_BASES_KEY, std::to_string(block_bases));
+    table.meta_data.SetIntervalKey("RNAME", "START", "END");
+
+    return(n_blocks);
+}
+
+}
@@ -0,0 +1,94 @@
+#ifndef IMPORTERS_REFERENCE_IMPORTER_H_
+#define IMPORTERS_REFERENCE_IMPORTER_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "../table.h"
+#include "../transform/reference_sequence.h"
+#include "text_reader.h"
+
+namespace pil {
+
+// Keys of the contig names and lengths (one "name\tlength" line per contig in
+// identifier order) and of the number of bases per block in FileMetaData.
+#define PIL_REFERENCE_CONTIGS_KEY     "REFERENCE_CONTIGS"
+#define PIL_REFERENCE_BLOCK_BASES_KEY "REFERENCE_BLOCK_BASES"
+
+typedef enum {
+    PIL_REFERENCE_AUTO, // Detected from the leading bytes of the file.
+    PIL_REFERENCE_FASTA,
+    PIL_REFERENCE_2BIT
+} PIL_REFERENCE_FORMAT;
+
+// Import FASTA or UCSC 2bit reference sequences into a TableConstructor. The
+// bases of every contig are split into blocks of `block_bases` bases and
+// every block is stored as one record: RNAME (uint32 contig identifier),
+// START and END (0-based, half-open int64 coordinates of the block), BASES
+// (tensor of bases packed with 2 bits per base, see PackedReference) and the
+// sparse N_RUNS and MASK_RUNS uint32 tensors of (start, length) exception
+// pairs relative to the block. (RNAME, START, END) is the interval key of the
+// file such that only the blocks overlapping a region have to be decoded.
+//
+// The same blocks are collected in `reference` for random access with
+// PackedReference::FetchRegion.
+class ReferenceImporter {
+public:
+    ReferenceImporter();
+
+    /**<
+     * Import every contig of the reference file into the provided Table. The
+     * contig names and lengths are stored in the Table meta data. The Table
+     * is not finalized.
+     * @param path  Path to the FASTA or 2bit file.
+     * @param table Destination TableConstructor with an open output stream.
+     * @return      Returns the number of blocks imported or a negative value if the file is malformed.
+     */
+    int64_t Import(const std::string& path, TableConstructor& table);
+
+    /**<
+     * Register the Fields with their default transformations: START and END
+     * are delta encoded and compressed with Zstd. Fields that already exist
+     * in the Table are left untouched.
+     * @param table Destination TableConstructor.
+     * @return      Returns 1 if successful or a negative value otherwise.
+     */
+    static int SetFields(TableConstructor& table);
+
+    /**<
+     * Detect the format of a file from its leading bytes: 2bit files start
+     * with their signature and every other file is FASTA.
+     * @param path Path to the reference file.
+     * @return     Returns the format or PIL_REFERENCE_AUTO if the file cannot be read.
+     */
+    static PIL_REFERENCE_FORMAT DetectFormat(const std::string& path);
+
+private:
+    int64_t ImportFasta(const std::string& path, TableConstructor& table, RecordBuilder& rbuild);
+    int64_t Import2bit(const std::string& path, TableConstructor& table, RecordBuilder& rbuild);
+
+    /**<
+     * Append the packed block in `packed_` with the exceptions in `n_runs_`
+     * and `mask_runs_` to the last contig and to the Table.
+     * @return Returns 1 if successful or -1 otherwise.
+     */
+    int AppendBlock(const uint32_t n_bases, TableConstructor& table, RecordBuilder& rbuild);
+
+public:
+    PIL_REFERENCE_FORMAT format; // Input format or PIL_REFERENCE_AUTO.
+    uint32_t n_threads; // Threads used to index FASTA blocks.
+    size_t block_size; // Bytes read per FASTA block.
+    uint32_t block_bases; // Bases per stored block: a multiple of 4.
+    bool set_fields; // Call SetFields before importing.
+    std::shared_ptr<PackedReference> reference;
+
+private:
+    TextReader reader_;
+    std::vector<uint8_t> packed_;
+    std::vector<uint32_t> n_runs_, mask_runs_;
+};
+
+}
+
+#endif /* IMPORTERS_REFERENCE_IMPORTER_H_ */
@@ -0,0 +1,162 @@
+#ifndef IMPORTERS_REFERENCE_IMPORTER_TEST_H_
+#define IMPORTERS_REFERENCE_IMPORTER_TEST_H_
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include "reference_importer.h"
+
+namespace pil {
+
+// Write a version 0 2bit file in native byte order.
+static void ReferenceTestWrite2bit(const std::string& path, const std::vector<std::string>& names, const std::vector<std::string>& seqs) {
+    std::ofstream f(path, std::ios::binary);
+    auto put = [&f](const uint32_t v) { f.write(reinterpret_cast<const char*>(&v), sizeof(uint32_t)); };
+    put(0x1A412743); put(0); put(names.size()); put(0);
+
+    uint32_t offset = 16;
+    for(size_t i = 0; i < names.size(); ++i) offset += 1 + names[i].size() + 4;
+    for(size_t i = 0; i < names.size(); ++i) {
+        f.put(names[i].size());
+        f.write(names[i].data(), names[i].size());
+        put(offset);
+        // Header, N and mask blocks, reserved and packed bases.
+        uint32_t n_n = 0, n_mask = 0;
+        for(size_t j = 0; j < seqs[i].size(); ++j) {
+            n_n += (toupper(seqs[i][j]) == 'N') && (j == 0 || toupper(seqs[i][j - 1]) != 'N');
+            n_mask += islower(seqs[i][j]) && (j == 0 || !islower(seqs[i][j - 1]));
+        }
+        offset += 4 + 4 + 8*n_n + 4 + 8*n_mask + 4 + (seqs[i].size() + 3) / 4;
+    }
+
+    for(size_t i = 0; i < seqs.size(); ++i) {
+        const std::string& s = seqs[i];
+        std::vector<uint32_t> n_starts, n_sizes, mask_starts, mask_sizes;
+        for(size_t j = 0; j < s.size(); ++j) {
+            if(toupper(s[j]) == 'N') {
+                if(j == 0 || toupper(s[j - 1]) != 'N') { n_starts.push_back(j); n_sizes.push_back(0); }
+                ++n_sizes.back();
+            }
+            if(islower(s[j])) {
+                if(j == 0 || !islower(s[j - 1])) { mask_starts.push_back(j); mask_sizes.push_back(0); }
+                ++mask_sizes.back();
+            }
+        }
+        put(s.size());
+        put(n_starts.size());
+        for(uint32_t v : n_starts) put(v);
+        for(uint32_t v : n_sizes) put(v);
+        put(mask_starts.size());
+        for(uint32_t v : mask_starts) put(v);
+        for(uint32_t v : mask_sizes) put(v);
+        put(0);
+        std::vector<uint8_t> packed((s.size() + 3) / 4, 0);
+        for(size_t j = 0; j < s.size(); ++j) {
+            const char c = toupper(s[j]);
+            const uint8_t code = c == 'C' ? 1 : c == 'A' ? 2 : c == 'G' ? 3 : 0;
+            packed[j / 4] |= code << (6 - 2 * (j % 4));
+        }
+        f.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+    }
+}
+
+TEST(ImporterTests, ReferenceImport) {
+    const std::string fasta_path = "pil_reference_import_test.fa";
+    const std::string twobit_path = "pil_reference_import_test.2bit";
+    const std::string path = "pil_reference_import_test.pil";
+    std::mt19937 rng(17);
+
+    // Contigs with runs of N, soft-masked runs and IUPAC codes (stored as N).
+    const std::vector<std::string> names = {"chr1", "chr2", "chrM", "empty"};
+    const std::vector<uint32_t> lengths = {5003, 1024, 77, 0};
+    std::vector<std::string> seqs, truth;
+    for(size_t i = 0; i < names.size(); ++i) {
+        std::string s, t;
+        bool lower = false;
+        for(uint32_t j = 0; j < lengths[i]; ++j) {
+            if(rng() % 200 == 0) lower = !lower;
+            char c = "ACGT"[rng() & 3];
+            if(j >= 1000 && j < 1300) c = 'N';
+            if(rng() % 500 == 0) c = 'R';
+            if(lower) c = tolower(c);
+            s += c;
+            t += toupper(c) == 'R' ? (lower ? 'n' : 'N') : c;
+        }
+        seqs.push_back(s);
+        truth.push_back(t);
+    }
+    {
+        std::ofstream f(fasta_path, std::ios::binary);
+        for(size_t i = 0; i < names.size(); ++i) {
+            f << ">" << names[i] << " description\n";
+            for(size_t j = 0; j < seqs[i].size(); j += 60) f << seqs[i].substr(j, 60) << "\n";
+        }
+    }
+    ReferenceTestWrite2bit(twobit_path, names, truth);
+
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+
+    ReferenceImporter importer;
+    importer.block_bases = 256;
+    ASSERT_EQ(PIL_REFERENCE_FASTA, ReferenceImporter::DetectFormat(fasta_path));
+    ASSERT_EQ(20 + 4 + 1, importer.Import(fasta_path, table));
+    ASSERT_EQ(25, table.meta_data.batches.back()->n_rec);
+    ASSERT_EQ("chr1\t5003\nchr2\t1024\nchrM\t77\nempty\t0\n", *table.meta_data.GetKeyValue(PIL_REFERENCE_CONTIGS_KEY));
+    std::string contig, start, end;
+    ASSERT_TRUE(table.meta_data.GetIntervalKey(contig, start, end));
+    ASSERT_EQ("START", start);
+
+    std::shared_ptr<PackedReference> fasta_ref = importer.reference;
+    ASSERT_EQ(-1, importer.reference->FetchRegion("chrX", 0, 1, start));
+    ASSERT_EQ(-2, importer.reference->FetchRegion("chr2", 0, 1025, start));
+
+    ASSERT_EQ(PIL_REFERENCE_2BIT, ReferenceImporter::DetectFormat(twobit_path));
+    TableConstructor table2;
+    ASSERT_EQ(25, importer.Import(twobit_path, table2));
+    std::shared_ptr<PackedReference> twobit_ref = importer.reference;
+
+    std::stringstream ss;
+    ASSERT_EQ(1, fasta_ref->Serialize(ss));
+    PackedReference copy;
+    ASSERT_EQ(1, copy.Deserialize(ss));
+
+    // Contig lengths must match the bases in their blocks.
+    for(const int64_t delta : {-1, 1}) {
+        PackedReference corrupt = copy;
+        corrupt.contigs[0].length += delta;
+        std::stringstream cs;
+        ASSERT_EQ(1, corrupt.Serialize(cs));
+        PackedReference refused;
+        ASSERT_EQ(-2, refused.Deserialize(cs));
+    }
+
+    for(const PackedReference* ref : {fasta_ref.get(), twobit_ref.get(), &copy}) {
+        std::string out;
+        for(size_t i = 0; i < names.size(); ++i) {
+            ASSERT_EQ(lengths[i], ref->FetchRegion(names[i], 0, lengths[i], out));
+            ASSERT_EQ(truth[i], out);
+        }
+        // Random regions within and across blocks.
+        for(uint32_t k = 0; k < 500; ++k) {
+            const uint32_t a = rng() % (lengths[0] + 1), b = rng() % (lengths[0] + 1);
+            ASSERT_EQ(std::max(a, b) - std::min(a, b), ref->FetchRegion("chr1", std::min(a, b), std::max(a, b), out));
+            ASSERT_EQ(truth[0].substr(std::min(a, b), std::max(a, b) - std::min(a, b)), out);
+        }
+    }
+
+    ASSERT_EQ(1, table.FinalizeBatch(0));
+    table.out_stream.close();
+
+    std::remove(fasta_path.c_str());
+    std::remove(twobit_path.c_str());
+    std::remove(path.c_str());
+}
+
+}
+
+#endif /* IMPORTERS_REFERENCE_IMPORTER_TEST_H_ */
@@ -0,0 +1,402 @@
+#include <thread>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "sam_importer.h"
+
+// Blocks with fewer lines are tokenized by a single thread.
+#define PIL_SAM_MIN_PARALLEL 4096
+
+namespace pil {
+
+PIL_PRIMITIVE_TYPE SamTypeToPrimitive(const char type) {
+    switch(type) {
+    case('A'): return(PIL_TYPE_UINT8);
+    case('c'): return(PIL_TYPE_INT8);
+    case('C'): return(PIL_TYPE_UINT8);
+    case('s'): return(PIL_TYPE_INT16);
+    case('S'): return(PIL_TYPE_UINT16);
+    case('i'): return(PIL_TYPE_INT32);
+    case('I'): return(PIL_TYPE_UINT32);
+    case('f'): return(PIL_TYPE_FLOAT);
+    case('Z'): return(PIL_TYPE_UINT8);
+    case('H'): return(PIL_TYPE_UINT8);
+    default:   return(PIL_TYPE_UNKNOWN);
+    }
+}
+
+// Append a value to the data buffer of a Chunk.
+template <class T>
+static inline void SamPushValue(PoolBytes& data, const T value) {
+    const size_t offset = data.size();
+    data.resize(offset + sizeof(T));
+    memcpy(&data[offset], &value, sizeof(T));
+}
+
+// Parse an integer of a SAM integer type and append it to the data buffer.
+static bool SamPushInteger(const char* begin, const char* end, const char type, PoolBytes& data) {
+    int64_t value = 0;
+    if(ParseInteger(begin, end, value) == false) return(false);
+
+    switch(type) {
+    case('c'): if(value < INT8_MIN  || value > INT8_MAX)   return(false); SamPushValue<int8_t>(data, value);   break;
+    case('C'): if(value < 0         || value > UINT8_MAX)  return(false); SamPushValue<uint8_t>(data, value);  break;
+    case('s'): if(value < INT16_MIN || value > INT16_MAX)  return(false); SamPushValue<int16_t>(data, value);  break;
+    case('S'): if(value < 0         || value > UINT16_MAX) return(false); SamPushValue<uint16_t>(data, value); break;
+    case('i'): if(value < INT32_MIN || value > INT32_MAX)  return(false); SamPushValue<int32_t>(data, value);  break;
+    case('I'): if(value < 0         || value > UINT32_MAX) return(false); SamPushValue<uint32_t>(data, value); break;
+    default: return(false);
+    }
+    return(true);
+}
+
+static bool SamPushFloat(const char* begin, const char* end, PoolBytes& data) {
+    if(begin == end) return(false);
+    // Fields are followed by a tab or newline that terminates strtof.
+    char* parsed = nullptr;
+    const float value = strtof(begin, &parsed);
+    if(parsed != end) return(false);
+    SamPushValue<float>(data, value);
+    return(true);
+}
+
+template <class T>
+static int SamAppendAuxValues(TableConstructor& table, RecordBuilder& rbuild, const std::string& field_name,
+                              const PIL_PRIMITIVE_TYPE ptype, const bool is_array, const uint32_t n_values,
+                              const uint8_t* data)
+{
+    if(is_array == false) {
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return(rbuild.Add<T>(field_name, ptype, value));
+    }
+
+    T* dst = table.ReserveArray<T>(rbuild, field_name, ptype, n_values);
+    if(dst == nullptr) return(n_values ? -1 : 1);
+    memcpy(dst, data, n_values * sizeof(T));
+    return(1);
+}
+
+int AppendSamAux(TableConstructor& table, RecordBuilder& rbuild, const std::string& field_name,
+                 const char type, const bool is_array, const uint32_t n_values, const uint8_t* data)
+{
+    const PIL_PRIMITIVE_TYPE ptype = SamTypeToPrimitive(type);
+    switch(ptype) {
+    case(PIL_TYPE_INT8):   return(SamAppendAuxValues<int8_t>(table, rbuild, field_name, ptype, is_array, n_values, data));
+    case(PIL_TYPE_UINT8):  return(SamAppendAuxValues<uint8_t>(table, rbuild, field_name, ptype, is_array, n_values, data));
+    case(PIL_TYPE_INT16):  return(SamAppendAuxValues<int16_t>(table, rbuild, field_name, ptype, is_array, n_values, data));
+    case(PIL_TYPE_UINT16): return(SamAppendAuxValues<uint16_t>(table, rbuild, field_name, ptype, is_array, n_values, data));
+    case(PIL_TYPE_INT32):  return(SamAppendAuxValues<int32_t>(table, rbuild, field_name, ptype, is_array, n_values, data));
+    case(PIL_TYPE_UINT32): return(SamAppendAuxValues<uint32_t>(table, rbuild, field_name, ptype, is_array, n_values, data));
+    case(PIL_TYPE_FLOAT):  return(SamAppendAuxValues<float>(table, rbuild, field_name, ptype, is_array, n_values, data));
+    default: return(-1);
+    }
+}
+
+const std::string& SamAuxFields::FieldName(const char* tag, const char type, const bool is_array) {
+    const bool b_array = is_array && type != 'Z' && type != 'H';
+    std::string key(tag, 2);
+    if(b_array) key += 'B';
+    key += type;
+
+    std::unordered_map<std::string, std::string>::const_iterator it = fields_.find(key);
+    if(it != fields_.end()) return(it->second);
+
+    const std::string tag_name(tag, 2);
+    std::string field_name = tag_name;
+    if(types_.find(tag_name) == types_.end()) types_[tag_name] = key;
+    else field_name = tag_name + ":" + (b_array ? "B:" : "") + type;
+
+    keys_.push_back(key);
+    return(fields_[key] = field_name);
+}
+
+std::string SamAuxFields::Serialize() const {
+    std::string ret;
+    for(size_t i = 0; i < keys_.size(); ++i) {
+        ret += fields_.find(keys_[i])->second;
+        ret += '\t';
+        ret.append(keys_[i], 2, std::string::npos);
+        ret += '\n';
+    }
+    return(ret);
+}
+
+// Write a text field directly into its ColumnSet.
+static int SamAppendText(TableConstructor& table, RecordBuilder& rbuild, const char* field_name,
+                         const char* text, const uint32_t l_text)
+{
+    uint8_t* dst = table.ReserveArray<uint8_t>(rbuild, field_name, PIL_TYPE_UINT8, l_text);
+    if(dst == nullptr) return(l_text ? -1 : 1);
+    memcpy(dst, text, l_text);
+    return(1);
+}
+
+SamImporter::SamImporter() :
+    n_threads(1), block_size(16 << 20), set_fields(true)
+{
+}
+
+int SamImporter::SetFields(TableConstructor& table) {
+    std::vector<PIL_COMPRESSION_TYPE> ctypes;
+    ctypes.push_back(PIL_COMPRESS_RC_QUAL);
+    if(table.SetField("QUAL", PIL_TYPE_BYTE_ARRAY, PIL_TYPE_UINT8, ctypes) < 0) return(-1);
+
+    ctypes.clear();
+    ctypes.push_back(PIL_COMPRESS_ZSTD);
+    if(table.SetField("BASES", PIL_TYPE_BYTE_ARRAY, PIL_TYPE_UINT8, ctypes) < 0) return(-1);
+
+    ctypes.clear();
+    ctypes.push_back(PIL_COMPRESS_RC_ILLUMINA_NAME);
+    if(table.SetField("NAME", PIL_TYPE_BYTE_ARRAY, PIL_TYPE_UINT8, ctypes) < 0) return(-1);
+
+    return(1);
+}
+
+uint32_t SamImporter::InternName(const char* name, const uint32_t l_name) {
+    const std::string s(name, l_name);
+    std::unordered_map<std::string, uint32_t>::const_iterator it = rname_map_.find(s);
+    if(it != rname_map_.end()) return(it->second);
+
+    const uint32_t id = rname_dict.size();
+    rname_map_[s] = id;
+    rname_dict.push_back(s);
+    return(id);
+}
+
+void SamImporter::ParseHeaderLine(const char* line, const uint32_t l_line) {
+    if(l_line < 3 || line[1] != 'S' || line[2] != 'Q') return;
+
+    const char* end = line + l_line;
+    const char* token = line;
+    while(token < end) {
+        const char* token_end = std::find(token, end, '\t');
+        if(token_end - token > 3 && token[0] == 'S' && token[1] == 'N' && token[2] == ':') {
+            InternName(token + 3, token_end - token - 3);
+            return;
+        }
+        token = token_end + 1;
+    }
+}
+
+bool SamImporter::ParseAux(const char* begin, const char* end, Chunk& chunk) const {
+    if(end - begin < 5 || begin[2] != ':' || begin[4] != ':') return(false);
+
+    AuxValue aux;
+    aux.tag[0] = begin[0];
+    aux.tag[1] = begin[1];
+    aux.type = begin[3];
+    aux.is_array = false;
+    aux.n_values = 1;
+    // Values are 8-byte aligned in the data buffer.
+    chunk.data.resize((chunk.data.size() + 7) & ~7);
+    aux.offset = chunk.data.size();
+
+    const char* value = begin + 5;
+    switch(aux.type) {
+    case('A'):
+        if(end - value != 1) return(false);
+        SamPushValue<uint8_t>(chunk.data, *value);
+        break;
+    case('i'): {
+        // Text SAM stores all integers as `i`: values in [2^31, 2^32) are
+        // stored as `I`.
+        int64_t v = 0;
+        if(ParseInteger(value, end, v) == false) return(false);
+        if(v > INT32_MAX) aux.type = 'I';
+        if(SamPushInteger(value, end, aux.type, chunk.data) == false) return(false);
+        break;
+    }
+    case('c'): case('C'): case('s'): case('S'): case('I'):
+        if(SamPushInteger(value, end, aux.type, chunk.data) == false) return(false);
+        break;
+    case('f'):
+        if(SamPushFloat(value, end, chunk.data) == false) return(false);
+        break;
+    case('Z'): case('H'):
+        aux.is_array = true;
+        aux.n_values = end - value;
+        chunk.data.insert(chunk.data.end(), value, end);
+        break;
+    case('B'): {
+        // B:t,v1,v2,...
+        if(value == end) return(false);
+        aux.type = *value++;
+        aux.is_array = true;
+        aux.n_values = 0;
+        if(SamTypeToPrimitive(aux.type) == PIL_TYPE_UNKNOWN || aux.type == 'A' || aux.type == 'Z' || aux.type == 'H') return(false);
+        while(value != end) {
+            if(*value++ != ',') return(false);
+            const char* value_end = std::find(value, end, ',');
+            const bool ok = aux.type == 'f' ? SamPushFloat(value, value_end, chunk.data) : SamPushInteger(value, value_end, aux.type, chunk.data);
+            if(ok == false) return(false);
+            ++aux.n_values;
+            value = value_end;
+        }
+        break;
+    }
+    default: return(false);
+    }
+
+    chunk.aux.push_back(aux);
+    return(true);
+}
+
+uint32_t SamImporter::ParseLines(const uint32_t from, const uint32_t to, Chunk& chunk) const {
+    for(uint32_t i = from; i < to; ++i) {
+        const char* line = reader_.line(i);
+        const uint32_t l_line = reader_.line_length(i);
+        if(l_line == 0) continue;
+
+        chunk.tabs.clear();
+        FindCharacter(line, l_line, '\t', 0, chunk.tabs);
+        if(chunk.tabs.size() < 10) return(i);
+
+        Record rec;
+        rec.line = i;
+        for(uint32_t k = 0; k < 10; ++k) rec.tabs[k] = chunk.tabs[k];
+        rec.tabs[10] = chunk.tabs.size() > 10 ? chunk.tabs[10] : l_line;
+
+        // Field k spans [tabs[k-1] + 1, tabs[k]).
+        int64_t v = 0;
+        if(ParseInteger(line + rec.tabs[0] + 1, line + rec.tabs[1], v) == false || v < 0 || v > UINT16_MAX) return(i);
+        rec.flag = v;
+        if(ParseInteger(line + rec.tabs[2] + 1, line + rec.tabs[3], v) == false || v < 0 || v > INT32_MAX) return(i);
+        rec.pos = v;
+        if(ParseInteger(line + rec.tabs[3] + 1, line + rec.tabs[4], v) == false || v < 0 || v > UINT8_MAX) return(i);
+        rec.mapq = v;
+        if(ParseInteger(line + rec.tabs[6] + 1, line + rec.tabs[7], v) == false || v < 0 || v > INT32_MAX) return(i);
+        rec.pnext = v;
+        if(ParseInteger(line + rec.tabs[7] + 1, line + rec.tabs[8], v) == false || v < INT32_MIN || v > INT32_MAX) return(i);
+        rec.tlen = v;
+
+        // The dictionary is read-only while threads are parsing: names that
+        // are not in it are interned when appending.
+        std::unordered_map<std::string, uint32_t>::const_iterator it = rname_map_.find(std::string(line + rec.tabs[1] + 1, rec.tabs[2] - rec.tabs[1] - 1));
+        rec.rname = it == rname_map_.end() ? -1 : it->second;
+        it = rname_map_.find(std::string(line + rec.tabs[5] + 1, rec.tabs[6] - rec.tabs[5] - 1));
+        rec.rnext = it == rname_map_.end() ? -1 : it->second;
+
+        rec.aux_offset = chunk.aux.size();
+        for(uint32_t k = 10; k < chunk.tabs.size(); ++k) {
+            const uint32_t end = k + 1 < chunk.tabs.size() ? chunk.tabs[k + 1] : l_line;
+            if(ParseAux(line + chunk.tabs[k] + 1, line + end, chunk) == false) return(i);
+        }
+        rec.n_aux = chunk.aux.size() - rec.aux_offset;
+        chunk.records.push_back(rec);
+    }
+    return(to);
+}
+
+int SamImporter::AppendChunk(const Chunk& chunk, TableConstructor& table, RecordBuilder& rbuild) {
+    for(size_t r = 0; r < chunk.records.size(); ++r) {
+        const Record& rec = chunk.records[r];
+        const char* line = reader_.line(rec.line);
+
+        const uint32_t rname = rec.rname >= 0 ? rec.rname : InternName(line + rec.tabs[1] + 1, rec.tabs[2] - rec.tabs[1] - 1);
+        const uint32_t rnext = rec.rnext >= 0 ? rec.rnext : InternName(line + rec.tabs[5] + 1, rec.tabs[6] - rec.tabs[5] - 1);
+
+        if(SamAppendText(table, rbuild, "NAME", line, rec.tabs[0]) != 1) return(-1);
+        rbuild.Add<uint16_t>("FLAG", PIL_TYPE_UINT16, rec.flag);
+        rbuild.Add<uint32_t>("RNAME", PIL_TYPE_UINT32, rname);
+        rbuild.Add<uint32_t>("POS", PIL_TYPE_UINT32, rec.pos);
+        rbuild.Add<uint8_t>("MAPQ", PIL_TYPE_UINT8, rec.mapq);
+        if(SamAppendText(table, rbuild, "CIGAR", line + rec.tabs[4] + 1, rec.tabs[5] - rec.tabs[4] - 1) != 1) return(-1);
+        rbuild.Add<uint32_t>("RNEXT", PIL_TYPE_UINT32, rnext);
+        rbuild.Add<int32_t>("PNEXT", PIL_TYPE_INT32, rec.pnext);
+        rbuild.Add<int32_t>("TLEN", PIL_TYPE_INT32, rec.tlen);
+        if(SamAppendText(table, rbuild, "BASES", line + rec.tabs[8] + 1, rec.tabs[9] - rec.tabs[8] - 1) != 1) return(-1);
+        if(SamAppendText(table, rbuild, "QUAL", line + rec.tabs[9] + 1, rec.tabs[10] - rec.tabs[9] - 1) != 1) return(-1);
+
+        for(uint32_t a = rec.aux_offset; a < rec.aux_offset + rec.n_aux; ++a) {
+            const AuxValue& aux = chunk.aux[a];
+            const std::string& field_name = aux_fields_.FieldName(aux.tag, aux.type, aux.is_array);
+            const int ret = AppendSamAux(table, rbuild, field_name, aux.type, aux.is_array, aux.n_values, &chunk.data[aux.offset]);
+            if(ret != 1) return(-1);
+        }
+
+        if(table.Append(rbuild) != 1) return(-1);
+    }
+    return(1);
+}
+
+int64_t SamImporter::Import(const std::string& path, TableConstructor& table) {
+    if(set_fields && SetFields(table) < 0) return(-1);
+
+    reader_.block_size = block_size;
+    reader_.n_threads = n_threads;
+    if(reader_.Open(path) != 1) return(-1);
+
+    header.clear();
+    rname_dict.clear();
+    rname_map_.clear();
+    aux_fields_.clear();
+
+    RecordBuilder rbuild;
+    int64_t n_records = 0;
+    bool in_header = true;
+    while(true) {
+        const int64_t n_lines = reader_.Next(1);
+        if(n_lines == 0) break;
+        if(n_lines < 0) { reader_.Close(); return(-2); }
+
+        // Header lines precede the alignments.
+        uint32_t first = 0;
+        while(in_header && first < n_lines) {
+            const uint32_t l_line = reader_.line_length(first);
+            if(l_line && reader_.line(first)[0] != '@') { in_header = false; break; }
+            if(l_line) {
+                header.append(reader_.line(first), l_line);
+                header += '\n';
+                ParseHeaderLine(reader_.line(first), l_line);
+            }
+            ++first;
+        }
+
+        // Tokenize ranges of lines in parallel.
+        const uint32_t n_body = n_lines - first;
+        const uint32_t n_parts = n_body < PIL_SAM_MIN_PARALLEL ? 1 : std::max(1u, n_threads);
+        if(chunks_.size() < n_parts) chunks_.resize(n_parts);
+        std::vector<uint32_t> results(n_parts);
+        std::vector<uint32_t> ends(n_parts);
+        const uint32_t part_size = n_body / n_parts;
+        std::vector<std::thread> threads;
+        for(uint32_t p = 0; p < n_parts; ++p) {
+            const uint32_t from = first + p * part_size;
+            ends[p] = p + 1 == n_parts ? n_lines : from + part_size;
+            chunks_[p].clear();
+            if(n_parts == 1) results[p] = ParseLines(from, ends[p], chunks_[p]);
+            else threads.push_back(std::thread([this, &results, &ends, p, from]() { results[p] = ParseLines(from, ends[p], chunks_[p]); }));
+        }
+        for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+        for(uint32_t p = 0; p < n_parts; ++p) {
+            if(results[p] != ends[p]) {
+                std::cerr << "malformed SAM line: " << std::string(reader_.line(results[p]), reader_.line_length(results[p])) << std::endl;
+                reader_.Close();
+                return(-3);
+            }
+        }
+
+        for(uint32_t p = 0; p < n_parts; ++p) {
+            if(AppendChunk(chunks_[p], table, rbuild) != 1) { reader_.Close(); return(-4); }
+            n_records += chunks_[p].records.size();
+        }
+    }
+    reader_.Close();
+
+    std::string names;
+    for(size_t i = 0; i < rname_dict.size(); ++i) {
+        names += rname_dict[i];
+        names += '\n';
+    }
+    table.meta_data.SetKeyValue(PIL_SAM_HEADER_KEY, header);
+    table.meta_data.SetKeyValue(PIL_SAM_RNAME_KEY, names);
+    table.meta_data.SetKeyValue(PIL_SAM_AUX_KEY, aux_fields_.Serialize());
+
+    return(n_records);
+}
+
+}
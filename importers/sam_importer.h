@@ -0,0 +1,185 @@
+#ifndef IMPORTERS_SAM_IMPORTER_H_
+#define IMPORTERS_SAM_IMPORTER_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../table.h"
+#include "text_reader.h"
+
+namespace pil {
+
+// Keys of the SAM header, the RNAME dictionary and the aux tag types (see
+// SamAuxFields::Serialize) in FileMetaData.
+#define PIL_SAM_HEADER_KEY "SAM_HEADER"
+#define PIL_SAM_RNAME_KEY  "SAM_RNAME"
+#define PIL_SAM_AUX_KEY    "SAM_AUX"
+
+/**<
+ * Map a SAM aux type character (A, c, C, s, S, i, I, f, Z, H, or the
+ * subtype of B) to its primitive type. Strings and characters map to
+ * PIL_TYPE_UINT8.
+ * @param type SAM type character.
+ * @return     Returns the primitive type or PIL_TYPE_UNKNOWN.
+ */
+PIL_PRIMITIVE_TYPE SamTypeToPrimitive(const char type);
+
+// Names of the Fields that hold SAM aux tags. The first type seen for a tag
+// is stored in a Field named by the tag and other types in Fields named
+// "TG:t" (or "TG:B:t" for B arrays) such that a Field never changes type.
+class SamAuxFields {
+public:
+    /**<
+     * Find or assign the Field name of an aux tag.
+     * @param tag      Two-character tag.
+     * @param type     SAM type with B arrays given by their subtype.
+     * @param is_array TRUE for Z, H, and B types.
+     * @return         Returns the Field name.
+     */
+    const std::string& FieldName(const char* tag, const char type, const bool is_array);
+
+    /**<
+     * List the SAM type of every Field in the order the Fields were named:
+     * one "name\ttype" line per Field where the type is the SAM type
+     * character, prefixed by 'B' for B arrays. The integer width and the A,
+     * Z and H types are not recoverable from the primitive types alone.
+     * @return Returns the list of Field types.
+     */
+    std::string Serialize() const;
+
+    void clear() { fields_.clear(); types_.clear(); keys_.clear(); }
+
+private:
+    std::unordered_map<std::string, std::string> fields_; // tag + type -> Field name
+    std::vector<std::string> keys_; // tag + type in the order the Fields were named
+    std::unordered_map<std::string, std::string> types_; // tag -> type of the Field named by the tag
+};
+
+/**<
+ * Add an aux value to a record: scalars through the RecordBuilder and
+ * arrays in place (see TableConstructor::ReserveArray).
+ * @param table      Destination TableConstructor.
+ * @param rbuild     RecordBuilder of the current record.
+ * @param field_name Field name given by SamAuxFields.
+ * @param type       SAM type with B arrays given by their subtype.
+ * @param is_array   TRUE for Z, H, and B types.
+ * @param n_values   Number of values.
+ * @param data       Values in the primitive type of `type`.
+ * @return           Returns 1 if successful or -1 otherwise.
+ */
+int AppendSamAux(TableConstructor& table, RecordBuilder& rbuild, const std::string& field_name,
+                 const char type, const bool is_array, const uint32_t n_values, const uint8_t* data);
+
+// Import SAM files into a TableConstructor. Blocks of lines are split into
+// ranges that are tokenized by several threads: tabs are located with SIMD
+// comparisons, integers are parsed without locale lookups, and aux tags are
+// converted to values of their SAM type. The parsed records are then
+// appended in order.
+//
+// The mandatory fields are stored as NAME, FLAG, RNAME, POS, MAPQ, CIGAR,
+// RNEXT, PNEXT, TLEN, BASES and QUAL. RNAME and RNEXT are interned into
+// uint32 identifiers in the order of the @SQ header lines such that they
+// can be used with a matching reference (see TableConstructor::SetReference).
+// Aux tags are stored in the Fields given by SamAuxFields: scalar types as
+// columns and Z, H, and B types as tensors.
+class SamImporter {
+public:
+    // Aux value parsed by a worker thread. Values are stored in the thread's
+    // data buffer at an 8-byte aligned offset.
+    struct AuxValue {
+        char tag[2];
+        char type; // SAM type with B arrays given by their subtype.
+        bool is_array;
+        uint32_t n_values;
+        uint64_t offset;
+    };
+
+    // Mandatory fields parsed by a worker thread. Fields that are kept as
+    // text are located through the tab offsets of the line.
+    struct Record {
+        uint32_t line;
+        uint32_t tabs[11]; // Offset of the tab (or line end) after each mandatory field.
+        int32_t rname, rnext; // Identifiers or -1 if not in the dictionary.
+        uint16_t flag;
+        uint8_t mapq;
+        uint32_t pos;
+        int32_t pnext, tlen;
+        uint32_t aux_offset, n_aux;
+    };
+
+    // Output of a worker thread.
+    struct Chunk {
+        void clear() { records.clear(); aux.clear(); data.clear(); tabs.clear(); }
+
+        std::vector<Record> records;
+        std::vector<AuxValue> aux;
+        PoolBytes data; // Drawn from the MemoryPool of the parsing thread.
+        std::vector<uint32_t> tabs; // Scratch space.
+    };
+
+public:
+    SamImporter();
+
+    /**<
+     * Import every record of the SAM file into the provided Table. The
+     * header and RNAME dictionary are stored in the Table meta data under
+     * PIL_SAM_HEADER_KEY and PIL_SAM_RNAME_KEY. The Table is not finalized.
+     * @param path  Path to the SAM file.
+     * @param table Destination TableConstructor with an open output stream.
+     * @return      Returns the number of records imported or a negative value if the file is malformed.
+     */
+    int64_t Import(const std::string& path, TableConstructor& table);
+
+    /**<
+     * Register the Fields with their default transformations: the CRAM-style
+     * range coders for the qualities and read names and ZSTD for the bases,
+     * as SEQ may hold `*`, `=` and IUPAC codes. Fields that already exist in
+     * the Table are left untouched.
+     * @param table Destination TableConstructor.
+     * @return      Returns 1 if successful or a negative value otherwise.
+     */
+    static int SetFields(TableConstructor& table);
+
+    /**<
+     * Find or add a reference name in the RNAME dictionary.
+     * @param name   Reference name.
+     * @param l_name Length of the name.
+     * @return       Returns the identifier of the name.
+     */
+    uint32_t InternName(const char* name, const uint32_t l_name);
+
+private:
+    /**<
+     * Tokenize the lines [from, to) of the current block into a Chunk.
+     * @return Returns the first malformed line or `to` otherwise.
+     */
+    uint32_t ParseLines(const uint32_t from, const uint32_t to, Chunk& chunk) const;
+    bool ParseAux(const char* begin, const char* end, Chunk& chunk) const;
+
+    // Parse the @SQ line and add its name to the dictionary.
+    void ParseHeaderLine(const char* line, const uint32_t l_line);
+
+    /**<
+     * Append the records of a parsed Chunk to the Table.
+     * @return Returns 1 if successful or -1 otherwise.
+     */
+    int AppendChunk(const Chunk& chunk, TableConstructor& table, RecordBuilder& rbuild);
+
+public:
+    uint32_t n_threads; // Threads used to index and tokenize blocks.
+    size_t block_size; // Bytes read per block.
+    bool set_fields; // Call SetFields before importing.
+    std::string header; // Header lines including newlines.
+    std::vector<std::string> rname_dict; // Reference names in identifier order.
+
+private:
+    TextReader reader_;
+    std::unordered_map<std::string, uint32_t> rname_map_;
+    SamAuxFields aux_fields_;
+    std::vector<Chunk> chunks_;
+};
+
+}
+
+#endif /* IMPORTERS_SAM_IMPORTER_H_ */
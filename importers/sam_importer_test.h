@@ -0,0 +1,130 @@
+#ifndef IMPORTERS_SAM_IMPORTER_TEST_H_
+#define IMPORTERS_SAM_IMPORTER_TEST_H_
+
+#include <cstdio>
+#include <fstream>
+
+#include <gtest/gtest.h>
+#include "sam_importer.h"
+
+namespace pil {
+
+// Transform the BASES of the current RecordBatch as FinalizeBatch does and
+// assert that decompressing them restores every record.
+static void SamTestBasesRoundTrip(TableConstructor& table, const std::vector<std::string>& expected) {
+    std::shared_ptr<ColumnSet> bases = table.GetBatchColumnSet("BASES");
+    ASSERT_TRUE(bases.get() != nullptr);
+    const DictionaryFieldType& field = table.field_dict.dict[table.field_dict.Find("BASES")];
+    ASSERT_EQ(expected.size() + 1, bases->columns[0]->n_records);
+
+    ASSERT_GT(table.transformer.Transform(bases, field), 0);
+    ASSERT_GT(static_cast<SequenceCompressor*>(&table.transformer)->Decompress(bases, field), 0);
+    ASSERT_GT(static_cast<ZstdCompressor*>(&table.transformer)->DecompressNullity(bases->columns[0]), 0);
+
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(bases->columns[0]->mutable_data());
+    const char* data = reinterpret_cast<const char*>(bases->columns[1]->mutable_data());
+    for(size_t i = 0; i < expected.size(); ++i)
+        ASSERT_EQ(expected[i], std::string(data + offsets[i], offsets[i + 1] - offsets[i]));
+}
+
+TEST(ImporterTests, SamImport) {
+    const std::string sam_path = "pil_sam_import_test.sam";
+    const std::string path = "pil_sam_import_test.pil";
+    const uint32_t n_reads = 10000;
+    {
+        std::ofstream f(sam_path, std::ios::binary);
+        f << "@HD\tVN:1.6\tSO:coordinate\n@SQ\tSN:chr2\tLN:1000000\n@SQ\tSN:chr1\tLN:1000000\n";
+        for(uint32_t i = 0; i < n_reads; ++i) {
+            const char* rname = (i % 3 == 0) ? "chr1" : (i % 3 == 1) ? "chr2" : "chrUn";
+            f << "read" << i << "\t" << (i % 4) * 16 << "\t" << rname << "\t" << i + 1 << "\t60\t8M\t=\t" << i + 100 << "\t" << -(int)i << "\tACGTACGT\tFFFFFFFF";
+            f << "\tNM:i:" << i % 5 << "\tXA:Z:alt" << i << "\tBC:B:s,-1," << i % 100 << ",3\tXF:f:1.5\tXC:A:x";
+            if(i == 7) f << "\tNM:Z:text";
+            f << "\n";
+        }
+    }
+
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+    table.batch_size = 1000000;
+
+    SamImporter importer;
+    importer.n_threads = 4;
+    ASSERT_EQ(n_reads, importer.Import(sam_path, table));
+    ASSERT_EQ(n_reads, table.meta_data.batches.back()->n_rec);
+
+    // Reference names are numbered in header order followed by new names.
+    ASSERT_EQ(4, importer.rname_dict.size());
+    ASSERT_EQ("chr2", importer.rname_dict[0]);
+    ASSERT_EQ("chr1", importer.rname_dict[1]);
+    ASSERT_EQ("chr2\nchr1\n=\nchrUn\n", *table.meta_data.GetKeyValue(PIL_SAM_RNAME_KEY));
+    ASSERT_EQ(0, table.meta_data.GetKeyValue(PIL_SAM_HEADER_KEY)->find("@HD\tVN:1.6"));
+
+    const uint32_t* rname = reinterpret_cast<const uint32_t*>(table.GetBatchColumnSet("RNAME")->columns[0]->mutable_data());
+    ASSERT_EQ(1, rname[0]);
+    ASSERT_EQ(0, rname[1]);
+    ASSERT_EQ("chrUn", importer.rname_dict[rname[2]]);
+    const int32_t* tlen = reinterpret_cast<const int32_t*>(table.GetBatchColumnSet("TLEN")->columns[0]->mutable_data());
+    ASSERT_EQ(-9999, tlen[9999]);
+
+    // Aux tags map to their SAM types.
+    ASSERT_EQ(PIL_TYPE_INT32, table.field_dict.dict[table.field_dict.Find("NM")].ptype);
+    ASSERT_EQ(PIL_CSTORE_COLUMN, table.field_dict.dict[table.field_dict.Find("NM")].cstore);
+    ASSERT_EQ(PIL_CSTORE_TENSOR, table.field_dict.dict[table.field_dict.Find("NM:Z")].cstore);
+    ASSERT_EQ(PIL_TYPE_UINT8, table.field_dict.dict[table.field_dict.Find("XA")].ptype);
+    ASSERT_EQ(PIL_CSTORE_TENSOR, table.field_dict.dict[table.field_dict.Find("XA")].cstore);
+    ASSERT_EQ(PIL_TYPE_INT16, table.field_dict.dict[table.field_dict.Find("BC")].ptype);
+    ASSERT_EQ(PIL_CSTORE_TENSOR, table.field_dict.dict[table.field_dict.Find("BC")].cstore);
+    ASSERT_EQ(PIL_TYPE_FLOAT, table.field_dict.dict[table.field_dict.Find("XF")].ptype);
+    ASSERT_EQ(PIL_TYPE_UINT8, table.field_dict.dict[table.field_dict.Find("XC")].ptype);
+
+    std::shared_ptr<ColumnSet> bc = table.GetBatchColumnSet("BC");
+    const int16_t* bc_values = reinterpret_cast<const int16_t*>(bc->columns[1]->mutable_data());
+    ASSERT_EQ(3 * n_reads, bc->columns[1]->n_elements);
+    ASSERT_EQ(-1, bc_values[3 * 1234]);
+    ASSERT_EQ(34, bc_values[3 * 1234 + 1]);
+    const float* xf = reinterpret_cast<const float*>(table.GetBatchColumnSet("XF")->columns[0]->mutable_data());
+    ASSERT_EQ(1.5f, xf[n_reads - 1]);
+    table.out_stream.close();
+
+    // Malformed integers are rejected.
+    {
+        std::ofstream f(sam_path, std::ios::binary);
+        f << "r1\t0\tchr1\t1x\t60\t4M\t*\t0\t0\tACGT\tFFFF\n";
+    }
+    TableConstructor table2;
+    ASSERT_EQ(-3, importer.Import(sam_path, table2));
+
+    std::remove(sam_path.c_str());
+    std::remove(path.c_str());
+}
+
+TEST(ImporterTests, SamImportNonAcgtBases) {
+    const std::string sam_path = "pil_sam_import_bases_test.sam";
+
+    // Missing SEQ, IUPAC codes and '=' bases are stored as they are.
+    const std::string seqs[4] = {"ACGTNACGTN", "*", "ACGRYKMSWBDHVN", "AC==GT=A"};
+    std::vector<std::string> expected;
+    {
+        std::ofstream f(sam_path, std::ios::binary);
+        f << "@SQ\tSN:chr1\tLN:1000000\n";
+        for(uint32_t i = 0; i < 1000; ++i) {
+            const std::string& seq = seqs[i % 4];
+            f << "read" << i << "\t0\tchr1\t" << i + 1 << "\t60\t*\t*\t0\t0\t" << seq << "\t*\n";
+            expected.push_back(seq);
+        }
+    }
+
+    TableConstructor table;
+    SamImporter importer;
+    importer.n_threads = 2;
+    ASSERT_EQ(1000, importer.Import(sam_path, table));
+    ASSERT_EQ(PIL_COMPRESS_ZSTD, table.field_dict.dict[table.field_dict.Find("BASES")].transforms[0]);
+    SamTestBasesRoundTrip(table, expected);
+
+    std::remove(sam_path.c_str());
+}
+
+}
+
+#endif /* IMPORTERS_SAM_IMPORTER_TEST_H_ */
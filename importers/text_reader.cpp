@@ -0,0 +1,140 @@
+#include <cstring>
+#include <thread>
+#include <functional>
+#include <limits>
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "text_reader.h"
+
+// Blocks smaller than this are indexed by a single thread.
+#define PIL_TEXT_MIN_PARALLEL (1 << 20)
+
+namespace pil {
+
+void FindCharacter(const char* data, const size_t n_data, const char c, const uint32_t base, std::vector<uint32_t>& out) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i target = _mm256_set1_epi8(c);
+    for(; i + 32 <= n_data; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, target));
+        while(mask) {
+            out.push_back(base + i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i target = _mm_set1_epi8(c);
+    for(; i + 16 <= n_data; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, target));
+        while(mask) {
+            out.push_back(base + i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for(; i < n_data; ++i) {
+        if(data[i] == c) out.push_back(base + i);
+    }
+}
+
+TextReader::TextReader(const size_t block_size, const uint32_t n_threads) :
+    block_size(block_size), n_threads(n_threads), eof_(true), bytes_read_(0),
+    n_block_(0), n_consumed_(0), n_lines_(0)
+{
+}
+
+TextReader::~TextReader() { Close(); }
+
+int TextReader::Open(const std::string& path) {
+    Close();
+    stream_.open(path, std::ios::binary | std::ios::in);
+    if(stream_.good() == false) return(-1);
+    eof_ = false;
+    return(1);
+}
+
+void TextReader::Close() {
+    if(stream_.is_open()) stream_.close();
+    eof_ = true;
+    bytes_read_ = 0;
+    n_block_ = 0;
+    n_consumed_ = 0;
+    n_lines_ = 0;
+    line_ends_.clear();
+}
+
+int64_t TextReader::Next(const uint32_t line_multiple) {
+    if(line_multiple == 0) return(-1);
+
+    // Move the lines carried over from the previous block to the front.
+    if(n_consumed_) {
+        memmove(&block_[0], &block_[n_consumed_], n_block_ - n_consumed_);
+        n_block_ -= n_consumed_;
+        n_consumed_ = 0;
+    }
+    n_lines_ = 0;
+
+    size_t capacity = block_.size() ? std::max(block_size, block_.size() - 1) : block_size;
+    while(true) {
+        // Offsets are stored as 32-bit integers.
+        if(capacity >= std::numeric_limits<uint32_t>::max()) return(-2);
+        if(block_.size() < capacity + 1) block_.resize(capacity + 1);
+
+        while(eof_ == false && n_block_ < capacity) {
+            stream_.read(&block_[n_block_], capacity - n_block_);
+            const size_t n_read = stream_.gcount();
+            n_block_ += n_read;
+            bytes_read_ += n_read;
+            if(stream_.good() == false) eof_ = true;
+        }
+        // Terminate a final line without a newline.
+        if(eof_ && n_block_ && block_[n_block_ - 1] != '\n') block_[n_block_++] = '\n';
+
+        IndexLines(n_block_);
+        const uint32_t n_keep = line_ends_.size() - line_ends_.size() % line_multiple;
+        if(n_keep) {
+            n_lines_ = n_keep;
+            n_consumed_ = line_ends_[n_keep - 1] + 1;
+            return(n_keep);
+        }
+
+        if(eof_) {
+            // An incomplete record at the end of the file.
+            if(n_block_) return(-3);
+            return(0);
+        }
+        capacity *= 2;
+    }
+}
+
+void TextReader::IndexLines(const size_t n) {
+    line_ends_.clear();
+    const uint32_t n_parts = n < PIL_TEXT_MIN_PARALLEL ? 1 : std::max(1u, n_threads);
+    if(n_parts == 1) {
+        FindNewlines(&block_[0], n, 0, line_ends_);
+        return;
+    }
+
+    std::vector< std::vector<uint32_t> > parts(n_parts);
+    std::vector<std::thread> threads;
+    const size_t part_size = n / n_parts;
+    for(uint32_t p = 0; p < n_parts; ++p) {
+        const size_t begin = p * part_size;
+        const size_t end = p + 1 == n_parts ? n : begin + part_size;
+        threads.push_back(std::thread(FindCharacter, &block_[begin], end - begin, '\n', begin, std::ref(parts[p])));
+    }
+    for(uint32_t p = 0; p < n_parts; ++p) threads[p].join();
+
+    size_t n_total = 0;
+    for(uint32_t p = 0; p < n_parts; ++p) n_total += parts[p].size();
+    line_ends_.reserve(n_total);
+    for(uint32_t p = 0; p < n_parts; ++p) line_ends_.insert(line_ends_.end(), parts[p].begin(), parts[p].end());
+}
+
+}
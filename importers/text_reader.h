@@ -0,0 +1,117 @@
+#ifndef IMPORTERS_TEXT_READER_H_
+#define IMPORTERS_TEXT_READER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+
+namespace pil {
+
+/**<
+ * Find the offsets of all occurrences of `c` in [data, data + n_data) and
+ * append `base` + offset to `out`. Uses AVX2 or SSE2 comparisons if
+ * available.
+ * @param data   Source data.
+ * @param n_data Number of bytes in the source.
+ * @param c      Target character.
+ * @param base   Offset added to every position.
+ * @param out    Destination vector.
+ */
+void FindCharacter(const char* data, const size_t n_data, const char c, const uint32_t base, std::vector<uint32_t>& out);
+
+inline void FindNewlines(const char* data, const size_t n_data, const uint32_t base, std::vector<uint32_t>& out) {
+    FindCharacter(data, n_data, '\n', base, out);
+}
+
+/**<
+ * Parse a base-10 integer with an optional sign spanning [begin, end).
+ * Unlike std::atoi the input does not have to be NUL-terminated and any
+ * other character is an error.
+ * @param begin First character.
+ * @param end   One past the last character.
+ * @param out   Destination value.
+ * @return      Returns TRUE if successful or FALSE otherwise.
+ */
+inline bool ParseInteger(const char* begin, const char* end, int64_t& out) {
+    bool negative = false;
+    if(begin != end && (*begin == '-' || *begin == '+')) {
+        negative = (*begin == '-');
+        ++begin;
+    }
+    if(begin == end || end - begin > 19) return(false);
+
+    uint64_t value = 0;
+    for(; begin != end; ++begin) {
+        const uint32_t digit = static_cast<uint8_t>(*begin) - '0';
+        if(digit > 9) return(false);
+        value = value * 10 + digit;
+    }
+    out = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+    return(true);
+}
+
+// Block-wise reader of line-based text files. Every block holds a whole
+// number of lines (or groups of lines) and the line boundaries are located
+// by several threads at once. Incomplete lines at the end of a block are
+// carried over to the next block.
+class TextReader {
+public:
+    TextReader(const size_t block_size = (16 << 20), const uint32_t n_threads = 1);
+    ~TextReader();
+
+    /**<
+     * Open a text file for reading.
+     * @param path Path to the file.
+     * @return     Returns 1 if successful or -1 otherwise.
+     */
+    int Open(const std::string& path);
+    void Close();
+
+    /**<
+     * Read the next block of lines. Only the largest multiple of
+     * `line_multiple` lines is kept in the block such that records spanning
+     * several lines are never split. The block grows if it does not hold a
+     * single such group. Carriage returns preceding newlines are not part
+     * of the lines.
+     * @param line_multiple Number of lines per record.
+     * @return              Returns the number of lines, 0 at the end of the file, or a negative value on error.
+     */
+    int64_t Next(const uint32_t line_multiple = 1);
+
+    uint32_t size() const { return(n_lines_); }
+    const char* line(const uint32_t i) const { return(&block_[line_begin(i)]); }
+    uint32_t line_length(const uint32_t i) const {
+        uint32_t end = line_ends_[i];
+        const uint32_t begin = line_begin(i);
+        if(end > begin && block_[end - 1] == '\r') --end;
+        return(end - begin);
+    }
+
+    // Bytes read from the file so far.
+    uint64_t bytes_read() const { return(bytes_read_); }
+
+private:
+    uint32_t line_begin(const uint32_t i) const { return(i == 0 ? 0 : line_ends_[i - 1] + 1); }
+
+    // Locate the newlines in [0, n) of the block using n_threads threads.
+    void IndexLines(const size_t n);
+
+public:
+    size_t block_size;
+    uint32_t n_threads;
+
+private:
+    std::ifstream stream_;
+    bool eof_;
+    uint64_t bytes_read_;
+    std::vector<char> block_;
+    size_t n_block_;   // Valid bytes in block_.
+    size_t n_consumed_; // Bytes of block_ handed out by the previous call to Next.
+    uint32_t n_lines_;
+    std::vector<uint32_t> line_ends_; // Offset of the newline terminating each line.
+};
+
+}
+
+#endif /* IMPORTERS_TEXT_READER_H_ */
@@ -0,0 +1,571 @@
+#include <cstring>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "vcf_importer.h"
+
+// Blocks with fewer lines are parsed by a single thread.
+#define PIL_VCF_MIN_PARALLEL 1024
+
+namespace pil {
+
+int PackDiploidGenotypes(const char* data, const uint32_t n_samples, uint8_t* out, uint32_t& n_phased) {
+    n_phased = 0;
+    uint32_t s = 0;
+    // Every sample spans 4 characters `a|b\t`: alleles are at offsets 0 and
+    // 2, separators at offset 1 and tabs at offset 3. The comparison mask of
+    // '1' restricted to the allele offsets is then the packed 2-bit matrix.
+    // The last sample is not followed by a tab and is handled below.
+#if defined(__AVX2__)
+    const __m256i zero  = _mm256_set1_epi8('0');
+    const __m256i one   = _mm256_set1_epi8('1');
+    const __m256i bar   = _mm256_set1_epi8('|');
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i tab   = _mm256_set1_epi8('\t');
+    for(; s + 8 < n_samples; s += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 4 * s));
+        const uint32_t m_one    = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, one));
+        const uint32_t m_allele = m_one | _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        const uint32_t m_bar    = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, bar));
+        const uint32_t m_sep    = m_bar | _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, slash));
+        const uint32_t m_tab    = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, tab));
+        if((m_allele & 0x55555555) != 0x55555555 || (m_sep & 0x22222222) != 0x22222222 || (m_tab & 0x88888888) != 0x88888888)
+            return(-1);
+
+        const uint32_t packed = m_one & 0x55555555;
+        memcpy(out + s / 2, &packed, sizeof(uint32_t));
+        n_phased += __builtin_popcount(m_bar & 0x22222222);
+    }
+#elif defined(__SSE2__)
+    const __m128i zero  = _mm_set1_epi8('0');
+    const __m128i one   = _mm_set1_epi8('1');
+    const __m128i bar   = _mm_set1_epi8('|');
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i tab   = _mm_set1_epi8('\t');
+    for(; s + 4 < n_samples; s += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 4 * s));
+        const uint32_t m_one    = _mm_movemask_epi8(_mm_cmpeq_epi8(v, one));
+        const uint32_t m_allele = m_one | _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        const uint32_t m_bar    = _mm_movemask_epi8(_mm_cmpeq_epi8(v, bar));
+        const uint32_t m_sep    = m_bar | _mm_movemask_epi8(_mm_cmpeq_epi8(v, slash));
+        const uint32_t m_tab    = _mm_movemask_epi8(_mm_cmpeq_epi8(v, tab));
+        if((m_allele & 0x5555) != 0x5555 || (m_sep & 0x2222) != 0x2222 || (m_tab & 0x8888) != 0x8888)
+            return(-1);
+
+        const uint16_t packed = m_one & 0x5555;
+        memcpy(out + s / 2, &packed, sizeof(uint16_t));
+        n_phased += __builtin_popcount(m_bar & 0x2222);
+    }
+#endif
+
+    memset(out + s / 2, 0, (n_samples + 1) / 2 - s / 2);
+    for(; s < n_samples; ++s) {
+        const char* g = data + 4 * s;
+        if((g[0] != '0' && g[0] != '1') || (g[1] != '|' && g[1] != '/') || (g[2] != '0' && g[2] != '1')) return(-1);
+        if(s + 1 < n_samples && g[3] != '\t') return(-1);
+        out[s / 2] |= ((g[0] - '0') | ((g[2] - '0') << 2)) << ((s & 1) * 4);
+        n_phased += (g[1] == '|');
+    }
+    return(1);
+}
+
+// Append a value to the data buffer of a Chunk.
+template <class T>
+static inline void VcfPushValue(PoolBytes& data, const T value) {
+    const size_t offset = data.size();
+    data.resize(offset + sizeof(T));
+    memcpy(&data[offset], &value, sizeof(T));
+}
+
+// Values are 8-byte aligned in the data buffer.
+static inline uint64_t VcfAlignData(PoolBytes& data) {
+    data.resize((data.size() + 7) & ~7);
+    return(data.size());
+}
+
+// Value of a key in a structured header line such as ##INFO=<ID=DP,...>.
+// Only the part preceding the free-text Description is searched.
+static std::string VcfHeaderValue(const char* line, const uint32_t l_line, const std::string& key) {
+    const std::string text(line, l_line);
+    const size_t limit = text.find("Description=");
+    size_t pos = text.find("<" + key + "=");
+    if(pos == std::string::npos) pos = text.find("," + key + "=");
+    if(pos == std::string::npos || pos > limit) return(std::string());
+
+    pos += key.size() + 2;
+    const size_t end = text.find_first_of(",>", pos);
+    return(text.substr(pos, end == std::string::npos ? std::string::npos : end - pos));
+}
+
+// Write a text field directly into its ColumnSet.
+static int VcfAppendText(TableConstructor& table, RecordBuilder& rbuild, const std::string& field_name,
+                         const char* text, const uint32_t l_text)
+{
+    uint8_t* dst = table.ReserveArray<uint8_t>(rbuild, field_name, PIL_TYPE_UINT8, l_text);
+    if(dst == nullptr) return(l_text ? -1 : 1);
+    memcpy(dst, text, l_text);
+    return(1);
+}
+
+template <class T>
+static int VcfAppendArray(TableConstructor& table, RecordBuilder& rbuild, const std::string& field_name,
+                          const PIL_PRIMITIVE_TYPE ptype, const uint8_t* data, const uint32_t n_values)
+{
+    T* dst = table.ReserveArray<T>(rbuild, field_name, ptype, n_values);
+    if(dst == nullptr) return(n_values ? -1 : 1);
+    memcpy(dst, data, n_values * sizeof(T));
+    return(1);
+}
+
+VcfImporter::VcfImporter() :
+    n_threads(1), block_size(16 << 20), set_fields(true)
+{
+}
+
+int VcfImporter::SetFields(TableConstructor& table) {
+    std::vector<PIL_COMPRESSION_TYPE> ctypes;
+    ctypes.push_back(PIL_ENCODE_PBWT);
+    if(table.SetField("GT", PIL_TYPE_BYTE_ARRAY, PIL_TYPE_UINT8, ctypes) < 0) return(-1);
+
+    return(1);
+}
+
+uint32_t VcfImporter::InternName(std::unordered_map<std::string, uint32_t>& map, std::vector<std::string>& dict,
+                                 const char* name, const uint32_t l_name)
+{
+    const std::string s(name, l_name);
+    std::unordered_map<std::string, uint32_t>::const_iterator it = map.find(s);
+    if(it != map.end()) return(it->second);
+
+    const uint32_t id = dict.size();
+    map[s] = id;
+    dict.push_back(s);
+    return(id);
+}
+
+uint32_t VcfImporter::AddInfoField(const std::string& key, const std::string& number, const std::string& type) {
+    std::unordered_map<std::string, uint32_t>::const_iterator it = info_map_.find(key);
+    if(it != info_map_.end()) return(it->second);
+
+    InfoField f;
+    f.field_name = "INFO:" + key;
+    f.is_flag = (type == "Flag");
+    if(type == "Integer") {
+        f.ptype = PIL_TYPE_INT32;
+        f.is_array = (number != "1");
+    } else if(type == "Float") {
+        f.ptype = PIL_TYPE_FLOAT;
+        f.is_array = (number != "1");
+    } else {
+        f.ptype = PIL_TYPE_UINT8;
+        f.is_array = (f.is_flag == false);
+    }
+
+    const uint32_t id = info_fields_.size();
+    info_map_[key] = id;
+    info_fields_.push_back(f);
+    return(id);
+}
+
+int VcfImporter::ParseHeaderLine(const char* line, const uint32_t l_line) {
+    const std::string prefix(line, std::min<uint32_t>(l_line, 10));
+    if(prefix.compare(0, 10, "##contig=<") == 0) {
+        const std::string id = VcfHeaderValue(line, l_line, "ID");
+        if(id.size()) InternName(chrom_map_, chrom_dict, id.data(), id.size());
+    } else if(prefix.compare(0, 10, "##FILTER=<") == 0) {
+        const std::string id = VcfHeaderValue(line, l_line, "ID");
+        if(id.size()) InternName(filter_map_, filter_dict, id.data(), id.size());
+    } else if(prefix.compare(0, 8, "##INFO=<") == 0) {
+        const std::string id = VcfHeaderValue(line, l_line, "ID");
+        if(id.size()) AddInfoField(id, VcfHeaderValue(line, l_line, "Number"), VcfHeaderValue(line, l_line, "Type"));
+    } else if(prefix.compare(0, 6, "#CHROM") == 0) {
+        // Sample names follow the FORMAT column.
+        std::vector<uint32_t> tabs;
+        FindCharacter(line, l_line, '\t', 0, tabs);
+        if(tabs.size() < 7) return(-1);
+        samples.clear();
+        for(uint32_t k = 8; k < tabs.size(); ++k) {
+            const uint32_t end = k + 1 < tabs.size() ? tabs[k + 1] : l_line;
+            samples.push_back(std::string(line + tabs[k] + 1, end - tabs[k] - 1));
+        }
+    }
+    return(1);
+}
+
+bool VcfImporter::ParseInfo(const char* begin, const char* end, const char* line, Chunk& chunk) const {
+    if(end - begin == 1 && *begin == '.') return(true);
+
+    while(begin < end) {
+        const char* token_end = std::find(begin, end, ';');
+        if(begin == token_end) { ++begin; continue; }
+        const char* eq = std::find(begin, token_end, '=');
+        if(eq == begin) return(false);
+
+        InfoValue v;
+        std::unordered_map<std::string, uint32_t>::const_iterator it = info_map_.find(std::string(begin, eq - begin));
+        v.key = it == info_map_.end() ? -1 : it->second;
+        v.key_begin = begin - line;
+        v.key_length = eq - begin;
+        v.offset = VcfAlignData(chunk.data);
+        v.n_values = 0;
+
+        const char* value = eq == token_end ? token_end : eq + 1;
+        const InfoField* f = v.key >= 0 ? &info_fields_[v.key] : nullptr;
+        if(f == nullptr || (f->ptype == PIL_TYPE_UINT8 && f->is_flag == false)) {
+            // Strings (including undeclared keys) are kept as text.
+            chunk.data.insert(chunk.data.end(), value, token_end);
+            v.n_values = token_end - value;
+        } else if(f->is_flag) {
+            VcfPushValue<uint8_t>(chunk.data, 1);
+            v.n_values = 1;
+        } else if(token_end - value == 1 && *value == '.') {
+            // Missing values leave the Field null.
+            begin = token_end + 1;
+            continue;
+        } else {
+            while(true) {
+                const char* value_end = std::find(value, token_end, ',');
+                const bool missing = (value_end - value == 1 && *value == '.');
+                if(f->ptype == PIL_TYPE_INT32) {
+                    int64_t x = std::numeric_limits<int32_t>::min();
+                    if(missing == false && (ParseInteger(value, value_end, x) == false || x <= INT32_MIN || x > INT32_MAX)) return(false);
+                    VcfPushValue<int32_t>(chunk.data, x);
+                } else {
+                    float x = std::numeric_limits<float>::quiet_NaN();
+                    if(missing == false) {
+                        if(value == value_end) return(false);
+                        char* parsed = nullptr;
+                        x = strtof(value, &parsed);
+                        if(parsed != value_end) return(false);
+                    }
+                    VcfPushValue<float>(chunk.data, x);
+                }
+                ++v.n_values;
+                if(value_end == token_end) break;
+                value = value_end + 1;
+            }
+            if(f->is_array == false && v.n_values != 1) return(false);
+        }
+
+        chunk.info.push_back(v);
+        begin = token_end + 1;
+    }
+    return(true);
+}
+
+bool VcfImporter::ParseGenotypes(const char* format, const uint32_t l_format, const char* begin, const char* end, Site& site, Chunk& chunk) const {
+    site.gt_kind = 0;
+    if(l_format < 2 || format[0] != 'G' || format[1] != 'T' || (l_format > 2 && format[2] != ':')) return(true);
+
+    const uint32_t n_samples = samples.size();
+
+    // Fast path: diploid biallelic genotypes without other FORMAT fields.
+    if(l_format == 2 && (uint64_t)(end - begin) == 4 * (uint64_t)n_samples - 1) {
+        const uint64_t offset = VcfAlignData(chunk.data);
+        chunk.data.resize(offset + (n_samples + 1) / 2);
+        uint32_t n_phased = 0;
+        if(PackDiploidGenotypes(begin, n_samples, &chunk.data[offset], n_phased) == 1 && (n_phased == 0 || n_phased == n_samples)) {
+            site.gt_kind = 1;
+            site.ploidy = 2;
+            site.phased = n_phased ? 1 : 0;
+            site.n_gt = (n_samples + 1) / 2;
+            site.gt_offset = offset;
+            return(true);
+        }
+        chunk.data.resize(offset);
+    }
+
+    // General path: parse the allele indices of every sample.
+    chunk.alleles.clear();
+    chunk.ploidy.clear();
+    chunk.phase.clear();
+    int32_t max_allele = 0;
+    uint32_t max_ploidy = 0, n_phased = 0;
+    const char* p = begin;
+    for(uint32_t s = 0; s < n_samples; ++s) {
+        const char* column_end = reinterpret_cast<const char*>(memchr(p, '\t', end - p));
+        if(column_end == nullptr) column_end = end;
+        if(column_end == end && s + 1 < n_samples) return(false);
+        const char* gt_end = std::find(p, column_end, ':');
+
+        uint32_t ploidy = 0;
+        bool phased = true;
+        const char* q = p;
+        while(true) {
+            if(q == gt_end) return(false);
+            if(*q == '.') {
+                chunk.alleles.push_back(PIL_VCF_ALLELE_MISSING);
+                ++q;
+            } else {
+                const char* digits_end = q;
+                while(digits_end != gt_end && *digits_end >= '0' && *digits_end <= '9') ++digits_end;
+                int64_t a = 0;
+                if(ParseInteger(q, digits_end, a) == false || a > INT16_MAX) return(false);
+                chunk.alleles.push_back(a);
+                max_allele = std::max<int32_t>(max_allele, a);
+                q = digits_end;
+            }
+            ++ploidy;
+            if(q == gt_end) break;
+            if(*q != '|' && *q != '/') return(false);
+            if(*q == '/') phased = false;
+            ++q;
+        }
+        if(ploidy > UINT8_MAX) return(false);
+
+        chunk.ploidy.push_back(ploidy);
+        chunk.phase.push_back(ploidy > 1 && phased);
+        n_phased += chunk.phase.back();
+        max_ploidy = std::max(max_ploidy, ploidy);
+        p = column_end + 1;
+    }
+    if(p < end) return(false);
+
+    site.ploidy = max_ploidy;
+    site.phased = n_phased == 0 ? 0 : n_phased == n_samples ? 1 : 2;
+    site.gt_offset = VcfAlignData(chunk.data);
+    const uint64_t n_haplotypes = (uint64_t)n_samples * max_ploidy;
+    if(max_allele <= 1) {
+        site.gt_kind = 1;
+        site.n_gt = (n_haplotypes + 3) / 4;
+        chunk.data.resize(site.gt_offset + site.n_gt, 0);
+        uint8_t* out = &chunk.data[site.gt_offset];
+        uint64_t a = 0, h = 0;
+        for(uint32_t s = 0; s < n_samples; ++s) {
+            for(uint32_t k = 0; k < max_ploidy; ++k, ++h) {
+                uint8_t code = PIL_VCF_GT_EOV;
+                if(k < chunk.ploidy[s]) {
+                    code = chunk.alleles[a] < 0 ? PIL_VCF_GT_MISSING : chunk.alleles[a];
+                    ++a;
+                }
+                out[h / 4] |= code << ((h % 4) * 2);
+            }
+        }
+    } else {
+        site.gt_kind = 2;
+        site.n_gt = n_haplotypes;
+        uint64_t a = 0;
+        for(uint32_t s = 0; s < n_samples; ++s) {
+            for(uint32_t k = 0; k < max_ploidy; ++k) {
+                int16_t value = PIL_VCF_ALLELE_EOV;
+                if(k < chunk.ploidy[s]) value = chunk.alleles[a++];
+                VcfPushValue<int16_t>(chunk.data, value);
+            }
+        }
+    }
+
+    if(site.phased == 2) {
+        site.phase_offset = chunk.data.size();
+        chunk.data.resize(site.phase_offset + (n_samples + 7) / 8, 0);
+        for(uint32_t s = 0; s < n_samples; ++s)
+            chunk.data[site.phase_offset + s / 8] |= chunk.phase[s] << (s % 8);
+    }
+    return(true);
+}
+
+uint32_t VcfImporter::ParseLines(const uint32_t from, const uint32_t to, Chunk& chunk) const {
+    for(uint32_t i = from; i < to; ++i) {
+        const char* line = reader_.line(i);
+        const uint32_t l_line = reader_.line_length(i);
+        if(l_line == 0) continue;
+        const char* end = line + l_line;
+
+        // Only the tabs of the fixed columns are located: the sample columns
+        // are handled by ParseGenotypes.
+        Site site;
+        site.line = i;
+        uint32_t n_tabs = 0;
+        const char* p = line;
+        while(n_tabs < 8) {
+            const char* tab = reinterpret_cast<const char*>(memchr(p, '\t', end - p));
+            if(tab == nullptr) break;
+            site.tabs[n_tabs++] = tab - line;
+            p = tab + 1;
+        }
+        if(n_tabs < 7) return(i);
+        if(n_tabs == 7) site.tabs[7] = l_line;
+
+        // Column k spans [tabs[k-1] + 1, tabs[k]).
+        int64_t v = 0;
+        if(ParseInteger(line + site.tabs[0] + 1, line + site.tabs[1], v) == false || v < 0 || v > INT32_MAX) return(i);
+        site.pos = v;
+
+        const char* qual = line + site.tabs[4] + 1;
+        if(line + site.tabs[5] - qual == 1 && *qual == '.') {
+            site.qual = std::numeric_limits<float>::quiet_NaN();
+        } else {
+            char* parsed = nullptr;
+            site.qual = strtof(qual, &parsed);
+            if(qual == line + site.tabs[5] || parsed != line + site.tabs[5]) return(i);
+        }
+
+        // The dictionaries are read-only while threads are parsing: names
+        // that are not in them are interned when appending.
+        std::unordered_map<std::string, uint32_t>::const_iterator it = chrom_map_.find(std::string(line, site.tabs[0]));
+        site.chrom = it == chrom_map_.end() ? -1 : it->second;
+        it = filter_map_.find(std::string(line + site.tabs[5] + 1, site.tabs[6] - site.tabs[5] - 1));
+        site.filter = it == filter_map_.end() ? -1 : it->second;
+
+        site.info_offset = chunk.info.size();
+        if(ParseInfo(line + site.tabs[6] + 1, line + site.tabs[7], line, chunk) == false) return(i);
+        site.n_info = chunk.info.size() - site.info_offset;
+
+        site.gt_kind = 0;
+        if(samples.size()) {
+            if(n_tabs < 8) return(i);
+            const char* format = line + site.tabs[7] + 1;
+            const char* format_end = reinterpret_cast<const char*>(memchr(format, '\t', end - format));
+            if(format_end == nullptr) return(i);
+            if(ParseGenotypes(format, format_end - format, format_end + 1, end, site, chunk) == false) return(i);
+        }
+        chunk.sites.push_back(site);
+    }
+    return(to);
+}
+
+int VcfImporter::AppendChunk(const Chunk& chunk, TableConstructor& table, RecordBuilder& rbuild) {
+    for(size_t r = 0; r < chunk.sites.size(); ++r) {
+        const Site& site = chunk.sites[r];
+        const char* line = reader_.line(site.line);
+
+        const uint32_t chrom = site.chrom >= 0 ? site.chrom : InternName(chrom_map_, chrom_dict, line, site.tabs[0]);
+        const uint32_t filter = site.filter >= 0 ? site.filter : InternName(filter_map_, filter_dict, line + site.tabs[5] + 1, site.tabs[6] - site.tabs[5] - 1);
+
+        rbuild.Add<uint32_t>("RNAME", PIL_TYPE_UINT32, chrom);
+        rbuild.Add<uint32_t>("POS", PIL_TYPE_UINT32, site.pos);
+        if(VcfAppendText(table, rbuild, "NAME", line + site.tabs[1] + 1, site.tabs[2] - site.tabs[1] - 1) != 1) return(-1);
+        if(VcfAppendText(table, rbuild, "REF", line + site.tabs[2] + 1, site.tabs[3] - site.tabs[2] - 1) != 1) return(-1);
+        if(VcfAppendText(table, rbuild, "ALT", line + site.tabs[3] + 1, site.tabs[4] - site.tabs[3] - 1) != 1) return(-1);
+        rbuild.Add<float>("QUAL", PIL_TYPE_FLOAT, site.qual);
+        rbuild.Add<uint32_t>("FILTER", PIL_TYPE_UINT32, filter);
+
+        for(uint32_t k = site.info_offset; k < site.info_offset + site.n_info; ++k) {
+            const InfoValue& v = chunk.info[k];
+            // Undeclared keys are Strings.
+            const uint32_t key = v.key >= 0 ? v.key : AddInfoField(std::string(line + v.key_begin, v.key_length), "1", "String");
+            const InfoField& f = info_fields_[key];
+            const uint8_t* data = &chunk.data[v.offset];
+
+            int ret = 1;
+            if(f.is_flag) rbuild.Add<uint8_t>(f.field_name, PIL_TYPE_UINT8, 1);
+            else if(f.ptype == PIL_TYPE_INT32) {
+                if(f.is_array) ret = VcfAppendArray<int32_t>(table, rbuild, f.field_name, f.ptype, data, v.n_values);
+                else rbuild.Add<int32_t>(f.field_name, f.ptype, *reinterpret_cast<const int32_t*>(data));
+            } else if(f.ptype == PIL_TYPE_FLOAT) {
+                if(f.is_array) ret = VcfAppendArray<float>(table, rbuild, f.field_name, f.ptype, data, v.n_values);
+                else rbuild.Add<float>(f.field_name, f.ptype, *reinterpret_cast<const float*>(data));
+            } else ret = VcfAppendArray<uint8_t>(table, rbuild, f.field_name, f.ptype, data, v.n_values);
+            if(ret != 1) return(-1);
+        }
+
+        if(site.gt_kind) {
+            rbuild.Add<uint8_t>("GT_PLOIDY", PIL_TYPE_UINT8, site.ploidy);
+            rbuild.Add<uint8_t>("GT_PHASED", PIL_TYPE_UINT8, site.phased);
+            int ret = 1;
+            if(site.gt_kind == 1) ret = VcfAppendArray<uint8_t>(table, rbuild, "GT", PIL_TYPE_UINT8, &chunk.data[site.gt_offset], site.n_gt);
+            else ret = VcfAppendArray<int16_t>(table, rbuild, "GT_ALLELES", PIL_TYPE_INT16, &chunk.data[site.gt_offset], site.n_gt);
+            if(ret != 1) return(-1);
+            if(site.phased == 2) {
+                ret = VcfAppendArray<uint8_t>(table, rbuild, "GT_PHASE", PIL_TYPE_UINT8, &chunk.data[site.phase_offset], (samples.size() + 7) / 8);
+                if(ret != 1) return(-1);
+            }
+        }
+
+        if(table.Append(rbuild) != 1) return(-1);
+    }
+    return(1);
+}
+
+int64_t VcfImporter::Import(const std::string& path, TableConstructor& table) {
+    if(set_fields && SetFields(table) < 0) return(-1);
+
+    reader_.block_size = block_size;
+    reader_.n_threads = n_threads;
+    if(reader_.Open(path) != 1) return(-1);
+
+    header.clear();
+    samples.clear();
+    chrom_dict.clear();
+    chrom_map_.clear();
+    filter_dict.clear();
+    filter_map_.clear();
+    info_map_.clear();
+    info_fields_.clear();
+
+    RecordBuilder rbuild;
+    int64_t n_sites = 0;
+    bool in_header = true;
+    while(true) {
+        const int64_t n_lines = reader_.Next(1);
+        if(n_lines == 0) break;
+        if(n_lines < 0) { reader_.Close(); return(-2); }
+
+        // Header lines precede the sites.
+        uint32_t first = 0;
+        while(in_header && first < n_lines) {
+            const uint32_t l_line = reader_.line_length(first);
+            if(l_line && reader_.line(first)[0] != '#') { in_header = false; break; }
+            if(l_line) {
+                header.append(reader_.line(first), l_line);
+                header += '\n';
+                if(ParseHeaderLine(reader_.line(first), l_line) != 1) { reader_.Close(); return(-3); }
+            }
+            ++first;
+        }
+        // Batches may be finalized while appending sites: the genotype index
+        // needs the number of samples from the header by then.
+        table.genotype_index_options.n_samples = samples.size();
+
+        // Parse ranges of lines in parallel.
+        const uint32_t n_body = n_lines - first;
+        const uint32_t n_parts = n_body < PIL_VCF_MIN_PARALLEL ? 1 : std::max(1u, n_threads);
+        if(chunks_.size() < n_parts) chunks_.resize(n_parts);
+        std::vector<uint32_t> results(n_parts);
+        std::vector<uint32_t> ends(n_parts);
+        const uint32_t part_size = n_body / n_parts;
+        std::vector<std::thread> threads;
+        for(uint32_t p = 0; p < n_parts; ++p) {
+            const uint32_t from = first + p * part_size;
+            ends[p] = p + 1 == n_parts ? n_lines : from + part_size;
+            chunks_[p].clear();
+            if(n_parts == 1) results[p] = ParseLines(from, ends[p], chunks_[p]);
+            else threads.push_back(std::thread([this, &results, &ends, p, from]() { results[p] = ParseLines(from, ends[p], chunks_[p]); }));
+        }
+        for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+        for(uint32_t p = 0; p < n_parts; ++p) {
+            if(results[p] != ends[p]) {
+                std::cerr << "malformed VCF line: " << std::string(reader_.line(results[p]), std::min<uint32_t>(256, reader_.line_length(results[p]))) << std::endl;
+                reader_.Close();
+                return(-3);
+            }
+        }
+
+        for(uint32_t p = 0; p < n_parts; ++p) {
+            if(AppendChunk(chunks_[p], table, rbuild) != 1) { reader_.Close(); return(-4); }
+            n_sites += chunks_[p].sites.size();
+        }
+    }
+    reader_.Close();
+
+    std::string names;
+    for(size_t i = 0; i < samples.size(); ++i) { names += samples[i]; names += '\n'; }
+    table.meta_data.SetKeyValue(PIL_VCF_SAMPLES_KEY, names);
+    names.clear();
+    for(size_t i = 0; i < chrom_dict.size(); ++i) { names += chrom_dict[i]; names += '\n'; }
+    table.meta_data.SetKeyValue(PIL_VCF_CHROM_KEY, names);
+    names.clear();
+    for(size_t i = 0; i < filter_dict.size(); ++i) { names += filter_dict[i]; names += '\n'; }
+    table.meta_data.SetKeyValue(PIL_VCF_FILTER_KEY, names);
+    table.meta_data.SetKeyValue(PIL_VCF_HEADER_KEY, header);
+
+    return(n_sites);
+}
+
+}
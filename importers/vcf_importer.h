@@ -0,0 +1,173 @@
+#ifndef IMPORTERS_VCF_IMPORTER_H_
+#define IMPORTERS_VCF_IMPORTER_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../table.h"
+#include "text_reader.h"
+
+namespace pil {
+
+// Keys of the VCF header and dictionaries in FileMetaData. Dictionaries
+// hold one name per line in identifier order.
+#define PIL_VCF_HEADER_KEY  "VCF_HEADER"
+#define PIL_VCF_SAMPLES_KEY "VCF_SAMPLES"
+#define PIL_VCF_CHROM_KEY   "VCF_CHROM"
+#define PIL_VCF_FILTER_KEY  "VCF_FILTER"
+
+// 2-bit haplotype codes of the packed GT matrix. Samples with fewer
+// haplotypes than the ploidy of the site are padded with PIL_VCF_GT_EOV.
+#define PIL_VCF_GT_REF     0
+#define PIL_VCF_GT_ALT     1
+#define PIL_VCF_GT_MISSING 2
+#define PIL_VCF_GT_EOV     3
+
+// Special values of the GT_ALLELES tensor.
+#define PIL_VCF_ALLELE_MISSING -1
+#define PIL_VCF_ALLELE_EOV     -2
+
+/**<
+ * Pack a run of diploid genotypes of the form `a|b` or `a/b` with alleles
+ * 0 or 1 and separated by tabs into 2 bits per haplotype. Groups of samples
+ * are validated and packed with AVX2 or SSE2 comparisons if available.
+ * @param data      First character of the first sample (4 * n_samples - 1 characters).
+ * @param n_samples Number of samples.
+ * @param out       Destination of (n_samples + 1) / 2 bytes.
+ * @param n_phased  Number of phased (`|`) samples.
+ * @return          Returns 1 if every sample matches the pattern or -1 otherwise.
+ */
+int PackDiploidGenotypes(const char* data, const uint32_t n_samples, uint8_t* out, uint32_t& n_phased);
+
+// Import VCF files into a TableConstructor. Blocks of lines are split into
+// ranges that are parsed by several threads and the sites are then appended
+// in order.
+//
+// The fixed columns are stored as RNAME, POS, NAME, REF, ALT, QUAL and
+// FILTER, where RNAME and FILTER are interned into uint32 identifiers in the
+// order of the ##contig and ##FILTER header lines. INFO keys are stored in
+// sparse Fields named "INFO:<key>" typed by their ##INFO declaration:
+// Integer and Float values as int32 and float columns (Number=1) or tensors,
+// Flags as uint8 columns, and Strings as text. Undeclared keys are Strings.
+//
+// Genotypes never go through per-sample strings. Sites where every allele is
+// 0, 1 or missing store their GT matrix in the GT tensor with 2 bits per
+// haplotype (4 haplotypes per byte in sample-major order); other sites store
+// int16 allele indices in GT_ALLELES. GT_PLOIDY holds the number of
+// haplotypes per sample and GT_PHASED is 0 (unphased), 1 (phased) or 2
+// (mixed, with one bit per sample in GT_PHASE). The remaining FORMAT fields
+// are not imported. The number of samples is passed on to the genotype index
+// options of the Table (see GenotypeIndex).
+class VcfImporter {
+public:
+    // Declared type of an INFO key.
+    struct InfoField {
+        std::string field_name;
+        PIL_PRIMITIVE_TYPE ptype;
+        bool is_array; // Number is not 1 or the type is String.
+        bool is_flag;
+    };
+
+    // INFO value parsed by a worker thread. Values are stored in the thread's
+    // data buffer at an 8-byte aligned offset.
+    struct InfoValue {
+        int32_t key; // Offset into the declared INFO keys or -1 if undeclared.
+        uint32_t key_begin, key_length; // Key in the line.
+        uint32_t n_values;
+        uint64_t offset;
+    };
+
+    // Site parsed by a worker thread. Fields that are kept as text are
+    // located through the tab offsets of the line.
+    struct Site {
+        uint32_t line;
+        uint32_t tabs[8]; // Offset of the tab after the fixed columns CHROM to INFO.
+        int32_t chrom, filter; // Identifiers or -1 if not in the dictionary.
+        uint32_t pos;
+        float qual;
+        uint32_t info_offset, n_info;
+        uint8_t gt_kind; // 0: no genotypes, 1: packed, 2: allele indices.
+        uint8_t ploidy, phased;
+        uint32_t n_gt; // Bytes (packed) or values (allele indices).
+        uint64_t gt_offset, phase_offset;
+    };
+
+    // Output of a worker thread.
+    struct Chunk {
+        void clear() { sites.clear(); info.clear(); data.clear(); }
+
+        std::vector<Site> sites;
+        std::vector<InfoValue> info;
+        PoolBytes data; // Drawn from the MemoryPool of the parsing thread.
+        std::vector<int32_t> alleles; // Scratch space.
+        std::vector<uint8_t> ploidy, phase; // Scratch space.
+    };
+
+public:
+    VcfImporter();
+
+    /**<
+     * Import every site of the VCF file into the provided Table. The header
+     * lines, sample names and the CHROM and FILTER dictionaries are stored
+     * in the Table meta data. The Table is not finalized.
+     * @param path  Path to the VCF file.
+     * @param table Destination TableConstructor with an open output stream.
+     * @return      Returns the number of sites imported or a negative value if the file is malformed.
+     */
+    int64_t Import(const std::string& path, TableConstructor& table);
+
+    /**<
+     * Register the Fields with their default transformations: the packed GT
+     * matrix is compressed with the PBWT codec. Fields that already exist in
+     * the Table are left untouched.
+     * @param table Destination TableConstructor.
+     * @return      Returns 1 if successful or a negative value otherwise.
+     */
+    static int SetFields(TableConstructor& table);
+
+private:
+    // Parse a ## or #CHROM header line.
+    int ParseHeaderLine(const char* line, const uint32_t l_line);
+    uint32_t InternName(std::unordered_map<std::string, uint32_t>& map, std::vector<std::string>& dict, const char* name, const uint32_t l_name);
+    uint32_t AddInfoField(const std::string& key, const std::string& number, const std::string& type);
+
+    /**<
+     * Parse the lines [from, to) of the current block into a Chunk.
+     * @return Returns the first malformed line or `to` otherwise.
+     */
+    uint32_t ParseLines(const uint32_t from, const uint32_t to, Chunk& chunk) const;
+    bool ParseInfo(const char* begin, const char* end, const char* line, Chunk& chunk) const;
+
+    /**<
+     * Parse the GT subfield of the sample columns starting at `begin`.
+     * @return Returns TRUE if successful or FALSE otherwise.
+     */
+    bool ParseGenotypes(const char* format, const uint32_t l_format, const char* begin, const char* end, Site& site, Chunk& chunk) const;
+
+    /**<
+     * Append the sites of a parsed Chunk to the Table.
+     * @return Returns 1 if successful or -1 otherwise.
+     */
+    int AppendChunk(const Chunk& chunk, TableConstructor& table, RecordBuilder& rbuild);
+
+public:
+    uint32_t n_threads; // Threads used to index and parse blocks.
+    size_t block_size; // Bytes read per block.
+    bool set_fields; // Call SetFields before importing.
+    std::string header; // Header lines including newlines.
+    std::vector<std::string> samples; // Sample names.
+    std::vector<std::string> chrom_dict; // Contig names in identifier order.
+    std::vector<std::string> filter_dict; // FILTER values in identifier order.
+
+private:
+    TextReader reader_;
+    std::unordered_map<std::string, uint32_t> chrom_map_, filter_map_;
+    std::unordered_map<std::string, uint32_t> info_map_;
+    std::vector<InfoField> info_fields_;
+    std::vector<Chunk> chunks_;
+};
+
+}
+
+#endif /* IMPORTERS_VCF_IMPORTER_H_ */
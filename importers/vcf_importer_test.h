@@ -0,0 +1,169 @@
+#ifndef IMPORTERS_VCF_IMPORTER_TEST_H_
+#define IMPORTERS_VCF_IMPORTER_TEST_H_
+
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <random>
+
+#include <gtest/gtest.h>
+#include "vcf_importer.h"
+
+namespace pil {
+
+// Packed 2-bit code of a haplotype.
+static uint32_t VcfTestHaplotype(const uint8_t* packed, const uint32_t h) {
+    return((packed[h / 4] >> ((h % 4) * 2)) & 3);
+}
+
+TEST(ImporterTests, PackDiploidGenotypes) {
+    std::mt19937 rng(42);
+    const uint32_t sizes[] = {1, 3, 4, 5, 8, 9, 17, 100, 2504};
+    for(uint32_t n_samples : sizes) {
+        std::string gt;
+        std::vector<uint32_t> haplotypes;
+        uint32_t n_phased = 0;
+        for(uint32_t s = 0; s < n_samples; ++s) {
+            const uint32_t a = rng() & 1, b = rng() & 1;
+            const bool phased = rng() % 4 != 0;
+            gt += (char)('0' + a);
+            gt += phased ? '|' : '/';
+            gt += (char)('0' + b);
+            if(s + 1 < n_samples) gt += '\t';
+            haplotypes.push_back(a);
+            haplotypes.push_back(b);
+            n_phased += phased;
+        }
+
+        std::vector<uint8_t> packed((n_samples + 1) / 2);
+        uint32_t n_phased_out = 0;
+        ASSERT_EQ(1, PackDiploidGenotypes(gt.data(), n_samples, packed.data(), n_phased_out));
+        ASSERT_EQ(n_phased, n_phased_out);
+        for(uint32_t h = 0; h < 2 * n_samples; ++h) ASSERT_EQ(haplotypes[h], VcfTestHaplotype(packed.data(), h));
+
+        // Alleles other than 0 or 1 are rejected.
+        gt[4 * (n_samples / 2) + 2] = '2';
+        ASSERT_EQ(-1, PackDiploidGenotypes(gt.data(), n_samples, packed.data(), n_phased_out));
+    }
+}
+
+TEST(ImporterTests, VcfImport) {
+    const std::string vcf_path = "pil_vcf_import_test.vcf";
+    const std::string path = "pil_vcf_import_test.pil";
+    const uint32_t n_samples = 41;
+    const uint32_t n_sites = 3000;
+    {
+        std::ofstream f(vcf_path, std::ios::binary);
+        f << "##fileformat=VCFv4.2\n##contig=<ID=20,length=63025520>\n##FILTER=<ID=PASS,Description=\"All filters passed\">\n";
+        f << "##INFO=<ID=AC,Number=A,Type=Integer,Description=\"Allele count, Type=Float\">\n";
+        f << "##INFO=<ID=AF,Number=A,Type=Float,Description=\"Allele frequency\">\n";
+        f << "##INFO=<ID=NS,Number=1,Type=Integer,Description=\"Samples\">\n";
+        f << "##INFO=<ID=DB,Number=0,Type=Flag,Description=\"dbSNP\">\n";
+        f << "##INFO=<ID=AA,Number=1,Type=String,Description=\"Ancestral allele\">\n";
+        f << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+        for(uint32_t s = 0; s < n_samples; ++s) f << "\tS" << s;
+        f << "\n";
+        for(uint32_t i = 0; i < n_sites; ++i) {
+            f << "20\t" << 1000 + i << "\trs" << i << "\tA\tG\t100\tPASS\tAC=" << i % 7 << ";AF=0.25;NS=" << n_samples << ";AA=.|||";
+            if(i % 2) f << ";DB";
+            f << "\tGT";
+            for(uint32_t s = 0; s < n_samples; ++s) f << "\t" << (s + i) % 2 << "|" << (s * i) % 2;
+            f << "\n";
+        }
+        // Multi-allelic site with missing values and additional FORMAT fields.
+        f << "20\t5000\t.\tA\tG,T\t.\tq10\tAC=1,2;AF=.,0.5;XX=text\tGT:DP";
+        for(uint32_t s = 0; s < n_samples; ++s) f << "\t" << (s == 0 ? "./." : s == 1 ? "2/1" : "0/1") << ":" << s;
+        f << "\n";
+        // Mixed ploidy and phasing on an undeclared contig.
+        f << "chrX\t10\t.\tC\tT\t50\tPASS\t.\tGT";
+        for(uint32_t s = 0; s < n_samples; ++s) f << "\t" << (s == 0 ? "1" : s == 1 ? "0/1" : "0|1");
+        f << "\n";
+    }
+
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+    table.batch_size = 1000000;
+
+    VcfImporter importer;
+    importer.n_threads = 4;
+    ASSERT_EQ(n_sites + 2, importer.Import(vcf_path, table));
+    ASSERT_EQ(n_sites + 2, table.meta_data.batches.back()->n_rec);
+    ASSERT_EQ(n_samples, importer.samples.size());
+    ASSERT_EQ("20\nchrX\n", *table.meta_data.GetKeyValue(PIL_VCF_CHROM_KEY));
+    ASSERT_EQ("PASS\nq10\n", *table.meta_data.GetKeyValue(PIL_VCF_FILTER_KEY));
+    ASSERT_EQ("S0", table.meta_data.GetKeyValue(PIL_VCF_SAMPLES_KEY)->substr(0, 2));
+
+    // INFO keys are typed by their declarations.
+    ASSERT_EQ(PIL_TYPE_INT32, table.field_dict.dict[table.field_dict.Find("INFO:AC")].ptype);
+    ASSERT_EQ(PIL_CSTORE_TENSOR, table.field_dict.dict[table.field_dict.Find("INFO:AC")].cstore);
+    ASSERT_EQ(PIL_TYPE_FLOAT, table.field_dict.dict[table.field_dict.Find("INFO:AF")].ptype);
+    ASSERT_EQ(PIL_TYPE_INT32, table.field_dict.dict[table.field_dict.Find("INFO:NS")].ptype);
+    ASSERT_EQ(PIL_CSTORE_COLUMN, table.field_dict.dict[table.field_dict.Find("INFO:NS")].cstore);
+    ASSERT_EQ(PIL_TYPE_UINT8, table.field_dict.dict[table.field_dict.Find("INFO:DB")].ptype);
+    ASSERT_EQ(PIL_CSTORE_TENSOR, table.field_dict.dict[table.field_dict.Find("INFO:XX")].cstore);
+
+    const int32_t* ns = reinterpret_cast<const int32_t*>(table.GetBatchColumnSet("INFO:NS")->columns[0]->mutable_data());
+    ASSERT_EQ(n_samples, ns[1234]);
+    std::shared_ptr<ColumnSet> ac = table.GetBatchColumnSet("INFO:AC");
+    const uint32_t* ac_offsets = reinterpret_cast<const uint32_t*>(ac->columns[0]->mutable_data());
+    const int32_t* ac_values = reinterpret_cast<const int32_t*>(ac->columns[1]->mutable_data());
+    ASSERT_EQ(1234 % 7, ac_values[ac_offsets[1234]]);
+    ASSERT_EQ(2, ac_offsets[n_sites + 1] - ac_offsets[n_sites]);
+    ASSERT_EQ(2, ac_values[ac_offsets[n_sites] + 1]);
+    std::shared_ptr<ColumnSet> af = table.GetBatchColumnSet("INFO:AF");
+    const uint32_t* af_offsets = reinterpret_cast<const uint32_t*>(af->columns[0]->mutable_data());
+    ASSERT_TRUE(std::isnan(reinterpret_cast<const float*>(af->columns[1]->mutable_data())[af_offsets[n_sites]]));
+
+    // Biallelic diploid sites are packed with 2 bits per haplotype.
+    std::shared_ptr<ColumnSet> gt = table.GetBatchColumnSet("GT");
+    const uint32_t* gt_offsets = reinterpret_cast<const uint32_t*>(gt->columns[0]->mutable_data());
+    const uint8_t* gt_data = gt->columns[1]->mutable_data();
+    for(uint32_t i = 0; i < n_sites; i += 97) {
+        ASSERT_EQ((n_samples + 1) / 2, gt_offsets[i + 1] - gt_offsets[i]);
+        for(uint32_t s = 0; s < n_samples; ++s) {
+            ASSERT_EQ((s + i) % 2, VcfTestHaplotype(gt_data + gt_offsets[i], 2 * s)) << i << " " << s;
+            ASSERT_EQ((s * i) % 2, VcfTestHaplotype(gt_data + gt_offsets[i], 2 * s + 1));
+        }
+    }
+    const uint8_t* phased = table.GetBatchColumnSet("GT_PHASED")->columns[0]->mutable_data();
+    ASSERT_EQ(1, phased[0]);
+
+    // Multi-allelic sites store allele indices.
+    ASSERT_EQ(0, gt_offsets[n_sites + 1] - gt_offsets[n_sites]);
+    std::shared_ptr<ColumnSet> alleles = table.GetBatchColumnSet("GT_ALLELES");
+    const uint32_t* allele_offsets = reinterpret_cast<const uint32_t*>(alleles->columns[0]->mutable_data());
+    const int16_t* allele_values = reinterpret_cast<const int16_t*>(alleles->columns[1]->mutable_data()) + allele_offsets[n_sites];
+    ASSERT_EQ(2 * n_samples, allele_offsets[n_sites + 1] - allele_offsets[n_sites]);
+    ASSERT_EQ(PIL_VCF_ALLELE_MISSING, allele_values[0]);
+    ASSERT_EQ(2, allele_values[2]);
+    ASSERT_EQ(1, allele_values[5]);
+    ASSERT_EQ(0, phased[n_sites]);
+
+    // Samples with a lower ploidy are padded and mixed phasing is kept per sample.
+    const uint8_t* last = gt_data + gt_offsets[n_sites + 1];
+    ASSERT_EQ(PIL_VCF_GT_ALT, VcfTestHaplotype(last, 0));
+    ASSERT_EQ(PIL_VCF_GT_EOV, VcfTestHaplotype(last, 1));
+    ASSERT_EQ(PIL_VCF_GT_REF, VcfTestHaplotype(last, 2));
+    ASSERT_EQ(2, phased[n_sites + 1]);
+    std::shared_ptr<ColumnSet> phase = table.GetBatchColumnSet("GT_PHASE");
+    const uint8_t* phase_bits = phase->columns[1]->mutable_data() + reinterpret_cast<const uint32_t*>(phase->columns[0]->mutable_data())[n_sites + 1];
+    ASSERT_EQ(0xFC, phase_bits[0]);
+    table.out_stream.close();
+
+    // Malformed genotypes are rejected.
+    {
+        std::ofstream f(vcf_path, std::ios::binary);
+        f << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tS0\tS1\n";
+        f << "20\t1\t.\tA\tG\t.\tPASS\t.\tGT\t0|x\t0|0\n";
+    }
+    TableConstructor table2;
+    ASSERT_EQ(-3, importer.Import(vcf_path, table2));
+
+    std::remove(vcf_path.c_str());
+    std::remove(path.c_str());
+}
+
+}
+
+#endif /* IMPORTERS_VCF_IMPORTER_TEST_H_ */
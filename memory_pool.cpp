@@ -3,6 +3,14 @@
 #include <cerrno>
 #include <cassert>
 #include <cstring>
+#include <limits>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 
 namespace pil {
 
@@ -108,6 +116,23 @@ int ReallocateAligned(int64_t old_size, int64_t new_size, uint8_t** ptr) {
 
 }  // namespace
 
+bool MemoryBudget::Reserve(int64_t size) {
+    int64_t used = bytes_used_.load();
+    do {
+        const int64_t l = limit_.load();
+        if(l != 0 && size > 0 && used + size > l) return false;
+    } while(!bytes_used_.compare_exchange_weak(used, used + size));
+
+    int64_t max = max_memory_.load();
+    while(used + size > max && !max_memory_.compare_exchange_weak(max, used + size)) {}
+    return true;
+}
+
+MemoryBudget* default_memory_budget() {
+    static MemoryBudget default_memory_budget_;
+    return &default_memory_budget_;
+}
+
 MemoryPool::MemoryPool() {}
 
 MemoryPool::~MemoryPool() {}
@@ -122,18 +147,28 @@ public:
     ~DefaultMemoryPool() override {}
 
     int Allocate(int64_t size, uint8_t** out) override {
+        if(default_memory_budget()->Reserve(size) == false) return -1;
         int status = AllocateAligned(size, out);
-        if(status != 1) return -1;
+        if(status != 1) {
+            default_memory_budget()->Release(size);
+            return -1;
+        }
 
         stats_.UpdateAllocatedBytes(size);
         return 1;
     }
 
     int Reallocate(int64_t old_size, int64_t new_size, uint8_t** ptr) override {
+        const int64_t diff = new_size - old_size;
+        if(diff > 0 && default_memory_budget()->Reserve(diff) == false) return -1;
         int status = ReallocateAligned(old_size, new_size, ptr);
-        if(status != 1) return -1;
+        if(status != 1) {
+            if(diff > 0) default_memory_budget()->Release(diff);
+            return -1;
+        }
+        if(diff < 0) default_memory_budget()->Release(-diff);
 
-        stats_.UpdateAllocatedBytes(new_size - old_size);
+        stats_.UpdateAllocatedBytes(diff);
         return 1;
     }
 
@@ -143,6 +178,7 @@ public:
         DeallocateAligned(buffer, size);
 
         stats_.UpdateAllocatedBytes(-size);
+        default_memory_budget()->Release(size);
     }
 
     int64_t max_memory() const override { return stats_.max_memory(); }
@@ -160,5 +196,402 @@ MemoryPool* default_memory_pool() {
     return &default_memory_pool_;
 }
 
+// Thread-local MemoryPool implementation
+
+// Budget is reserved by thread-local pools in multiples of this size.
+constexpr int64_t kBudgetQuantum = 1 << 20;
+
+// The pool is shared by its thread and every live allocation: it is deleted
+// by whichever drops the last reference, such that buffers can outlive the
+// thread and be released from any other thread.
+class ThreadLocalMemoryPool : public MemoryPool {
+public:
+    explicit ThreadLocalMemoryPool(MemoryBudget* budget) : budget_(budget), used_(0), reserved_(0), refs_(1), orphaned_(false) {}
+    ~ThreadLocalMemoryPool() override { budget_->Release(reserved_.load()); }
+
+    int Allocate(int64_t size, uint8_t** out) override {
+        if(Charge(size) == false) return -1;
+        int status = AllocateAligned(size, out);
+        if(status != 1) {
+            Uncharge(size);
+            return -1;
+        }
+
+        refs_.fetch_add(1);
+        stats_.UpdateAllocatedBytes(size);
+        return 1;
+    }
+
+    int Reallocate(int64_t old_size, int64_t new_size, uint8_t** ptr) override {
+        const int64_t diff = new_size - old_size;
+        if(diff > 0 && Charge(diff) == false) return -1;
+        int status = ReallocateAligned(old_size, new_size, ptr);
+        if(status != 1) {
+            if(diff > 0) Uncharge(diff);
+            return -1;
+        }
+        if(diff < 0) Uncharge(-diff);
+
+        stats_.UpdateAllocatedBytes(diff);
+        return 1;
+    }
+
+    void Free(uint8_t* buffer, int64_t size) override {
+        DeallocateAligned(buffer, size);
+
+        stats_.UpdateAllocatedBytes(-size);
+        Uncharge(size);
+        Unref();
+    }
+
+    int64_t bytes_allocated() const override { return stats_.bytes_allocated(); }
+    int64_t max_memory() const override { return stats_.max_memory(); }
+
+    // Called when the owning thread exits: return the reservation that is
+    // not backing live allocations and drop the reference of the thread.
+    void Orphan() {
+        orphaned_ = true;
+        Uncharge(0);
+        Unref();
+    }
+
+private:
+    // Charge the local counter and reserve another quantum of the budget
+    // once the local reservation is used up.
+    bool Charge(int64_t size) {
+        const int64_t used = used_.fetch_add(size) + size;
+        int64_t reserved = reserved_.load();
+        while(used > reserved) {
+            const int64_t q = (used - reserved + kBudgetQuantum - 1) / kBudgetQuantum * kBudgetQuantum;
+            if(budget_->Reserve(q) == false) {
+                used_.fetch_sub(size);
+                return false;
+            }
+            reserved = reserved_.fetch_add(q) + q;
+        }
+        return true;
+    }
+
+    // Return unused quanta to the budget while keeping one in reserve. Pools
+    // of exited threads keep no reserve.
+    void Uncharge(int64_t size) {
+        const int64_t used = used_.fetch_sub(size) - size;
+        int64_t reserved = reserved_.load();
+        const int64_t keep = orphaned_.load() ? 0 : kBudgetQuantum;
+        if(reserved - used >= keep + kBudgetQuantum) {
+            const int64_t q = (reserved - used - keep) / kBudgetQuantum * kBudgetQuantum;
+            if(reserved_.compare_exchange_strong(reserved, reserved - q)) budget_->Release(q);
+        }
+    }
+
+    void Unref() {
+        if(refs_.fetch_sub(1) == 1) delete this;
+    }
+
+    MemoryBudget* budget_;
+    std::atomic<int64_t> used_; // Bytes allocated from this pool.
+    std::atomic<int64_t> reserved_; // Bytes reserved from the budget.
+    std::atomic<int64_t> refs_; // Live allocations plus one while the thread is running.
+    std::atomic<bool> orphaned_; // Set once the thread has exited.
+    internal::MemoryPoolStats stats_;
+};
+
+// Hands the pool over to its allocations when the thread exits.
+struct ThreadLocalMemoryPoolHolder {
+    ThreadLocalMemoryPoolHolder() : pool(new ThreadLocalMemoryPool(default_memory_budget())) {}
+    ~ThreadLocalMemoryPoolHolder() { pool->Orphan(); }
+
+    ThreadLocalMemoryPool* pool;
+};
+
+MemoryPool* thread_local_memory_pool() {
+    static thread_local ThreadLocalMemoryPoolHolder holder;
+    return holder.pool;
+}
+
+// Budget MemoryPool implementation
+
+int BudgetMemoryPool::Allocate(int64_t size, uint8_t** out) {
+    if(budget_ != nullptr && budget_->Reserve(size) == false) return -1;
+    if(parent_->Allocate(size, out) != 1) {
+        if(budget_ != nullptr) budget_->Release(size);
+        return -1;
+    }
+    stats_.UpdateAllocatedBytes(size);
+    return 1;
+}
+
+int BudgetMemoryPool::Reallocate(int64_t old_size, int64_t new_size, uint8_t** ptr) {
+    const int64_t diff = new_size - old_size;
+    if(budget_ != nullptr && diff > 0 && budget_->Reserve(diff) == false) return -1;
+    if(parent_->Reallocate(old_size, new_size, ptr) != 1) {
+        if(budget_ != nullptr && diff > 0) budget_->Release(diff);
+        return -1;
+    }
+    if(budget_ != nullptr && diff < 0) budget_->Release(-diff);
+    stats_.UpdateAllocatedBytes(diff);
+    return 1;
+}
+
+void BudgetMemoryPool::Free(uint8_t* buffer, int64_t size) {
+    parent_->Free(buffer, size);
+    if(budget_ != nullptr) budget_->Release(size);
+    stats_.UpdateAllocatedBytes(-size);
+}
+
+// Huge page MemoryPool implementation
+
+namespace {
+
+// Size and alignment of transparent huge pages on x86-64 and arm64.
+constexpr int64_t kHugePageSize = 2 * 1024 * 1024;
+
+inline int64_t RoundUpToHugePage(int64_t size) {
+    return((size + kHugePageSize - 1) / kHugePageSize * kHugePageSize);
+}
+
+}  // namespace
+
+HugePageMemoryPool::HugePageMemoryPool(MemoryPool* parent, int64_t threshold, bool use_hugetlb, bool numa_local) :
+    parent_(parent), threshold_(std::max<int64_t>(kAlignment, threshold)),
+    use_hugetlb_(use_hugetlb), numa_local_(numa_local), bytes_mapped_(0)
+{
+#if !defined(__linux__)
+    // Every allocation is passed through to the parent pool.
+    threshold_ = std::numeric_limits<int64_t>::max();
+#endif
+}
+
+int HugePageMemoryPool::Map(int64_t size, uint8_t** out) {
+#if defined(__linux__)
+    const int64_t length = RoundUpToHugePage(size);
+    void* ptr = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    // Reserved huge pages are already aligned. This fails unless the
+    // administrator has set aside pages in vm.nr_hugepages.
+    if(use_hugetlb_)
+        ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if(ptr == MAP_FAILED) {
+        // Over-map by one huge page and trim the ends so that the mapping is
+        // aligned and can be backed by transparent huge pages.
+        uint8_t* raw = reinterpret_cast<uint8_t*>(mmap(nullptr, length + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if(raw == MAP_FAILED) return -1;
+        const uintptr_t addr = reinterpret_cast<uintptr_t>(raw);
+        const int64_t head = (kHugePageSize - (addr % kHugePageSize)) % kHugePageSize;
+        if(head) munmap(raw, head);
+        munmap(raw + head + length, kHugePageSize - head);
+        ptr = raw + head;
+#if defined(MADV_HUGEPAGE)
+        madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+    }
+
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+    // Prefer the NUMA node of the calling thread. The policy is a hint: it
+    // is ignored on single-node machines and in restricted containers.
+    if(numa_local_) {
+        unsigned int cpu = 0, node = 0;
+        if(syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 && node < 64) {
+            const unsigned long mask = 1UL << node;
+            const int mpol_preferred = 1;
+            syscall(SYS_mbind, ptr, length, mpol_preferred, &mask, 64, 0);
+        }
+    }
+#endif
+
+    bytes_mapped_ += length;
+    *out = reinterpret_cast<uint8_t*>(ptr);
+    return 1;
+#else
+    return -1;
+#endif
+}
+
+void HugePageMemoryPool::Unmap(uint8_t* ptr, int64_t size) {
+#if defined(__linux__)
+    const int64_t length = RoundUpToHugePage(size);
+    munmap(ptr, length);
+    bytes_mapped_ -= length;
+#endif
+}
+
+int HugePageMemoryPool::Allocate(int64_t size, uint8_t** out) {
+    if(size < 0) return -1;
+    if(IsMapped(size) == false) {
+        int status = parent_->Allocate(size, out);
+        if(status == 1) stats_.UpdateAllocatedBytes(size);
+        return status;
+    }
+
+    if(default_memory_budget()->Reserve(size) == false) return -1;
+    if(Map(size, out) != 1) {
+        default_memory_budget()->Release(size);
+        return -1;
+    }
+    stats_.UpdateAllocatedBytes(size);
+    return 1;
+}
+
+int HugePageMemoryPool::Reallocate(int64_t old_size, int64_t new_size, uint8_t** ptr) {
+    if(new_size < 0) return -1;
+    if(IsMapped(old_size) == false && IsMapped(new_size) == false) {
+        int status = parent_->Reallocate(old_size, new_size, ptr);
+        if(status == 1) stats_.UpdateAllocatedBytes(new_size - old_size);
+        return status;
+    }
+
+    // Mappings are rounded up to whole huge pages and can be resized in
+    // place while the rounded length is unchanged.
+    const int64_t diff = new_size - old_size;
+    if(IsMapped(old_size) && IsMapped(new_size) && RoundUpToHugePage(old_size) == RoundUpToHugePage(new_size)) {
+        if(diff > 0 && default_memory_budget()->Reserve(diff) == false) return -1;
+        if(diff < 0) default_memory_budget()->Release(-diff);
+        stats_.UpdateAllocatedBytes(diff);
+        return 1;
+    }
+
+    uint8_t* out = nullptr;
+    if(Allocate(new_size, &out) != 1) return -1;
+    memcpy(out, *ptr, static_cast<size_t>(std::min(old_size, new_size)));
+    Free(*ptr, old_size);
+    *ptr = out;
+    return 1;
+}
+
+void HugePageMemoryPool::Free(uint8_t* buffer, int64_t size) {
+    if(IsMapped(size) == false) {
+        parent_->Free(buffer, size);
+    } else {
+        Unmap(buffer, size);
+        default_memory_budget()->Release(size);
+    }
+    stats_.UpdateAllocatedBytes(-size);
+}
+
+MemoryPool* huge_page_memory_pool() {
+    static HugePageMemoryPool huge_page_memory_pool_;
+    return &huge_page_memory_pool_;
+}
+
+// Arena MemoryPool implementation
+
+namespace {
+
+inline int64_t RoundUpToAlignment(int64_t size) {
+    return((size + kAlignment - 1) / kAlignment * kAlignment);
+}
+
+}  // namespace
+
+ArenaMemoryPool::ArenaMemoryPool(int64_t chunk_size, MemoryPool* parent) :
+    parent_(parent), chunk_size_(RoundUpToAlignment(std::max<int64_t>(kAlignment, chunk_size))),
+    bytes_reserved_(0), current_(0), offset_(0), last_(nullptr)
+{
+}
+
+ArenaMemoryPool::~ArenaMemoryPool() {
+    for(size_t i = 0; i < chunks_.size(); ++i)
+        parent_->Free(chunks_[i].data, chunks_[i].size);
+}
+
+int ArenaMemoryPool::NextChunk(int64_t size) {
+    // Reuse a retained chunk if one is large enough. Skipped chunks are kept
+    // after the current chunk for subsequent allocations.
+    const size_t next = chunks_.empty() ? 0 : current_ + 1;
+    size_t i = next;
+    for(; i < chunks_.size(); ++i) {
+        if(chunks_[i].size >= size) break;
+    }
+
+    if(i == chunks_.size()) {
+        Chunk chunk;
+        chunk.size = std::max(chunk_size_, size);
+        if(parent_->Allocate(chunk.size, &chunk.data) != 1) return(-1);
+        chunks_.push_back(chunk);
+        bytes_reserved_ += chunk.size;
+    }
+
+    std::swap(chunks_[next], chunks_[i]);
+    current_ = next;
+    offset_ = 0;
+    return(1);
+}
+
+int ArenaMemoryPool::Allocate(int64_t size, uint8_t** out) {
+    if(size < 0) return(-1);
+    if(size == 0) {
+        *out = zero_size_area;
+        return(1);
+    }
+
+    const int64_t n = RoundUpToAlignment(size);
+    if(chunks_.empty() || offset_ + n > chunks_[current_].size) {
+        if(NextChunk(n) != 1) return(-1);
+    }
+
+    *out = chunks_[current_].data + offset_;
+    offset_ += n;
+    last_ = *out;
+    stats_.UpdateAllocatedBytes(n);
+    return(1);
+}
+
+int ArenaMemoryPool::Reallocate(int64_t old_size, int64_t new_size, uint8_t** ptr) {
+    if(*ptr == zero_size_area) {
+        assert(old_size == 0);
+        return(Allocate(new_size, ptr));
+    }
+
+    if(new_size == 0) {
+        *ptr = zero_size_area;
+        return(1);
+    }
+
+    const int64_t n_old = RoundUpToAlignment(old_size);
+    const int64_t n_new = RoundUpToAlignment(new_size);
+
+    // The most recent allocation is resized in place if it fits.
+    if(*ptr == last_) {
+        const int64_t start = last_ - chunks_[current_].data;
+        if(start + n_new <= chunks_[current_].size) {
+            offset_ = start + n_new;
+            stats_.UpdateAllocatedBytes(n_new - n_old);
+            return(1);
+        }
+    }
+
+    // Shrinking never moves the data.
+    if(n_new <= n_old) return(1);
+
+    uint8_t* out = nullptr;
+    if(Allocate(new_size, &out) != 1) return(-1);
+    memcpy(out, *ptr, static_cast<size_t>(std::min(new_size, old_size)));
+    *ptr = out;
+    return(1);
+}
+
+void ArenaMemoryPool::Free(uint8_t* buffer, int64_t size) {
+    // Memory is released by Reset().
+}
+
+void ArenaMemoryPool::ReleaseChunks() {
+    assert(bytes_allocated() == 0);
+    for(size_t i = 0; i < chunks_.size(); ++i)
+        parent_->Free(chunks_[i].data, chunks_[i].size);
+    chunks_.clear();
+    bytes_reserved_ = 0;
+    current_ = 0;
+    offset_ = 0;
+    last_ = nullptr;
+}
+
+void ArenaMemoryPool::Reset() {
+    current_ = 0;
+    offset_ = 0;
+    last_ = nullptr;
+    stats_.UpdateAllocatedBytes(-stats_.bytes_allocated());
+}
+
 
 }
@@ -2,9 +2,12 @@
 #define MEMORY_POOL_H_
 
 #include <cstdint>
+#include <cassert>
 #include <algorithm>
 #include <memory>
 #include <atomic>
+#include <new>
+#include <vector>
 
 #include "status.h"
 
@@ -38,6 +41,43 @@ protected:
 
 }  // namespace internal
 
+/// Process-wide memory budget with an optional hard limit. Memory pools
+/// charge their allocations to a budget and allocations that would exceed
+/// the limit fail. The counters are atomic.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(int64_t limit = 0) : limit_(limit), bytes_used_(0), max_memory_(0) {}
+
+    /// Charge size bytes to the budget.
+    ///
+    /// \return FALSE without charging anything if the limit would be exceeded.
+    bool Reserve(int64_t size);
+    void Release(int64_t size) { bytes_used_.fetch_sub(size); }
+
+    int64_t bytes_used() const { return bytes_used_.load(); }
+    int64_t max_memory() const { return max_memory_.load(); }
+
+    /// Hard limit in bytes or 0 if unlimited.
+    int64_t limit() const { return limit_.load(); }
+    void set_limit(int64_t limit) { limit_ = limit; }
+
+    /// Returns TRUE if a limit is set and more than the given fraction of it
+    /// is in use.
+    bool IsAbove(double fraction) const {
+        const int64_t l = limit();
+        return(l != 0 && bytes_used() > fraction * l);
+    }
+
+private:
+    std::atomic<int64_t> limit_;
+    std::atomic<int64_t> bytes_used_;
+    std::atomic<int64_t> max_memory_;
+};
+
+/// Return the process-wide memory budget charged by default_memory_pool()
+/// and thread_local_memory_pool().
+MemoryBudget* default_memory_budget();
+
 class MemoryPool {
 public:
     virtual ~MemoryPool();
@@ -81,6 +121,186 @@ protected:
 /// Return the process-wide default memory pool.
 MemoryPool* default_memory_pool();
 
+/// Return the memory pool of the calling thread.
+///
+/// Allocations are charged to default_memory_budget() in large quanta such
+/// that threads rarely touch the process-wide counters. Buffers may outlive
+/// their thread and be released from any other thread: once the thread has
+/// exited, the unused reservation is returned to the budget and the pool is
+/// destroyed with its last buffer.
+MemoryPool* thread_local_memory_pool();
+
+/// STL allocator drawing from a MemoryPool such that containers are charged
+/// to its budget. Without an explicit pool, the pool is that of the thread
+/// making the first allocation: containers filled by worker threads are
+/// placed in the memory of the worker.
+template <class T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    PoolAllocator() : pool_(nullptr) {}
+    explicit PoolAllocator(MemoryPool* pool) : pool_(pool) {}
+    template <class U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool_(other.pool()) {}
+
+    T* allocate(std::size_t n) {
+        if(pool_ == nullptr) pool_ = thread_local_memory_pool();
+        uint8_t* out = nullptr;
+        if(pool_->Allocate(n * sizeof(T), &out) != 1) throw std::bad_alloc();
+        return(reinterpret_cast<T*>(out));
+    }
+
+    void deallocate(T* p, std::size_t n) { pool_->Free(reinterpret_cast<uint8_t*>(p), n * sizeof(T)); }
+
+    MemoryPool* pool() const { return(pool_); }
+
+private:
+    MemoryPool* pool_;
+};
+
+template <class T, class U>
+bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) { return(a.pool() == b.pool()); }
+template <class T, class U>
+bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) { return(a.pool() != b.pool()); }
+
+/// Byte vector drawn from a MemoryPool (see PoolAllocator).
+typedef std::vector<uint8_t, PoolAllocator<uint8_t> > PoolBytes;
+
+/// MemoryPool charging the allocations of a parent pool to a MemoryBudget.
+///
+/// The parent pool still charges its own budget, usually the process-wide
+/// default_memory_budget(), such that a job can be capped by a budget of its
+/// own while sharing the process-wide pools. Without a budget, allocations
+/// are passed through to the parent.
+class BudgetMemoryPool : public MemoryPool {
+public:
+    explicit BudgetMemoryPool(MemoryPool* parent = default_memory_pool(), MemoryBudget* budget = nullptr) :
+        parent_(parent), budget_(budget) {}
+    ~BudgetMemoryPool() override {}
+
+    int Allocate(int64_t size, uint8_t** out) override;
+    int Reallocate(int64_t old_size, int64_t new_size, uint8_t** ptr) override;
+    void Free(uint8_t* buffer, int64_t size) override;
+
+    int64_t bytes_allocated() const override { return stats_.bytes_allocated(); }
+    int64_t max_memory() const override { return stats_.max_memory(); }
+
+    /// Change the parent pool or the budget. Requires that every allocation
+    /// is released first.
+    void SetParent(MemoryPool* parent) { assert(bytes_allocated() == 0); parent_ = parent; }
+    void SetBudget(MemoryBudget* budget) { assert(bytes_allocated() == 0); budget_ = budget; }
+
+    MemoryPool* parent() const { return parent_; }
+    MemoryBudget* budget() const { return budget_; }
+
+private:
+    MemoryPool* parent_;
+    MemoryBudget* budget_;
+    internal::MemoryPoolStats stats_;
+};
+
+/// MemoryPool backing large allocations with huge pages.
+///
+/// Allocations of at least `threshold` bytes are mapped with mmap() aligned
+/// to 2 MiB and advised with MADV_HUGEPAGE, or taken from the hugetlbfs pool
+/// with MAP_HUGETLB if requested. Mappings can be bound to the NUMA node of
+/// the allocating thread. Each step falls back gracefully if unavailable.
+/// Smaller allocations, and every allocation on platforms other than Linux,
+/// use the parent pool.
+class HugePageMemoryPool : public MemoryPool {
+public:
+    explicit HugePageMemoryPool(MemoryPool* parent = default_memory_pool(),
+                                int64_t threshold = 2 * 1024 * 1024,
+                                bool use_hugetlb = false,
+                                bool numa_local = true);
+    ~HugePageMemoryPool() override {}
+
+    int Allocate(int64_t size, uint8_t** out) override;
+    int Reallocate(int64_t old_size, int64_t new_size, uint8_t** ptr) override;
+    void Free(uint8_t* buffer, int64_t size) override;
+
+    int64_t bytes_allocated() const override { return stats_.bytes_allocated(); }
+    int64_t max_memory() const override { return stats_.max_memory(); }
+
+    /// The number of bytes currently mapped by this pool.
+    int64_t bytes_mapped() const { return bytes_mapped_.load(); }
+
+private:
+    bool IsMapped(int64_t size) const { return size >= threshold_; }
+    int Map(int64_t size, uint8_t** out);
+    void Unmap(uint8_t* ptr, int64_t size);
+
+    MemoryPool* parent_;
+    int64_t threshold_;
+    bool use_hugetlb_;
+    bool numa_local_;
+    std::atomic<int64_t> bytes_mapped_;
+    internal::MemoryPoolStats stats_;
+};
+
+/// Return the process-wide huge page memory pool with default options.
+MemoryPool* huge_page_memory_pool();
+
+/// MemoryPool scoped to a single RecordBatch.
+///
+/// Allocations are bump-allocated from large 64-byte aligned chunks that are
+/// requested from a parent pool. The most recent allocation is grown in place
+/// and Free() is a no-op: every allocation is released at once by Reset(),
+/// which retains the chunks for subsequent batches. Not thread-safe.
+class ArenaMemoryPool : public MemoryPool {
+public:
+    explicit ArenaMemoryPool(int64_t chunk_size = 4 * 1024 * 1024, MemoryPool* parent = default_memory_pool());
+    ~ArenaMemoryPool() override;
+    ArenaMemoryPool(const ArenaMemoryPool&) = delete;
+    ArenaMemoryPool& operator=(const ArenaMemoryPool&) = delete;
+
+    int Allocate(int64_t size, uint8_t** out) override;
+    int Reallocate(int64_t old_size, int64_t new_size, uint8_t** ptr) override;
+    void Free(uint8_t* buffer, int64_t size) override;
+
+    /// Release every allocation in O(1). Buffers allocated from this pool
+    /// must not be used afterwards.
+    void Reset();
+
+    /// Return the retained chunks to the parent pool. Requires that every
+    /// allocation is released by Reset() first.
+    void ReleaseChunks();
+
+    /// Release the retained chunks and take subsequent chunks from the
+    /// given pool. Requires that every allocation is released first.
+    void SetParent(MemoryPool* parent) {
+        ReleaseChunks();
+        parent_ = parent;
+    }
+
+    /// The number of bytes handed out since the last Reset().
+    int64_t bytes_allocated() const override { return stats_.bytes_allocated(); }
+    int64_t max_memory() const override { return stats_.max_memory(); }
+
+    /// The number of bytes held in chunks from the parent pool.
+    int64_t bytes_reserved() const { return bytes_reserved_; }
+    size_t num_chunks() const { return chunks_.size(); }
+
+private:
+    // Make the next chunk with room for at least size bytes current.
+    int NextChunk(int64_t size);
+
+    struct Chunk {
+        uint8_t* data;
+        int64_t size;
+    };
+
+    MemoryPool* parent_;
+    int64_t chunk_size_;
+    int64_t bytes_reserved_;
+    std::vector<Chunk> chunks_;
+    size_t current_; // Chunk allocations are taken from.
+    int64_t offset_; // Offset of the first free byte in the current chunk.
+    uint8_t* last_; // Most recent allocation.
+    internal::MemoryPoolStats stats_;
+};
+
 }
 
 
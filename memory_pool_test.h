@@ -0,0 +1,175 @@
+#ifndef MEMORY_POOL_TEST_H_
+#define MEMORY_POOL_TEST_H_
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "memory_pool.h"
+#include "buffer_builder.h"
+
+namespace pil {
+
+TEST(MemoryPoolTests, ArenaBumpAndGrowInPlace) {
+    ArenaMemoryPool pool(4096);
+
+    uint8_t* a = nullptr;
+    uint8_t* b = nullptr;
+    ASSERT_EQ(1, pool.Allocate(100, &a));
+    ASSERT_EQ(1, pool.Allocate(10, &b));
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(a) % 64);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(b) % 64);
+    ASSERT_EQ(a + 128, b);
+    ASSERT_EQ(1, pool.num_chunks());
+
+    // The most recent allocation grows in place.
+    memset(b, 7, 10);
+    uint8_t* b_old = b;
+    ASSERT_EQ(1, pool.Reallocate(10, 1000, &b));
+    ASSERT_EQ(b_old, b);
+
+    // Other allocations move and keep their data.
+    memset(a, 3, 100);
+    ASSERT_EQ(1, pool.Reallocate(100, 500, &a));
+    ASSERT_NE(b, a);
+    for(int i = 0; i < 100; ++i) ASSERT_EQ(3, a[i]);
+
+    // Allocations larger than a chunk get a chunk of their own.
+    uint8_t* c = nullptr;
+    ASSERT_EQ(1, pool.Allocate(10000, &c));
+    ASSERT_EQ(2, pool.num_chunks());
+    const int64_t reserved = pool.bytes_reserved();
+    ASSERT_GT(pool.bytes_allocated(), 10000);
+
+    // Chunks are recycled after a reset: repeating the same allocations
+    // does not request memory from the parent pool.
+    pool.Reset();
+    ASSERT_EQ(0, pool.bytes_allocated());
+    ASSERT_EQ(1, pool.Allocate(100, &a));
+    ASSERT_EQ(1, pool.Allocate(10, &b));
+    ASSERT_EQ(1, pool.Reallocate(10, 1000, &b));
+    ASSERT_EQ(1, pool.Reallocate(100, 500, &a));
+    ASSERT_EQ(1, pool.Allocate(10000, &c));
+    ASSERT_EQ(2, pool.num_chunks());
+    ASSERT_EQ(reserved, pool.bytes_reserved());
+}
+
+TEST(MemoryPoolTests, ArenaBufferBuilder) {
+    ArenaMemoryPool pool(1 << 16);
+    for(int batch = 0; batch < 3; ++batch) {
+        {
+            BufferBuilder builder(&pool);
+            for(uint32_t i = 0; i < 20000; ++i) ASSERT_EQ(1, builder.Append(&i, sizeof(uint32_t)));
+            const uint32_t* vals = reinterpret_cast<const uint32_t*>(builder.mutable_data());
+            for(uint32_t i = 0; i < 20000; ++i) ASSERT_EQ(i, vals[i]);
+        }
+        pool.Reset();
+    }
+    // A single growing buffer never leaves the first chunks.
+    ASSERT_EQ(2, pool.num_chunks());
+}
+
+TEST(MemoryPoolTests, HugePagePool) {
+    HugePageMemoryPool pool(default_memory_pool(), 1 << 20);
+    const int64_t parent_allocated = default_memory_pool()->bytes_allocated();
+
+    // Small allocations are served by the parent pool.
+    uint8_t* small = nullptr;
+    ASSERT_EQ(1, pool.Allocate(1000, &small));
+    ASSERT_EQ(parent_allocated + 1000, default_memory_pool()->bytes_allocated());
+    ASSERT_EQ(0, pool.bytes_mapped());
+
+    // Large allocations are mapped separately.
+    uint8_t* large = nullptr;
+    ASSERT_EQ(1, pool.Allocate(3 << 20, &large));
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(large) % 64);
+    ASSERT_EQ(parent_allocated + 1000, default_memory_pool()->bytes_allocated());
+    ASSERT_EQ((3 << 20) + 1000, pool.bytes_allocated());
+    for(int i = 0; i < (3 << 20); ++i) large[i] = i & 255;
+
+    // Growing within the mapping keeps the address, beyond it the data.
+    uint8_t* large_old = large;
+    ASSERT_EQ(1, pool.Reallocate(3 << 20, (3 << 20) + 100, &large));
+    ASSERT_EQ(large_old, large);
+    ASSERT_EQ(1, pool.Reallocate((3 << 20) + 100, 9 << 20, &large));
+    for(int i = 0; i < (3 << 20); ++i) ASSERT_EQ(i & 255, large[i]);
+
+    // Crossing the threshold moves the data between the pools.
+    ASSERT_EQ(1, pool.Reallocate(1000, 2 << 20, &small));
+    ASSERT_EQ(parent_allocated, default_memory_pool()->bytes_allocated());
+    ASSERT_EQ(1, pool.Reallocate(2 << 20, 500, &small));
+    ASSERT_EQ(parent_allocated + 500, default_memory_pool()->bytes_allocated());
+
+    pool.Free(small, 500);
+    pool.Free(large, 9 << 20);
+    ASSERT_EQ(0, pool.bytes_allocated());
+    ASSERT_EQ(0, pool.bytes_mapped());
+    ASSERT_EQ(parent_allocated, default_memory_pool()->bytes_allocated());
+}
+
+TEST(MemoryPoolTests, MemoryBudgetLimit) {
+    MemoryBudget budget(1000);
+    ASSERT_EQ(true, budget.Reserve(600));
+    ASSERT_EQ(false, budget.Reserve(600));
+    ASSERT_EQ(600, budget.bytes_used());
+    ASSERT_EQ(false, budget.IsAbove(0.8));
+    ASSERT_EQ(true, budget.Reserve(300));
+    ASSERT_EQ(true, budget.IsAbove(0.8));
+    budget.Release(900);
+    ASSERT_EQ(0, budget.bytes_used());
+    ASSERT_EQ(900, budget.max_memory());
+
+    budget.set_limit(0);
+    ASSERT_EQ(true, budget.Reserve(1 << 30));
+    ASSERT_EQ(false, budget.IsAbove(0.8));
+}
+
+TEST(MemoryPoolTests, ThreadLocalPoolsRollUp) {
+    MemoryBudget* budget = default_memory_budget();
+    const int64_t used = budget->bytes_used();
+
+    std::vector<std::thread> threads;
+    std::atomic<int> n_ok(0);
+    for(int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([&n_ok, budget, used]() {
+            MemoryPool* pool = thread_local_memory_pool();
+            uint8_t* data = nullptr;
+            if(pool->Allocate(3 << 20, &data) != 1) return;
+            if(pool->Reallocate(3 << 20, 5 << 20, &data) != 1) return;
+            memset(data, 1, 5 << 20);
+            if(pool->bytes_allocated() != (5 << 20)) return;
+            if(budget->bytes_used() < used + (5 << 20)) return;
+            pool->Free(data, 5 << 20);
+            if(pool->bytes_allocated() != 0) return;
+            ++n_ok;
+        }));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    ASSERT_EQ(4, n_ok.load());
+
+    // Exited threads return their reservations.
+    ASSERT_LE(budget->bytes_used(), used);
+
+    // Buffers outlive their thread and release its pool when freed.
+    std::shared_ptr<ResizableBuffer> buffer;
+    std::thread([&buffer]() { AllocateResizableBuffer(thread_local_memory_pool(), 3 << 20, &buffer); }).join();
+    ASSERT_TRUE(buffer.get() != nullptr);
+    ASSERT_GE(budget->bytes_used(), used + (3 << 20));
+    ASSERT_LE(budget->bytes_used(), used + (4 << 20));
+    ASSERT_EQ(1, buffer->Resize(5 << 20));
+    buffer.reset();
+    ASSERT_LE(budget->bytes_used(), used);
+
+    // Allocations beyond the hard limit fail.
+    budget->set_limit(budget->bytes_used() + (8 << 20));
+    uint8_t* data = nullptr;
+    ASSERT_EQ(-1, default_memory_pool()->Allocate(16 << 20, &data));
+    ASSERT_EQ(-1, thread_local_memory_pool()->Allocate(16 << 20, &data));
+    ASSERT_EQ(1, default_memory_pool()->Allocate(1 << 20, &data));
+    default_memory_pool()->Free(data, 1 << 20);
+    budget->set_limit(0);
+}
+
+}
+
+#endif /* MEMORY_POOL_TEST_H_ */
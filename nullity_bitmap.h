@@ -0,0 +1,129 @@
+#ifndef NULLITY_BITMAP_H_
+#define NULLITY_BITMAP_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace pil {
+
+// Helpers for Nullity (validity) bitmaps: bit i of 32-bit word i / 32 is set
+// if record i is valid. Bits past the last record are expected to be unset.
+namespace NullityBitmap {
+
+// Number of bytes used by a bitmap of n_records bits.
+inline uint32_t Bytes(const uint32_t n_records) { return(((n_records + 31) / 32) * sizeof(uint32_t)); }
+
+inline uint32_t Popcount(const uint32_t v) {
+#if defined(__clang__) || defined(__GNUC__)
+    return(__builtin_popcount(v));
+#else
+    uint32_t c = v - ((v >> 1) & 0x55555555);
+    c = (c & 0x33333333) + ((c >> 2) & 0x33333333);
+    return((((c + (c >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+#endif
+}
+
+// Number of valid records among the first n_records.
+inline uint32_t CountValid(const uint32_t* bitmap, const uint32_t n_records) {
+    uint32_t n_valid = 0;
+    const uint32_t n_words = n_records / 32;
+    for(uint32_t i = 0; i < n_words; ++i) n_valid += Popcount(bitmap[i]);
+    if(n_records % 32) n_valid += Popcount(bitmap[n_words] & ((1u << (n_records % 32)) - 1));
+    return(n_valid);
+}
+
+/**<
+ * Invoke `f(record)` for every valid record among the first n_records.
+ * Words are skipped as a whole if every record in them is null.
+ */
+template <class F>
+inline void ForEachValid(const uint32_t* bitmap, const uint32_t n_records, F f) {
+    const uint32_t n_words = (n_records + 31) / 32;
+    for(uint32_t i = 0; i < n_words; ++i) {
+        uint32_t w = bitmap[i];
+        if(i + 1 == n_words && (n_records % 32)) w &= (1u << (n_records % 32)) - 1;
+        while(w) {
+            const uint32_t bit = __builtin_ctz(w);
+            f(i * 32 + bit);
+            w &= w - 1;
+        }
+    }
+}
+
+// Set the first n_records bits and clear the remaining bits of the last word.
+inline void Fill(uint32_t* bitmap, const uint32_t n_records, const bool valid) {
+    const uint32_t n_words = (n_records + 31) / 32;
+    for(uint32_t i = 0; i < n_words; ++i) bitmap[i] = valid ? 0xFFFFFFFF : 0;
+    if(valid && (n_records % 32)) bitmap[n_words - 1] = (1u << (n_records % 32)) - 1;
+}
+
+/**<
+ * Run-length encode the first n_records bits as varints of the alternating
+ * lengths of valid and null runs, starting with a (possibly empty) valid run.
+ * @param bitmap    Source bitmap.
+ * @param n_records Number of records.
+ * @param out       Destination for the run lengths.
+ * @param max_bytes Stop once the output exceeds this size.
+ * @return          Returns the number of bytes written or -1 if the output exceeds max_bytes.
+ */
+inline int EncodeRuns(const uint32_t* bitmap, const uint32_t n_records, std::vector<uint8_t>& out, const uint32_t max_bytes) {
+    out.clear();
+    bool state = true;
+    uint32_t i = 0;
+    while(i < n_records) {
+        // Length of the current run.
+        uint32_t j = i;
+        while(j < n_records) {
+            const uint32_t w = bitmap[j / 32] >> (j % 32);
+            const uint32_t run_w = state ? w : ~w;
+            // Skip whole words of the current state at once.
+            if((j % 32) == 0 && run_w == 0xFFFFFFFF) { j += 32; continue; }
+            if((run_w & 1) == 0) break;
+            ++j;
+        }
+        if(j > n_records) j = n_records;
+
+        uint32_t len = j - i;
+        while(len >= 128) { out.push_back((len & 127) | 128); len >>= 7; }
+        out.push_back(len);
+        if(out.size() > max_bytes) return(-1);
+
+        i = j;
+        state = !state;
+    }
+    return(out.size());
+}
+
+/**<
+ * Decode run lengths written by EncodeRuns into a bitmap of n_records bits.
+ * @param in        Source run lengths.
+ * @param n_in      Number of bytes in the source.
+ * @param n_records Number of records.
+ * @param bitmap    Destination bitmap with room for Bytes(n_records) bytes.
+ * @return          Returns 1 if successful or -1 if the runs are malformed.
+ */
+inline int DecodeRuns(const uint8_t* in, const uint32_t n_in, const uint32_t n_records, uint32_t* bitmap) {
+    Fill(bitmap, n_records, false);
+    bool state = true;
+    uint32_t i = 0, p = 0;
+    while(p < n_in) {
+        uint32_t len = 0, shift = 0;
+        while(p < n_in && (in[p] & 128)) { len |= (in[p++] & 127) << shift; shift += 7; }
+        if(p == n_in || shift > 28) return(-1);
+        len |= in[p++] << shift;
+        if(len > n_records - i) return(-1);
+
+        if(state) {
+            for(uint32_t j = i; j < i + len; ++j) bitmap[j / 32] |= 1u << (j % 32);
+        }
+        i += len;
+        state = !state;
+    }
+    return(i == n_records ? 1 : -1);
+}
+
+}
+
+}
+
+#endif /* NULLITY_BITMAP_H_ */
@@ -0,0 +1,50 @@
+#ifndef NULLITY_BITMAP_TEST_H_
+#define NULLITY_BITMAP_TEST_H_
+
+#include <random>
+#include <vector>
+
+#include "nullity_bitmap.h"
+#include <gtest/gtest.h>
+
+namespace pil {
+
+TEST(NullityBitmapTests, CountIterateRuns) {
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint32_t> distr(0, 99);
+
+    const uint32_t n_records = 5000 + distr(eng);
+    std::vector<uint32_t> bitmap(NullityBitmap::Bytes(n_records) / sizeof(uint32_t), 0);
+    std::vector<uint32_t> valid;
+    // Long runs of either state interleaved with random bits.
+    for(uint32_t i = 0; i < n_records; ++i) {
+        const bool v = (i / 1000) % 2 ? (distr(eng) < 50) : (i / 1000 == 0);
+        if(v) {
+            bitmap[i / 32] |= 1u << (i % 32);
+            valid.push_back(i);
+        }
+    }
+
+    ASSERT_EQ(valid.size(), NullityBitmap::CountValid(&bitmap[0], n_records));
+
+    std::vector<uint32_t> iterated;
+    NullityBitmap::ForEachValid(&bitmap[0], n_records, [&](const uint32_t i){ iterated.push_back(i); });
+    ASSERT_EQ(valid, iterated);
+
+    std::vector<uint8_t> runs;
+    ASSERT_GT(NullityBitmap::EncodeRuns(&bitmap[0], n_records, runs, n_records), 0);
+    std::vector<uint32_t> decoded(bitmap.size(), ~0u);
+    ASSERT_EQ(1, NullityBitmap::DecodeRuns(&runs[0], runs.size(), n_records, &decoded[0]));
+    ASSERT_EQ(bitmap, decoded);
+
+    // Truncated runs are rejected.
+    ASSERT_EQ(-1, NullityBitmap::DecodeRuns(&runs[0], runs.size() - 1, n_records, &decoded[0]));
+
+    // The size limit is honoured.
+    ASSERT_EQ(-1, NullityBitmap::EncodeRuns(&bitmap[0], n_records, runs, 16));
+}
+
+}
+
+#endif /* NULLITY_BITMAP_TEST_H_ */
@@ -47,12 +47,54 @@ typedef enum {
     PIL_COMPRESS_RC_BASES, /** Range codec with models for sequence bases **/
     PIL_COMPRESS_RC_ILLUMINA_NAME, /** Range codec models for Illumina sequence names **/
     PIL_ENCODE_DICT, /** Dictionary encoding **/
-    PIL_ENCODE_DELTA, /** Delta encoding of arithmetic progression - requires uint32_t **/
+    PIL_ENCODE_DELTA, /** Delta encoding of arithmetic progression - requires uint32_t or 64-bit integers **/
     PIL_ENCODE_DELTA_DELTA, /** Delta of deltas **/
-    PIL_ENCODE_BASES_2BIT /** 2-bit encoding of sequence bases with additional mask **/
+    PIL_ENCODE_BASES_2BIT, /** 2-bit encoding of sequence bases with additional mask **/
+    PIL_COMPRESS_REF_BASES, /** Range codec for sequence bases storing only differences to an external reference **/
+    PIL_ENCODE_CIGAR_NIBBLE, /** CIGAR operations as nibbles and lengths as varints in two range coded streams **/
+    PIL_ENCODE_PBWT /** Positional Burrows-Wheeler transform of 2-bit haplotype vectors with range coded run lengths **/
 } PIL_COMPRESSION_TYPE;
 
-const std::string PIL_TRANSFORM_TYPE_STRING[] = {"AUTO","ZSTD","NONE","RC_QUAL","RC_BASES","RC_ILLUMINA_NAME","DICT","DELTA","DELTA_DELTA","BASES_2BIT","CIGAR_NIBBLE"};
+/**<
+ * Returns TRUE if the provided transformation is a terminal compression codec
+ * or FALSE if it is an encoding that can be followed by other transformations.
+ * Values are appended to PIL_COMPRESSION_TYPE as they are added so codecs are
+ * no longer a contiguous range.
+ */
+inline bool IsCompressionCodec(const PIL_COMPRESSION_TYPE ctype) {
+    return((ctype >= PIL_COMPRESS_AUTO && ctype <= PIL_COMPRESS_RC_ILLUMINA_NAME) ||
+           ctype == PIL_COMPRESS_REF_BASES || ctype == PIL_ENCODE_CIGAR_NIBBLE ||
+           ctype == PIL_ENCODE_PBWT);
+}
+
+// Stored representation of a Nullity bitmap.
+typedef enum {
+    PIL_NULLITY_BITMAP, /** ZSTD-compressed bitmap **/
+    PIL_NULLITY_ALL_VALID, /** Every record is valid: nothing is stored **/
+    PIL_NULLITY_ALL_NULL, /** Every record is null: nothing is stored **/
+    PIL_NULLITY_RUNS /** ZSTD-compressed varint lengths of alternating valid and null runs **/
+} PIL_NULLITY_TYPE;
+
+// Criterion used by TableConstructor to finalize a RecordBatch. Per-field
+// byte limits (DictionaryFieldType::batch_bytes) apply with every policy.
+typedef enum {
+    PIL_FLUSH_RECORDS, /** Flush after `batch_size` records **/
+    PIL_FLUSH_BYTES, /** Flush once `batch_bytes` bytes are buffered **/
+    PIL_FLUSH_RECORDS_OR_BYTES /** Flush at whichever of the two limits is reached first **/
+} PIL_FLUSH_POLICY;
+
+// Checksum algorithm applied to uncompressed and transformed data. Digests
+// are stored in 16-byte fields: shorter digests are zero-padded.
+typedef enum {
+    PIL_CHECKSUM_NONE, /** No checksum: digests are zero **/
+    PIL_CHECKSUM_MD5, /** MD5 (OpenSSL) **/
+    PIL_CHECKSUM_CRC32C, /** CRC32C (Castagnoli) using the SSE4.2 instruction if available **/
+    PIL_CHECKSUM_XXH3 /** 64-bit XXH3 **/
+} PIL_CHECKSUM_TYPE;
+
+const std::string PIL_CHECKSUM_TYPE_STRING[] = {"NONE","MD5","CRC32C","XXH3"};
+
+const std::string PIL_TRANSFORM_TYPE_STRING[] = {"AUTO","ZSTD","NONE","RC_QUAL","RC_BASES","RC_ILLUMINA_NAME","DICT","DELTA","DELTA_DELTA","BASES_2BIT","REF_BASES","CIGAR_NIBBLE","PBWT"};
 
 }
 
@@ -19,7 +19,7 @@ public:
     RecordBuilderFields() :
         primitive_type(PIL_TYPE_UNKNOWN),
         array_primitive_type(PIL_TYPE_UNKNOWN),
-        n(0), m(4096), stride(0), data(new uint8_t[4096])
+        n(0), m(4096), stride(0), reserved(false), data(new uint8_t[4096])
     {}
     ~RecordBuilderFields(){ delete[] data; }
 
@@ -41,12 +41,13 @@ public:
     PIL_PRIMITIVE_TYPE array_primitive_type; // if primary type is an array then this secondary primary type is used to denote the "actual" primitive type of the byte array
     uint32_t n, m; // number of used bytes, allocated bytes
     uint32_t stride; // number of elements
+    bool reserved; // data is written in place into the target ColumnSet
     uint8_t* data; // actual data
 };
 
 struct RecordBuilder {
 public:
-    RecordBuilder() : n_added(0), n_used(0) {}
+    RecordBuilder() : n_added(0), n_used(0), n_reserved(0) {}
 
     template <class T>
     int AddArray(const std::string& id, PIL_PRIMITIVE_TYPE ptype, const T* value, uint32_t n_values) {
@@ -56,6 +57,7 @@ public:
             slots.push_back( std::unique_ptr<RecordBuilderFields>(new RecordBuilderFields()) );
         }
         slots[n_used]->field_name = id;
+        slots[n_used]->reserved = false;
         slots[n_used]->stride = n_values;
         slots[n_used]->primitive_type = PIL_TYPE_BYTE_ARRAY;
         slots[n_used]->array_primitive_type = ptype;
@@ -63,9 +65,7 @@ public:
         if(n_values * sizeof(T) > slots[n_used]->m)
             slots[n_used]->resize(n_values * sizeof(T) + 1024);
 
-        for(uint32_t i = 0; i < n_values; ++i){
-            reinterpret_cast<T*>(slots[n_used]->data)[i] = value[i];
-        }
+        memcpy(slots[n_used]->data, value, n_values * sizeof(T));
         slots[n_used]->n = sizeof(T) * n_values;
         ++n_used;
 
@@ -80,6 +80,7 @@ public:
             slots.push_back( std::unique_ptr<RecordBuilderFields>(new RecordBuilderFields()) );
         }
         slots[n_used]->field_name = id;
+        slots[n_used]->reserved = false;
         slots[n_used]->stride = values.size();
         slots[n_used]->primitive_type = PIL_TYPE_BYTE_ARRAY;
         slots[n_used]->array_primitive_type = ptype;
@@ -87,9 +88,7 @@ public:
         if(values.size() * sizeof(T) > slots[n_used]->m)
             slots[n_used]->resize(values.size() * sizeof(T) + 1024);
 
-        for(size_t i = 0; i < values.size(); ++i){
-            reinterpret_cast<T*>(slots[n_used]->data)[i] = values[i];
-        }
+        if(values.size()) memcpy(slots[n_used]->data, &values[0], values.size() * sizeof(T));
         slots[n_used]->n = sizeof(T) * values.size();
         ++n_used;
 
@@ -104,6 +103,7 @@ public:
             slots.push_back( std::unique_ptr<RecordBuilderFields>(new RecordBuilderFields()) );
         }
         slots[n_used]->field_name = id;
+        slots[n_used]->reserved = false;
         slots[n_used]->stride = 1;
         slots[n_used]->primitive_type = ptype;
         reinterpret_cast<T*>(slots[n_used]->data)[0] = value;
@@ -121,15 +121,14 @@ public:
             slots.push_back( std::unique_ptr<RecordBuilderFields>(new RecordBuilderFields()) );
         }
         slots[n_used]->field_name = id;
+        slots[n_used]->reserved = false;
         slots[n_used]->stride = n_values;
         slots[n_used]->primitive_type = ptype;
 
         if(n_values * sizeof(T) > slots[n_used]->m)
             slots[n_used]->resize(n_values * sizeof(T) + 1024);
 
-        for(int i = 0; i < n_values; ++i){
-            reinterpret_cast<T*>(slots[n_used]->data)[i] = value[i];
-        }
+        memcpy(slots[n_used]->data, value, n_values * sizeof(T));
         slots[n_used]->n = sizeof(T) * n_values;
         ++n_used;
 
@@ -144,15 +143,14 @@ public:
             slots.push_back( std::unique_ptr<RecordBuilderFields>(new RecordBuilderFields()) );
         }
         slots[n_used]->field_name = id;
+        slots[n_used]->reserved = false;
         slots[n_used]->stride = values.size();
         slots[n_used]->primitive_type = ptype;
 
         if(values.size() * sizeof(T) > slots[n_used]->m)
             slots[n_used]->resize(values.size() * sizeof(T) + 1024);
 
-        for(size_t i = 0; i < values.size(); ++i){
-            reinterpret_cast<T*>(slots[n_used]->data)[i] = values[i];
-        }
+        if(values.size()) memcpy(slots[n_used]->data, &values[0], values.size() * sizeof(T));
         slots[n_used]->n = sizeof(T) * values.size();
         ++n_used;
 
@@ -160,6 +158,34 @@ public:
         return(1);
     }
 
+    /**<
+     * Register an array of n_values values that is written directly into
+     * the target ColumnSet rather than copied through this builder. Used by
+     * TableConstructor::ReserveArray.
+     * @param id       Field name.
+     * @param ptype    Primitive type of the array values.
+     * @param n_values Number of values in the array.
+     * @return         Returns 1 if successful or -1 otherwise.
+     */
+    template <class T>
+    int AddReserved(const std::string& id, PIL_PRIMITIVE_TYPE ptype, uint32_t n_values) {
+        if(ptype == PIL_TYPE_BYTE_ARRAY || ptype == PIL_TYPE_UNKNOWN) return -1;
+        if(n_used == slots.size()) {
+            slots.push_back( std::unique_ptr<RecordBuilderFields>(new RecordBuilderFields()) );
+        }
+        slots[n_used]->field_name = id;
+        slots[n_used]->reserved = true;
+        slots[n_used]->stride = n_values;
+        slots[n_used]->primitive_type = PIL_TYPE_BYTE_ARRAY;
+        slots[n_used]->array_primitive_type = ptype;
+        slots[n_used]->n = sizeof(T) * n_values;
+        ++n_used;
+        ++n_reserved;
+
+        // Success
+        return(1);
+    }
+
     int PrintDebug() {
         for(size_t i = 0; i < slots.size(); ++i){
             std::cerr << "field-" << i << ": " << slots[i]->field_name << ":" << slots[i]->primitive_type << " bytelen=" << slots[i]->n << " n=" << slots[i]->stride << std::endl;
@@ -170,14 +196,17 @@ public:
 
     void reset() {
         n_used = 0;
+        n_reserved = 0;
         for(size_t i = 0; i < slots.size(); ++i) {
             slots[i]->n = 0;
+            slots[i]->reserved = false;
         }
     }
 
 public:
     uint64_t n_added;
     uint32_t n_used;
+    uint32_t n_reserved; // number of slots written in place
     std::vector< std::unique_ptr<RecordBuilderFields> > slots;
 };
 
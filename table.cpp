@@ -41,17 +41,54 @@ int TableConstructor::SetField(const std::string& field_name,
     return(1);
 }
 
+int TableConstructor::SetReference(const std::string& fasta_path) {
+    std::shared_ptr<ReferenceSequence> reference = std::make_shared<ReferenceSequence>();
+    int ret = reference->Open(fasta_path);
+    if(ret < 0) return(ret);
+
+    transformer.ref_context.reference = reference;
+    return(1);
+}
+
+int TableConstructor::SetFieldBatchBytes(const std::string& field_name, const uint64_t n_bytes) {
+    const int32_t global_id = field_dict.Find(field_name);
+    if(global_id == -1) return(-1);
+
+    field_dict.dict[global_id].batch_bytes = n_bytes;
+    return(1);
+}
+
+int TableConstructor::SetHugePages(const bool enabled) {
+    if(build_csets.size() || batch_pool.bytes_allocated()) return(-1);
+
+    MemoryPool* pool = enabled ? huge_page_memory_pool() : default_memory_pool();
+    transformer.ReleaseBuffers();
+    batch_pool.ReleaseChunks();
+    budget_pool.SetParent(pool);
+    return(1);
+}
+
+int TableConstructor::SetMemoryBudget(MemoryBudget* budget) {
+    if(budget == nullptr) return(-1);
+    if(build_csets.size() || batch_pool.bytes_allocated()) return(-1);
+
+    // The default budget is already charged by every parent pool.
+    transformer.ReleaseBuffers();
+    batch_pool.ReleaseChunks();
+    budget_pool.SetBudget(budget == default_memory_budget() ? nullptr : budget);
+    memory_budget = budget;
+    return(1);
+}
+
 int TableConstructor::Append(RecordBuilder& builder) {
     if(meta_data.batches.size() == 0)
         meta_data.batches.push_back(std::make_shared<RecordBatch>());
 
-    // Check if the current RecordBatch has reached its Batch limit.
-    // If it has then finalize the Batch.
-    if(meta_data.batches.back()->n_rec >= batch_size) {
-        uint32_t batch_id = meta_data.batches.size() == 0 ? 0 : meta_data.batches.size() - 1;
-        //std::cerr << "FINALIZING: " << batch_id << std::endl;
-        FinalizeBatch(batch_id);
-    }
+    // Check if the current RecordBatch has reached its Batch limit or if
+    // the memory budget is nearly exhausted. If it has then finalize the Batch.
+    // Records with reserved Slots were checked before their first reservation
+    // as finalizing now would discard the data written in place.
+    if(builder.n_reserved == 0) FinalizeBatchIfFull();
 
     //std::cerr << "ADDING: " << builder.slots[0]->field_name;
     //for(int i = 1; i < builder.slots.size(); ++i) {
@@ -65,7 +102,9 @@ int TableConstructor::Append(RecordBuilder& builder) {
     SchemaPattern pattern;
     std::unordered_map<uint32_t, uint32_t> pattern_map;
 
-    for(size_t i = 0; i < builder.slots.size(); ++i) {
+    // Only the first n_used Slots belong to this record: the remaining Slots
+    // are kept allocated from earlier, wider records.
+    for(size_t i = 0; i < builder.n_used; ++i) {
         if(field_dict.Find(builder.slots[i]->field_name) == -1) {
             meta_data.field_meta.push_back(std::make_shared<FieldMetaData>());
         }
@@ -82,6 +121,13 @@ int TableConstructor::Append(RecordBuilder& builder) {
     uint32_t pid = schema_dict.FindOrAdd(pattern);
     //std::cerr << "schema_id=" << pid << std::endl;
 
+    // Every ColumnSet of the RecordBatch receives either data or padding
+    // below: mark them all such that a record that cannot be added
+    // completely can be removed again.
+    const size_t n_marked = build_csets.size();
+    if(build_marks.size() < n_marked) build_marks.resize(n_marked);
+    for(size_t i = 0; i < n_marked; ++i) build_csets[i]->GetMark(build_marks[i]);
+
     // Check the local stack of ColumnSets if the target identifier is present.
     // If the target identifier is NOT available then we insert a new ColumnSet
     // with that identifier in the current Batch and pad with NULL values up
@@ -93,17 +139,22 @@ int TableConstructor::Append(RecordBuilder& builder) {
             //std::cerr << "target column does NOT Exist in local stack: insert -> " << pattern.ids[i] << " -> " << builder.slots[i]->field_name << std::endl;
             _segid = BatchAddColumn(builder.slots[i]->primitive_type, builder.slots[i]->array_primitive_type, pattern.ids[i]);
             //std::cerr << "_segid=" << _segid << std::endl;
-            assert(_segid != -1);
+            if(_segid == -1) {
+                RollbackAppend(n_marked);
+                builder.reset();
+                return(-1);
+            }
         }
 
         // Actual addition of data.
-        assert(AppendData(builder, i, build_csets[_segid]) == 1);
+        if(AppendData(builder, i, build_csets[_segid]) != 1) {
+            RollbackAppend(n_marked);
+            builder.reset();
+            return(-1);
+        }
+        UpdateBatchBytes(_segid, pattern.ids[i]);
     }
 
-    // Map GLOBAL to LOCAL Schema in the current RecordBatch.
-    // Note: Adding a pattern automatically increments the record count in a RecordBatch.
-    meta_data.batches.back()->AddSchema(pid);
-
     // CRITICAL!
     // Every Field in the current RecordBatch that is NOT in the current
     // Schema MUST be padded with NULLs for the current Schema. This is to
@@ -165,7 +216,20 @@ int TableConstructor::Append(RecordBuilder& builder) {
             default: std::cerr << "no known type: " << ptype << std::endl; ret_status = -1; break;
             }
         }
-        assert(ret_status == 1);
+        if(ret_status != 1) {
+            RollbackAppend(n_marked);
+            builder.reset();
+            return(-1);
+        }
+        UpdateBatchBytes(tgt_id, pad_tgts[i]);
+    }
+
+    // Map GLOBAL to LOCAL Schema in the current RecordBatch.
+    // Note: Adding a pattern automatically increments the record count in a RecordBatch.
+    if(meta_data.batches.back()->AddSchema(pid) != 1) {
+        RollbackAppend(n_marked);
+        builder.reset();
+        return(-1);
     }
 
     ++builder.n_added;
@@ -174,6 +238,102 @@ int TableConstructor::Append(RecordBuilder& builder) {
     return(1); // success
 }
 
+// private
+void TableConstructor::UpdateBatchBytes(const uint32_t local_id, const uint32_t global_id) {
+    if(build_bytes.size() < build_csets.size()) build_bytes.resize(build_csets.size(), 0);
+
+    const uint64_t n_bytes = build_csets[local_id]->GetMemoryUsage();
+    batch_bytes_used += n_bytes - build_bytes[local_id];
+    build_bytes[local_id] = n_bytes;
+
+    const uint64_t limit = field_dict.dict[global_id].batch_bytes;
+    if(limit != 0 && n_bytes >= limit) field_limit_reached = true;
+}
+
+// private
+void TableConstructor::RollbackAppend(const size_t n_marked) {
+    for(size_t i = 0; i < n_marked; ++i) {
+        build_csets[i]->Rollback(build_marks[i]);
+        UpdateBatchBytes(i, meta_data.batches.back()->local_dict[i]);
+    }
+
+    // ColumnSets added for the record hold no data of earlier records.
+    while(build_csets.size() > n_marked) {
+        build_csets.pop_back();
+        meta_data.batches.back()->RemoveLastGlobalField();
+    }
+    if(build_bytes.size() > n_marked) {
+        for(size_t i = n_marked; i < build_bytes.size(); ++i) batch_bytes_used -= build_bytes[i];
+        build_bytes.resize(n_marked);
+    }
+}
+
+// private
+bool TableConstructor::BatchIsFull() const {
+    if(field_limit_reached) return(true);
+
+    const uint32_t n_rec = meta_data.batches.back()->n_rec;
+    switch(flush_policy) {
+    case(PIL_FLUSH_RECORDS): return(n_rec >= batch_size);
+    case(PIL_FLUSH_BYTES):   return(batch_bytes_used >= batch_bytes);
+    case(PIL_FLUSH_RECORDS_OR_BYTES): return(n_rec >= batch_size || batch_bytes_used >= batch_bytes);
+    }
+    return(false);
+}
+
+int32_t TableConstructor::PrepareReservation(RecordBuilder& builder,
+                                             const std::string& field_name,
+                                             PIL_PRIMITIVE_TYPE ptype)
+{
+    if(ptype == PIL_TYPE_BYTE_ARRAY || ptype == PIL_TYPE_UNKNOWN) return(-1);
+
+    if(meta_data.batches.size() == 0)
+        meta_data.batches.push_back(std::make_shared<RecordBatch>());
+
+    // The batch limits are checked before the first reservation of a record
+    // instead of in Append as the reserved memory belongs to the current
+    // RecordBatch.
+    if(builder.n_reserved == 0) FinalizeBatchIfFull();
+
+    if(field_dict.Find(field_name) == -1) {
+        meta_data.field_meta.push_back(std::make_shared<FieldMetaData>());
+    }
+    int32_t global_id = field_dict.FindOrAdd(field_name, PIL_TYPE_BYTE_ARRAY, ptype);
+    if(field_dict.dict[global_id].cstore != PIL_CSTORE_TENSOR) return(-1);
+
+    int32_t local_id = meta_data.batches.back()->FindLocalField(global_id);
+    if(local_id == -1) {
+        local_id = BatchAddColumn(PIL_TYPE_BYTE_ARRAY, ptype, global_id);
+        if(local_id == -1) return(-1);
+    }
+
+    return(local_id);
+}
+
+std::shared_ptr<ColumnSet> TableConstructor::GetBatchColumnSet(const std::string& field_name) {
+    if(meta_data.batches.size() == 0) return(nullptr);
+    const int32_t global_id = field_dict.Find(field_name);
+    if(global_id < 0) return(nullptr);
+    const int32_t local_id = meta_data.batches.back()->FindLocalField(global_id);
+    if(local_id < 0) return(nullptr);
+    return(build_csets[local_id]);
+}
+
+int TableConstructor::FinalizeBatchIfFull() {
+    if(meta_data.batches.size() == 0) return(0);
+    if(meta_data.batches.back()->n_rec == 0) return(0);
+    if(BatchIsFull() == false) {
+        // Finalize early under memory pressure unless the batch is too small
+        // for its buffers to matter.
+        if(memory_budget->IsAbove(budget_flush_fraction) == false) return(0);
+        if(meta_data.batches.back()->n_rec < budget_flush_min_records && batch_bytes_used < budget_flush_min_bytes) return(0);
+    }
+
+    //std::cerr << "FINALIZING: " << meta_data.batches.size() - 1 << std::endl;
+    FinalizeBatch(meta_data.batches.size() - 1);
+    return(1);
+}
+
 // private
 int TableConstructor::BatchAddColumn(PIL_PRIMITIVE_TYPE ptype,
                                      PIL_PRIMITIVE_TYPE ptype_arr,
@@ -186,7 +346,9 @@ int TableConstructor::BatchAddColumn(PIL_PRIMITIVE_TYPE ptype,
     }
     int col_id = meta_data.batches.back()->AddGlobalField(global_id);
 
-    build_csets.push_back(std::unique_ptr<ColumnSet>(new ColumnSet()));
+    build_csets.push_back(std::unique_ptr<ColumnSet>(new ColumnSet(&batch_pool)));
+    build_csets.back()->expected_records = batch_size;
+    build_csets.back()->checksum_type = checksum_type;
 
     const uint32_t padding_to = meta_data.batches.back()->n_rec;
     //if(padding_to != 0) std::cerr << "padding up to: " << padding_to << std::endl;
@@ -211,7 +373,7 @@ int TableConstructor::BatchAddColumn(PIL_PRIMITIVE_TYPE ptype,
            case(PIL_TYPE_DOUBLE): ret_status = std::static_pointer_cast< ColumnSetBuilderTensor<double> >(build_csets.back())->PadNull();   break;
            default: std::cerr << "no known type: " << ptype_arr << std::endl; ret_status = -1; break;
            }
-           assert(ret_status == 1);
+           if(ret_status != 1) break;
         }
     } else {
         for(uint32_t j = 0; j < padding_to; ++j) {
@@ -228,7 +390,7 @@ int TableConstructor::BatchAddColumn(PIL_PRIMITIVE_TYPE ptype,
            case(PIL_TYPE_DOUBLE): ret_status = std::static_pointer_cast< ColumnSetBuilder<double> >(build_csets.back())->PadNull();   break;
            default: std::cerr << "no known type: " << ptype << std::endl; ret_status = -1; break;
            }
-           assert(ret_status == 1);
+           if(ret_status != 1) break;
         }
     }
 
@@ -236,7 +398,11 @@ int TableConstructor::BatchAddColumn(PIL_PRIMITIVE_TYPE ptype,
 
     //std::cerr << "returning: " << col_id << " with ret_status=" << ret_status << std::endl;
     if(ret_status == 1) return(col_id);
-    else return(-1);
+
+    // The padding could not be allocated: the Field is not added.
+    build_csets.pop_back();
+    meta_data.batches.back()->RemoveLastGlobalField();
+    return(-1);
 }
 
 // private
@@ -247,6 +413,9 @@ int TableConstructor::AppendData(const RecordBuilder& builder,
     PIL_PRIMITIVE_TYPE ptype = builder.slots[slot_offset]->primitive_type;
     PIL_PRIMITIVE_TYPE ptype_arr = builder.slots[slot_offset]->array_primitive_type;
 
+    if(builder.slots[slot_offset]->reserved)
+        return(CommitData(builder, slot_offset, dst_column));
+
     int ret_status = 0;
 
     if(ptype == PIL_TYPE_BYTE_ARRAY) {
@@ -282,6 +451,27 @@ int TableConstructor::AppendData(const RecordBuilder& builder,
     return(ret_status);
 }
 
+int TableConstructor::CommitData(const RecordBuilder& builder,
+                                 const uint32_t slot_offset,
+                                 std::shared_ptr<ColumnSet> dst_column)
+{
+    const uint32_t stride = builder.slots[slot_offset]->stride;
+
+    switch(builder.slots[slot_offset]->array_primitive_type) {
+    case(PIL_TYPE_INT8):   return(std::static_pointer_cast< ColumnSetBuilderTensor<int8_t> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_INT16):  return(std::static_pointer_cast< ColumnSetBuilderTensor<int16_t> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_INT32):  return(std::static_pointer_cast< ColumnSetBuilderTensor<int32_t> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_INT64):  return(std::static_pointer_cast< ColumnSetBuilderTensor<int64_t> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_UINT8):  return(std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_UINT16): return(std::static_pointer_cast< ColumnSetBuilderTensor<uint16_t> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_UINT32): return(std::static_pointer_cast< ColumnSetBuilderTensor<uint32_t> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_UINT64): return(std::static_pointer_cast< ColumnSetBuilderTensor<uint64_t> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_FLOAT):  return(std::static_pointer_cast< ColumnSetBuilderTensor<float> >(dst_column)->Commit(stride));
+    case(PIL_TYPE_DOUBLE): return(std::static_pointer_cast< ColumnSetBuilderTensor<double> >(dst_column)->Commit(stride));
+    default: std::cerr << "no known type: " << builder.slots[slot_offset]->array_primitive_type << std::endl; return(-1);
+    }
+}
+
 int TableConstructor::AddRecordBatchSchemas(std::shared_ptr<ColumnSet> cset, const uint32_t batch_id) {
     if(cset.get() == nullptr) return(-1);
     if(out_stream.good() == false) return(-2);
@@ -292,8 +482,12 @@ int TableConstructor::AddRecordBatchSchemas(std::shared_ptr<ColumnSet> cset, con
 
     // Adding a RecordBatch to the core FieldMetaData will return the offset it was added to.
     uint32_t core_batch_id = meta_data.core_meta[batch_id]->AddBatch(cset);
-    // Compress the Schema identifiers for this RecordBatch.
+    // Compress the Schema identifiers for this RecordBatch. The Schemas are
+    // retained in the meta data after the batch arena is reset so the
+    // scratch buffers swapped into them must not come from the arena.
+    transformer.SetMemoryPool(default_memory_pool());
     static_cast<ZstdCompressor*>(&transformer)->Compress(cset, PIL_CSTORE_COLUMN, PIL_ZSTD_DEFAULT_LEVEL);
+    transformer.SetMemoryPool(&batch_pool);
     //std::cerr << "SCHEMAS=" << cset->columns[0]->uncompressed_size << "->" << cset->columns[0]->compressed_size << std::endl;
     //std::cerr << "core-id=" << core_batch_id << "/" << meta_data.core_meta.back()->cset_meta.size() << std::endl;
     meta_data.core_meta[batch_id]->cset_meta[core_batch_id]->UpdateColumnSet(meta_data.batches[batch_id]->schemas);
@@ -311,7 +505,7 @@ int TableConstructor::AddRecordBatchSchemas(std::shared_ptr<ColumnSet> cset, con
 }
 
 int TableConstructor::FinalizeBatch(const uint32_t batch_id) {
-    uint32_t mem_in = 0, mem_out = 0;
+    uint64_t mem_in = 0, mem_out = 0;
 
     // Add the Schemas for the RecordBatch to the meta data indices.
     // This function returns the offset where the data was added. This offset
@@ -322,8 +516,25 @@ int TableConstructor::FinalizeBatch(const uint32_t batch_id) {
         exit(1);
     }
 
-    // This is NOT thread safe.
+    // Reference-based codecs read the untransformed alignment fields so
+    // fields using them have to be transformed first.
+    std::vector<uint32_t> order, order_tail;
+    transformer.ref_context.clear();
     for(size_t i = 0; i < build_csets.size(); ++i) {
+        const DictionaryFieldType& field = field_dict.dict[meta_data.batches[batch_id]->local_dict[i]];
+        if(field.field_name == transformer.ref_context.rname_field) transformer.ref_context.rname = build_csets[i];
+        else if(field.field_name == transformer.ref_context.pos_field) transformer.ref_context.pos = build_csets[i];
+        else if(field.field_name == transformer.ref_context.cigar_field) transformer.ref_context.cigar = build_csets[i];
+
+        if(std::find(field.transforms.begin(), field.transforms.end(), PIL_COMPRESS_REF_BASES) != field.transforms.end())
+            order.push_back(i);
+        else order_tail.push_back(i);
+    }
+    order.insert(order.end(), order_tail.begin(), order_tail.end());
+
+    // This is NOT thread safe.
+    for(size_t k = 0; k < order.size(); ++k) {
+        const uint32_t i = order[k];
         uint32_t global_id = meta_data.batches[batch_id]->local_dict[i];
         // Add ColumnSet to the FieldMetaData
         int target = meta_data.AddColumnSet(build_csets[i], global_id, field_dict);
@@ -332,9 +543,31 @@ int TableConstructor::FinalizeBatch(const uint32_t batch_id) {
         const int64_t sz_untransformed = build_csets[i]->GetMemoryUsage();
         mem_in += sz_untransformed;
 
+        // Select the transformation chain for fields without user-provided
+        // transforms by trial-encoding a sample of the data.
+        if(CodecTuner::NeedsTuning(field_dict.dict[global_id], batch_id, tuner_options))
+            static_cast<CodecTuner*>(&transformer)->Tune(build_csets[i], field_dict.dict[global_id], tuner_options);
+
+        // Sample the buffers of the first batches of the Field and compress
+        // the remaining ones against the dictionary trained from them.
+        std::shared_ptr<FieldMetaData> tgt_meta_field = meta_data.field_meta[global_id];
+        if(dictionary_options.enabled && tgt_meta_field->zstd_dictionary.get() == nullptr)
+            tgt_meta_field->zstd_dictionary = std::make_shared<ZstdDictionary>(dictionary_options);
+        transformer.zstd_dictionary = tgt_meta_field->zstd_dictionary;
+
+        // Index the genotype classes of every sample while the genotype
+        // matrix is still untransformed.
+        if(genotype_index_options.enabled && field_dict.dict[global_id].field_name == genotype_index_options.field_name) {
+            meta_data.batches[batch_id]->genotype_index = std::make_shared<GenotypeIndex>();
+            if(meta_data.batches[batch_id]->genotype_index->Build(build_csets[i], genotype_index_options.n_samples, genotype_index_options.ploidy) < 0)
+                meta_data.batches[batch_id]->genotype_index = nullptr;
+        }
+
         // Compress ColumnSet according as described in the paired FieldMeta
         // record or automatically.
         const int64_t sz_compressed = transformer.Transform(build_csets[i], field_dict.dict[global_id]);
+        if(transformer.zstd_dictionary.get() != nullptr) transformer.zstd_dictionary->FinishBatch();
+        transformer.zstd_dictionary = nullptr;
         // Debug
         std::cerr << field_dict.dict[global_id].field_name << ": " << PIL_PRIMITIVE_TYPE_STRING[field_dict.dict[global_id].ptype] << "\t"
                 << "compressed: n=" << build_csets[i]->size() << " size=" << sz_untransformed  << "->" << build_csets[i]->GetMemoryUsage()
@@ -347,7 +580,6 @@ int TableConstructor::FinalizeBatch(const uint32_t batch_id) {
         // Write out.
 
         // Todo: write data to single archive if split is deactivated
-        std::shared_ptr<FieldMetaData> tgt_meta_field = meta_data.field_meta[global_id];
         if(single_archive == false && tgt_meta_field->open_writer == false)
             tgt_meta_field->OpenWriter("/Users/Mivagallery/Desktop/pil/test_" + field_dict.dict[global_id].field_name);
 
@@ -356,8 +588,18 @@ int TableConstructor::FinalizeBatch(const uint32_t batch_id) {
         else tgt_meta_field->SerializeColumnSet(build_csets[i], out_stream);
     }
 
-    // Todo: do not release memory after each Batch update.
+    // Every buffer of the RecordBatch is released at once and the arena
+    // chunks are recycled for the next batch.
+    transformer.ref_context.clear();
     build_csets.clear();
+    build_bytes.clear();
+    batch_bytes_used = 0;
+    field_limit_reached = false;
+    transformer.ReleaseBuffers();
+    batch_pool.Reset();
+    ++n_finalized;
+    // Return the chunks if the memory budget is still under pressure.
+    if(memory_budget->IsAbove(budget_flush_fraction)) batch_pool.ReleaseChunks();
     std::cerr << "total: compressed: " << mem_in << "->" << mem_out << "(" << (float)mem_in/mem_out << "-fold)" << std::endl;
     c_in  += mem_in;
     c_out += mem_out;
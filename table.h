@@ -12,6 +12,7 @@
 #include "record_builder.h"
 #include "table_schemas.h"
 #include "transform/transformer.h"
+#include "transform/codec_tuner.h"
 
 namespace pil {
 
@@ -30,18 +31,87 @@ public:
 // Use during construciton ONLY! This separates out construction and reading
 class TableConstructor : public Table {
 public:
-    TableConstructor() : single_archive(true), batch_size(65536), c_in(0), c_out(0){}
+    TableConstructor() : single_archive(true), batch_size(65536), batch_bytes(64 << 20), flush_policy(PIL_FLUSH_RECORDS),
+        checksum_type(PIL_CHECKSUM_CRC32C), memory_budget(default_memory_budget()), budget_flush_fraction(0.8),
+        budget_flush_min_records(1024), budget_flush_min_bytes(1 << 20),
+        c_in(0), c_out(0), batch_pool(4 * 1024 * 1024, &budget_pool),
+        batch_bytes_used(0), field_limit_reached(false), n_finalized(0)
+    {
+        transformer.SetMemoryPool(&batch_pool);
+        transformer.SetModelMemoryPool(&budget_pool);
+    }
     ~TableConstructor(){}
 
     /**<
      * Convert a tuple into ColumnStore representation. This function will accept
      * a RecordBuilder reference with properly overloaded data and described slots
      * and will attempt to insert it into the current RecordBatch.
+     *
+     * If memory for the record cannot be allocated, for example because the
+     * limit of the MemoryBudget is reached, the part of the record already
+     * added is removed again and the record is dropped: the RecordBatch is
+     * left as it was before the call.
      * @param builder Reference to a RecordBuilder.
-     * @return
+     * @return        Returns 1 if successful or -1 otherwise.
      */
     int Append(RecordBuilder& builder);
 
+    /**<
+     * Reserve room for an array of n_values values of the given Field in the
+     * current RecordBatch and return a writable pointer to it. Parsers write
+     * the values in place, avoiding the copies into the RecordBuilder and
+     * from there into the ColumnSet. The reservation is registered in the
+     * builder and committed by the next call to Append. The pointer is
+     * invalidated by further reservations for the same Field and by Append.
+     *
+     * Example usage:
+     *
+     * uint8_t* bases = table.ReserveArray<uint8_t>(rbuild, "BASES", PIL_TYPE_UINT8, l_seq);
+     * memcpy(bases, seq, l_seq); // or decode into it directly
+     * table.Append(rbuild);
+     *
+     * @param builder    Reference to the RecordBuilder of the current record.
+     * @param field_name Name of the target Field.
+     * @param ptype      Primitive type of the array values.
+     * @param n_values   Number of values that will be written.
+     * @return           Returns a pointer to the reserved values or nullptr otherwise.
+     */
+    template <class T>
+    T* ReserveArray(RecordBuilder& builder, const std::string& field_name, PIL_PRIMITIVE_TYPE ptype, const uint32_t n_values) {
+        const int32_t local_id = PrepareReservation(builder, field_name, ptype);
+        if(local_id < 0) return(nullptr);
+        if(builder.AddReserved<T>(field_name, ptype, n_values) != 1) return(nullptr);
+        return(std::static_pointer_cast< ColumnSetBuilderTensor<T> >(build_csets[local_id])->Reserve(n_values));
+    }
+
+    /**<
+     * Find or add the tensor ColumnSet of the given Field in the current
+     * RecordBatch ahead of a reservation. The RecordBatch is finalized first
+     * if this is the first reservation of a record and the batch is full.
+     * @param builder    Reference to the RecordBuilder of the current record.
+     * @param field_name Name of the target Field.
+     * @param ptype      Primitive type of the array values.
+     * @return           Returns the local offset of the ColumnSet or -1 otherwise.
+     */
+    int32_t PrepareReservation(RecordBuilder& builder, const std::string& field_name, PIL_PRIMITIVE_TYPE ptype);
+
+    /**<
+     * Return the ColumnSet of a Field in the current RecordBatch. The
+     * ColumnSet is untransformed until the RecordBatch is finalized.
+     * @param field_name Name of the target Field.
+     * @return           Returns the ColumnSet or nullptr if the current RecordBatch does not hold the Field.
+     */
+    std::shared_ptr<ColumnSet> GetBatchColumnSet(const std::string& field_name);
+
+    /**<
+     * Finalize the current RecordBatch if it holds records and has reached
+     * its limits (see BatchIsFull) or the memory budget is nearly exhausted
+     * and the batch holds at least budget_flush_min_records records or
+     * budget_flush_min_bytes bytes.
+     * @return Returns 1 if the batch was finalized or 0 otherwise.
+     */
+    int FinalizeBatchIfFull();
+
     /**<
      * Add a new ColumnSet to the current RecordBatch and null-pad up to the
      * current record count.
@@ -62,6 +132,40 @@ public:
      */
     int AppendData(const RecordBuilder& builder, const uint32_t slot_offset, std::shared_ptr<ColumnSet> dst_column);
 
+    /**<
+     * Commit a Slot reserved with ReserveArray whose data was written in
+     * place into the target ColumnSet.
+     * @param builder     Reference RecordBuilder holding the reserved Slot.
+     * @param slot_offset Target Slot in the RecordBuilder.
+     * @param dst_column  Target ColumnSet holding the reserved data.
+     * @return            Returns 1 if succesful or -1 otherwise.
+     */
+    int CommitData(const RecordBuilder& builder, const uint32_t slot_offset, std::shared_ptr<ColumnSet> dst_column);
+
+    /**<
+     * Update the number of bytes buffered in the current RecordBatch after
+     * data was added to a ColumnSet. Only the memory usage of the target
+     * ColumnSet is recomputed.
+     * @param local_id  Local offset of the ColumnSet in the RecordBatch.
+     * @param global_id Global identifier of its Field.
+     */
+    void UpdateBatchBytes(const uint32_t local_id, const uint32_t global_id);
+
+    /**<
+     * Remove a record that could not be added completely: every ColumnSet
+     * is rolled back to its Mark in `build_marks` and ColumnSets added for
+     * the record are removed from the RecordBatch.
+     * @param n_marked Number of ColumnSets marked before the record was added.
+     */
+    void RollbackAppend(const size_t n_marked);
+
+    /**<
+     * Check if the current RecordBatch should be finalized according to
+     * `flush_policy` and the per-field byte limits.
+     * @return Returns TRUE if the batch is full or FALSE otherwise.
+     */
+    bool BatchIsFull() const;
+
     /**<
      * Finalise the RecordBatch by encoding and compressing the ColumnSets.
      * @param batch_id
@@ -117,6 +221,46 @@ public:
                  PIL_PRIMITIVE_TYPE ptype_array,
                  const std::vector<PIL_COMPRESSION_TYPE>& ctype);
 
+    /**<
+     * Load a FASTA reference (with .fai index) used by reference-based codecs
+     * such as PIL_COMPRESS_REF_BASES. Alignment fields are looked up by the
+     * names set in `transformer.ref_context` (RNAME, POS, and CIGAR by
+     * default) and RNAME values are interpreted as contig identifiers in the
+     * order of the reference index.
+     * @param fasta_path Path to the FASTA file.
+     * @return           Returns 1 if successful or a negative value otherwise.
+     */
+    int SetReference(const std::string& fasta_path);
+
+    /**<
+     * Finalize the RecordBatch once the given Field buffers n_bytes bytes,
+     * regardless of `flush_policy`. Useful to bound the heaviest columns,
+     * such as the bases and qualities of long reads.
+     * @param field_name Name of a Field set with SetField or seen in Append.
+     * @param n_bytes    Byte limit or 0 to remove the limit.
+     * @return           Returns 1 if successful or -1 if the Field is unknown.
+     */
+    int SetFieldBatchBytes(const std::string& field_name, const uint64_t n_bytes);
+
+    /**<
+     * Back the RecordBatch buffers and the codec model tables with huge
+     * pages (see HugePageMemoryPool). Must be called between batches.
+     * @param enabled Use huge pages if TRUE or the default pool otherwise.
+     * @return        Returns 1 if successful or -1 if a batch is in progress.
+     */
+    int SetHugePages(const bool enabled);
+
+    /**<
+     * Charge the RecordBatch buffers and the codec model tables to the given
+     * MemoryBudget, for example to cap the memory of a single import, in
+     * addition to the process-wide default_memory_budget(). Allocations fail
+     * once the limit of the budget is reached and batches are finalized early
+     * as the limit is approached. Must be called between batches.
+     * @param budget Target MemoryBudget.
+     * @return       Returns 1 if successful or -1 if a batch is in progress.
+     */
+    int SetMemoryBudget(MemoryBudget* budget);
+
     /**<
      * Finalize import of data.
      * @return
@@ -125,13 +269,36 @@ public:
 
 public:
     bool single_archive; // Write a single archive or mutiple output files in a directory.
-    uint32_t batch_size;
+    uint32_t batch_size; // Records per RecordBatch for PIL_FLUSH_RECORDS(_OR_BYTES).
+    uint64_t batch_bytes; // Buffered bytes per RecordBatch for PIL_FLUSH_(RECORDS_OR_)BYTES.
+    PIL_FLUSH_POLICY flush_policy;
+    PIL_CHECKSUM_TYPE checksum_type; // Checksum algorithm for stored data: PIL_CHECKSUM_NONE for scratch archives.
+    // Batches are finalized early once more than budget_flush_fraction of
+    // the limit of memory_budget is in use and they hold at least
+    // budget_flush_min_records records or budget_flush_min_bytes bytes, such
+    // that pressure from other users of the budget cannot cause a run of
+    // tiny batches. The budget is charged by the batch buffers and codec
+    // models: set it with SetMemoryBudget.
+    MemoryBudget* memory_budget;
+    double budget_flush_fraction;
+    uint32_t budget_flush_min_records;
+    uint64_t budget_flush_min_bytes;
     // Construction helpers
     uint64_t c_in, c_out; // Todo: delete - these are temporary
     //std::shared_ptr<RecordBatch> record_batch; // temporary instance of a RecordBatch
+    BudgetMemoryPool budget_pool; // Charges memory_budget: parent of batch_pool and pool of the codec models.
+    ArenaMemoryPool batch_pool; // Buffers of the current RecordBatch: reset after FinalizeBatch.
     std::vector< std::shared_ptr<ColumnSet> > build_csets; // temporary ColumnSets used during construction.
+    std::vector<uint64_t> build_bytes; // Memory usage of each ColumnSet in build_csets when last updated.
+    std::vector<ColumnSet::Mark> build_marks; // State of each ColumnSet in build_csets before the record being appended.
+    uint64_t batch_bytes_used; // Sum of build_bytes.
+    bool field_limit_reached; // Set if a ColumnSet reached the batch_bytes limit of its Field.
+    uint64_t n_finalized; // Number of RecordBatches finalized: the buffers of earlier batches are no longer valid.
     std::ofstream out_stream;
     Transformer transformer;
+    CodecTunerOptions tuner_options; // Automatic codec selection for fields without user-provided transforms.
+    ZstdDictionaryOptions dictionary_options; // Per-field ZSTD dictionaries trained from the first batches.
+    GenotypeIndexOptions genotype_index_options; // Per-batch WAH bitmaps of the genotype classes of every sample.
 };
 
 
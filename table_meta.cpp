@@ -27,10 +27,10 @@ int ColumnStoreMetaData::Serialize(std::ostream& stream) {
     stream.write(reinterpret_cast<char*>(&file_offset), sizeof(uint64_t));
     stream.write(reinterpret_cast<char*>(&last_modified), sizeof(uint64_t));
     stream.write(reinterpret_cast<char*>(&n_records), sizeof(uint32_t));
-    stream.write(reinterpret_cast<char*>(&n_elements), sizeof(uint32_t));
+    stream.write(reinterpret_cast<char*>(&n_elements), sizeof(uint64_t));
     stream.write(reinterpret_cast<char*>(&n_null), sizeof(uint32_t));
-    stream.write(reinterpret_cast<char*>(&uncompressed_size), sizeof(uint32_t));
-    stream.write(reinterpret_cast<char*>(&compressed_size), sizeof(uint32_t));
+    stream.write(reinterpret_cast<char*>(&uncompressed_size), sizeof(uint64_t));
+    stream.write(reinterpret_cast<char*>(&compressed_size), sizeof(uint64_t));
     stream.write(reinterpret_cast<char*>(&stats_surrogate_min), sizeof(uint64_t));
     stream.write(reinterpret_cast<char*>(&stats_surrogate_max), sizeof(uint64_t));
     return(stream.good());
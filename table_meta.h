@@ -6,6 +6,7 @@
 #include <fstream>
 
 #include "transform/compressor.h"
+#include "genotype_index.h"
 
 namespace pil {
 
@@ -33,13 +34,13 @@ public:
         have_segmental_stats = true;
 
         if(cstore->nullity.get() == nullptr) { // if nullity is available
-            for(uint32_t i = 0; i < n_elements; ++i) {
+            for(uint64_t i = 0; i < n_elements; ++i) {
                 min = std::min(min, values[i]);
                 max = std::max(max, values[i]);
             }
         } else { // if nullity is not available
             uint32_t n_valid = 0;
-            for(uint32_t i = 0; i < n_elements; ++i) {
+            for(uint64_t i = 0; i < n_elements; ++i) {
                 if(cstore->IsValid(i) == false) continue;
                 min = std::min(min, values[i]);
                 max = std::max(max, values[i]);
@@ -104,7 +105,10 @@ public:
     bool have_segmental_stats;
     uint64_t file_offset; // file offset on disk to seek to the start of this ColumnStore
     uint64_t last_modified; // unix timestamp when last modified
-    uint32_t n_records, n_elements, n_null, uncompressed_size, compressed_size; // number of elements
+    uint32_t n_records;
+    uint64_t n_elements;
+    uint32_t n_null;
+    uint64_t uncompressed_size, compressed_size;
     uint64_t stats_surrogate_min, stats_surrogate_max; // cast to actual ptype, any possible remainder is 0
 };
 
@@ -382,6 +386,13 @@ public:
     int Serialize(std::ostream& stream) {
         uint32_t n_file_name = file_name.size();
         stream.write(reinterpret_cast<char*>(&n_file_name), sizeof(uint32_t));
+        // Trained ZSTD dictionary or its length (0) if there is none.
+        if(zstd_dictionary.get() != nullptr && zstd_dictionary->IsTrained()) {
+            zstd_dictionary->Serialize(stream);
+        } else {
+            uint32_t n_dict = 0;
+            stream.write(reinterpret_cast<char*>(&n_dict), sizeof(uint32_t));
+        }
         uint32_t n_cset = cset_meta.size();
         stream.write(reinterpret_cast<char*>(&n_cset), sizeof(uint32_t));
         for(size_t i = 0; i < n_cset; ++i) {
@@ -398,6 +409,7 @@ public:
     std::unique_ptr<std::ofstream> writer;
     std::unique_ptr<std::ifstream> reader;
     std::vector< std::shared_ptr<ColumnSetMetaData> > cset_meta;
+    std::shared_ptr<ZstdDictionary> zstd_dictionary; // Stored once for every ColumnSet of this Field.
 };
 
 /**<
@@ -424,7 +436,7 @@ public:
     int AddSchema(uint32_t pid) {
         if(schemas.get() == nullptr) schemas = std::make_shared<ColumnSet>();
         int insert_status = std::static_pointer_cast< ColumnSetBuilder<uint32_t> >(schemas)->Append(pid);
-        ++n_rec;
+        if(insert_status == 1) ++n_rec;
         return(insert_status);
     }
 
@@ -452,6 +464,12 @@ public:
         return(local);
     }
 
+    // Remove the Field added last by AddGlobalField.
+    void RemoveLastGlobalField() {
+        global_local_field_map.erase(local_dict.back());
+        local_dict.pop_back();
+    }
+
     int FindLocalField(const uint32_t global_id) const {
         std::unordered_map<uint32_t, uint32_t>::const_iterator ret = global_local_field_map.find(global_id);
         if(ret != global_local_field_map.end()) {
@@ -471,19 +489,27 @@ public:
         for(size_t i = 0; i < n_dict; ++i)
             stream.write(reinterpret_cast<char*>(&local_dict[i]), sizeof(uint32_t));
 
+        // Genotype index or its number of samples (0) if there is none.
+        if(genotype_index.get() != nullptr) {
+            genotype_index->Serialize(stream);
+        } else {
+            uint32_t n_samples = 0;
+            stream.write(reinterpret_cast<char*>(&n_samples), sizeof(uint32_t));
+        }
+
         // Todo: move out
         if(0) {
             assert(schemas->columns[0].get() != nullptr);
             // Compress with Zstd
             Compressor c;
-            int ret = static_cast<ZstdCompressor*>(&c)->Compress(schemas->columns[0]->mutable_data(),
+            int64_t ret = static_cast<ZstdCompressor*>(&c)->Compress(schemas->columns[0]->mutable_data(),
                                                                  schemas->columns[0]->uncompressed_size,
                                                                  PIL_ZSTD_DEFAULT_LEVEL);
 
             //std::cerr << "SERIALIZE zstd: " << schemas->columns[0]->uncompressed_size << "->" << ret << std::endl;
             assert(ret != -1);
-            stream.write(reinterpret_cast<char*>(&schemas->columns[0]->uncompressed_size), sizeof(uint32_t)); // uncompressed size
-            stream.write(reinterpret_cast<char*>(&ret), sizeof(int)); // compressed size
+            stream.write(reinterpret_cast<char*>(&schemas->columns[0]->uncompressed_size), sizeof(uint64_t)); // uncompressed size
+            stream.write(reinterpret_cast<char*>(&ret), sizeof(int64_t)); // compressed size
             stream.write(reinterpret_cast<char*>(c.data()->mutable_data()), ret); // compressed data
 
         }
@@ -501,8 +527,14 @@ public:
     std::unordered_map<uint32_t, uint32_t> global_local_field_map; // Map from global field id -> local field id
     // ColumnStore for Schemas. ALWAYS cast as uint32_t
     std::shared_ptr<ColumnSet> schemas; // Array storage of the local dictionary-encoded BatchPatterns.
+    std::shared_ptr<GenotypeIndex> genotype_index; // Per-sample genotype bitmaps if enabled.
 };
 
+// Key of the interval key in the file-level key-values. The value holds the
+// names of the contig, start and end Fields separated by tabs. Intervals are
+// 0-based and half-open.
+#define PIL_INTERVAL_KEY "PIL_INTERVAL_KEY"
+
 struct FileMetaData {
 public:
     FileMetaData() : n_rows(0){}
@@ -579,9 +611,76 @@ public:
             field_meta[i]->Serialize(ostream);
         }
 
+        uint32_t n_key_values = key_values.size();
+        ostream.write(reinterpret_cast<char*>(&n_key_values), sizeof(uint32_t));
+        for(uint32_t i = 0; i < n_key_values; ++i) {
+            for(const std::string* s : {&key_values[i].first, &key_values[i].second}) {
+                uint32_t l_s = s->size();
+                ostream.write(reinterpret_cast<char*>(&l_s), sizeof(uint32_t));
+                ostream.write(s->data(), l_s);
+            }
+        }
+
         return(ostream.good());
     }
 
+    /**<
+     * Store a file-level key-value pair, such as the header of an imported
+     * file, with the meta data. The value of an existing key is replaced.
+     * @param key   Key string.
+     * @param value Value string.
+     */
+    void SetKeyValue(const std::string& key, const std::string& value) {
+        for(size_t i = 0; i < key_values.size(); ++i) {
+            if(key_values[i].first == key) {
+                key_values[i].second = value;
+                return;
+            }
+        }
+        key_values.push_back(std::make_pair(key, value));
+    }
+
+    /**<
+     * Retrieve the value of a file-level key-value pair.
+     * @param key Key string.
+     * @return    Returns a pointer to the value or nullptr if the key is not set.
+     */
+    const std::string* GetKeyValue(const std::string& key) const {
+        for(size_t i = 0; i < key_values.size(); ++i) {
+            if(key_values[i].first == key) return(&key_values[i].second);
+        }
+        return(nullptr);
+    }
+
+    /**<
+     * Mark the Fields holding the contig identifier and the 0-based,
+     * half-open start and end coordinates of every record as the interval key
+     * of the file. Archives with an interval key can be joined or
+     * intersected with other archives by coordinate.
+     * @param contig Name of the contig Field.
+     * @param start  Name of the start Field.
+     * @param end    Name of the end Field.
+     */
+    void SetIntervalKey(const std::string& contig, const std::string& start, const std::string& end) {
+        SetKeyValue(PIL_INTERVAL_KEY, contig + '\t' + start + '\t' + end);
+    }
+
+    /**<
+     * Retrieve the Field names of the interval key.
+     * @return Returns TRUE if the file has an interval key or FALSE otherwise.
+     */
+    bool GetIntervalKey(std::string& contig, std::string& start, std::string& end) const {
+        const std::string* value = GetKeyValue(PIL_INTERVAL_KEY);
+        if(value == nullptr) return(false);
+        const size_t t1 = value->find('\t');
+        const size_t t2 = t1 == std::string::npos ? t1 : value->find('\t', t1 + 1);
+        if(t2 == std::string::npos) return(false);
+        contig = value->substr(0, t1);
+        start  = value->substr(t1 + 1, t2 - t1 - 1);
+        end    = value->substr(t2 + 1);
+        return(true);
+    }
+
 public:
     uint64_t n_rows;
     // Efficient map of a RecordBatch to the ColumnSets it contains:
@@ -598,6 +697,8 @@ public:
     std::vector< std::shared_ptr<FieldMetaData> > core_meta;
     // Meta data for each Field
     std::vector< std::shared_ptr<FieldMetaData> > field_meta;
+    // File-level key-value pairs, e.g. headers of imported files.
+    std::vector< std::pair<std::string, std::string> > key_values;
 };
 
 }
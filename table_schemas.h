@@ -46,12 +46,15 @@ struct SchemaPattern {
 // This means that all returned values should be compatibile with
 // this assigned primitive type.
 struct DictionaryFieldType {
-    DictionaryFieldType() : cstore(PIL_CSTORE_UNKNOWN), ptype(PIL_TYPE_UNKNOWN){}
+    DictionaryFieldType() : cstore(PIL_CSTORE_UNKNOWN), ptype(PIL_TYPE_UNKNOWN), compression_level(0), auto_tuned(false), batch_bytes(0){}
 
     std::string field_name;
     PIL_CSTORE_TYPE cstore;
     PIL_PRIMITIVE_TYPE ptype;
     std::vector<PIL_COMPRESSION_TYPE> transforms;
+    int compression_level; // Level used by PIL_COMPRESS_ZSTD or 0 for the default level.
+    bool auto_tuned; // Set if `transforms` was chosen by the CodecTuner.
+    uint64_t batch_bytes; // Finalize the RecordBatch once this Field buffers this many bytes or 0 for no limit.
 };
 
 /**<
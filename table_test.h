@@ -791,6 +791,199 @@ TEST(TableInsertion, MixedSchemasExtreme) {
     ASSERT_EQ(1, table.FinalizeBatch(0));
 }
 
+TEST(TableInsertion, MemoryBudgetFlush) {
+    const std::string path = "pil_budget_test.pil";
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+
+    MemoryBudget budget(64 << 20);
+    ASSERT_EQ(1, table.SetMemoryBudget(&budget));
+    table.budget_flush_fraction = 0.1;
+    table.budget_flush_min_records = 1000;
+    table.budget_flush_min_bytes = 1 << 20;
+
+    // Pressure from other users of the budget does not finalize batches
+    // below the minimum size.
+    ASSERT_EQ(true, budget.Reserve(32 << 20));
+    RecordBuilder rbuild;
+    for(int i = 0; i < 100; ++i) {
+        rbuild.Add<uint32_t>("POS", pil::PIL_TYPE_UINT32, i);
+        ASSERT_EQ(1, table.Append(rbuild));
+    }
+    ASSERT_EQ(1, table.meta_data.batches.size());
+    ASSERT_EQ(100, table.meta_data.batches.back()->n_rec);
+    budget.Release(32 << 20);
+
+    // The batch buffers are charged to the budget of the table.
+    ASSERT_GE(budget.bytes_used(), 4 << 20);
+    ASSERT_EQ(table.budget_pool.bytes_allocated(), budget.bytes_used());
+
+    // Pressure from the batch itself finalizes batches once they hold the
+    // minimum number of bytes.
+    std::vector<uint8_t> values(1 << 16, 7);
+    for(int i = 0; i < 200; ++i) {
+        rbuild.Add<uint32_t>("POS", pil::PIL_TYPE_UINT32, i);
+        rbuild.AddArray<uint8_t>("DATA", pil::PIL_TYPE_UINT8, values);
+        ASSERT_EQ(1, table.Append(rbuild));
+    }
+    ASSERT_GT(table.meta_data.batches.size(), 2);
+    for(size_t i = 0; i + 1 < table.meta_data.batches.size(); ++i)
+        ASSERT_GE(table.meta_data.batches[i]->n_rec, 16);
+    ASSERT_LE(budget.max_memory(), 64 << 20);
+
+    // The arena chunks are returned while the budget is under pressure.
+    ASSERT_NE(0, table.batch_pool.num_chunks());
+    ASSERT_EQ(true, budget.Reserve(32 << 20));
+    ASSERT_EQ(1, table.FinalizeBatch(table.meta_data.batches.size() - 1));
+    ASSERT_EQ(0, table.batch_pool.num_chunks());
+    budget.Release(32 << 20);
+    ASSERT_EQ(0, budget.bytes_used());
+
+    table.out_stream.close();
+    std::remove(path.c_str());
+}
+
+TEST(TableInsertion, BudgetExhaustedAppend) {
+    TableConstructor table;
+    table.budget_flush_fraction = 2; // never finalize early: the table has no output
+    RecordBuilder rbuild;
+    std::vector<uint8_t> values(1 << 16, 7);
+
+    // The first arena chunk fits in the limit but the second does not.
+    MemoryBudget budget(6 << 20);
+    ASSERT_EQ(1, table.SetMemoryBudget(&budget));
+    int ret = 1;
+    uint32_t n_added = 0;
+    for(int i = 0; i < 1000 && ret == 1; ++i) {
+        rbuild.Add<uint32_t>("POS", pil::PIL_TYPE_UINT32, i);
+        rbuild.AddArray<uint8_t>("DATA", pil::PIL_TYPE_UINT8, values);
+        ret = table.Append(rbuild);
+        n_added += (ret == 1);
+    }
+    ASSERT_EQ(-1, ret);
+    ASSERT_GT(n_added, 0);
+    ASSERT_LT(n_added, 1000);
+
+    // The record that failed is removed from every column.
+    ASSERT_EQ(n_added, table.meta_data.batches.back()->n_rec);
+    ASSERT_EQ(2, table.build_csets.size());
+    std::shared_ptr<ColumnStore> pos = table.build_csets[0]->columns[0];
+    ASSERT_EQ(n_added, pos->n_records);
+    ASSERT_EQ(n_added * sizeof(uint32_t), pos->uncompressed_size);
+    ASSERT_EQ(n_added * sizeof(uint32_t), pos->buffer.length());
+    std::shared_ptr<ColumnStore> offsets = table.build_csets[1]->columns[0];
+    std::shared_ptr<ColumnStore> data = table.build_csets[1]->columns[1];
+    ASSERT_EQ(n_added + 1, offsets->n_records);
+    ASSERT_EQ(n_added * values.size(), reinterpret_cast<const uint32_t*>(offsets->mutable_data())[n_added]);
+    ASSERT_EQ(n_added, data->n_records);
+    ASSERT_EQ(n_added * values.size(), data->n_elements);
+    ASSERT_EQ(n_added * values.size(), data->uncompressed_size);
+    ASSERT_EQ(n_added * values.size(), data->buffer.length());
+    ASSERT_EQ(table.build_csets[0]->GetMemoryUsage() + table.build_csets[1]->GetMemoryUsage(), table.batch_bytes_used);
+
+    // Records are added again once memory is available.
+    budget.set_limit(0);
+    rbuild.Add<uint32_t>("POS", pil::PIL_TYPE_UINT32, n_added);
+    rbuild.AddArray<uint8_t>("DATA", pil::PIL_TYPE_UINT8, values);
+    ASSERT_EQ(1, table.Append(rbuild));
+    ASSERT_EQ(n_added + 1, table.meta_data.batches.back()->n_rec);
+    ASSERT_EQ(n_added + 1, pos->n_records);
+    ASSERT_EQ(n_added + 2, offsets->n_records);
+    ASSERT_EQ((n_added + 1) * values.size(), data->buffer.length());
+}
+
+TEST(TableInsertion, ByteBudgetFlush) {
+    const std::string path = "pil_batch_bytes_test.pil";
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+
+    // Every record buffers 400 bytes of values.
+    table.flush_policy = PIL_FLUSH_BYTES;
+    table.batch_bytes = 4000;
+    RecordBuilder rbuild;
+    std::vector<float> vecvals(100, 1);
+    for(int i = 0; i < 25; ++i) {
+        rbuild.Add<float>("FIELD1", pil::PIL_TYPE_FLOAT, vecvals);
+        ASSERT_EQ(1, table.Append(rbuild));
+    }
+    ASSERT_EQ(3, table.meta_data.batches.size());
+    ASSERT_EQ(10, table.meta_data.batches[0]->n_rec);
+    ASSERT_EQ(5, table.meta_data.batches.back()->n_rec);
+    ASSERT_EQ(5 * 400, table.batch_bytes_used);
+    ASSERT_EQ(table.build_csets[0]->GetMemoryUsage(), table.batch_bytes_used);
+
+    // The record limit applies as well.
+    table.flush_policy = PIL_FLUSH_RECORDS_OR_BYTES;
+    table.batch_size = 7;
+    for(int i = 0; i < 2; ++i) {
+        rbuild.Add<float>("FIELD1", pil::PIL_TYPE_FLOAT, vecvals);
+        ASSERT_EQ(1, table.Append(rbuild));
+    }
+    ASSERT_EQ(7, table.meta_data.batches.back()->n_rec);
+
+    // A per-field limit finalizes batches regardless of the policy.
+    ASSERT_EQ(-1, table.SetFieldBatchBytes("FIELD2", 1000));
+    table.flush_policy = PIL_FLUSH_RECORDS;
+    table.batch_size = 65536;
+    ASSERT_EQ(1, table.SetFieldBatchBytes("FIELD1", 1000));
+    for(int i = 0; i < 4; ++i) {
+        rbuild.Add<float>("FIELD1", pil::PIL_TYPE_FLOAT, vecvals);
+        ASSERT_EQ(1, table.Append(rbuild));
+    }
+    ASSERT_EQ(8, table.meta_data.batches[table.meta_data.batches.size() - 2]->n_rec);
+    ASSERT_EQ(3, table.meta_data.batches.back()->n_rec);
+    ASSERT_EQ(true, table.field_limit_reached);
+
+    table.out_stream.close();
+    std::remove(path.c_str());
+}
+
+TEST(TableInsertion, ReserveArrayInPlace) {
+    const std::string path = "pil_reserve_test.pil";
+    TableConstructor table;
+    table.out_stream.open(path, std::ios::binary);
+    ASSERT_TRUE(table.out_stream.good());
+    table.batch_size = 4;
+
+    // Records 0-3 fill the first batch. The fifth record finalizes it
+    // before its data is written in place.
+    RecordBuilder rbuild;
+    for(uint32_t i = 0; i < 6; ++i) {
+        ASSERT_EQ(1, rbuild.Add<uint32_t>("ID", pil::PIL_TYPE_UINT32, i));
+        uint8_t* bases = table.ReserveArray<uint8_t>(rbuild, "BASES", pil::PIL_TYPE_UINT8, i + 1);
+        ASSERT_NE(nullptr, bases);
+        for(uint32_t j = 0; j <= i; ++j) bases[j] = 'A' + i;
+        ASSERT_EQ(1, rbuild.n_reserved);
+        ASSERT_EQ(1, table.Append(rbuild));
+        ASSERT_EQ(0, rbuild.n_reserved);
+    }
+    ASSERT_EQ(2, table.meta_data.batches.size());
+    ASSERT_EQ(2, table.meta_data.batches.back()->n_rec);
+
+    // The committed records match the layout of copied arrays.
+    std::shared_ptr<ColumnSet> cset = table.GetBatchColumnSet("BASES");
+    ASSERT_TRUE(cset.get() != nullptr);
+    ASSERT_EQ(2, cset->size());
+    ASSERT_EQ(3, cset->columns[0]->n_records);
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data());
+    ASSERT_EQ(0, offsets[0]);
+    ASSERT_EQ(5, offsets[1]);
+    ASSERT_EQ(11, offsets[2]);
+    ASSERT_EQ(11, cset->columns[1]->n_elements);
+    ASSERT_EQ(2, cset->columns[1]->n_records);
+    const uint8_t* data = cset->columns[1]->mutable_data();
+    for(int j = 0; j < 5; ++j)  ASSERT_EQ('E', data[j]);
+    for(int j = 5; j < 11; ++j) ASSERT_EQ('F', data[j]);
+
+    // Reservations are only available for tensor Fields.
+    ASSERT_EQ(nullptr, table.ReserveArray<uint32_t>(rbuild, "ID", pil::PIL_TYPE_UINT32, 1));
+
+    table.out_stream.close();
+    std::remove(path.c_str());
+}
+
 }
 
 
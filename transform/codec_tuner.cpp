@@ -0,0 +1,178 @@
+#include <chrono>
+#include <algorithm>
+
+#include "codec_tuner.h"
+#include "compressor.h"
+
+namespace pil {
+
+std::shared_ptr<ColumnSet> CodecTuner::Sample(std::shared_ptr<ColumnSet> cset,
+                                              const DictionaryFieldType& field,
+                                              const uint32_t max_recs,
+                                              const uint32_t max_bytes)
+{
+    if(cset.get() == nullptr) return(nullptr);
+    std::shared_ptr<ColumnSet> sample = std::make_shared<ColumnSet>();
+
+    if(field.cstore == PIL_CSTORE_COLUMN) {
+        if(cset->size() == 0) return(nullptr);
+        uint32_t n = std::min(cset->columns[0]->n_records, max_recs);
+        uint32_t width = 0;
+        for(size_t i = 0; i < cset->size(); ++i) {
+            if(cset->columns[i].get() == nullptr) return(nullptr);
+            if(cset->columns[i]->n_records) width += cset->columns[i]->buffer.length() / cset->columns[i]->n_records;
+        }
+        if(width) n = std::max<uint32_t>(1, std::min<uint32_t>(n, max_bytes / width));
+
+        for(size_t i = 0; i < cset->size(); ++i) {
+            std::shared_ptr<ColumnStore> src = cset->columns[i];
+            std::shared_ptr<ColumnStore> dst = std::make_shared<ColumnStore>();
+            const uint32_t n_recs = std::min(n, src->n_records);
+            const uint32_t n_bytes = n_recs ? n_recs * (src->buffer.length() / src->n_records) : 0;
+            if(n_bytes) assert(dst->buffer.Append(src->mutable_data(), n_bytes) == 1);
+            dst->n_records = n_recs;
+            dst->n_elements = n_recs;
+            dst->uncompressed_size = n_bytes;
+            sample->Append(dst);
+        }
+    } else if(field.cstore == PIL_CSTORE_TENSOR) {
+        if(cset->size() != 2) return(nullptr);
+        if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(nullptr);
+        if(cset->columns[0]->n_records == 0) return(nullptr);
+        // Batches with 64-bit offsets are always compressed with ZSTD.
+        if(Transformer::HasWideOffsets(cset)) return(nullptr);
+
+        const uint32_t* offsets = reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data());
+        const uint32_t n_recs = cset->columns[0]->n_records - 1;
+        const uint32_t width = offsets[n_recs] ? cset->columns[1]->buffer.length() / offsets[n_recs] : 1;
+
+        // Largest number of leading records fitting the byte limit.
+        uint32_t n = std::min(n_recs, max_recs);
+        n = std::upper_bound(offsets, offsets + n + 1, max_bytes / width) - offsets - 1;
+        n = std::max<uint32_t>(std::min<uint32_t>(1, n_recs), n);
+
+        std::shared_ptr<ColumnStore> dst0 = std::make_shared<ColumnStore>();
+        assert(dst0->buffer.Append(offsets, (n + 1) * sizeof(uint32_t)) == 1);
+        dst0->n_records = n + 1;
+        dst0->n_elements = n + 1;
+        dst0->uncompressed_size = (n + 1) * sizeof(uint32_t);
+        dst0->offset_width = sizeof(uint32_t);
+
+        std::shared_ptr<ColumnStore> dst1 = std::make_shared<ColumnStore>();
+        if(offsets[n]) assert(dst1->buffer.Append(cset->columns[1]->mutable_data(), offsets[n] * width) == 1);
+        dst1->n_records = n;
+        dst1->n_elements = offsets[n];
+        dst1->uncompressed_size = offsets[n] * width;
+
+        sample->Append(dst0);
+        sample->Append(dst1);
+    } else return(nullptr);
+
+    // Trial encodings are discarded: skip checksumming them.
+    for(size_t i = 0; i < sample->size(); ++i) sample->columns[i]->checksum_type = PIL_CHECKSUM_NONE;
+
+    // Copy the Nullity bitmaps.
+    for(size_t i = 0; i < sample->size(); ++i) {
+        if(cset->columns[i]->nullity.get() == nullptr) continue;
+        const uint32_t n_nullity = (sample->columns[i]->n_records + 31) / 32;
+        assert(AllocateResizableBuffer(default_memory_pool(), std::max<uint32_t>(1, n_nullity) * sizeof(uint32_t), &sample->columns[i]->nullity) == 1);
+        memcpy(sample->columns[i]->nullity->mutable_data(), cset->columns[i]->nullity->mutable_data(), n_nullity * sizeof(uint32_t));
+        sample->columns[i]->m_nullity = n_nullity * 32;
+    }
+
+    return(sample);
+}
+
+int64_t CodecTuner::StoredSize(std::shared_ptr<ColumnSet> cset) {
+    int64_t total = 0;
+    for(size_t i = 0; i < cset->size(); ++i) {
+        std::shared_ptr<ColumnStore> cstore = cset->columns[i];
+        total += cstore->buffer.length();
+        if(cstore->have_dictionary && cstore->dictionary.get() != nullptr) {
+            std::shared_ptr<ColumnDictionary> dict = cstore->dictionary;
+            total += dict->GetCompressedSize() ? dict->GetCompressedSize() : dict->GetUncompressedSize();
+            if(dict->IsTensorBased())
+                total += dict->GetCompressedLengthSize() ? dict->GetCompressedLengthSize() : dict->GetUncompressedLengthSize();
+        }
+    }
+    return(total);
+}
+
+int CodecTuner::Tune(std::shared_ptr<ColumnSet> cset,
+                     DictionaryFieldType& field,
+                     const CodecTunerOptions& options,
+                     std::vector<CodecTrial>* trials)
+{
+    if(cset.get() == nullptr) return(-1);
+
+    std::shared_ptr<ColumnSet> sample = Sample(cset, field, options.max_sample_records, options.max_sample_bytes);
+    if(sample.get() == nullptr) return(-2);
+    const int64_t n_in = StoredSize(sample);
+    if(n_in == 0) return(-3);
+
+    // Candidate chains. The current default (automatic mode) is listed
+    // first such that it is kept in case of ties.
+    std::vector<CodecTrial> candidates(2);
+    candidates[0].transforms.push_back(PIL_COMPRESS_AUTO);
+    candidates[1].transforms.push_back(PIL_COMPRESS_NONE);
+
+    for(size_t i = 0; i < options.zstd_levels.size(); ++i) {
+        candidates.push_back(CodecTrial());
+        candidates.back().transforms.push_back(PIL_COMPRESS_ZSTD);
+        candidates.back().compression_level = options.zstd_levels[i];
+
+        if(field.cstore == PIL_CSTORE_COLUMN && field.ptype == PIL_TYPE_UINT32) {
+            candidates.push_back(CodecTrial());
+            candidates.back().transforms.push_back(PIL_ENCODE_DELTA);
+            candidates.back().transforms.push_back(PIL_COMPRESS_ZSTD);
+            candidates.back().compression_level = options.zstd_levels[i];
+        }
+    }
+
+    if(field.cstore == PIL_CSTORE_TENSOR && field.ptype == PIL_TYPE_UINT8) {
+        const PIL_COMPRESSION_TYPE rc_types[3] = {PIL_COMPRESS_RC_QUAL, PIL_COMPRESS_RC_ILLUMINA_NAME, PIL_ENCODE_CIGAR_NIBBLE};
+        for(int i = 0; i < 3; ++i) {
+            candidates.push_back(CodecTrial());
+            candidates.back().transforms.push_back(rc_types[i]);
+        }
+
+        // The base codec is only lossless for upper-case ACGTN. Later
+        // batches with other bytes are stored with ZSTD by the codec itself.
+        if(SequenceCompressor::IsLossless(sample->columns[1]->mutable_data(), sample->columns[1]->buffer.length())) {
+            candidates.push_back(CodecTrial());
+            candidates.back().transforms.push_back(PIL_COMPRESS_RC_BASES);
+        }
+    }
+
+    int best = -1, n_success = 0;
+    for(size_t i = 0; i < candidates.size(); ++i) {
+        // Every trial operates on its own copy of the sample.
+        std::shared_ptr<ColumnSet> trial = (i == 0) ? sample : Sample(cset, field, options.max_sample_records, options.max_sample_bytes);
+        DictionaryFieldType trial_field = field;
+        trial_field.transforms = candidates[i].transforms;
+        trial_field.compression_level = candidates[i].compression_level;
+
+        auto t0 = std::chrono::steady_clock::now();
+        int64_t ret = Transform(trial, trial_field);
+        auto t1 = std::chrono::steady_clock::now();
+        if(ret < 1) continue;
+
+        candidates[i].n_in    = n_in;
+        candidates[i].n_out   = StoredSize(trial);
+        candidates[i].time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        candidates[i].score   = (double)candidates[i].n_out / n_in + options.speed_weight * candidates[i].time_ns / n_in;
+        if(trials) trials->push_back(candidates[i]);
+
+        if(best == -1 || candidates[i].score < candidates[best].score) best = i;
+        ++n_success;
+    }
+    if(best == -1) return(-4);
+
+    field.transforms = candidates[best].transforms;
+    field.compression_level = candidates[best].compression_level;
+    field.auto_tuned = true;
+
+    return(n_success);
+}
+
+}
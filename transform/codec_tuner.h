@@ -0,0 +1,105 @@
+#ifndef TRANSFORM_CODEC_TUNER_H_
+#define TRANSFORM_CODEC_TUNER_H_
+
+#include <vector>
+
+#include "transformer.h"
+
+namespace pil {
+
+// Parameters for automatic codec selection. Candidate chains are scored as
+//
+//    compressed size / input size + speed_weight * encoding ns / input byte
+//
+// and the chain with the lowest score is selected. A speed_weight of 0
+// selects the smallest output regardless of encoding speed.
+struct CodecTunerOptions {
+    CodecTunerOptions() :
+        enabled(false), speed_weight(0.002), retune_interval(16),
+        max_sample_records(65536), max_sample_bytes(1 << 20),
+        zstd_levels({1, 3, 9})
+    {}
+
+    bool enabled; // Tune fields without user-provided transforms.
+    double speed_weight;
+    uint32_t retune_interval; // Re-run the trials every N batches or 0 for the first batch only.
+    uint32_t max_sample_records, max_sample_bytes; // Upper limits of the trial sample.
+    std::vector<int> zstd_levels; // ZSTD levels to try.
+};
+
+// A candidate transformation chain and the score of its trial.
+struct CodecTrial {
+    CodecTrial() : compression_level(0), n_in(0), n_out(0), time_ns(0), score(0){}
+
+    std::vector<PIL_COMPRESSION_TYPE> transforms;
+    int compression_level;
+    int64_t n_in, n_out, time_ns;
+    double score;
+};
+
+/**<
+ * Selects a transformation chain for a field by trial-encoding a sample of a
+ * ColumnSet with every applicable candidate chain: automatic mode, no
+ * compression, ZSTD at a range of levels, delta encoding followed by ZSTD
+ * (UINT32 columns), and the range codecs (UINT8 tensors).
+ */
+class CodecTuner : public Transformer {
+public:
+    /**<
+     * Trial-encode a sample of the provided ColumnSet and record the best
+     * chain in the field's `transforms` and `compression_level`. The
+     * ColumnSet itself is not modified.
+     * @param cset    Source ColumnSet in its untransformed state.
+     * @param field   Destination DictionaryFieldType.
+     * @param options Tuning parameters.
+     * @param trials  Optional destination for every successful trial.
+     * @return        Returns the number of successful trials or a negative value otherwise.
+     */
+    int Tune(std::shared_ptr<ColumnSet> cset,
+             DictionaryFieldType& field,
+             const CodecTunerOptions& options,
+             std::vector<CodecTrial>* trials = nullptr);
+
+    /**<
+     * Predicate for whether a field should be (re-)tuned in the given batch.
+     * Fields with user-provided transforms are never tuned.
+     * @param field    Target DictionaryFieldType.
+     * @param batch_id Current batch number.
+     * @param options  Tuning parameters.
+     * @return
+     */
+    static bool NeedsTuning(const DictionaryFieldType& field, const uint32_t batch_id, const CodecTunerOptions& options) {
+        if(options.enabled == false) return false;
+        if(field.auto_tuned == false) {
+            return(field.transforms.size() == 0 ||
+                   (field.transforms.size() == 1 && field.transforms[0] == PIL_COMPRESS_AUTO));
+        }
+        return(options.retune_interval != 0 && batch_id % options.retune_interval == 0);
+    }
+
+    /**<
+     * Copy the leading records of a ColumnSet. At least one record is
+     * copied if the source is not empty.
+     * @param cset      Source ColumnSet in its untransformed state.
+     * @param field     DictionaryFieldType describing the column store type.
+     * @param max_recs  Upper limit on the number of records.
+     * @param max_bytes Upper limit on the number of data bytes.
+     * @return          Returns a new ColumnSet or nullptr if the input is illegal.
+     */
+    static std::shared_ptr<ColumnSet> Sample(std::shared_ptr<ColumnSet> cset,
+                                             const DictionaryFieldType& field,
+                                             const uint32_t max_recs,
+                                             const uint32_t max_bytes);
+
+    /**<
+     * Number of stored bytes of a transformed ColumnSet excluding the Nullity
+     * bitmaps, which are the same for every candidate chain.
+     * @param cset Source ColumnSet.
+     * @return
+     */
+    static int64_t StoredSize(std::shared_ptr<ColumnSet> cset);
+};
+
+}
+
+#endif /* TRANSFORM_CODEC_TUNER_H_ */
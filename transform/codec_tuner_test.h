@@ -0,0 +1,107 @@
+#ifndef CODEC_TUNER_TEST_H_
+#define CODEC_TUNER_TEST_H_
+
+#include <random>
+#include <algorithm>
+
+#include "codec_tuner.h"
+#include <gtest/gtest.h>
+
+namespace pil {
+
+TEST(CodecTunerTests, SortedColumn) {
+    CodecTuner tuner;
+    CodecTunerOptions options;
+    options.enabled = true;
+    options.speed_weight = 0; // size only: deterministic
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_COLUMN;
+    field.ptype  = PIL_TYPE_UINT32;
+    ASSERT_EQ(true, CodecTuner::NeedsTuning(field, 0, options));
+
+    std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSetBuilder<uint32_t> > builder = std::static_pointer_cast< ColumnSetBuilder<uint32_t> >(cset);
+
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint32_t> distr(0, 1000);
+    uint32_t pos = 10000;
+    for(int i = 0; i < 100000; ++i) {
+        pos += distr(eng);
+        ASSERT_EQ(1, builder->Append(pos));
+    }
+    cset->columns[0]->ComputeChecksum();
+
+    std::vector<CodecTrial> trials;
+    ASSERT_GT(tuner.Tune(cset, field, options, &trials), 0);
+    ASSERT_EQ(true, field.auto_tuned);
+    ASSERT_EQ(2, field.transforms.size());
+    ASSERT_EQ(PIL_ENCODE_DELTA, field.transforms[0]);
+    ASSERT_EQ(PIL_COMPRESS_ZSTD, field.transforms[1]);
+    ASSERT_EQ(true, Transformer::ValidTransformationOrder(field.transforms));
+
+    // The sample is limited by the record and byte budgets.
+    for(size_t i = 0; i < trials.size(); ++i)
+        ASSERT_EQ(std::min<uint32_t>(options.max_sample_records, options.max_sample_bytes / sizeof(uint32_t)) * sizeof(uint32_t), trials[i].n_in);
+
+    // The source data is untouched.
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[0]->checksum_type, cset->columns[0]->mutable_data(), cset->columns[0]->uncompressed_size, digest);
+    ASSERT_EQ(0, memcmp(cset->columns[0]->checksum, digest, 16));
+    ASSERT_EQ(0, cset->columns[0]->transformation_args.size());
+
+    // Retuning only happens periodically.
+    ASSERT_EQ(false, CodecTuner::NeedsTuning(field, 1, options));
+    ASSERT_EQ(true, CodecTuner::NeedsTuning(field, options.retune_interval, options));
+}
+
+TEST(CodecTunerTests, Tensor) {
+    CodecTuner tuner;
+    CodecTunerOptions options;
+    options.enabled = true;
+    options.speed_weight = 0;
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint32_t> distr(0, 3);
+    std::uniform_int_distribution<uint32_t> dbyte(0, 255);
+    const char* bases = "ACGT";
+
+    // Bases make the base codec a candidate while arbitrary bytes do not.
+    for(int k = 0; k < 2; ++k) {
+        std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+        std::shared_ptr<ColumnSetBuilderTensor<uint8_t> > builder = std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset);
+        for(int i = 0; i < 5000; ++i) {
+            std::string s;
+            for(int j = 0; j < 100; ++j) s += k == 0 ? bases[distr(eng)] : dbyte(eng);
+            if(i % 100 == 0) builder->PadNull();
+            else ASSERT_EQ(1, builder->Append(reinterpret_cast<const uint8_t*>(s.data()), s.size()));
+        }
+
+        field.transforms.clear();
+        field.auto_tuned = false;
+        std::vector<CodecTrial> trials;
+        ASSERT_GT(tuner.Tune(cset, field, options, &trials), 0);
+        ASSERT_EQ(1, field.transforms.size());
+
+        bool have_bases = false;
+        for(size_t i = 0; i < trials.size(); ++i) {
+            have_bases |= (trials[i].transforms[0] == PIL_COMPRESS_RC_BASES);
+            ASSERT_GT(trials[i].n_out, 0);
+        }
+        ASSERT_EQ(k == 0, have_bases);
+        // Random bases are below 2.5 bits per base.
+        if(k == 0) {
+            ASSERT_LT(std::min_element(trials.begin(), trials.end(), [](const CodecTrial& a, const CodecTrial& b){ return(a.score < b.score); })->score, 0.35);
+        }
+    }
+}
+
+}
+
+#endif /* CODEC_TUNER_TEST_H_ */
@@ -38,51 +38,204 @@
 
 namespace pil {
 
-int ZstdCompressor::Compress(std::shared_ptr<ColumnSet> cset, const PIL_CSTORE_TYPE& field_type, const int compression_level) {
+// Array of codec models allocated from a MemoryPool. Elements are default
+// constructed and the memory is returned to the pool on destruction.
+template <class T>
+struct ModelArray {
+    ModelArray(MemoryPool* pool, const int64_t n) : pool_(pool), n_(n), data_(nullptr) {
+        uint8_t* data = nullptr;
+        if(pool_->Allocate(n_ * sizeof(T), &data) != 1) return;
+        data_ = reinterpret_cast<T*>(data);
+        for(int64_t i = 0; i < n_; ++i) new (&data_[i]) T();
+    }
+
+    ~ModelArray() {
+        if(data_ == nullptr) return;
+        for(int64_t i = 0; i < n_; ++i) data_[i].~T();
+        pool_->Free(reinterpret_cast<uint8_t*>(data_), n_ * sizeof(T));
+    }
+
+    ModelArray(const ModelArray&) = delete;
+    ModelArray& operator=(const ModelArray&) = delete;
+
+    T& operator[](const int64_t i) { return data_[i]; }
+    T* operator->() { return data_; }
+    T* data() { return data_; }
+
+    MemoryPool* pool_;
+    int64_t n_;
+    T* data_;
+};
+
+// compressor
+
+int Compressor::CompressStrides(std::shared_ptr<ColumnSet> cset) {
     if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-2);
+    if(cset->columns[0].get() == nullptr) return(-3);
 
-    int ret = 0;
+    // Compute the delta of the cumulative sums of strides.
+    static_cast<DeltaEncoder*>(static_cast<Transformer*>(this))->UnsafeEncode(cset->columns[0]);
+
+    // Compress the strides with ZSTD.
+    int ret = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Compress(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
+    if(ret < 0) return(-6); // compression failure
+
+    // Compress the Nullity bitmap
+    int retNull = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->CompressNullity(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
+    if(retNull < 0) return(-6); // compression failure
+
+    return(ret + retNull);
+}
+
+int Compressor::DecompressStrides(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+    if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-2);
+    if(cset->columns[0].get() == nullptr) return(-3);
+    if(cset->columns[0]->transformation_args.size() != 2) return(-4);
+
+    // Decompress strides
+    if(cset->columns[0]->transformation_args.back()->ctype != PIL_COMPRESS_ZSTD) return(-4);
+    int decomp = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Decompress(cset->columns[0], cset->columns[0]->transformation_args.back());
+    if(decomp < 0) return(-5);
+    if(decomp != cset->columns[0]->transformation_args.back()->u_sz) return(-6);
+    cset->columns[0]->buffer.UnsafeSetLength(decomp);
+    cset->columns[0]->transformation_args.pop_back();
+    // Prefix compute the stride lengths
+    if(cset->columns[0]->transformation_args.back()->ctype != PIL_ENCODE_DELTA) return(-4);
+    if(static_cast<DeltaEncoder*>(static_cast<Transformer*>(this))->UnsafePrefixSum(cset->columns[0], field) < 0) return(-7);
+    int ret = cset->columns[0]->transformation_args.back()->u_sz;
+    cset->columns[0]->transformation_args.pop_back();
+
+    return(ret);
+}
+
+// zstd
+
+// Creating a ZSTD context allocates several hundred kilobytes of state so
+// every thread keeps a compression and a decompression context for its
+// lifetime instead of creating them for every call.
+struct ZstdContexts {
+    ZstdContexts() : cctx(ZSTD_createCCtx()), dctx(ZSTD_createDCtx()){}
+    ~ZstdContexts(){ ZSTD_freeCCtx(cctx); ZSTD_freeDCtx(dctx); }
+
+    ZSTD_CCtx* cctx;
+    ZSTD_DCtx* dctx;
+};
+
+static ZstdContexts& GetZstdContexts() {
+    static thread_local ZstdContexts contexts;
+    return(contexts);
+}
+
+int64_t ZstdCompressor::Compress(std::shared_ptr<ColumnSet> cset, const PIL_CSTORE_TYPE& field_type, const int compression_level) {
+    if(cset.get() == nullptr) return(-1);
+
+    int64_t ret = 0;
     if(field_type == PIL_CSTORE_COLUMN) {
        //std::cerr << "in cstore col: n=" << cset->size() << std::endl;
        for(int i = 0; i < cset->size(); ++i) {
-           std::shared_ptr<ColumnStore> tgt = cset->columns[i];
-
-           int64_t in_size = tgt->buffer.length();
-           int ret2 = Compress(
-                   tgt->buffer.mutable_data(),
-                   tgt->buffer.length(),
-                   compression_level);
-
-           tgt->compressed_size = ret2;
-           memcpy(tgt->buffer.mutable_data(), buffer->mutable_data(), ret2);
-           tgt->buffer.UnsafeSetLength(ret2);
-           tgt->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_ZSTD, in_size, ret2));
-           tgt->transformation_args.back()->ComputeChecksum(tgt->buffer.mutable_data(), ret2);
+           int64_t ret2 = Compress(cset->columns[i], compression_level);
+           if(ret2 < 0) return(ret2);
            ret += ret2;
        }
        return(ret);
     } else if(field_type == PIL_CSTORE_TENSOR) {
-        std::cerr << "not allowed yet" << std::endl;
-        exit(1);
+        // Only the data is compressed here: the strides and their Nullity
+        // bitmap are compressed by the residual step in Transformer::Transform.
+        if(cset->size() != 2) return(-3);
+        return(Compress(cset->columns[1], compression_level));
+    }
+    return(ret);
+}
+
+int64_t ZstdCompressor::Compress(std::shared_ptr<ColumnStore> cstore, const int compression_level) {
+    if(cstore.get() == nullptr) return(-2);
+
+    int64_t in_size = cstore->buffer.length();
+    int64_t ret = Compress(cstore->buffer.mutable_data(),
+                       cstore->buffer.length(),
+                       compression_level);
+    if(ret < 0) return(ret);
+
+    // Hand over the compressed buffer and keep the uncompressed buffer as
+    // scratch space for the next call.
+    cstore->buffer.Swap(buffer, ret);
+    cstore->compressed_size = ret;
+    cstore->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_ZSTD, in_size, ret));
+    cstore->transformation_args.back()->ComputeChecksum(cstore->checksum_type, cstore->buffer.mutable_data(), ret);
+    return(ret);
+}
+
+int ZstdCompressor::CompressNullity(std::shared_ptr<ColumnStore> cstore, const int compression_level) {
+    if(cstore.get() == nullptr) return(-2);
+    cstore->nullity_u = NullityBitmap::Bytes(cstore->n_records);
+
+    // The Nullity bitmap is never materialized if every record is valid.
+    if(cstore->nullity.get() == nullptr) {
+        cstore->n_null = 0;
+        cstore->nullity_type = PIL_NULLITY_ALL_VALID;
+        cstore->nullity_c = 0;
+        return(0);
+    }
+
+    // Tensor offsets hold one more entry than there are records: the
+    // trailing offset has no validity of its own.
+    const uint32_t n_real = cstore->n_records - (cstore->offset_width != 0 && cstore->n_records != 0);
+    const uint32_t* bitmap = reinterpret_cast<const uint32_t*>(cstore->nullity->mutable_data());
+    const uint32_t n_valid = NullityBitmap::CountValid(bitmap, n_real);
+    cstore->n_null = n_real - n_valid;
+
+    // Uniform bitmaps are described by their type alone.
+    if(n_valid == n_real || n_valid == 0) {
+        cstore->nullity_type = (n_valid == n_real) ? PIL_NULLITY_ALL_VALID : PIL_NULLITY_ALL_NULL;
+        cstore->nullity_c = 0;
+        return(0);
+    }
+
+    // Sparse patterns are stored as run lengths if they are smaller than
+    // the bitmap.
+    std::vector<uint8_t> runs;
+    int ret = 0;
+    if(NullityBitmap::EncodeRuns(bitmap, cstore->n_records, runs, cstore->nullity_u) > 0) {
+        cstore->nullity_type = PIL_NULLITY_RUNS;
+        ret = Compress(&runs[0], runs.size(), compression_level);
+    } else {
+        cstore->nullity_type = PIL_NULLITY_BITMAP;
+        ret = Compress(cstore->nullity->mutable_data(), cstore->nullity_u, compression_level);
     }
+    if(ret < 0) return(ret);
+
+    cstore->nullity_c = ret;
+    cstore->nullity.swap(buffer);
     return(ret);
 }
 
-int ZstdCompressor::Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field, const int compression_level) {
+int64_t ZstdCompressor::Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field, const int compression_level) {
     return(Compress(cset, field.cstore, compression_level));
 }
 
-int ZstdCompressor::Compress(const uint8_t* src, const uint32_t n_src, const int compression_level) {
+int64_t ZstdCompressor::Compress(const uint8_t* src, const int64_t n_src, const int compression_level) {
+    const size_t n_bound = ZSTD_compressBound(n_src);
+
     if(buffer.get() == nullptr) {
-        assert(AllocateResizableBuffer(pool_, n_src + 16384, &buffer) == 1);
+        assert(AllocateResizableBuffer(pool_, n_bound, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < (int64_t)n_bound){
+        assert(buffer->Reserve(n_bound) == 1);
     }
 
-    if(buffer->capacity() < n_src + 16384){
-        //std::cerr << "here in limit=" << n*sizeof(T) << "/" << buffer->capacity() << std::endl;
-        assert(buffer->Reserve(n_src + 16384) == 1);
+    size_t ret = 0;
+    if(zstd_dictionary.get() != nullptr && zstd_dictionary->IsTrained()) {
+        ZSTD_CDict* cdict = zstd_dictionary->GetCDict(compression_level);
+        if(cdict == nullptr) return(-1);
+        ret = ZSTD_compress_usingCDict(GetZstdContexts().cctx, buffer->mutable_data(), buffer->capacity(), src, n_src, cdict);
+    } else {
+        if(zstd_dictionary.get() != nullptr) zstd_dictionary->AddSamples(src, n_src);
+        ret = ZSTD_compressCCtx(GetZstdContexts().cctx, buffer->mutable_data(), buffer->capacity(), src, n_src, compression_level);
     }
 
-    const int32_t ret = ZSTD_compress(buffer->mutable_data(), buffer->capacity(), src, n_src, compression_level);
     if(ZSTD_isError(ret)){
         std::cerr << "zstd error: " << ZSTD_getErrorString(ZSTD_getErrorCode(ret)) << std::endl;
         return(-1);
@@ -91,364 +244,1616 @@ int ZstdCompressor::Compress(const uint8_t* src, const uint32_t n_src, const int
     return(ret);
 }
 
-int ZstdCompressor::UnsafeDecompress(std::shared_ptr<ColumnStore> cstore, const bool back_copy) {
-	const size_t ret = ZSTD_decompress(
-							   buffer->mutable_data(),
-							   buffer->capacity(),
-							   cstore->mutable_data(),
-							   cstore->compressed_size);
-
-	if(ZSTD_isError(ret)){
-		std::cerr << ZSTD_getErrorString(ZSTD_getErrorCode(ret)) << std::endl;
-		return(false);
-	}
-
-	if(back_copy) {
-	    memcpy(cstore->mutable_data(), buffer->mutable_data(), ret);
-	    cstore->uncompressed_size = ret;
-	}
-	return(ret);
+int64_t ZstdCompressor::Decompress(const uint8_t* src, const int64_t n_src, const int64_t n_hint) {
+    if(src == nullptr) return(-1);
+
+    // Every frame written by Compress stores its content size.
+    unsigned long long n_out = ZSTD_getFrameContentSize(src, n_src);
+    if(n_out == ZSTD_CONTENTSIZE_ERROR) return(-1);
+    if(n_out == ZSTD_CONTENTSIZE_UNKNOWN) n_out = n_hint;
+
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, n_out + 1, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < (int64_t)n_out + 1) {
+        assert(buffer->Reserve(n_out + 1) == 1);
+    }
+
+    // Frames compressed against a dictionary record its identifier.
+    size_t ret = 0;
+    const uint32_t dict_id = ZSTD_getDictID_fromFrame(src, n_src);
+    if(dict_id != 0) {
+        if(zstd_dictionary.get() == nullptr || zstd_dictionary->GetId() != dict_id) return(-2); // missing dictionary
+        ret = ZSTD_decompress_usingDDict(GetZstdContexts().dctx,
+                                         buffer->mutable_data(),
+                                         buffer->capacity(),
+                                         src, n_src,
+                                         zstd_dictionary->GetDDict());
+    } else {
+        ret = ZSTD_decompressDCtx(GetZstdContexts().dctx,
+                                  buffer->mutable_data(),
+                                  buffer->capacity(),
+                                  src, n_src);
+    }
+
+    if(ZSTD_isError(ret)){
+        std::cerr << ZSTD_getErrorString(ZSTD_getErrorCode(ret)) << std::endl;
+        return(-1);
+    }
+
+    return(ret);
+}
+
+int64_t ZstdCompressor::UnsafeDecompress(std::shared_ptr<ColumnStore> cstore, const bool back_copy) {
+    if(cstore.get() == nullptr) return(-1);
+
+    int64_t ret = Decompress(cstore->mutable_data(), cstore->compressed_size, cstore->uncompressed_size);
+    if(ret < 0) return(ret);
+
+    if(back_copy) {
+        cstore->buffer.Swap(buffer, ret);
+        cstore->uncompressed_size = ret;
+    }
+    return(ret);
+}
+
+int ZstdCompressor::DecompressNullity(std::shared_ptr<ColumnStore> cstore) {
+    if(cstore.get() == nullptr) return(-1);
+
+    const uint32_t n_bytes = NullityBitmap::Bytes(cstore->n_records);
+
+    // All-valid bitmaps are left unallocated as in ColumnStoreBuilder.
+    if(cstore->nullity_type == PIL_NULLITY_ALL_VALID) {
+        cstore->nullity.reset();
+        cstore->nullity_u = n_bytes;
+        cstore->nullity_c = 0;
+        cstore->nullity_type = PIL_NULLITY_BITMAP;
+        cstore->m_nullity = 0;
+        return(n_bytes);
+    }
+
+    std::shared_ptr<ResizableBuffer> bitmap;
+    assert(AllocateResizableBuffer(pool_, n_bytes + sizeof(uint32_t), &bitmap) == 1);
+    uint32_t* words = reinterpret_cast<uint32_t*>(bitmap->mutable_data());
+
+    switch(cstore->nullity_type) {
+    case(PIL_NULLITY_ALL_NULL):  NullityBitmap::Fill(words, cstore->n_records, false); break;
+    case(PIL_NULLITY_BITMAP):
+    case(PIL_NULLITY_RUNS): {
+        if(cstore->nullity.get() == nullptr) return(-2);
+        int ret = Decompress(cstore->nullity->mutable_data(), cstore->nullity_c, cstore->nullity_u);
+        if(ret < 0) return(-3);
+
+        if(cstore->nullity_type == PIL_NULLITY_BITMAP) {
+            if((uint32_t)ret != n_bytes) return(-4);
+            memcpy(words, buffer->mutable_data(), n_bytes);
+        } else if(NullityBitmap::DecodeRuns(buffer->mutable_data(), ret, cstore->n_records, words) < 0) {
+            return(-4);
+        }
+        break;
+    }
+    default: return(-5);
+    }
+
+    cstore->nullity = bitmap;
+    cstore->nullity_u = n_bytes;
+    cstore->nullity_c = 0;
+    cstore->nullity_type = PIL_NULLITY_BITMAP;
+    cstore->m_nullity = n_bytes * 8;
+    return(n_bytes);
 }
 
-int ZstdCompressor::Decompress(std::shared_ptr<ColumnStore> cstore, std::shared_ptr<TransformMeta> meta, const bool back_copy) {
+int64_t ZstdCompressor::Decompress(std::shared_ptr<ColumnStore> cstore, std::shared_ptr<TransformMeta> meta, const bool back_copy) {
     if(meta->ctype != PIL_COMPRESS_ZSTD) return(-1);
+    return(UnsafeDecompress(cstore, back_copy));
+}
+
+
+// quality
+
+int QualityCompressor::Compress(std::shared_ptr<ColumnSet> cset, PIL_CSTORE_TYPE cstore) {
+    if(cset.get() == nullptr) return(-1);
+
+    int ret = 0;
+    if(cstore == PIL_CSTORE_COLUMN) {
+        //std::cerr << "in cstore col" << std::endl;
+        for(int i = 0; i < cset->columns.size(); ++i) {
+            std::cerr << "not imeplemented yet: compress multicol" << std::endl;
+            exit(1);
+            /*
+            if(cset->columns[i].get() == nullptr) return(-2);
+            std::shared_ptr<ColumnStore> tgt = cset->columns[i];
+            uint32_t n_l = tgt->buffer.length();
+            int64_t n_in = tgt->buffer.length();
+            int ret2 = Compress(tgt->buffer.mutable_data(), tgt->buffer.length(), &n_l, 1);
+            tgt->compressed_size = ret2;
+            memcpy(tgt->buffer.mutable_data(), buffer->mutable_data(), ret2);
+            tgt->buffer.UnsafeSetLength(ret2);
+            tgt->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_QUAL, n_in, ret2));
+            tgt->transformation_args.back()->ComputeChecksum(tgt->checksum_type, tgt->buffer.mutable_data(), ret2);
+            ret += ret2;
+            */
+        }
+    } else if(cstore == PIL_CSTORE_TENSOR) {
+        if(cset->size() != 2) return(-3);
+        if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-2);
+
+        static_cast<DeltaEncoder*>(static_cast<Transformer*>(this))->UnsafeEncode(cset->columns[0]);
+
+        if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
+
+        if(buffer.get() == nullptr) {
+           assert(AllocateResizableBuffer(pool_, cset->columns[1]->buffer.length()*1.1 + 16384, &buffer) == 1);
+        }
+
+        if(buffer->capacity() < cset->columns[1]->buffer.length()*1.1 + 16384){
+           assert(buffer->Reserve(cset->columns[1]->buffer.length()*1.1 + 16384) == 1);
+        }
+
+        int vers = 4;
+
+        size_t out_size = 0;
+        int64_t n_in = cset->columns[1]->buffer.length();
+        ret += Compress(vers, cset, buffer, out_size);
+        // Incompressible data can expand beyond the input size.
+        if(cset->columns[1]->buffer.capacity() < (int64_t)out_size) {
+            assert(cset->columns[1]->buffer.Resize(out_size, false) == 1);
+        }
+        memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), out_size);
+        cset->columns[1]->compressed_size = out_size;
+        cset->columns[1]->buffer.UnsafeSetLength(out_size);
+        cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_QUAL, n_in, out_size));
+        cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->checksum_type, cset->columns[1]->buffer.mutable_data(), out_size);
+
+        if(ret < 0) return(ret);
+
+        int ret1 = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Compress(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
+        if(ret1 < 0) return(-6); // compression failure
+        ret += ret1;
+
+        // Compress the Nullity bitmap
+        int retNull = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->CompressNullity(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
+        if(retNull < 0) return(-6); // compression failure
+        ret += retNull;
+        //std::cerr << ">>>>>>>>>>NULLITY=" << n_nullity << "->" << retNull << std::endl;
+
+    } else {
+        //std::cerr << "unknown cstore type" << std::endl;
+        return(-1);
+    }
+
+    return(ret);
+}
+
+int QualityCompressor::Decompress(std::shared_ptr<ColumnSet> cset, PIL_CSTORE_TYPE cstore) {
+    if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-2);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
+    if(cset->columns[1]->transformation_args.back()->ctype != PIL_COMPRESS_RC_QUAL) return(-4);
+
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, cset->columns[1]->transformation_args.back()->u_sz + 16384, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < cset->columns[1]->transformation_args.back()->u_sz + 16384){
+        assert(buffer->Reserve(cset->columns[1]->transformation_args.back()->u_sz + 16384) == 1);
+    }
+    size_t ret = cset->columns[1]->transformation_args.back()->u_sz;
+    Decompress(cset, buffer, ret);
+    memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), ret);
+    cset->columns[1]->buffer.UnsafeSetLength(ret);
+
+    return(ret);
+}
+
+// sequence
+
+bool SequenceCompressor::IsLossless(const uint8_t* bases, const uint64_t n_bases) {
+    for(uint64_t i = 0; i < n_bases; ++i) {
+        switch(bases[i]) {
+        case('A'): case('C'): case('G'): case('T'): case('N'): break;
+        default: return(false);
+        }
+    }
+    return(true);
+}
+
+int SequenceCompressor::Compress(std::shared_ptr<ColumnSet> cset, PIL_CSTORE_TYPE cstore) {
+    if(cset.get() == nullptr) return(-1);
+
+    int ret = 0;
+    if(cstore == PIL_CSTORE_COLUMN) {
+        //std::cerr << "in cstore col: COMPUTING BASES" << std::endl;
+        for(int i = 0; i < cset->columns.size(); ++i) {
+            if(cset->columns[i].get() == nullptr) return(-2);
+
+            std::shared_ptr<ColumnStore> tgt = cset->columns[i];
+            if(IsLossless(tgt->buffer.mutable_data(), tgt->buffer.length()) == false) {
+                int64_t ret2 = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Compress(tgt, PIL_ZSTD_DEFAULT_LEVEL);
+                if(ret2 < 0) return(-6); // compression failure
+                ret += ret2;
+                continue;
+            }
+            uint32_t n_l = tgt->buffer.length();
+            int64_t n_in = tgt->buffer.length();
+            int ret2 = Compress(tgt->buffer.mutable_data(), tgt->buffer.length(), &n_l, 1);
+            tgt->compressed_size = ret2;
+            memcpy(tgt->buffer.mutable_data(), buffer->mutable_data(), ret2);
+            tgt->buffer.UnsafeSetLength(ret2);
+            tgt->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_BASES, n_in, ret2));
+            tgt->transformation_args.back()->ComputeChecksum(tgt->checksum_type, tgt->buffer.mutable_data(), ret2);
+            ret += ret2;
+        }
+    } else if(cstore == PIL_CSTORE_TENSOR) {
+        if(cset->size() != 2) return(-3);
+        if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-2);
+
+        // Batches with bytes the models cannot represent are stored with ZSTD.
+        if(IsLossless(cset->columns[1]->buffer.mutable_data(), cset->columns[1]->buffer.length()) == false) {
+            int64_t ret2 = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Compress(cset->columns[1], PIL_ZSTD_DEFAULT_LEVEL);
+            if(ret2 < 0) return(-6); // compression failure
+            int ret1 = CompressStrides(cset);
+            if(ret1 < 0) return(ret1);
+            return(ret2 + ret1);
+        }
+
+        static_cast<DeltaEncoder*>(static_cast<Transformer*>(this))->UnsafeEncode(cset->columns[0]);
+
+        int64_t n_in = cset->columns[1]->buffer.length();
+        int ret2 = Compress(cset->columns[1]->buffer.mutable_data(),
+                            cset->columns[1]->buffer.length(),
+                            reinterpret_cast<uint32_t*>(cset->columns[0]->buffer.mutable_data()),
+                            cset->columns[0]->n_records);
+
+        cset->columns[1]->compressed_size = ret2;
+        cset->columns[1]->buffer.UnsafeSetLength(ret2);
+        cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_BASES,n_in,ret2));
+        memcpy(cset->columns[1]->buffer.mutable_data(), buffer->mutable_data(), ret2);
+        cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->checksum_type, cset->columns[1]->buffer.mutable_data(), ret2);
+        ret += ret2;
+
+        int ret1 = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Compress(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
+        if(ret1 < 0) return(-6); // compression failure
+        ret += ret1;
+
+        // Compress the Nullity bitmap
+        int retNull = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->CompressNullity(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
+        if(retNull < 0) return(-6); // compression failure
+        ret += retNull;
+
+    } else {
+        //std::cerr << "unknown cstore type" << std::endl;
+        return(-1);
+    }
+
+    return(ret);
+}
+
+int SequenceCompressor::Compress(const uint8_t* bases, const uint32_t n_src, const uint32_t* lengths, const uint32_t n_lengths) {
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, n_src + 65536, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < n_src + 65536) {
+        assert(buffer->Reserve(n_src + 65536) == 1);
+    }
+
+    // slevel in range [1,9);
+    int slevel = 3; // Number of bases of sequence context.
+    int NS = 7 + slevel;
+    const int NS_MASK = ((1 << (2*NS)) - 1);
+    /* Corresponds to a 12-mer word that doesn't occur in human genome. */
+    int last  = 0x7616c7 & NS_MASK;
+
+    ModelArray< BaseModel<uint16_t> > model_seq16(model_pool_, 1 << (2 * NS));
+    if(model_seq16.data() == nullptr) return(-5);
+    FrequencyModel<2> model_null(2);
+
+    int L[256];
+    /* ACGTN* */
+    for (int i = 0; i < 256; i++) L[i] = -1;
+    L['A'] = L['a'] = 0;
+    L['C'] = L['c'] = 1;
+    L['G'] = L['g'] = 2;
+    L['T'] = L['t'] = 3;
+    L['N'] = L['n'] = 4;
+
+    RangeCoder rc;
+    rc.StartEncode();
+    rc.SetOutput(buffer->mutable_data());
+
+    uint32_t cum_offset = 0;
+    for(int i = 1; i < n_lengths; ++i) {
+        for (int j = 0; j < lengths[i]; ++j) {
+            const uint8_t b = L[(uint8_t)bases[cum_offset + j]];
+            if(b == 4) model_null.EncodeSymbol(&rc, 1);
+            else {
+                model_null.EncodeSymbol(&rc, 0);
+                //const uint8_t b = L[(uint8_t)bases[cum_offset + j]];
+                model_seq16[last].EncodeSymbol(&rc, b);
+                last = (last*4 + b) & NS_MASK;
+                //volatile int p = *(int *)&model_seq16[last];
+                _mm_prefetch((const char *)&model_seq16[last], _MM_HINT_T0);
+            }
+        }
+        cum_offset += lengths[i];
+    }
+
+   rc.FinishEncode();
+
+   return(rc.OutSize());
+}
+
+int SequenceCompressor::DecompressStrides(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+    if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-2);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
+    if(cset->columns[1]->transformation_args.size() == 0) return(-4);
+    const PIL_COMPRESSION_TYPE ctype = cset->columns[1]->transformation_args.back()->ctype;
+    if(ctype != PIL_COMPRESS_RC_BASES && ctype != PIL_COMPRESS_ZSTD) return(-4);
+
+    return(Compressor::DecompressStrides(cset, field));
+}
+
+int SequenceCompressor::Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+    if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-2);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
+    if(cset->columns[1]->transformation_args.size() == 0) return(-4);
+    const PIL_COMPRESSION_TYPE ctype = cset->columns[1]->transformation_args.back()->ctype;
+    if(ctype != PIL_COMPRESS_RC_BASES && ctype != PIL_COMPRESS_ZSTD) return(-4);
+
+    // Decompress stride data.
+    int dec_strides = DecompressStrides(cset, field);
+    if(dec_strides < 0) return(dec_strides);
+
+    // Batches the models cannot represent were stored with ZSTD.
+    if(ctype == PIL_COMPRESS_ZSTD) {
+        int64_t ret = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Decompress(cset->columns[1], cset->columns[1]->transformation_args.back());
+        if(ret < 0) return(-5);
+        if(ret != cset->columns[1]->transformation_args.back()->u_sz) return(-6);
+        cset->columns[1]->buffer.UnsafeSetLength(ret);
+        return(ret);
+    }
+
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, cset->columns[1]->transformation_args.back()->u_sz + 16384, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < cset->columns[1]->transformation_args.back()->u_sz + 16384){
+        assert(buffer->Reserve(cset->columns[1]->transformation_args.back()->u_sz + 16384) == 1);
+    }
+
+    int slevel = 3; // Number of bases of sequence context.
+    int NS = 7 + slevel;
+    const int NS_MASK = ((1 << (2*NS)) - 1);
+    ModelArray< BaseModel<uint16_t> > model_seq16(model_pool_, 1 << (2 * NS));
+    if(model_seq16.data() == nullptr) return(-5);
+    FrequencyModel<2> model_null(2);
+    uint8_t* out = buffer->mutable_data();
+    const char* dec = "ACGTN";
+    int last  = 0x7616c7 & NS_MASK;
+    const uint32_t u_sz = cset->columns[1]->transformation_args.back()->u_sz;
+
+    RangeCoder rc;
+    rc.SetInput(cset->columns[1]->mutable_data());
+    rc.StartDecode();
+
+    for (int i = 0; i < u_sz; i++) {
+        const uint8_t null = model_null.DecodeSymbol(&rc);
+        if(null == 0) {
+            const uint8_t b = model_seq16[last].DecodeSymbol(&rc);
+            out[i] = dec[b];
+            last = (last*4 + b) & NS_MASK;
+            _mm_prefetch((const char *)&model_seq16[last], _MM_HINT_T0);
+        } else {
+            out[i] = 'N';
+        }
+    }
+    rc.FinishDecode();
+    std::cerr << std::endl;
+
+    memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), u_sz);
+    cset->columns[1]->buffer.UnsafeSetLength(u_sz);
+
+    return(u_sz);
+}
+
+// reference-based sequence
+
+// Models used by the reference-based sequence codec. Encoding and decoding
+// must construct identical model states.
+struct ReferenceBaseModels {
+    static constexpr int NS = 10; // Order-k context for bases not placed on the reference.
+    static constexpr int NS_MASK = ((1 << (2*NS)) - 1);
+
+    explicit ReferenceBaseModels(MemoryPool* pool) : model_seq16(pool, 1 << (2 * NS)) {}
+
+    FrequencyModel<3> model_mode; // 0: reference, 1: order-k ACGTN, 2: raw bytes
+    FrequencyModel<2> model_match[8]; // Match/mismatch conditioned on the last three outcomes.
+    FrequencyModel<5> model_sub[5]; // Substituted base conditioned on the reference base.
+    FrequencyModel<5> model_ins[25]; // Inserted bases conditioned on the previous two bases.
+    FrequencyModel<5> model_clip[25]; // Soft-clipped bases conditioned on the previous two bases.
+    FrequencyModel<256> model_raw;
+    FrequencyModel<2> model_null;
+    ModelArray< BaseModel<uint16_t> > model_seq16;
+};
+
+/**<
+ * Compute the number of query bases and the number of reference bases
+ * consumed by a CIGAR string in text format.
+ * @param cigar     CIGAR text (e.g. 10S90M).
+ * @param n_cigar   Length of the CIGAR text.
+ * @param query_len Destination number of query bases.
+ * @param ref_span  Destination number of reference bases.
+ * @return          Returns 1 if the CIGAR is valid or a negative value otherwise.
+ */
+static int CigarSpans(const uint8_t* cigar, const uint32_t n_cigar, uint32_t& query_len, uint32_t& ref_span) {
+    query_len = 0; ref_span = 0;
+    if(n_cigar == 0 || (n_cigar == 1 && cigar[0] == '*')) return(-1);
+
+    uint32_t len = 0; bool have_len = false;
+    for(uint32_t i = 0; i < n_cigar; ++i) {
+        if(cigar[i] >= '0' && cigar[i] <= '9') {
+            len = len * 10 + (cigar[i] - '0');
+            have_len = true;
+            continue;
+        }
+        if(have_len == false) return(-2);
+
+        switch(cigar[i]) {
+        case('M'): case('='): case('X'): query_len += len; ref_span += len; break;
+        case('I'): case('S'): query_len += len; break;
+        case('D'): case('N'): ref_span += len; break;
+        case('H'): case('P'): break;
+        default: return(-2);
+        }
+        len = 0; have_len = false;
+    }
+    if(have_len) return(-2); // trailing length without operation
+
+    return(1);
+}
+
+/**<
+ * Retrieve the reference placement of a read from the alignment fields.
+ * @param context   Source ReferenceContext.
+ * @param i         Target record.
+ * @param contig_id Destination contig identifier.
+ * @param pos       Destination 0-based start position.
+ * @param cigar     Destination pointer to the CIGAR text.
+ * @param n_cigar   Destination length of the CIGAR text.
+ * @return          Returns TRUE if the read is placed or FALSE otherwise.
+ */
+static bool ReferencePlacement(const ReferenceContext& context, const uint32_t i,
+                               uint32_t& contig_id, int64_t& pos,
+                               const uint8_t*& cigar, uint32_t& n_cigar)
+{
+    if(context.rname->size() == 0 || context.pos->size() == 0 || context.cigar->size() != 2) return false;
+
+    std::shared_ptr<ColumnStore> rname = context.rname->columns[0];
+    std::shared_ptr<ColumnStore> rpos  = context.pos->columns[0];
+    if(i >= rname->n_records || i >= rpos->n_records) return false;
+    if(i + 1 >= context.cigar->columns[0]->n_records) return false;
+    if(rname->nullity.get() != nullptr && rname->IsValid(i) == false) return false;
+    if(rpos->nullity.get() != nullptr && rpos->IsValid(i) == false) return false;
+
+    contig_id = reinterpret_cast<const uint32_t*>(rname->mutable_data())[i];
+    pos = (int64_t)reinterpret_cast<const uint32_t*>(rpos->mutable_data())[i] - 1;
+    if(contig_id >= context.reference->size() || pos < 0) return false;
+
+    const uint32_t* cigar_offsets = reinterpret_cast<const uint32_t*>(context.cigar->columns[0]->mutable_data());
+    cigar   = context.cigar->columns[1]->mutable_data() + cigar_offsets[i];
+    n_cigar = cigar_offsets[i + 1] - cigar_offsets[i];
+
+    return true;
+}
+
+int ReferenceSequenceCompressor::Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+    if(cset.get() == nullptr) return(-1);
+    if(field.cstore != PIL_CSTORE_TENSOR) return(-1);
+
+    // Without a reference we use the reference-free models.
+    if(ref_context.IsAvailable() == false)
+        return(static_cast<SequenceCompressor*>(static_cast<Transformer*>(this))->Compress(cset, field.cstore));
+
+    if(cset->size() != 2) return(-3);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-2);
+    if(cset->columns[0]->n_records == 0) return(-3);
+
+    int ret = 0;
+    int64_t n_in = cset->columns[1]->buffer.length();
+    int ret2 = Compress(cset->columns[1]->buffer.mutable_data(),
+                        reinterpret_cast<const uint32_t*>(cset->columns[0]->buffer.mutable_data()),
+                        cset->columns[0]->n_records - 1,
+                        ref_context);
+    if(ret2 < 0) return(ret2);
+
+    // Unmapped reads and reads with non-ACGTN bytes are stored verbatim and
+    // the output of short columns may exceed the input.
+    if(cset->columns[1]->buffer.capacity() < ret2) {
+        if(cset->columns[1]->buffer.Resize(ret2, false) != 1) return(-6);
+    }
+
+    memcpy(cset->columns[1]->buffer.mutable_data(), buffer->mutable_data(), ret2);
+    cset->columns[1]->compressed_size = ret2;
+    cset->columns[1]->buffer.UnsafeSetLength(ret2);
+    cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_REF_BASES,n_in,ret2));
+    cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->checksum_type, cset->columns[1]->buffer.mutable_data(), ret2);
+
+    // Store the fingerprint of the reference such that decoding can assert
+    // that the same reference is used.
+    std::unique_ptr<TransformMetaTuple> tuple(new TransformMetaTuple());
+    tuple->ptype  = PIL_TYPE_UINT64;
+    tuple->n_data = 1;
+    tuple->data   = new uint8_t[sizeof(uint64_t)];
+    const uint64_t fingerprint = ref_context.reference->Fingerprint();
+    memcpy(tuple->data, &fingerprint, sizeof(uint64_t));
+    cset->columns[1]->transformation_args.back()->tuples.push_back(std::move(tuple));
+    ret += ret2;
+
+    // Compress the strides and their Nullity bitmap.
+    int ret1 = CompressStrides(cset);
+    if(ret1 < 0) return(ret1);
+    ret += ret1;
+
+    return(ret);
+}
+
+int ReferenceSequenceCompressor::Compress(const uint8_t* bases, const uint32_t* offsets, const uint32_t n_records, const ReferenceContext& context) {
+    if(context.IsAvailable() == false) return(-1);
+
+    // Every symbol costs at most 16 bits in the adaptive models and reads
+    // placed on the reference emit at most two symbols per base.
+    const uint32_t n_src = offsets[n_records];
+    const int64_t n_bound = 4*(int64_t)n_src + 2*(int64_t)n_records + 65536;
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, n_bound, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < n_bound) {
+        assert(buffer->Reserve(n_bound) == 1);
+    }
+
+    ReferenceBaseModels models(model_pool_);
+    if(models.model_seq16.data() == nullptr) return(-5);
+    std::vector<uint8_t> ref;
+    int last = 0x7616c7 & ReferenceBaseModels::NS_MASK;
+
+    RangeCoder rc;
+    rc.StartEncode();
+    rc.SetOutput(buffer->mutable_data());
+
+    for(uint32_t i = 0; i < n_records; ++i) {
+        const uint32_t len = offsets[i + 1] - offsets[i];
+        if(len == 0) continue;
+        const uint8_t* seq = &bases[offsets[i]];
+
+        // Reads with bytes outside of ACGTN are stored verbatim.
+        uint8_t mode = 1;
+        for(uint32_t j = 0; j < len; ++j) {
+            if(seq[j] != 'A' && seq[j] != 'C' && seq[j] != 'G' && seq[j] != 'T' && seq[j] != 'N') {
+                mode = 2;
+                break;
+            }
+        }
+
+        uint32_t contig_id = 0, n_cigar = 0, query_len = 0, ref_span = 0;
+        int64_t pos = 0;
+        const uint8_t* cigar = nullptr;
+        if(mode == 1 &&
+           ReferencePlacement(context, i, contig_id, pos, cigar, n_cigar) &&
+           CigarSpans(cigar, n_cigar, query_len, ref_span) == 1 &&
+           query_len == len &&
+           pos + ref_span <= context.reference->GetContig(contig_id).length)
+        {
+            mode = 0;
+        }
+
+        models.model_mode.EncodeSymbol(&rc, mode);
+
+        if(mode == 2) {
+            for(uint32_t j = 0; j < len; ++j)
+                models.model_raw.EncodeSymbol(&rc, seq[j]);
+            continue;
+        }
+
+        if(mode == 1) {
+            for(uint32_t j = 0; j < len; ++j) {
+                const uint8_t b = ReferenceBaseTable[seq[j]];
+                if(b == 4) models.model_null.EncodeSymbol(&rc, 1);
+                else {
+                    models.model_null.EncodeSymbol(&rc, 0);
+                    models.model_seq16[last].EncodeSymbol(&rc, b);
+                    last = (last*4 + b) & ReferenceBaseModels::NS_MASK;
+                    _mm_prefetch((const char *)&models.model_seq16[last], _MM_HINT_T0);
+                }
+            }
+            continue;
+        }
+
+        // Walk the CIGAR operations and encode differences to the reference.
+        if(ref.size() < ref_span) ref.resize(ref_span);
+        if(context.reference->Fetch(contig_id, pos, ref_span, ref.data()) != ref_span) return(-4);
+
+        uint32_t q = 0, r = 0, op_len = 0;
+        uint8_t match_ctx = 0, prev1 = 0, prev2 = 0;
+        for(uint32_t k = 0; k < n_cigar; ++k) {
+            if(cigar[k] >= '0' && cigar[k] <= '9') {
+                op_len = op_len * 10 + (cigar[k] - '0');
+                continue;
+            }
+
+            switch(cigar[k]) {
+            case('M'): case('='): case('X'):
+                for(uint32_t j = 0; j < op_len; ++j, ++q, ++r) {
+                    const uint8_t b  = ReferenceBaseTable[seq[q]];
+                    const uint8_t rb = ReferenceBaseTable[ref[r]];
+                    const uint8_t mismatch = (b != rb);
+                    models.model_match[match_ctx].EncodeSymbol(&rc, mismatch);
+                    if(mismatch) models.model_sub[rb].EncodeSymbol(&rc, b);
+                    match_ctx = ((match_ctx << 1) | mismatch) & 7;
+                    prev2 = prev1; prev1 = b;
+                }
+                break;
+            case('I'): case('S'):
+                for(uint32_t j = 0; j < op_len; ++j, ++q) {
+                    const uint8_t b = ReferenceBaseTable[seq[q]];
+                    if(cigar[k] == 'I') models.model_ins[prev2*5 + prev1].EncodeSymbol(&rc, b);
+                    else models.model_clip[prev2*5 + prev1].EncodeSymbol(&rc, b);
+                    prev2 = prev1; prev1 = b;
+                }
+                break;
+            case('D'): case('N'): r += op_len; break;
+            default: break; // H and P consume nothing
+            }
+            op_len = 0;
+        }
+    }
+
+    rc.FinishEncode();
+
+    return(rc.OutSize());
+}
+
+int ReferenceSequenceCompressor::Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+    if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-2);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
+    if(cset->columns[1]->transformation_args.size() == 0) return(-4);
+
+    // Data may have been stored without a reference.
+    if(cset->columns[1]->transformation_args.back()->ctype == PIL_COMPRESS_RC_BASES ||
+       cset->columns[1]->transformation_args.back()->ctype == PIL_COMPRESS_ZSTD)
+        return(static_cast<SequenceCompressor*>(static_cast<Transformer*>(this))->Decompress(cset, field));
+
+    if(cset->columns[1]->transformation_args.back()->ctype != PIL_COMPRESS_REF_BASES) return(-4);
+    if(ref_context.IsAvailable() == false) return(-5);
+
+    // Make sure we are decoding against the same reference.
+    std::shared_ptr<TransformMeta> meta = cset->columns[1]->transformation_args.back();
+    if(meta->tuples.size()) {
+        uint64_t fingerprint = 0;
+        memcpy(&fingerprint, meta->tuples[0]->data, sizeof(uint64_t));
+        if(fingerprint != ref_context.reference->Fingerprint()) return(-7);
+    }
+
+    // Decompress stride data.
+    int dec_strides = DecompressStrides(cset, field);
+    if(dec_strides < 0) return(dec_strides);
+
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, meta->u_sz + 16384, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < meta->u_sz + 16384){
+        assert(buffer->Reserve(meta->u_sz + 16384) == 1);
+    }
+
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data());
+    const uint32_t n_records = cset->columns[0]->n_records - 1;
+    const uint32_t u_sz = meta->u_sz;
+    if(offsets[n_records] != u_sz) return(-6);
+
+    ReferenceBaseModels models(model_pool_);
+    if(models.model_seq16.data() == nullptr) return(-8);
+    std::vector<uint8_t> ref;
+    const char* dec = "ACGTN";
+    int last = 0x7616c7 & ReferenceBaseModels::NS_MASK;
+    uint8_t* out = buffer->mutable_data();
+
+    RangeCoder rc;
+    rc.SetInput(cset->columns[1]->mutable_data());
+    rc.StartDecode();
+
+    for(uint32_t i = 0; i < n_records; ++i) {
+        const uint32_t len = offsets[i + 1] - offsets[i];
+        if(len == 0) continue;
+        uint8_t* seq = &out[offsets[i]];
+
+        const uint8_t mode = models.model_mode.DecodeSymbol(&rc);
+        if(mode == 2) {
+            for(uint32_t j = 0; j < len; ++j)
+                seq[j] = models.model_raw.DecodeSymbol(&rc);
+            continue;
+        }
+
+        if(mode == 1) {
+            for(uint32_t j = 0; j < len; ++j) {
+                const uint8_t null = models.model_null.DecodeSymbol(&rc);
+                if(null == 0) {
+                    const uint8_t b = models.model_seq16[last].DecodeSymbol(&rc);
+                    seq[j] = dec[b];
+                    last = (last*4 + b) & ReferenceBaseModels::NS_MASK;
+                    _mm_prefetch((const char *)&models.model_seq16[last], _MM_HINT_T0);
+                } else {
+                    seq[j] = 'N';
+                }
+            }
+            continue;
+        }
+
+        uint32_t contig_id = 0, n_cigar = 0, query_len = 0, ref_span = 0;
+        int64_t pos = 0;
+        const uint8_t* cigar = nullptr;
+        if(ReferencePlacement(ref_context, i, contig_id, pos, cigar, n_cigar) == false) return(-8);
+        if(CigarSpans(cigar, n_cigar, query_len, ref_span) != 1 || query_len != len) return(-8);
+        if(ref.size() < ref_span) ref.resize(ref_span);
+        if(ref_context.reference->Fetch(contig_id, pos, ref_span, ref.data()) != ref_span) return(-8);
+
+        uint32_t q = 0, r = 0, op_len = 0;
+        uint8_t match_ctx = 0, prev1 = 0, prev2 = 0;
+        for(uint32_t k = 0; k < n_cigar; ++k) {
+            if(cigar[k] >= '0' && cigar[k] <= '9') {
+                op_len = op_len * 10 + (cigar[k] - '0');
+                continue;
+            }
+
+            switch(cigar[k]) {
+            case('M'): case('='): case('X'):
+                for(uint32_t j = 0; j < op_len; ++j, ++q, ++r) {
+                    const uint8_t rb = ReferenceBaseTable[ref[r]];
+                    const uint8_t mismatch = models.model_match[match_ctx].DecodeSymbol(&rc);
+                    const uint8_t b = mismatch ? models.model_sub[rb].DecodeSymbol(&rc) : rb;
+                    seq[q] = dec[b];
+                    match_ctx = ((match_ctx << 1) | mismatch) & 7;
+                    prev2 = prev1; prev1 = b;
+                }
+                break;
+            case('I'): case('S'):
+                for(uint32_t j = 0; j < op_len; ++j, ++q) {
+                    const uint8_t b = cigar[k] == 'I' ? models.model_ins[prev2*5 + prev1].DecodeSymbol(&rc)
+                                                      : models.model_clip[prev2*5 + prev1].DecodeSymbol(&rc);
+                    seq[q] = dec[b];
+                    prev2 = prev1; prev1 = b;
+                }
+                break;
+            case('D'): case('N'): r += op_len; break;
+            default: break; // H and P consume nothing
+            }
+            op_len = 0;
+        }
+    }
+    rc.FinishDecode();
+
+    memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), u_sz);
+    cset->columns[1]->buffer.UnsafeSetLength(u_sz);
+
+    return(u_sz);
+}
+
+// cigar
+
+// Models used by the CIGAR codec. Encoding and decoding must construct
+// identical model states.
+struct CigarModels {
+    FrequencyModel<4> model_mode; // 0: empty, 1: '*', 2: operations, 3: raw text
+    FrequencyModel<256> model_nops[3]; // Varint bytes of the number of operations or raw text length.
+    FrequencyModel<16> model_op[16]; // Operation conditioned on the previous operation.
+    FrequencyModel<256> model_len[9][3]; // Varint bytes of lengths conditioned on the operation and byte index.
+    FrequencyModel<256> model_raw;
+};
+
+static const char* PIL_CIGAR_OPS = "MIDNSHP=X";
+
+// Varints are range coded with separate models for the first, second and
+// any remaining bytes.
+static inline void RangeEncodeVarint(RangeCoder* rc, FrequencyModel<256>* models, uint32_t value) {
+    for(int k = 0; ; ++k) {
+        const uint8_t b = (value & 0x7F) | ((value > 0x7F) << 7);
+        models[k < 2 ? k : 2].EncodeSymbol(rc, b);
+        value >>= 7;
+        if(value == 0) break;
+    }
+}
+
+static inline uint32_t RangeDecodeVarint(RangeCoder* rc, FrequencyModel<256>* models) {
+    uint32_t value = 0;
+    for(int k = 0; k < 5; ++k) {
+        const uint8_t b = models[k < 2 ? k : 2].DecodeSymbol(rc);
+        value |= (uint32_t)(b & 0x7F) << (7*k);
+        if((b & 0x80) == 0) break;
+    }
+    return(value);
+}
+
+int CigarCompressor::ParseCigar(const uint8_t* cigar, const uint32_t n_cigar, std::vector<uint32_t>& out) {
+    out.clear();
+
+    uint32_t len = 0, n_digits = 0;
+    for(uint32_t i = 0; i < n_cigar; ++i) {
+        if(cigar[i] >= '0' && cigar[i] <= '9') {
+            // Leading zeros cannot be reconstructed.
+            if(n_digits == 1 && len == 0) return(-1);
+            len = len * 10 + (cigar[i] - '0');
+            if(++n_digits > 9 || len >= (1 << 28)) return(-1);
+            continue;
+        }
+        if(n_digits == 0) return(-1);
+
+        const char* op = (const char*)memchr(PIL_CIGAR_OPS, cigar[i], 9);
+        if(op == nullptr) return(-1);
+        out.push_back(len << 4 | (op - PIL_CIGAR_OPS));
+        len = 0; n_digits = 0;
+    }
+    if(n_digits) return(-1); // trailing length without operation
+
+    return(out.size());
+}
+
+/**<
+ * Decode the two CIGAR streams into text and/or reference spans.
+ * @param pool         Pool for the models.
+ * @param ops          Operation stream.
+ * @param lengths      Length stream.
+ * @param n_records    Number of records.
+ * @param out          Destination for CIGAR text or nullptr.
+ * @param out_capacity Size of the destination for CIGAR text.
+ * @param spans        Destination for reference spans or nullptr.
+ * @return             Returns the number of text bytes decoded, -1 if the models cannot be allocated, -2 if the streams are corrupt, or -3 if the text does not fit in the destination.
+ */
+static int64_t CigarDecodeStreams(MemoryPool* pool, uint8_t* ops, uint8_t* lengths, const uint32_t n_records, uint8_t* out, const int64_t out_capacity, uint32_t* spans) {
+    ModelArray<CigarModels> models(pool, 1);
+    if(models.data() == nullptr) return(-1);
+    RangeCoder rc_ops, rc_len;
+    rc_ops.SetInput(ops);
+    rc_ops.StartDecode();
+    rc_len.SetInput(lengths);
+    rc_len.StartDecode();
+
+    int64_t n_out = 0;
+    char digits[16];
+    for(uint32_t i = 0; i < n_records; ++i) {
+        uint32_t span = 0;
+        const uint8_t mode = models->model_mode.DecodeSymbol(&rc_ops);
+        if(mode == 1) {
+            if(out) {
+                if(n_out + 1 > out_capacity) return(-3);
+                out[n_out] = '*';
+            }
+            ++n_out;
+        } else if(mode == 2) {
+            const uint32_t n_ops = RangeDecodeVarint(&rc_ops, models->model_nops);
+            uint8_t prev = 15;
+            for(uint32_t j = 0; j < n_ops; ++j) {
+                const uint8_t op = models->model_op[prev].DecodeSymbol(&rc_ops);
+                // The model holds 16 symbols but only the 9 operations are
+                // ever encoded.
+                if(op > 8) return(-2);
+                const uint32_t len = RangeDecodeVarint(&rc_len, models->model_len[op]);
+                if(len >= (1 << 28)) return(-2);
+                span += len & -((CigarCompressor::PIL_CIGAR_CONSUMES_REF >> op) & 1);
+                prev = op;
+
+                int n_digits = 0;
+                uint32_t v = len;
+                do { digits[n_digits++] = '0' + v % 10; v /= 10; } while(v);
+                if(out) {
+                    if(n_out + n_digits + 1 > out_capacity) return(-3);
+                    while(n_digits) out[n_out++] = digits[--n_digits];
+                    out[n_out++] = PIL_CIGAR_OPS[op];
+                } else {
+                    n_out += n_digits + 1;
+                }
+            }
+        } else if(mode == 3) {
+            const uint32_t n_raw = RangeDecodeVarint(&rc_ops, models->model_nops);
+            if(out && n_out + n_raw > out_capacity) return(-3);
+            for(uint32_t j = 0; j < n_raw; ++j) {
+                const uint8_t b = models->model_raw.DecodeSymbol(&rc_ops);
+                if(out) out[n_out] = b;
+                ++n_out;
+            }
+        }
+        if(spans) spans[i] = span;
+    }
+
+    rc_ops.FinishDecode();
+    rc_len.FinishDecode();
+
+    return(n_out);
+}
+
+int CigarCompressor::Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+    if(cset.get() == nullptr) return(-1);
+    if(field.cstore != PIL_CSTORE_TENSOR) return(-1);
+    if(cset->size() != 2) return(-3);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-2);
+    if(cset->columns[0]->n_records == 0) return(-3);
+
+    int ret = 0;
+    int64_t n_in = cset->columns[1]->buffer.length();
+    int ret2 = Compress(cset->columns[1]->buffer.mutable_data(),
+                        reinterpret_cast<const uint32_t*>(cset->columns[0]->buffer.mutable_data()),
+                        cset->columns[0]->n_records - 1);
+    if(ret2 < 0) return(ret2);
+
+    // The compressed streams may be larger than the input for very short
+    // columns.
+    if(cset->columns[1]->buffer.capacity() < ret2) {
+        assert(cset->columns[1]->buffer.Resize(ret2, false) == 1);
+    }
+
+    memcpy(cset->columns[1]->buffer.mutable_data(), buffer->mutable_data(), ret2);
+    cset->columns[1]->compressed_size = ret2;
+    cset->columns[1]->buffer.UnsafeSetLength(ret2);
+    cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_ENCODE_CIGAR_NIBBLE,n_in,ret2));
+    cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->checksum_type, cset->columns[1]->buffer.mutable_data(), ret2);
+    ret += ret2;
+
+    // Compress the strides and their Nullity bitmap.
+    int ret1 = CompressStrides(cset);
+    if(ret1 < 0) return(ret1);
+    ret += ret1;
+
+    return(ret);
+}
+
+int CigarCompressor::Compress(const uint8_t* cigars, const uint32_t* offsets, const uint32_t n_records) {
+    // Every symbol costs at most 16 bits in the adaptive models and every
+    // text byte emits at most five symbols. The two streams are written to
+    // separate halves of the buffer and then joined.
+    const uint32_t n_src = offsets[n_records];
+    const int64_t n_bound = 10*(int64_t)n_src + 16*(int64_t)n_records + 65536;
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, 2*n_bound, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < 2*n_bound) {
+        assert(buffer->Reserve(2*n_bound) == 1);
+    }
+
+    ModelArray<CigarModels> models(model_pool_, 1);
+    if(models.data() == nullptr) return(-1);
+    std::vector<uint32_t> ops;
+
+    RangeCoder rc_ops, rc_len;
+    rc_ops.StartEncode();
+    rc_ops.SetOutput(buffer->mutable_data() + sizeof(uint32_t));
+    rc_len.StartEncode();
+    rc_len.SetOutput(buffer->mutable_data() + n_bound);
+
+    for(uint32_t i = 0; i < n_records; ++i) {
+        const uint8_t* cigar = &cigars[offsets[i]];
+        const uint32_t n_cigar = offsets[i + 1] - offsets[i];
+
+        if(n_cigar == 0) {
+            models->model_mode.EncodeSymbol(&rc_ops, 0);
+        } else if(n_cigar == 1 && cigar[0] == '*') {
+            models->model_mode.EncodeSymbol(&rc_ops, 1);
+        } else if(ParseCigar(cigar, n_cigar, ops) > 0) {
+            models->model_mode.EncodeSymbol(&rc_ops, 2);
+            RangeEncodeVarint(&rc_ops, models->model_nops, ops.size());
+            uint8_t prev = 15;
+            for(size_t j = 0; j < ops.size(); ++j) {
+                const uint8_t op = ops[j] & 0xF;
+                models->model_op[prev].EncodeSymbol(&rc_ops, op);
+                RangeEncodeVarint(&rc_len, models->model_len[op], ops[j] >> 4);
+                prev = op;
+            }
+        } else {
+            models->model_mode.EncodeSymbol(&rc_ops, 3);
+            RangeEncodeVarint(&rc_ops, models->model_nops, n_cigar);
+            for(uint32_t j = 0; j < n_cigar; ++j)
+                models->model_raw.EncodeSymbol(&rc_ops, cigar[j]);
+        }
+    }
+
+    rc_ops.FinishEncode();
+    rc_len.FinishEncode();
+
+    // Stream layout: [operation stream size][operation stream][length stream]
+    const uint32_t n_ops_stream = rc_ops.OutSize();
+    const uint32_t n_len_stream = rc_len.OutSize();
+    memcpy(buffer->mutable_data(), &n_ops_stream, sizeof(uint32_t));
+    memmove(buffer->mutable_data() + sizeof(uint32_t) + n_ops_stream, buffer->mutable_data() + n_bound, n_len_stream);
+
+    return(sizeof(uint32_t) + n_ops_stream + n_len_stream);
+}
+
+int CigarCompressor::Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+    if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-2);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
+    if(cset->columns[1]->transformation_args.size() == 0) return(-4);
+    if(cset->columns[1]->transformation_args.back()->ctype != PIL_ENCODE_CIGAR_NIBBLE) return(-4);
+
+    const uint32_t u_sz = cset->columns[1]->transformation_args.back()->u_sz;
+    // Decompress stride data.
+    int dec_strides = DecompressStrides(cset, field);
+    if(dec_strides < 0) return(dec_strides);
+
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, u_sz + 16384, &buffer) == 1);
+    }
+
+    if(buffer->capacity() < u_sz + 16384){
+        assert(buffer->Reserve(u_sz + 16384) == 1);
+    }
+
+    const uint32_t n_records = cset->columns[0]->n_records - 1;
+    uint8_t* in = cset->columns[1]->mutable_data();
+    uint32_t n_ops_stream = 0;
+    memcpy(&n_ops_stream, in, sizeof(uint32_t));
+
+    const int64_t n_out = CigarDecodeStreams(model_pool_, in + sizeof(uint32_t), in + sizeof(uint32_t) + n_ops_stream, n_records, buffer->mutable_data(), buffer->capacity(), nullptr);
+    if(n_out < 0) return(-5);
+    if(n_out != u_sz) return(-6);
+    if(reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data())[n_records] != u_sz) return(-6);
+
+    if(cset->columns[1]->buffer.capacity() < u_sz) {
+        assert(cset->columns[1]->buffer.Resize(u_sz, false) == 1);
+    }
+    memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), u_sz);
+    cset->columns[1]->buffer.UnsafeSetLength(u_sz);
+    cset->columns[1]->transformation_args.pop_back();
+
+    return(u_sz);
+}
+
+int CigarCompressor::ReferenceSpans(std::shared_ptr<ColumnSet> cset, std::vector<uint32_t>& spans) {
+    if(cset.get() == nullptr) return(-1);
+    if(cset->size() != 2) return(-2);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
+    if(cset->columns[1]->transformation_args.size() == 0) return(-4);
+    if(cset->columns[1]->transformation_args.back()->ctype != PIL_ENCODE_CIGAR_NIBBLE) return(-4);
+
+    // The record count is unaffected by compression of the strides.
+    const uint32_t n_records = cset->columns[0]->n_records - 1;
+    spans.resize(n_records);
+
+    uint8_t* in = cset->columns[1]->mutable_data();
+    uint32_t n_ops_stream = 0;
+    memcpy(&n_ops_stream, in, sizeof(uint32_t));
+
+    const int64_t n_out = CigarDecodeStreams(model_pool_, in + sizeof(uint32_t), in + sizeof(uint32_t) + n_ops_stream, n_records, nullptr, 0, spans.data());
+    if(n_out < 0) return(-5);
+    if(n_out != cset->columns[1]->transformation_args.back()->u_sz) return(-6);
+
+    return(n_records);
+}
+
+// names
+
+// Token types of the name codec. MATCH and DELTA refer to the token at the
+// same position in the previous name.
+enum PIL_NAME_TOKEN_TYPE : uint8_t {
+    PIL_NAME_TOK_END, PIL_NAME_TOK_MATCH, PIL_NAME_TOK_DELTA, PIL_NAME_TOK_DIGITS,
+    PIL_NAME_TOK_DIGITS0, PIL_NAME_TOK_STRING, PIL_NAME_TOK_CHAR
+};
+
+struct NameToken {
+    NameToken() : type(PIL_NAME_TOK_END), start(0), len(0), value(0){}
+
+    uint8_t  type;
+    uint32_t start, len; // Offset and length of the token in the name.
+    uint32_t value; // Integer value of DIGITS and DIGITS0 tokens.
+};
+
+// Models used by the name codec, one set per token position.
+struct NameModels {
+    FrequencyModel<8>   model_type[NameCompressor::PIL_NAME_MAX_TOKENS];
+    FrequencyModel<256> model_delta[NameCompressor::PIL_NAME_MAX_TOKENS];
+    FrequencyModel<256> model_digits[NameCompressor::PIL_NAME_MAX_TOKENS][3];
+    FrequencyModel<16>  model_width[NameCompressor::PIL_NAME_MAX_TOKENS];
+    FrequencyModel<256> model_len[NameCompressor::PIL_NAME_MAX_TOKENS][3];
+    FrequencyModel<256> model_str[NameCompressor::PIL_NAME_MAX_TOKENS];
+    FrequencyModel<256> model_char[NameCompressor::PIL_NAME_MAX_TOKENS];
+};
+
+static inline bool NameIsDigit(const uint8_t c) { return(c >= '0' && c <= '9'); }
+static inline bool NameIsAlpha(const uint8_t c) { return((c | 0x20) >= 'a' && (c | 0x20) <= 'z'); }
+
+static inline void NameDigitsToken(const uint8_t* name, NameToken& tok) {
+    tok.value = 0;
+    for(uint32_t i = 0; i < tok.len; ++i) tok.value = tok.value * 10 + (name[tok.start + i] - '0');
+    tok.type = (tok.len > 1 && name[tok.start] == '0') ? PIL_NAME_TOK_DIGITS0 : PIL_NAME_TOK_DIGITS;
+}
+
+/**<
+ * Split a name into tokens. Alphanumeric runs are split into their letter and
+ * digit parts unless they alternate more than once (e.g. hexadecimal UUID
+ * parts) in which case they are kept as a single string. Digit runs longer
+ * than 9 characters are stored as strings.
+ * @param name   Source name.
+ * @param n_name Length of the name.
+ * @param toks   Destination tokens with room for PIL_NAME_MAX_TOKENS tokens.
+ * @return       Returns the number of tokens.
+ */
+static uint32_t NameTokenize(const uint8_t* name, const uint32_t n_name, NameToken* toks) {
+    uint32_t n_toks = 0, p = 0;
+    while(p < n_name) {
+        NameToken& tok = toks[n_toks];
+        tok.start = p;
+
+        // The remainder of the name is stored as a single string.
+        if(n_toks + 1 == NameCompressor::PIL_NAME_MAX_TOKENS) {
+            tok.type = PIL_NAME_TOK_STRING;
+            tok.len  = n_name - p;
+            ++n_toks;
+            break;
+        }
 
-    if(buffer.get() == nullptr) {
-        assert(AllocateResizableBuffer(pool_, meta->u_sz + 16384, &buffer) == 1);
-    }
+        if(NameIsDigit(name[p]) || NameIsAlpha(name[p])) {
+            uint32_t q = p + 1, n_switch = 0, split = 0;
+            for(; q < n_name && (NameIsDigit(name[q]) || NameIsAlpha(name[q])); ++q) {
+                if(NameIsDigit(name[q]) != NameIsDigit(name[q-1])) {
+                    ++n_switch;
+                    split = q;
+                }
+            }
 
-    if(buffer->capacity() < meta->u_sz + 8196) {
-        buffer->Reserve(meta->u_sz + 8196);
+            tok.len = (n_switch == 1 ? split : q) - p;
+            if(n_switch > 1) tok.type = PIL_NAME_TOK_STRING;
+            else if(NameIsDigit(name[p]) && tok.len <= 9) NameDigitsToken(name, tok);
+            else tok.type = PIL_NAME_TOK_STRING;
+        } else {
+            tok.type = PIL_NAME_TOK_CHAR;
+            tok.len  = 1;
+        }
+        p += tok.len;
+        ++n_toks;
     }
 
-    return(UnsafeDecompress(cstore, back_copy));
+    return(n_toks);
 }
 
-
-// quality
-
-int QualityCompressor::Compress(std::shared_ptr<ColumnSet> cset, PIL_CSTORE_TYPE cstore) {
+int NameCompressor::Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
     if(cset.get() == nullptr) return(-1);
+    if(field.cstore != PIL_CSTORE_TENSOR) return(-1);
+    if(cset->size() != 2) return(-3);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-2);
+    if(cset->columns[0]->n_records == 0) return(-3);
 
     int ret = 0;
-    if(cstore == PIL_CSTORE_COLUMN) {
-        //std::cerr << "in cstore col" << std::endl;
-        for(int i = 0; i < cset->columns.size(); ++i) {
-            std::cerr << "not imeplemented yet: compress multicol" << std::endl;
-            exit(1);
-            /*
-            if(cset->columns[i].get() == nullptr) return(-2);
-            std::shared_ptr<ColumnStore> tgt = cset->columns[i];
-            uint32_t n_l = tgt->buffer.length();
-            int64_t n_in = tgt->buffer.length();
-            int ret2 = Compress(tgt->buffer.mutable_data(), tgt->buffer.length(), &n_l, 1);
-            tgt->compressed_size = ret2;
-            memcpy(tgt->buffer.mutable_data(), buffer->mutable_data(), ret2);
-            tgt->buffer.UnsafeSetLength(ret2);
-            tgt->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_QUAL, n_in, ret2));
-            tgt->transformation_args.back()->ComputeChecksum(tgt->buffer.mutable_data(), ret2);
-            ret += ret2;
-            */
-        }
-    } else if(cstore == PIL_CSTORE_TENSOR) {
-        if(cset->size() != 2) return(-3);
-        if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-2);
+    int64_t n_in = cset->columns[1]->buffer.length();
+    int ret2 = Compress(cset->columns[1]->buffer.mutable_data(),
+                        reinterpret_cast<const uint32_t*>(cset->columns[0]->buffer.mutable_data()),
+                        cset->columns[0]->n_records - 1);
+    if(ret2 < 0) return(ret2);
+
+    if(cset->columns[1]->buffer.capacity() < ret2) {
+        assert(cset->columns[1]->buffer.Resize(ret2, false) == 1);
+    }
 
-        static_cast<DeltaEncoder*>(static_cast<Transformer*>(this))->UnsafeEncode(cset->columns[0]);
+    memcpy(cset->columns[1]->buffer.mutable_data(), buffer->mutable_data(), ret2);
+    cset->columns[1]->compressed_size = ret2;
+    cset->columns[1]->buffer.UnsafeSetLength(ret2);
+    cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_ILLUMINA_NAME,n_in,ret2));
+    cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->checksum_type, cset->columns[1]->buffer.mutable_data(), ret2);
+    ret += ret2;
 
-        if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
+    // Compress the strides and their Nullity bitmap.
+    int ret1 = CompressStrides(cset);
+    if(ret1 < 0) return(ret1);
+    ret += ret1;
 
-        if(buffer.get() == nullptr) {
-           assert(AllocateResizableBuffer(pool_, cset->columns[1]->buffer.length()*1.1 + 16384, &buffer) == 1);
-        }
+    return(ret);
+}
 
-        if(buffer->capacity() < cset->columns[1]->buffer.length()*1.1 + 16384){
-           assert(buffer->Reserve(cset->columns[1]->buffer.length()*1.1 + 16384) == 1);
-        }
+int NameCompressor::Compress(const uint8_t* names, const uint32_t* offsets, const uint32_t n_records) {
+    // Every token emits at most 12 symbols of at most 16 bits each and every
+    // token covers at least one byte of the input.
+    const uint32_t n_src = offsets[n_records];
+    const int64_t n_bound = 24*(int64_t)n_src + 2*(int64_t)n_records + 65536;
+    if(buffer.get() == nullptr) {
+        assert(AllocateResizableBuffer(pool_, n_bound, &buffer) == 1);
+    }
 
-        int vers = 4;
+    if(buffer->capacity() < n_bound) {
+        assert(buffer->Reserve(n_bound) == 1);
+    }
 
-        size_t out_size = 0;
-        int64_t n_in = cset->columns[1]->buffer.length();
-        ret += Compress(vers, cset, buffer, out_size);
-        memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), out_size);
-        cset->columns[1]->compressed_size = out_size;
-        cset->columns[1]->buffer.UnsafeSetLength(out_size);
-        cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_QUAL, n_in, out_size));
-        cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->buffer.mutable_data(), out_size);
+    ModelArray<NameModels> models(model_pool_, 1);
+    if(models.data() == nullptr) return(-1);
+    NameToken toks[2][PIL_NAME_MAX_TOKENS];
+    uint32_t n_toks[2] = {0, 0};
+    const uint8_t* prev_name = names;
+    int cur = 0;
 
-        if(ret < 0) return(ret);
+    RangeCoder rc;
+    rc.StartEncode();
+    rc.SetOutput(buffer->mutable_data());
 
-        int64_t n_in0 = cset->columns[0]->buffer.length();
-        int ret1 = reinterpret_cast<ZstdCompressor*>(this)->Compress(
-                                       cset->columns[0]->buffer.mutable_data(),
-                                       cset->columns[0]->buffer.length(),
-                                       PIL_ZSTD_DEFAULT_LEVEL);
-
-        memcpy(cset->columns[0]->buffer.mutable_data(), buffer->mutable_data(), ret1);
-        cset->columns[0]->compressed_size = ret1;
-        cset->columns[0]->buffer.UnsafeSetLength(ret1);
-        cset->columns[0]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_ZSTD, n_in0, ret1));
-        cset->columns[0]->transformation_args.back()->ComputeChecksum(cset->columns[0]->buffer.mutable_data(), ret1);
-        ret += ret1;
+    for(uint32_t i = 0; i < n_records; ++i) {
+        const uint8_t* name = &names[offsets[i]];
+        const uint32_t n_name = offsets[i + 1] - offsets[i];
+        NameToken* ctoks = toks[cur];
+        const NameToken* ptoks = toks[cur ^ 1];
+        const uint32_t n_prev = n_toks[cur ^ 1];
+
+        n_toks[cur] = NameTokenize(name, n_name, ctoks);
+        for(uint32_t j = 0; j < n_toks[cur]; ++j) {
+            const NameToken& t = ctoks[j];
+
+            if(j < n_prev && ptoks[j].type == t.type && ptoks[j].len == t.len &&
+               memcmp(&prev_name[ptoks[j].start], &name[t.start], t.len) == 0)
+            {
+                models->model_type[j].EncodeSymbol(&rc, PIL_NAME_TOK_MATCH);
+                continue;
+            }
 
-        // Compress the Nullity bitmap
-        if(cset->columns[0]->nullity.get() == nullptr) return(-5); // malformed data
+            if(j < n_prev && t.type == PIL_NAME_TOK_DIGITS && ptoks[j].type == PIL_NAME_TOK_DIGITS &&
+               t.value > ptoks[j].value && t.value - ptoks[j].value < 256)
+            {
+                models->model_type[j].EncodeSymbol(&rc, PIL_NAME_TOK_DELTA);
+                models->model_delta[j].EncodeSymbol(&rc, t.value - ptoks[j].value);
+                continue;
+            }
 
-        const uint32_t n_nullity = std::ceil((float)cset->columns[0]->n_records / 32);
-        int retNull = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Compress(
-                                     cset->columns[0]->nullity->mutable_data(),
-                                     n_nullity,
-                                     PIL_ZSTD_DEFAULT_LEVEL);
+            models->model_type[j].EncodeSymbol(&rc, t.type);
+            switch(t.type) {
+            case(PIL_NAME_TOK_DIGITS0):
+                models->model_width[j].EncodeSymbol(&rc, t.len);
+                // fall through
+            case(PIL_NAME_TOK_DIGITS):
+                RangeEncodeVarint(&rc, models->model_digits[j], t.value);
+                break;
+            case(PIL_NAME_TOK_STRING):
+                RangeEncodeVarint(&rc, models->model_len[j], t.len);
+                for(uint32_t k = 0; k < t.len; ++k)
+                    models->model_str[j].EncodeSymbol(&rc, name[t.start + k]);
+                break;
+            case(PIL_NAME_TOK_CHAR):
+                models->model_char[j].EncodeSymbol(&rc, name[t.start]);
+                break;
+            }
+        }
 
-        if(retNull < 0) return(-6); // compression failure
-        cset->columns[0]->nullity_u = n_nullity;
-        cset->columns[0]->nullity_c = retNull;
-        memcpy(cset->columns[0]->nullity->mutable_data(), buffer->mutable_data(), retNull);
-        ret += retNull;
-        //std::cerr << ">>>>>>>>>>NULLITY=" << n_nullity << "->" << retNull << std::endl;
+        if(n_toks[cur] < PIL_NAME_MAX_TOKENS)
+            models->model_type[n_toks[cur]].EncodeSymbol(&rc, PIL_NAME_TOK_END);
 
-    } else {
-        //std::cerr << "unknown cstore type" << std::endl;
-        return(-1);
+        // Empty names (including missing values) are not used as the
+        // reference for the next name.
+        if(n_name) {
+            prev_name = name;
+            cur ^= 1;
+        }
     }
 
-    return(ret);
+    rc.FinishEncode();
+
+    return(rc.OutSize());
 }
 
-int QualityCompressor::Decompress(std::shared_ptr<ColumnSet> cset, PIL_CSTORE_TYPE cstore) {
+int NameCompressor::Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
     if(cset.get() == nullptr) return(-1);
     if(cset->size() != 2) return(-2);
     if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
-    if(cset->columns[1]->transformation_args.back()->ctype != PIL_COMPRESS_RC_QUAL) return(-4);
+    if(cset->columns[1]->transformation_args.size() == 0) return(-4);
+    if(cset->columns[1]->transformation_args.back()->ctype != PIL_COMPRESS_RC_ILLUMINA_NAME) return(-4);
+
+    const uint32_t u_sz = cset->columns[1]->transformation_args.back()->u_sz;
+    // Decompress stride data.
+    int dec_strides = DecompressStrides(cset, field);
+    if(dec_strides < 0) return(dec_strides);
 
     if(buffer.get() == nullptr) {
-        assert(AllocateResizableBuffer(pool_, cset->columns[1]->transformation_args.back()->u_sz + 16384, &buffer) == 1);
+        assert(AllocateResizableBuffer(pool_, u_sz + 16384, &buffer) == 1);
     }
 
-    if(buffer->capacity() < cset->columns[1]->transformation_args.back()->u_sz + 16384){
-        assert(buffer->Reserve(cset->columns[1]->transformation_args.back()->u_sz + 16384) == 1);
+    if(buffer->capacity() < u_sz + 16384){
+        assert(buffer->Reserve(u_sz + 16384) == 1);
     }
-    size_t ret = cset->columns[1]->transformation_args.back()->u_sz;
-    Decompress(cset, buffer, ret);
-    memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), ret);
-    cset->columns[1]->buffer.UnsafeSetLength(ret);
 
-    return(ret);
-}
+    const uint32_t n_records = cset->columns[0]->n_records - 1;
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data());
+    if(offsets[n_records] != u_sz) return(-6);
 
-// sequence
+    ModelArray<NameModels> models(model_pool_, 1);
+    if(models.data() == nullptr) return(-7);
+    NameToken toks[2][PIL_NAME_MAX_TOKENS];
+    uint32_t n_toks[2] = {0, 0};
+    uint8_t* out = buffer->mutable_data();
+    uint32_t n_out = 0, prev_name = 0;
+    int cur = 0;
+    char digits[16];
 
-int SequenceCompressor::Compress(std::shared_ptr<ColumnSet> cset, PIL_CSTORE_TYPE cstore) {
-    if(cset.get() == nullptr) return(-1);
+    RangeCoder rc;
+    rc.SetInput(cset->columns[1]->mutable_data());
+    rc.StartDecode();
 
-    int ret = 0;
-    if(cstore == PIL_CSTORE_COLUMN) {
-        //std::cerr << "in cstore col: COMPUTING BASES" << std::endl;
-        for(int i = 0; i < cset->columns.size(); ++i) {
-            if(cset->columns[i].get() == nullptr) return(-2);
+    int ret = u_sz;
+    for(uint32_t i = 0; i < n_records; ++i) {
+        NameToken* ctoks = toks[cur];
+        const NameToken* ptoks = toks[cur ^ 1];
+        const uint32_t n_prev = n_toks[cur ^ 1];
+        const uint32_t start = n_out;
+
+        uint32_t j = 0;
+        for(; j < PIL_NAME_MAX_TOKENS; ++j) {
+            uint8_t type = models->model_type[j].DecodeSymbol(&rc);
+            if(type == PIL_NAME_TOK_END) break;
+
+            NameToken& t = ctoks[j];
+            t.start = n_out - start;
+            if((type == PIL_NAME_TOK_MATCH || type == PIL_NAME_TOK_DELTA) && j >= n_prev) { ret = -6; break; }
+
+            switch(type) {
+            case(PIL_NAME_TOK_MATCH):
+                t = ptoks[j];
+                t.start = n_out - start;
+                if(n_out + t.len > u_sz) { ret = -6; break; }
+                memcpy(&out[n_out], &out[prev_name + ptoks[j].start], t.len);
+                n_out += t.len;
+                break;
+            case(PIL_NAME_TOK_DELTA):
+            case(PIL_NAME_TOK_DIGITS):
+            case(PIL_NAME_TOK_DIGITS0):
+            {
+                uint32_t width = 0;
+                if(type == PIL_NAME_TOK_DELTA) t.value = ptoks[j].value + models->model_delta[j].DecodeSymbol(&rc);
+                else {
+                    if(type == PIL_NAME_TOK_DIGITS0) width = models->model_width[j].DecodeSymbol(&rc);
+                    t.value = RangeDecodeVarint(&rc, models->model_digits[j]);
+                }
+                t.type = (type == PIL_NAME_TOK_DIGITS0 ? PIL_NAME_TOK_DIGITS0 : PIL_NAME_TOK_DIGITS);
+
+                int n_digits = 0;
+                uint32_t v = t.value;
+                do { digits[n_digits++] = '0' + v % 10; v /= 10; } while(v);
+                while(n_digits < (int)width) digits[n_digits++] = '0';
+                if(n_out + n_digits > u_sz) { ret = -6; break; }
+                t.len = n_digits;
+                while(n_digits) out[n_out++] = digits[--n_digits];
+                break;
+            }
+            case(PIL_NAME_TOK_STRING):
+                t.type = type;
+                t.len  = RangeDecodeVarint(&rc, models->model_len[j]);
+                if(n_out + t.len > u_sz) { ret = -6; break; }
+                for(uint32_t k = 0; k < t.len; ++k)
+                    out[n_out++] = models->model_str[j].DecodeSymbol(&rc);
+                break;
+            case(PIL_NAME_TOK_CHAR):
+                t.type = type;
+                t.len  = 1;
+                if(n_out + 1 > u_sz) { ret = -6; break; }
+                out[n_out++] = models->model_char[j].DecodeSymbol(&rc);
+                break;
+            default: ret = -6; break;
+            }
+            if(ret < 0) break;
+        }
+        if(ret < 0) break;
 
-            std::shared_ptr<ColumnStore> tgt = cset->columns[i];
-            uint32_t n_l = tgt->buffer.length();
-            int64_t n_in = tgt->buffer.length();
-            int ret2 = Compress(tgt->buffer.mutable_data(), tgt->buffer.length(), &n_l, 1);
-            tgt->compressed_size = ret2;
-            memcpy(tgt->buffer.mutable_data(), buffer->mutable_data(), ret2);
-            tgt->buffer.UnsafeSetLength(ret2);
-            tgt->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_BASES, n_in, ret2));
-            tgt->transformation_args.back()->ComputeChecksum(tgt->buffer.mutable_data(), ret2);
-            ret += ret2;
+        n_toks[cur] = j;
+        if(n_out != offsets[i + 1]) { ret = -6; break; }
+        if(n_out != start) {
+            prev_name = start;
+            cur ^= 1;
         }
-    } else if(cstore == PIL_CSTORE_TENSOR) {
-        if(cset->size() != 2) return(-3);
-        if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-2);
+    }
 
-        static_cast<DeltaEncoder*>(static_cast<Transformer*>(this))->UnsafeEncode(cset->columns[0]);
+    rc.FinishDecode();
+    if(ret < 0) return(ret);
 
-        int64_t n_in = cset->columns[1]->buffer.length();
-        int ret2 = Compress(cset->columns[1]->buffer.mutable_data(),
-                            cset->columns[1]->buffer.length(),
-                            reinterpret_cast<uint32_t*>(cset->columns[0]->buffer.mutable_data()),
-                            cset->columns[0]->n_records);
+    if(cset->columns[1]->buffer.capacity() < u_sz) {
+        assert(cset->columns[1]->buffer.Resize(u_sz, false) == 1);
+    }
+    memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), u_sz);
+    cset->columns[1]->buffer.UnsafeSetLength(u_sz);
+    cset->columns[1]->transformation_args.pop_back();
 
-        cset->columns[1]->compressed_size = ret2;
-        cset->columns[1]->buffer.UnsafeSetLength(ret2);
-        cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_RC_BASES,n_in,ret2));
-        memcpy(cset->columns[1]->buffer.mutable_data(), buffer->mutable_data(), ret2);
-        cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->buffer.mutable_data(), ret2);
-        ret += ret2;
+    return(u_sz);
+}
 
-        int64_t n_in0 = cset->columns[0]->buffer.length();
-        int ret1 = reinterpret_cast<ZstdCompressor*>(this)->Compress(
-                                       cset->columns[0]->buffer.mutable_data(),
-                                       cset->columns[0]->buffer.length(),
-                                       PIL_ZSTD_DEFAULT_LEVEL);
+// pbwt
 
-        memcpy(cset->columns[0]->buffer.mutable_data(), buffer->mutable_data(), ret1);
-        cset->columns[0]->compressed_size = ret1;
-        cset->columns[0]->buffer.UnsafeSetLength(ret1);
-        cset->columns[0]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_ZSTD, n_in0, ret1));
-        cset->columns[0]->transformation_args.back()->ComputeChecksum(cset->columns[0]->buffer.mutable_data(), ret1);
+// Models used by the PBWT codec. Encoding and decoding must construct
+// identical model states.
+struct PbwtModels {
+    FrequencyModel<4> model_sym[5]; // Symbol of a run conditioned on the symbol of the previous run (4: first run).
+    FrequencyModel<256> model_len[4][3]; // Varint bytes of run lengths minus one conditioned on the symbol and byte index.
+};
 
-        ret += ret1;
+// Update the prefix array with a stable counting sort of the permuted column
+// `y`. Both arrays hold `n_haplotypes` values and `tmp` is scratch space.
+static void PbwtUpdatePrefix(uint32_t* ppa, const uint8_t* y, const uint32_t n_haplotypes, uint32_t* tmp) {
+    uint32_t starts[4] = {0, 0, 0, 0};
+    for(uint32_t j = 0; j < n_haplotypes; ++j) ++starts[y[j]];
+    uint32_t total = 0;
+    for(int k = 0; k < 4; ++k) {
+        const uint32_t n = starts[k];
+        starts[k] = total;
+        total += n;
+    }
 
-        // Compress the Nullity bitmap
-        if(cset->columns[0]->nullity.get() == nullptr) return(-5); // malformed data
+    for(uint32_t j = 0; j < n_haplotypes; ++j) tmp[starts[y[j]]++] = ppa[j];
+    memcpy(ppa, tmp, n_haplotypes*sizeof(uint32_t));
+}
 
-        const uint32_t n_nullity = std::ceil((float)cset->columns[0]->n_records / 32);
-        int retNull = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Compress(
-                                     cset->columns[0]->nullity->mutable_data(),
-                                     n_nullity,
-                                     PIL_ZSTD_DEFAULT_LEVEL);
+// Reset the prefix array to the identity for a new number of haplotypes.
+static void PbwtResetPrefix(std::vector<uint32_t>& ppa, std::vector<uint32_t>& tmp, std::vector<uint8_t>& y, const uint32_t n_haplotypes) {
+    ppa.resize(n_haplotypes);
+    tmp.resize(n_haplotypes);
+    y.resize(n_haplotypes);
+    for(uint32_t j = 0; j < n_haplotypes; ++j) ppa[j] = j;
+}
 
-        if(retNull < 0) return(-6); // compression failure
-        cset->columns[0]->nullity_u = n_nullity;
-        cset->columns[0]->nullity_c = retNull;
-        memcpy(cset->columns[0]->nullity->mutable_data(), buffer->mutable_data(), retNull);
-        ret += retNull;
+int PbwtCompressor::Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+    if(cset.get() == nullptr) return(-1);
+    if(field.cstore != PIL_CSTORE_TENSOR) return(-1);
+    if(cset->size() != 2) return(-3);
+    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-2);
+    if(cset->columns[0]->n_records == 0) return(-3);
 
-    } else {
-        //std::cerr << "unknown cstore type" << std::endl;
-        return(-1);
+    int ret = 0;
+    int64_t n_in = cset->columns[1]->buffer.length();
+    int ret2 = Compress(cset->columns[1]->buffer.mutable_data(),
+                        reinterpret_cast<const uint32_t*>(cset->columns[0]->buffer.mutable_data()),
+                        cset->columns[0]->n_records - 1);
+    if(ret2 < 0) return(ret2);
+
+    if(cset->columns[1]->buffer.capacity() < ret2) {
+        assert(cset->columns[1]->buffer.Resize(ret2, false) == 1);
     }
 
+    memcpy(cset->columns[1]->buffer.mutable_data(), buffer->mutable_data(), ret2);
+    cset->columns[1]->compressed_size = ret2;
+    cset->columns[1]->buffer.UnsafeSetLength(ret2);
+    cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_ENCODE_PBWT,n_in,ret2));
+    cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->checksum_type, cset->columns[1]->buffer.mutable_data(), ret2);
+    ret += ret2;
+
+    // Compress the strides and their Nullity bitmap.
+    int ret1 = CompressStrides(cset);
+    if(ret1 < 0) return(ret1);
+    ret += ret1;
+
     return(ret);
 }
 
-int SequenceCompressor::Compress(const uint8_t* bases, const uint32_t n_src, const uint32_t* lengths, const uint32_t n_lengths) {
+int PbwtCompressor::Compress(const uint8_t* data, const uint32_t* offsets, const uint32_t n_records) {
+    // Every byte holds four symbols and every symbol starts at most one run
+    // costing a symbol and one or more length bytes of at most 16 bits each.
+    const uint32_t n_src = offsets[n_records];
+    const int64_t n_bound = 24*(int64_t)n_src + 65536;
     if(buffer.get() == nullptr) {
-        assert(AllocateResizableBuffer(pool_, n_src + 65536, &buffer) == 1);
+        assert(AllocateResizableBuffer(pool_, n_bound, &buffer) == 1);
     }
 
-    if(buffer->capacity() < n_src + 65536) {
-        assert(buffer->Reserve(n_src + 65536) == 1);
+    if(buffer->capacity() < n_bound) {
+        assert(buffer->Reserve(n_bound) == 1);
     }
 
-    // slevel in range [1,9);
-    int slevel = 3; // Number of bases of sequence context.
-    int NS = 7 + slevel;
-    const int NS_MASK = ((1 << (2*NS)) - 1);
-    /* Corresponds to a 12-mer word that doesn't occur in human genome. */
-    int last  = 0x7616c7 & NS_MASK;
-
-    BaseModel<uint16_t>* model_seq16 = new BaseModel<uint16_t>[1 << (2 * NS)];
-    FrequencyModel<2> model_null(2);
-
-    int L[256];
-    /* ACGTN* */
-    for (int i = 0; i < 256; i++) L[i] = -1;
-    L['A'] = L['a'] = 0;
-    L['C'] = L['c'] = 1;
-    L['G'] = L['g'] = 2;
-    L['T'] = L['t'] = 3;
-    L['N'] = L['n'] = 4;
+    ModelArray<PbwtModels> models(model_pool_, 1);
+    if(models.data() == nullptr) return(-1);
+    std::vector<uint32_t> ppa, tmp;
+    std::vector<uint8_t> y;
+    uint32_t n_haplotypes = 0;
 
     RangeCoder rc;
     rc.StartEncode();
     rc.SetOutput(buffer->mutable_data());
 
-    uint32_t cum_offset = 0;
-    for(int i = 1; i < n_lengths; ++i) {
-        for (int j = 0; j < lengths[i]; ++j) {
-            const uint8_t b = L[(uint8_t)bases[cum_offset + j]];
-            if(b == 4) model_null.EncodeSymbol(&rc, 1);
-            else {
-                model_null.EncodeSymbol(&rc, 0);
-                //const uint8_t b = L[(uint8_t)bases[cum_offset + j]];
-                model_seq16[last].EncodeSymbol(&rc, b);
-                last = (last*4 + b) & NS_MASK;
-                //volatile int p = *(int *)&model_seq16[last];
-                _mm_prefetch((const char *)&model_seq16[last], _MM_HINT_T0);
-            }
+    for(uint32_t i = 0; i < n_records; ++i) {
+        const uint8_t* site = &data[offsets[i]];
+        const uint32_t n_site = offsets[i + 1] - offsets[i];
+        if(n_site == 0) continue;
+        if(4*n_site != n_haplotypes) {
+            n_haplotypes = 4*n_site;
+            PbwtResetPrefix(ppa, tmp, y, n_haplotypes);
         }
-        cum_offset += lengths[i];
-    }
-
-   rc.FinishEncode();
-   delete[] model_seq16;
-
-   return(rc.OutSize());
-}
-
-int SequenceCompressor::DecompressStrides(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
-    if(cset.get() == nullptr) return(-1);
-    if(cset->size() != 2) return(-2);
-    if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
-    if(cset->columns[1]->transformation_args.back()->ctype != PIL_COMPRESS_RC_BASES) return(-4);
 
-    if(buffer.get() == nullptr) {
-        assert(AllocateResizableBuffer(pool_, cset->columns[0]->transformation_args.back()->u_sz + 16384, &buffer) == 1);
-    }
+        // Permute the column by the prefix array.
+        for(uint32_t j = 0; j < n_haplotypes; ++j)
+            y[j] = (site[ppa[j] >> 2] >> ((ppa[j] & 3) << 1)) & 3;
+
+        uint8_t prev = 4;
+        for(uint32_t j = 0; j < n_haplotypes; ) {
+            const uint8_t sym = y[j];
+            uint32_t k = j + 1;
+            while(k < n_haplotypes && y[k] == sym) ++k;
+            models->model_sym[prev].EncodeSymbol(&rc, sym);
+            RangeEncodeVarint(&rc, models->model_len[sym], k - j - 1);
+            prev = sym;
+            j = k;
+        }
 
-    if(buffer->capacity() < cset->columns[0]->transformation_args.back()->u_sz + 16384){
-        assert(buffer->Reserve(cset->columns[0]->transformation_args.back()->u_sz + 16384) == 1);
+        PbwtUpdatePrefix(ppa.data(), y.data(), n_haplotypes, tmp.data());
     }
 
-    if(cset->columns[0]->transformation_args.size() != 2) return(-4);
-    // Decompress strides
-    if(cset->columns[0]->transformation_args.back()->ctype != PIL_COMPRESS_ZSTD) return(-4);
-    int decomp = static_cast<ZstdCompressor*>(static_cast<Transformer*>(this))->Decompress(cset->columns[0], cset->columns[0]->transformation_args.back());
-    if(decomp < 0) return(-5);
-    if(decomp != cset->columns[0]->transformation_args.back()->u_sz) return(-6);
-    cset->columns[0]->transformation_args.pop_back();
-    // Prefix compute the stride lengths
-    if(cset->columns[0]->transformation_args.back()->ctype != PIL_ENCODE_DELTA) return(-4);
-    static_cast<DeltaEncoder*>(static_cast<Transformer*>(this))->UnsafePrefixSum(cset->columns[0], field);
-    int ret = cset->columns[0]->transformation_args.back()->u_sz;
-    cset->columns[0]->transformation_args.pop_back();
+    rc.FinishEncode();
 
-    return(ret);
+    return(rc.OutSize());
 }
 
-int SequenceCompressor::Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+int PbwtCompressor::Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
     if(cset.get() == nullptr) return(-1);
     if(cset->size() != 2) return(-2);
     if(cset->columns[0].get() == nullptr || cset->columns[1].get() == nullptr) return(-3);
-    if(cset->columns[1]->transformation_args.back()->ctype != PIL_COMPRESS_RC_BASES) return(-4);
+    if(cset->columns[1]->transformation_args.size() == 0) return(-4);
+    if(cset->columns[1]->transformation_args.back()->ctype != PIL_ENCODE_PBWT) return(-4);
+
+    const uint32_t u_sz = cset->columns[1]->transformation_args.back()->u_sz;
+    // Decompress stride data.
+    int dec_strides = DecompressStrides(cset, field);
+    if(dec_strides < 0) return(dec_strides);
 
     if(buffer.get() == nullptr) {
-        assert(AllocateResizableBuffer(pool_, cset->columns[1]->transformation_args.back()->u_sz + 16384, &buffer) == 1);
+        assert(AllocateResizableBuffer(pool_, u_sz + 16384, &buffer) == 1);
     }
 
-    if(buffer->capacity() < cset->columns[1]->transformation_args.back()->u_sz + 16384){
-        assert(buffer->Reserve(cset->columns[1]->transformation_args.back()->u_sz + 16384) == 1);
+    if(buffer->capacity() < u_sz + 16384){
+        assert(buffer->Reserve(u_sz + 16384) == 1);
     }
 
-    // Decompress stride data.
-    int dec_strides = DecompressStrides(cset, field);
-    if(dec_strides < 0) return(dec_strides);
+    const uint32_t n_records = cset->columns[0]->n_records - 1;
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data());
+    if(offsets[n_records] != u_sz) return(-6);
 
-    int slevel = 3; // Number of bases of sequence context.
-    int NS = 7 + slevel;
-    const int NS_MASK = ((1 << (2*NS)) - 1);
-    BaseModel<uint16_t>* model_seq16 = new BaseModel<uint16_t>[1 << (2 * NS)];
-    FrequencyModel<2> model_null(2);
     uint8_t* out = buffer->mutable_data();
-    const char* dec = "ACGTN";
-    int last  = 0x7616c7 & NS_MASK;
-    const uint32_t u_sz = cset->columns[1]->transformation_args.back()->u_sz;
+    memset(out, 0, u_sz);
+
+    ModelArray<PbwtModels> models(model_pool_, 1);
+    if(models.data() == nullptr) return(-5);
+    std::vector<uint32_t> ppa, tmp;
+    std::vector<uint8_t> y;
+    uint32_t n_haplotypes = 0;
 
     RangeCoder rc;
     rc.SetInput(cset->columns[1]->mutable_data());
     rc.StartDecode();
 
-    for (int i = 0; i < u_sz; i++) {
-        const uint8_t null = model_null.DecodeSymbol(&rc);
-        if(null == 0) {
-            const uint8_t b = model_seq16[last].DecodeSymbol(&rc);
-            out[i] = dec[b];
-            last = (last*4 + b) & NS_MASK;
-            _mm_prefetch((const char *)&model_seq16[last], _MM_HINT_T0);
-        } else {
-            out[i] = 'N';
+    int ret = u_sz;
+    for(uint32_t i = 0; i < n_records; ++i) {
+        uint8_t* site = &out[offsets[i]];
+        const uint32_t n_site = offsets[i + 1] - offsets[i];
+        if(n_site == 0) continue;
+        if(4*n_site != n_haplotypes) {
+            n_haplotypes = 4*n_site;
+            PbwtResetPrefix(ppa, tmp, y, n_haplotypes);
+        }
+
+        uint8_t prev = 4;
+        for(uint32_t j = 0; j < n_haplotypes; ) {
+            const uint8_t sym = models->model_sym[prev].DecodeSymbol(&rc);
+            const uint32_t len = RangeDecodeVarint(&rc, models->model_len[sym]);
+            if(len >= n_haplotypes - j) { ret = -6; break; }
+            memset(&y[j], sym, len + 1);
+            prev = sym;
+            j += len + 1;
         }
+        if(ret < 0) break;
+
+        // Scatter the permuted column back to haplotype order.
+        for(uint32_t j = 0; j < n_haplotypes; ++j)
+            site[ppa[j] >> 2] |= y[j] << ((ppa[j] & 3) << 1);
+
+        PbwtUpdatePrefix(ppa.data(), y.data(), n_haplotypes, tmp.data());
     }
+
     rc.FinishDecode();
-    delete[] model_seq16;
-    std::cerr << std::endl;
+    if(ret < 0) return(ret);
 
+    if(cset->columns[1]->buffer.capacity() < u_sz) {
+        assert(cset->columns[1]->buffer.Resize(u_sz, false) == 1);
+    }
     memcpy(cset->columns[1]->mutable_data(), buffer->mutable_data(), u_sz);
     cset->columns[1]->buffer.UnsafeSetLength(u_sz);
+    cset->columns[1]->transformation_args.pop_back();
 
     return(u_sz);
 }
@@ -805,7 +2210,8 @@ int QualityCompressor::Compress(int vers, std::shared_ptr<ColumnSet> quals, std:
         stab[1] = 1 << q_sloc;
 
     const uint32_t n_qmodels = (1 << 16);
-    FrequencyModel<QMAX>* model_qual = new FrequencyModel<QMAX>[n_qmodels];
+    ModelArray< FrequencyModel<QMAX> > model_qual(model_pool_, n_qmodels);
+    if(model_qual.data() == nullptr) return(-1);
     // Not default constructor
     for (i = 0; i < n_qmodels; i++) model_qual[i].Initiate(max_sym + 1);
 
@@ -835,6 +2241,9 @@ int QualityCompressor::Compress(int vers, std::shared_ptr<ColumnSet> quals, std:
             // Todo; fix
             //int len = rec < n_records ? q_len[rec] : in_size - s->crecs[n_records-1].qual;
             //std::cerr << "rec=" << rec << std::endl;
+            // Empty records (e.g. missing values) carry no qualities and are
+            // not stored: their lengths are restored from the strides.
+            while (q_len[rec] == 0) rec++;
             int len = q_len[rec];
             //std::cerr << "len=" << len << std::endl;
 
@@ -885,7 +2294,7 @@ int QualityCompressor::Compress(int vers, std::shared_ptr<ColumnSet> quals, std:
 
         qlast = (qlast << q_qctxshift) + qtab[qhist[q]];
         last  = (qlast & ((1 << q_qctxbits) - 1)) << q_qloc;
-        last += ptab[UNSAFE_MIN(j,1024)]; //limits max pos
+        last += ptab[UNSAFE_MIN(j,1023)]; //limits max pos
         last += stab[read2];
         last += dtab[delta];
         last &= 0xffff;
@@ -948,7 +2357,6 @@ int QualityCompressor::Compress(int vers, std::shared_ptr<ColumnSet> quals, std:
 //      q_dloc,
 //      (int)in_size, (int)out_size);
 
-    delete[] model_qual;
     //return comp;
     return(out_size);
 }
@@ -1027,13 +2435,12 @@ int QualityCompressor::Decompress(std::shared_ptr<ColumnSet> quals, std::shared_
         stab[1] = 1<<q_sloc;
 
     const uint32_t n_qmodels = (1 << 16);
-    FrequencyModel<QMAX>* model_qual = new FrequencyModel<QMAX>[n_qmodels];
+    ModelArray< FrequencyModel<QMAX> > model_qual(model_pool_, n_qmodels);
+    if (model_qual.data() == nullptr)
+        return -2;
     // Not default constructor
     for (i = 0; i < n_qmodels; i++) model_qual[i].Initiate(max_sym + 1);
 
-    if (!model_qual)
-        return -2;
-
     FrequencyModel<256> model_len[4];
     FrequencyModel<2> model_revcomp(2);
     FrequencyModel<2> model_strand(2);
@@ -1101,7 +2508,7 @@ int QualityCompressor::Decompress(std::shared_ptr<ColumnSet> quals, std::shared_
 
         qlast = (qlast << q_qctxshift) + qtab[Q];
         last = (qlast & ((1 << q_qctxbits) - 1)) << q_qloc;
-        last += ptab[UNSAFE_MIN(j,1024)]; //limits max pos
+        last += ptab[UNSAFE_MIN(j,1023)]; //limits max pos
         last += stab[read2];
         last += dtab[delta];
 
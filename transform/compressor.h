@@ -63,22 +63,87 @@ public:
     ~Compressor(){}
 
     inline std::shared_ptr<ResizableBuffer> data() const { return(buffer); }
+
+    /**<
+     * Residual compression of the offsets of a Tensor-model ColumnSet: the
+     * cumulative offsets are delta encoded and compressed with ZSTD together
+     * with their Nullity bitmap.
+     * @param cset Source/destination ColumnSet.
+     * @return     Returns the number of compressed bytes or a negative value otherwise.
+     */
+    int CompressStrides(std::shared_ptr<ColumnSet> cset);
+
+    /**<
+     * Restore the cumulative offsets of a Tensor-model ColumnSet compressed
+     * with CompressStrides.
+     * @param cset  Source/destination ColumnSet.
+     * @param field DictionaryFieldType describing the column store type and primitive type used.
+     * @return      Returns the uncompressed size of the offsets or a negative value otherwise.
+     */
+    int DecompressStrides(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
 };
 
 class ZstdCompressor : public Compressor {
 public:
-    int Compress(std::shared_ptr<ColumnSet> cset, const PIL_CSTORE_TYPE& field_type, const int compression_level = 1);
-    int Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field, const int compression_level = 1);
-    int Compress(const uint8_t* src, const uint32_t n_src, const int compression_level = 1);
+    int64_t Compress(std::shared_ptr<ColumnSet> cset, const PIL_CSTORE_TYPE& field_type, const int compression_level = 1);
+    int64_t Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field, const int compression_level = 1);
+    /**<
+     * Compress the source into the scratch buffer using the calling thread's
+     * ZSTD compression context.
+     * @param src               Source data.
+     * @param n_src             Number of bytes in the source.
+     * @param compression_level ZSTD compression level.
+     * @return                  Returns the number of compressed bytes or a negative value otherwise.
+     */
+    int64_t Compress(const uint8_t* src, const int64_t n_src, const int compression_level = 1);
+
+    /**<
+     * Compress the data of a ColumnStore. The compressed buffer is swapped
+     * into the ColumnStore and its previous buffer is kept as scratch space.
+     * @param cstore            Source/destination ColumnStore.
+     * @param compression_level ZSTD compression level.
+     * @return                  Returns the number of compressed bytes or a negative value otherwise.
+     */
+    int64_t Compress(std::shared_ptr<ColumnStore> cstore, const int compression_level = 1);
+
+    /**<
+     * Compress the Nullity bitmap of a ColumnStore in place and set its
+     * `nullity_type`, `nullity_u`, `nullity_c`, and `n_null`. Bitmaps where
+     * every record is valid (or null) are stored with zero bytes and sparse
+     * patterns are stored as run lengths.
+     * @param cstore            Source/destination ColumnStore.
+     * @param compression_level ZSTD compression level.
+     * @return                  Returns the number of compressed bytes or a negative value otherwise.
+     */
+    int CompressNullity(std::shared_ptr<ColumnStore> cstore, const int compression_level = 1);
+
+    /**<
+     * Restore the Nullity bitmap of a ColumnStore compressed with
+     * CompressNullity.
+     * @param cstore Source/destination ColumnStore.
+     * @return       Returns the number of bytes in the bitmap or a negative value otherwise.
+     */
+    int DecompressNullity(std::shared_ptr<ColumnStore> cstore);
+
+    /**<
+     * Decompress a ZSTD frame into the scratch buffer.
+     * @param src    Source frame.
+     * @param n_src  Number of bytes in the source.
+     * @param n_hint Output size used if the frame does not store its content size.
+     * @return       Returns the number of decompressed bytes or a negative value otherwise.
+     */
+    int64_t Decompress(const uint8_t* src, const int64_t n_src, const int64_t n_hint);
+
     /**<
      * Decompression requires that `compressed_size` is properly set to the
-     * correct value. Unsafe method as we do not know the uncompressed size
-     * or the correctness of decompressor.
+     * correct value. The output is sized from the content size stored in the
+     * ZSTD frame. Unsafe method as we do not know the correctness of the
+     * decompressor.
      * @param cstore
-     * @param back_copy
+     * @param back_copy If set then the decompressed buffer is swapped into the ColumnStore.
      * @return
      */
-    int UnsafeDecompress(std::shared_ptr<ColumnStore> cstore, const bool back_copy = true);
+    int64_t UnsafeDecompress(std::shared_ptr<ColumnStore> cstore, const bool back_copy = true);
 
     /**<
      * Safe decompression of the target ColumnStore.
@@ -87,7 +152,7 @@ public:
      * @param back_copy
      * @return
      */
-    int Decompress(std::shared_ptr<ColumnStore> cstore, std::shared_ptr<TransformMeta> meta, const bool back_copy = true);
+    int64_t Decompress(std::shared_ptr<ColumnStore> cstore, std::shared_ptr<TransformMeta> meta, const bool back_copy = true);
 };
 
 class QualityCompressor : public Compressor {
@@ -123,12 +188,147 @@ public:
 
 class SequenceCompressor : public Compressor {
 public:
+    /**<
+     * The base models are only lossless for upper-case ACGTN: lower-case
+     * bases decode as upper-case and other bytes (IUPAC codes, '*' or '=')
+     * are dropped. Data with any other byte is compressed with ZSTD instead
+     * and tagged with PIL_COMPRESS_ZSTD.
+     * @param bases   Source bases.
+     * @param n_bases Number of bases.
+     * @return        Returns TRUE if every byte is one of ACGTN or FALSE otherwise.
+     */
+    static bool IsLossless(const uint8_t* bases, const uint64_t n_bases);
+
     int Compress(std::shared_ptr<ColumnSet> cset, PIL_CSTORE_TYPE cstore);
     int Compress(const uint8_t* bases, const uint32_t n_src, const uint32_t* lengths, const uint32_t n_lengths);
     int Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
     int DecompressStrides(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
 };
 
+/**<
+ * Reference-based compression of sequence bases. Reads are described by the
+ * RNAME, POS and CIGAR fields in Transformer::ref_context and only
+ * substitutions, insertions and soft-clips relative to the reference are
+ * encoded, each with their own context models. Reads that cannot be placed on
+ * the reference (unmapped, out of bounds, or with a CIGAR that does not match
+ * the read length) are stored with an order-k model as in SequenceCompressor
+ * and reads with non-ACGTN bytes are stored verbatim.
+ *
+ * The alignment fields must be in their untransformed state both during
+ * compression and decompression.
+ */
+class ReferenceSequenceCompressor : public Compressor {
+public:
+    /**<
+     * Compress a Tensor-model ColumnSet of sequence bases. If no reference
+     * context is available then this falls back to SequenceCompressor and
+     * the data is tagged with PIL_COMPRESS_RC_BASES.
+     * @param cset  Source/destination ColumnSet.
+     * @param field DictionaryFieldType describing the column store type and primitive type used.
+     * @return      Positive values are a success and negative values are failures.
+     */
+    int Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+    int Compress(const uint8_t* bases, const uint32_t* offsets, const uint32_t n_records, const ReferenceContext& context);
+    int Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+};
+
+/**<
+ * CIGAR codec for Tensor-model ColumnSets of CIGAR text. Each CIGAR is parsed
+ * into operation codes (BAM order: MIDNSHP=X as 0-8) and operation lengths.
+ * The operation nibbles and the varint-encoded lengths are written to two
+ * separate streams that are range coded with their own models: operations
+ * conditioned on the previous operation and length bytes conditioned on the
+ * operation. CIGARs that are not in canonical form are stored verbatim.
+ *
+ * Reference spans can be computed directly from the compressed streams with
+ * ReferenceSpans without materializing the CIGAR text.
+ */
+class CigarCompressor : public Compressor {
+public:
+    // Bitmasks over the BAM operation codes of operations consuming
+    // reference and query bases respectively.
+    static constexpr uint32_t PIL_CIGAR_CONSUMES_REF   = 0x18D; // M, D, N, =, X
+    static constexpr uint32_t PIL_CIGAR_CONSUMES_QUERY = 0x193; // M, I, S, =, X
+
+    int Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+    int Compress(const uint8_t* cigars, const uint32_t* offsets, const uint32_t n_records);
+    int Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+
+    /**<
+     * Compute the number of reference bases spanned by every record directly
+     * from a compressed ColumnSet. The ColumnSet is not modified. Records
+     * without an alignment (empty or `*`) have a span of 0.
+     * @param cset  Source ColumnSet compressed with PIL_ENCODE_CIGAR_NIBBLE.
+     * @param spans Destination vector of spans, one per record.
+     * @return      Returns the number of records or a negative value otherwise.
+     */
+    int ReferenceSpans(std::shared_ptr<ColumnSet> cset, std::vector<uint32_t>& spans);
+
+    /**<
+     * Reference span of a binary CIGAR (BAM layout: length << 4 | op). The
+     * loop is branch-free and auto-vectorizes.
+     * @param cigar  Binary CIGAR operations.
+     * @param n_ops  Number of operations.
+     * @return       Number of reference bases spanned.
+     */
+    static inline uint32_t ReferenceSpan(const uint32_t* cigar, const uint32_t n_ops) {
+        uint32_t span = 0;
+        for(uint32_t i = 0; i < n_ops; ++i)
+            span += (cigar[i] >> 4) & -((PIL_CIGAR_CONSUMES_REF >> (cigar[i] & 0xF)) & 1);
+        return(span);
+    }
+
+    /**<
+     * Parse CIGAR text into binary CIGAR operations (BAM layout).
+     * @param cigar   CIGAR text.
+     * @param n_cigar Length of the CIGAR text.
+     * @param out     Destination operations.
+     * @return        Returns the number of operations or a negative value if the text is not canonical.
+     */
+    static int ParseCigar(const uint8_t* cigar, const uint32_t n_cigar, std::vector<uint32_t>& out);
+};
+
+/**<
+ * Read name codec for Tensor-model ColumnSets of read names. Every name is
+ * split into tokens: runs of letters, runs of digits (stored as integers)
+ * and single punctuation characters. Each token is compared to the token at
+ * the same position in the previous name and encoded as a match, a small
+ * positive delta (integers only), or a new value. Every token position has
+ * its own set of range coder models such that fixed-format names, such as
+ * Illumina or Nanopore UUID names, are compressed as a single column.
+ */
+class NameCompressor : public Compressor {
+public:
+    // Maximum number of tokens per name. The remainder of longer names is
+    // stored as a single string token.
+    static constexpr uint32_t PIL_NAME_MAX_TOKENS = 32;
+
+    int Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+    int Compress(const uint8_t* names, const uint32_t* offsets, const uint32_t n_records);
+    int Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+};
+
+/**<
+ * Positional Burrows-Wheeler transform (PBWT) codec for Tensor-model
+ * ColumnSets of haplotype vectors, such as the packed GT matrix of the VCF
+ * importer. Every record (site) is read as 2-bit symbols (4 per byte with the
+ * first symbol in the lowest bits). The positional prefix array is carried
+ * from site to site within the batch: the symbols of a site are permuted by
+ * the prefix array, which is then updated with a stable sort of the permuted
+ * column. Haplotypes sharing a long history are therefore adjacent and the
+ * permuted column collapses into few runs. The runs are range coded as their
+ * symbol, conditioned on the symbol of the previous run, and their length.
+ *
+ * The prefix array is reset to the identity whenever the number of
+ * haplotypes changes. Empty records do not affect the prefix array.
+ */
+class PbwtCompressor : public Compressor {
+public:
+    int Compress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+    int Compress(const uint8_t* data, const uint32_t* offsets, const uint32_t n_records);
+    int Decompress(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+};
+
 }
 
 #endif /* TRANSFORM_COMPRESSOR_H_ */
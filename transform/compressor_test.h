@@ -7,9 +7,13 @@
 #include <algorithm>
 #include <functional>
 #include <memory> // static_ptr_cast
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
 
 #include "compressor.h"
 #include "encoder.h"
+#include "frequency_model.h"
 #include <gtest/gtest.h>
 
 namespace pil {
@@ -45,7 +49,7 @@ TEST(ZstdTests, CompressColumnRandom) {
     ASSERT_GT(zstd.Compress(cset, field), 0);
     ASSERT_EQ(1, cstore->transformation_args.size());
 
-    // Make sure the MD5 checksum is not 0
+    // Make sure the checksum is not 0
     uint8_t bad_md5[16]; memset(bad_md5, 0, 16);
     ASSERT_NE(0, memcmp(cset->columns[0]->mutable_data(), bad_md5, 16));
 }
@@ -69,7 +73,7 @@ TEST(ZstdTests, CompressColumnUniformSingle) {
     ASSERT_GT(zstd.Compress(cset, field), 0);
     ASSERT_EQ(1, cstore->transformation_args.size());
 
-    // Make sure the MD5 checksum is not 0
+    // Make sure the checksum is not 0
     uint8_t bad_md5[16]; memset(bad_md5, 0, 16);
     ASSERT_NE(0, memcmp(cset->columns[0]->mutable_data(), bad_md5, 16));
 }
@@ -96,13 +100,13 @@ TEST(ZstdTests, CompressDecompressColumnRandomUnsafe) {
     ASSERT_GT(zstd.Compress(cset, field), 0);
     ASSERT_EQ(1, cstore->transformation_args.size());
 
-    // Make sure the MD5 checksum is not 0
-    uint8_t md5[16]; memset(md5, 0, 16);
-    ASSERT_NE(0, memcmp(cset->columns[0]->mutable_data(), md5, 16));
+    // Make sure the checksum is not 0
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    ASSERT_NE(0, memcmp(cset->columns[0]->mutable_data(), digest, 16));
 
     ASSERT_GT(zstd.UnsafeDecompress(cstore, true), 0);
-    Digest::GenerateMd5(cstore->mutable_data(), cstore->uncompressed_size, md5);
-    ASSERT_EQ(0, memcmp(md5, cstore->md5_checksum, 16));
+    Checksum::Compute(cstore->checksum_type, cstore->mutable_data(), cstore->uncompressed_size, digest);
+    ASSERT_EQ(0, memcmp(digest, cstore->checksum, 16));
 }
 
 TEST(ZstdTests, CompressDecompressColumnRandomSafe) {
@@ -127,16 +131,46 @@ TEST(ZstdTests, CompressDecompressColumnRandomSafe) {
     ASSERT_GT(zstd.Compress(cset, field), 0);
     ASSERT_EQ(1, cstore->transformation_args.size());
 
-    // Make sure the MD5 checksum is not 0
-    uint8_t md5[16]; memset(md5, 0, 16);
-    ASSERT_NE(0, memcmp(cset->columns[0]->mutable_data(), md5, 16));
+    // Make sure the checksum is not 0
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    ASSERT_NE(0, memcmp(cset->columns[0]->mutable_data(), digest, 16));
 
     // Different compressor with empty buffer.
     ZstdCompressor zstd2;
 
     ASSERT_GT(zstd2.Decompress(cstore, cstore->transformation_args.back(), true), 0);
-    Digest::GenerateMd5(cstore->mutable_data(), cstore->uncompressed_size, md5);
-    ASSERT_EQ(0, memcmp(md5, cstore->md5_checksum, 16));
+    Checksum::Compute(cstore->checksum_type, cstore->mutable_data(), cstore->uncompressed_size, digest);
+    ASSERT_EQ(0, memcmp(digest, cstore->checksum, 16));
+}
+
+TEST(ZstdTests, CompressDecompressColumnUnsafeEmptyBuffer) {
+    ZstdCompressor zstd;
+
+    std::shared_ptr<ColumnStore > cstore = std::make_shared<ColumnStore>();
+    std::shared_ptr<ColumnStoreBuilder<uint32_t> > builder = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(cstore);
+    for(int i = 0; i < 50000; ++i) ASSERT_EQ(1, builder->Append(i % 1000));
+
+    std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+    ASSERT_EQ(1, cset->Append(builder));
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_COLUMN;
+    field.ptype  = PIL_TYPE_UINT32;
+
+    cstore->ComputeChecksum();
+    ASSERT_GT(zstd.Compress(cset, field), 0);
+    ASSERT_LT(cstore->buffer.length(), 50000*sizeof(uint32_t));
+    // The uncompressed buffer is kept as scratch space.
+    ASSERT_GE(zstd.data()->capacity(), 50000*sizeof(uint32_t));
+
+    // The output size is read from the ZSTD frame.
+    ZstdCompressor zstd2;
+    ASSERT_EQ(50000*sizeof(uint32_t), zstd2.UnsafeDecompress(cstore, true));
+    ASSERT_EQ(50000*sizeof(uint32_t), cstore->buffer.length());
+
+    uint8_t digest[PIL_CHECKSUM_LENGTH];
+    Checksum::Compute(cstore->checksum_type, cstore->mutable_data(), cstore->uncompressed_size, digest);
+    ASSERT_EQ(0, memcmp(digest, cstore->checksum, 16));
 }
 
 TEST(ZstdTests, CompressDecompressColumnRandomSafeIncorrectTyping) {
@@ -161,9 +195,9 @@ TEST(ZstdTests, CompressDecompressColumnRandomSafeIncorrectTyping) {
     ASSERT_GT(zstd.Compress(cset, field), 0);
     ASSERT_EQ(1, cstore->transformation_args.size());
 
-    // Make sure the MD5 checksum is not 0
-    uint8_t md5[16]; memset(md5, 0, 16);
-    ASSERT_NE(0, memcmp(cset->columns[0]->mutable_data(), md5, 16));
+    // Make sure the checksum is not 0
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    ASSERT_NE(0, memcmp(cset->columns[0]->mutable_data(), digest, 16));
 
     // Different compressor with empty buffer.
     ZstdCompressor zstd2;
@@ -192,13 +226,37 @@ TEST(DeltaTests, EncodeDecodeColumn) {
     ASSERT_EQ(1, transformer.Encode(cset, field));
     ASSERT_EQ(1, cstore->transformation_args.size());
 
-    // Make sure the MD5 checksum is not the same
-    ASSERT_NE(0, memcmp(cset->columns[0]->md5_checksum, cstore->transformation_args.back()->md5_checksum, 16));
+    // Make sure the checksum is not the same
+    ASSERT_NE(0, memcmp(cset->columns[0]->checksum, cstore->transformation_args.back()->checksum, 16));
 
     ASSERT_EQ(1, transformer.UnsafePrefixSum(cstore, field));
-    uint8_t md5[16]; memset(md5, 0, 16);
-    Digest::GenerateMd5(cset->columns[0]->mutable_data(), cset->columns[0]->buffer.length(), md5);
-    ASSERT_EQ(0, memcmp(cset->columns[0]->md5_checksum, md5, 16));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[0]->checksum_type, cset->columns[0]->mutable_data(), cset->columns[0]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[0]->checksum, digest, 16));
+}
+
+TEST(DeltaTests, EncodeDecodeColumnInt64) {
+    DeltaEncoder transformer;
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_COLUMN;
+    field.ptype  = PIL_TYPE_INT64;
+
+    // Coordinates beyond the uint32 range and decreasing values.
+    std::shared_ptr<ColumnStore > cstore = std::make_shared<ColumnStore>();
+    std::shared_ptr<ColumnStoreBuilder<int64_t> > builder = std::static_pointer_cast< ColumnStoreBuilder<int64_t> >(cstore);
+    for(int i = 0; i < 10000; ++i) builder->Append((i % 100 == 0 ? -1 : 1) * (5000000000LL + 37*i));
+    std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+    ASSERT_EQ(1, cset->Append(builder));
+
+    cstore->ComputeChecksum();
+    ASSERT_EQ(1, transformer.Encode(cset, field));
+    ASSERT_EQ(37, reinterpret_cast<const int64_t*>(cstore->mutable_data())[2]);
+
+    ASSERT_EQ(1, transformer.PrefixSum(cset, field));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[0]->checksum_type, cset->columns[0]->mutable_data(), cset->columns[0]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[0]->checksum, digest, 16));
 }
 
 TEST(DeltaTests, EncodeDecodeColumnSetTensor) {
@@ -223,13 +281,13 @@ TEST(DeltaTests, EncodeDecodeColumnSetTensor) {
     cset->columns[1]->ComputeChecksum();
     ASSERT_EQ(1, transformer.Encode(cset, field));
 
-    // Make sure the MD5 checksum is not the same
-    ASSERT_NE(0, memcmp(cset->columns[0]->md5_checksum, cset->columns[0]->transformation_args.back()->md5_checksum, 16));
+    // Make sure the checksum is not the same
+    ASSERT_NE(0, memcmp(cset->columns[0]->checksum, cset->columns[0]->transformation_args.back()->checksum, 16));
 
     ASSERT_EQ(1, transformer.PrefixSum(cset, field));
-    uint8_t md5[16]; memset(md5, 0, 16);
-    Digest::GenerateMd5(cset->columns[0]->mutable_data(), cset->columns[0]->buffer.length(), md5);
-    ASSERT_EQ(0, memcmp(cset->columns[0]->md5_checksum, md5, 16));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[0]->checksum_type, cset->columns[0]->mutable_data(), cset->columns[0]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[0]->checksum, digest, 16));
 }
 
 TEST(DeltaTests, EncodeDecodeColumnSetColumnSplit) {
@@ -255,16 +313,16 @@ TEST(DeltaTests, EncodeDecodeColumnSetColumnSplit) {
     // Encode the set
     ASSERT_EQ(1, transformer.Encode(cset, field));
 
-    // Make sure the MD5 checksum is not the same
+    // Make sure the checksum is not the same
     for(int i = 0; i < x.size(); ++i) {
-        ASSERT_NE(0, memcmp(cset->columns[i]->md5_checksum, cset->columns[i]->transformation_args.back()->md5_checksum, 16));
+        ASSERT_NE(0, memcmp(cset->columns[i]->checksum, cset->columns[i]->transformation_args.back()->checksum, 16));
     }
 
     ASSERT_EQ(1, transformer.PrefixSum(cset, field));
-    uint8_t md5[16]; memset(md5, 0, 16);
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
     for(int i = 0; i < x.size(); ++i) {
-        Digest::GenerateMd5(cset->columns[i]->mutable_data(), cset->columns[i]->buffer.length(), md5);
-        ASSERT_EQ(0, memcmp(cset->columns[i]->md5_checksum, md5, 16));
+        Checksum::Compute(cset->columns[i]->checksum_type, cset->columns[i]->mutable_data(), cset->columns[i]->buffer.length(), digest);
+        ASSERT_EQ(0, memcmp(cset->columns[i]->checksum, digest, 16));
     }
 }
 
@@ -319,13 +377,42 @@ TEST(QualityTests, EncodeDecode) {
     cset->columns[1]->ComputeChecksum();
     ASSERT_GT(transformer.Compress(cset, field.cstore), 0);
 
-    // Make sure the MD5 checksum is not the same
-    ASSERT_NE(0, memcmp(cset->columns[1]->md5_checksum, cset->columns[1]->transformation_args.back()->md5_checksum, 16));
+    // Make sure the checksum is not the same
+    ASSERT_NE(0, memcmp(cset->columns[1]->checksum, cset->columns[1]->transformation_args.back()->checksum, 16));
 
     transformer.Decompress(cset, field.cstore);
-    uint8_t md5[16]; memset(md5, 0, 16);
-    Digest::GenerateMd5(cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), md5);
-    ASSERT_EQ(0, memcmp(cset->columns[1]->md5_checksum, md5, 16));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
+}
+
+TEST(QualityTests, EncodeDecodeMissing) {
+    QualityCompressor transformer;
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+
+    std::shared_ptr<ColumnSet > cset = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSetBuilderTensor<uint8_t> > builder = std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset);
+
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint8_t> distr(0, 66);
+    for(int i = 0; i < 5000; ++i) {
+        // Missing records and reads longer than the position context.
+        if(i % 10 == 1) { builder->PadNull(); continue; }
+        std::vector<uint8_t> data(i % 100 == 0 ? 2000 : 100);
+        for(size_t j = 0; j < data.size(); ++j) data[j] = distr(eng);
+        ASSERT_EQ(1, builder->Append(data));
+    }
+
+    cset->columns[1]->ComputeChecksum();
+    ASSERT_GT(transformer.Compress(cset, field.cstore), 0);
+    transformer.Decompress(cset, field.cstore);
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
 }
 
 TEST(QualityTests, EncodeDecodeLong100kb) {
@@ -355,13 +442,13 @@ TEST(QualityTests, EncodeDecodeLong100kb) {
     cset->columns[1]->ComputeChecksum();
     ASSERT_GT(transformer.Compress(cset, field.cstore), 0);
 
-    // Make sure the MD5 checksum is not the same
-    ASSERT_NE(0, memcmp(cset->columns[1]->md5_checksum, cset->columns[1]->transformation_args.back()->md5_checksum, 16));
+    // Make sure the checksum is not the same
+    ASSERT_NE(0, memcmp(cset->columns[1]->checksum, cset->columns[1]->transformation_args.back()->checksum, 16));
 
     transformer.Decompress(cset, field.cstore);
-    uint8_t md5[16]; memset(md5, 0, 16);
-    Digest::GenerateMd5(cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), md5);
-    ASSERT_EQ(0, memcmp(cset->columns[1]->md5_checksum, md5, 16));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
 }
 
 TEST(QualityTests, EncodeDecodeLong1mb) {
@@ -391,13 +478,13 @@ TEST(QualityTests, EncodeDecodeLong1mb) {
     cset->columns[1]->ComputeChecksum();
     ASSERT_GT(transformer.Compress(cset, field.cstore), 0);
 
-    // Make sure the MD5 checksum is not the same
-    ASSERT_NE(0, memcmp(cset->columns[1]->md5_checksum, cset->columns[1]->transformation_args.back()->md5_checksum, 16));
+    // Make sure the checksum is not the same
+    ASSERT_NE(0, memcmp(cset->columns[1]->checksum, cset->columns[1]->transformation_args.back()->checksum, 16));
 
     transformer.Decompress(cset, field.cstore);
-    uint8_t md5[16]; memset(md5, 0, 16);
-    Digest::GenerateMd5(cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), md5);
-    ASSERT_EQ(0, memcmp(cset->columns[1]->md5_checksum, md5, 16));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
 }
 
 TEST(SeqTests, EncodeDecode) {
@@ -428,13 +515,486 @@ TEST(SeqTests, EncodeDecode) {
     cset->columns[1]->ComputeChecksum();
     ASSERT_GT(transformer.Compress(cset, field.cstore), 0);
 
-    // Make sure the MD5 checksum is not the same
-    ASSERT_NE(0, memcmp(cset->columns[1]->md5_checksum, cset->columns[1]->transformation_args.back()->md5_checksum, 16));
+    // Make sure the checksum is not the same
+    ASSERT_NE(0, memcmp(cset->columns[1]->checksum, cset->columns[1]->transformation_args.back()->checksum, 16));
 
     transformer.Decompress(cset, field);
-    uint8_t md5[16]; memset(md5, 0, 16);
-    Digest::GenerateMd5(cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), md5);
-    ASSERT_EQ(0, memcmp(cset->columns[1]->md5_checksum, md5, 16));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
+}
+
+TEST(SeqTests, NonBasesFallBackToZstd) {
+    Transformer transformer;
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+    field.transforms.push_back(PIL_COMPRESS_RC_BASES);
+
+    std::shared_ptr<ColumnSet > cset = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSetBuilderTensor<uint8_t> > builder = std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset);
+
+    // Missing SEQ, IUPAC codes, '=' and soft-masked bases are not
+    // representable by the base models.
+    const std::string reads[5] = {"ACGTNACGTN", "*", "ACGRYKMSWN", "==AC=GT", "acgtACGT"};
+    std::vector<std::string> expected;
+    for(int i = 0; i < 1000; ++i) {
+        if(i % 7 == 6) { ASSERT_EQ(1, builder->PadNull()); expected.push_back(""); continue; }
+        const std::string& read = reads[i % 5];
+        ASSERT_EQ(1, builder->Append(reinterpret_cast<const uint8_t*>(read.data()), read.size()));
+        expected.push_back(read);
+    }
+
+    ASSERT_GT(transformer.Transform(cset, field), 0);
+    ASSERT_EQ(PIL_COMPRESS_ZSTD, cset->columns[1]->transformation_args.back()->ctype);
+
+    ASSERT_GT(static_cast<SequenceCompressor*>(&transformer)->Decompress(cset, field), 0);
+    ASSERT_GT(static_cast<ZstdCompressor*>(&transformer)->DecompressNullity(cset->columns[0]), 0);
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(cset->columns[0]->mutable_data());
+    const char* bases = reinterpret_cast<const char*>(cset->columns[1]->mutable_data());
+    for(int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(expected[i], std::string(bases + offsets[i], offsets[i + 1] - offsets[i]));
+        ASSERT_EQ(i % 7 != 6, cset->columns[0]->IsValid(i));
+    }
+}
+
+TEST(SeqTests, WideOffsets) {
+    Transformer transformer;
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+    field.transforms.push_back(PIL_COMPRESS_RC_BASES);
+
+    std::shared_ptr<ColumnSet > cset = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSetBuilderTensor<uint8_t> > builder = std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset);
+
+    // Offsets are promoted to 64-bit in place and appends continue from the
+    // last offset.
+    std::vector<uint8_t> data(100, 'A');
+    for(int i = 0; i < 500; ++i) ASSERT_EQ(1, builder->Append(data));
+    ASSERT_EQ(sizeof(uint32_t), cset->columns[0]->offset_width);
+    ASSERT_EQ(1, builder->WidenOffsets());
+    ASSERT_EQ(sizeof(uint64_t), cset->columns[0]->offset_width);
+    ASSERT_EQ(1, builder->PadNull());
+    for(int i = 0; i < 500; ++i) ASSERT_EQ(1, builder->Append(data));
+
+    ASSERT_EQ(1002, cset->columns[0]->size());
+    ASSERT_EQ(1002 * sizeof(uint64_t), cset->columns[0]->uncompressed_size);
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(cset->columns[0]->mutable_data());
+    for(int i = 0; i <= 500; ++i) ASSERT_EQ(i * 100, offsets[i]);
+    ASSERT_EQ(500 * 100, offsets[501]);
+    ASSERT_EQ(1000 * 100, offsets[1001]);
+    ASSERT_EQ(false, cset->columns[0]->IsValid(500));
+    ASSERT_EQ(true, Transformer::HasWideOffsets(cset));
+
+    // Range coders fall back to ZSTD and the strides are restored as 64-bit.
+    ASSERT_GT(transformer.Transform(cset, field), 0);
+    ASSERT_EQ(PIL_COMPRESS_ZSTD, cset->columns[1]->transformation_args.back()->ctype);
+    ASSERT_GT(static_cast<Compressor*>(&transformer)->DecompressStrides(cset, field), 0);
+    offsets = reinterpret_cast<const uint64_t*>(cset->columns[0]->mutable_data());
+    ASSERT_EQ(500 * 100, offsets[501]);
+    ASSERT_EQ(1000 * 100, offsets[1001]);
+}
+
+TEST(RefSeqTests, EncodeDecode) {
+    // Write small references with an index to a temporary directory.
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint32_t> distr(0, 3);
+    const char map[] = {'A', 'C', 'G', 'T'};
+    const char* tmpdir = std::getenv("TMPDIR");
+    const std::string fasta_dir = (tmpdir != nullptr && tmpdir[0] != '\0') ? tmpdir : "/tmp";
+    const std::string fasta_path = fasta_dir + "/pil_refseq_test_" + std::to_string(rd()) + ".fa";
+    const std::string other_path = fasta_dir + "/pil_refseq_test_" + std::to_string(rd()) + ".fa";
+    const std::string same_layout_path = fasta_dir + "/pil_refseq_test_" + std::to_string(rd()) + ".fa";
+
+    // Write random contigs of the given lengths named chr1, chr2, ...
+    auto write_fasta = [&](const std::string& path, const std::vector<uint32_t>& lengths, std::vector<std::string>& contigs) {
+        std::ofstream fa(path), fai(path + ".fai");
+        if(fa.good() == false || fai.good() == false) return(false);
+        contigs.resize(lengths.size());
+        for(size_t c = 0; c < lengths.size(); ++c) {
+            contigs[c].clear();
+            for(uint32_t i = 0; i < lengths[c]; ++i) contigs[c] += map[distr(eng)];
+            fa << ">chr" << c + 1 << "\n";
+            fai << "chr" << c + 1 << "\t" << contigs[c].size() << "\t" << fa.tellp() << "\t60\t61\n";
+            for(size_t i = 0; i < contigs[c].size(); i += 60)
+                fa << contigs[c].substr(i, 60) << "\n";
+        }
+        return(fa.good() && fai.good());
+    };
+
+    std::vector<std::string> contigs, other_contigs, same_layout_contigs;
+    ASSERT_TRUE(write_fasta(fasta_path, {50000, 50000}, contigs));
+    // A different assembly of the same contigs.
+    ASSERT_TRUE(write_fasta(other_path, {50000, 50100}, other_contigs));
+    // Same names and lengths but different bases.
+    ASSERT_TRUE(write_fasta(same_layout_path, {50000, 50000}, same_layout_contigs));
+
+    ReferenceSequenceCompressor transformer;
+    transformer.ref_context.reference = std::make_shared<ReferenceSequence>();
+    ASSERT_EQ(1, transformer.ref_context.reference->Open(fasta_path));
+    ASSERT_EQ(2, transformer.ref_context.reference->size());
+
+    std::vector<uint8_t> fetched(100);
+    ASSERT_EQ(100, transformer.ref_context.reference->Fetch(1, 1000, 100, fetched.data()));
+    ASSERT_EQ(0, memcmp(fetched.data(), &contigs[1][1000], 100));
+    ASSERT_LT(transformer.ref_context.reference->Fetch(1, 49950, 100, fetched.data()), 0);
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+
+    std::shared_ptr<ColumnSet> cset  = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSet> rname = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSet> pos   = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSet> cigar = std::make_shared<ColumnSet>();
+    std::uniform_int_distribution<uint32_t> rpos(0, 49000);
+    std::uniform_int_distribution<uint32_t> rvar(0, 99);
+
+    for(int i = 0; i < 5000; ++i) {
+        const uint32_t contig = i % 2;
+        const uint32_t start  = rpos(eng);
+        std::string read, cig;
+        if(i % 50 == 0) { // unmapped
+            for(int j = 0; j < 100; ++j) read += map[distr(eng)];
+            cig = "*";
+        } else if(i % 77 == 0) { // non-ACGTN bytes
+            read = std::string(100, 'R');
+            cig = "100M";
+        } else { // 5S 40M 2I 20M 3D 33M
+            for(int j = 0; j < 5; ++j) read += map[distr(eng)];
+            read += contigs[contig].substr(start, 40);
+            read += "TA";
+            read += contigs[contig].substr(start + 40, 20);
+            read += contigs[contig].substr(start + 63, 33);
+            for(int j = 5; j < read.size(); ++j) {
+                if(rvar(eng) == 0) read[j] = map[distr(eng)];
+                if(rvar(eng) == 0) read[j] = 'N';
+            }
+            cig = "5S40M2I20M3D33M";
+        }
+
+        ASSERT_EQ(1, std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset)->Append(reinterpret_cast<const uint8_t*>(read.data()), read.size()));
+        ASSERT_EQ(1, std::static_pointer_cast< ColumnSetBuilder<uint32_t> >(rname)->Append(contig));
+        ASSERT_EQ(1, std::static_pointer_cast< ColumnSetBuilder<uint32_t> >(pos)->Append(cig == "*" ? 0 : start + 1));
+        ASSERT_EQ(1, std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cigar)->Append(reinterpret_cast<const uint8_t*>(cig.data()), cig.size()));
+    }
+
+    transformer.ref_context.rname = rname;
+    transformer.ref_context.pos   = pos;
+    transformer.ref_context.cigar = cigar;
+
+    cset->columns[1]->ComputeChecksum();
+    const uint32_t n_in = cset->columns[1]->buffer.length();
+    ASSERT_GT(transformer.Compress(cset, field), 0);
+    ASSERT_EQ(PIL_COMPRESS_REF_BASES, cset->columns[1]->transformation_args.back()->ctype);
+    ASSERT_LT(cset->columns[1]->compressed_size, n_in / 4);
+
+    // Decoding against a different reference is refused before the data
+    // is modified.
+    std::shared_ptr<ReferenceSequence> reference = transformer.ref_context.reference;
+    transformer.ref_context.reference = std::make_shared<ReferenceSequence>();
+    ASSERT_EQ(1, transformer.ref_context.reference->Open(other_path));
+    ASSERT_EQ(2, transformer.ref_context.reference->size());
+    ASSERT_NE(reference->Fingerprint(), transformer.ref_context.reference->Fingerprint());
+    ASSERT_EQ(-7, transformer.Decompress(cset, field));
+    transformer.ref_context.reference->Close();
+
+    ASSERT_EQ(1, transformer.ref_context.reference->Open(same_layout_path));
+    ASSERT_NE(reference->Fingerprint(), transformer.ref_context.reference->Fingerprint());
+    ASSERT_EQ(-7, transformer.Decompress(cset, field));
+    transformer.ref_context.reference->Close();
+    transformer.ref_context.reference = reference;
+
+    ASSERT_EQ(n_in, transformer.Decompress(cset, field));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
+
+    transformer.ref_context.reference->Close();
+    std::remove(fasta_path.c_str());
+    std::remove((fasta_path + ".fai").c_str());
+    std::remove(other_path.c_str());
+    std::remove((other_path + ".fai").c_str());
+    std::remove(same_layout_path.c_str());
+    std::remove((same_layout_path + ".fai").c_str());
+}
+
+TEST(CigarTests, EncodeDecode) {
+    CigarCompressor transformer;
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+
+    std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSetBuilderTensor<uint8_t> > builder = std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset);
+
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint32_t> dop(0, 8);
+    std::uniform_int_distribution<uint32_t> dlen(1, 200000);
+    const char ops[] = "MIDNSHP=X";
+    std::vector<uint32_t> truth_spans;
+    std::vector<uint32_t> binary;
+
+    for(int i = 0; i < 10000; ++i) {
+        std::string cigar;
+        uint32_t span = 0;
+        if(i % 100 == 0) cigar = "*";
+        else if(i % 333 == 0) cigar = "01M"; // not canonical
+        else if(i % 97 == 0) { builder->PadNull(); truth_spans.push_back(0); continue; }
+        else {
+            const int n_ops = 1 + i % 7;
+            for(int j = 0; j < n_ops; ++j) {
+                const uint32_t op = dop(eng), len = (j % 2) ? dlen(eng) : 1 + dlen(eng) % 150;
+                cigar += std::to_string(len) + ops[op];
+                if(op == 0 || op == 2 || op == 3 || op == 7 || op == 8) span += len;
+            }
+
+            ASSERT_EQ(n_ops, CigarCompressor::ParseCigar(reinterpret_cast<const uint8_t*>(cigar.data()), cigar.size(), binary));
+            ASSERT_EQ(span, CigarCompressor::ReferenceSpan(binary.data(), binary.size()));
+        }
+        if(cigar == "01M") span = 0;
+        truth_spans.push_back(span);
+        ASSERT_EQ(1, builder->Append(reinterpret_cast<const uint8_t*>(cigar.data()), cigar.size()));
+    }
+
+    cset->columns[1]->ComputeChecksum();
+    const uint32_t n_in = cset->columns[1]->buffer.length();
+    ASSERT_GT(transformer.Compress(cset, field), 0);
+    ASSERT_EQ(PIL_ENCODE_CIGAR_NIBBLE, cset->columns[1]->transformation_args.back()->ctype);
+    ASSERT_LT(cset->columns[1]->compressed_size, n_in);
+
+    // Spans are computed without decompressing the data.
+    std::vector<uint32_t> spans;
+    ASSERT_EQ(10000, transformer.ReferenceSpans(cset, spans));
+    ASSERT_EQ(truth_spans, spans);
+
+    ASSERT_EQ(n_in, transformer.Decompress(cset, field));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
+}
+
+TEST(CigarTests, CorruptOperation) {
+    CigarCompressor transformer;
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+
+    std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+    ASSERT_EQ(1, std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset)->Append(reinterpret_cast<const uint8_t*>("10M"), 3));
+    ASSERT_GT(transformer.Compress(cset, field), 0);
+
+    // Replace the streams with a record holding operation code 12: the
+    // operation model has 16 symbols but only 9 operations exist.
+    std::vector<uint8_t> streams(1024, 0);
+    FrequencyModel<4> model_mode;
+    FrequencyModel<256> model_nops;
+    FrequencyModel<16> model_op;
+    FrequencyModel<256> model_len;
+    RangeCoder rc_ops, rc_len;
+    rc_ops.StartEncode();
+    rc_ops.SetOutput(&streams[sizeof(uint32_t)]);
+    model_mode.EncodeSymbol(&rc_ops, 2);
+    model_nops.EncodeSymbol(&rc_ops, 1);
+    model_op.EncodeSymbol(&rc_ops, 12);
+    rc_ops.FinishEncode();
+    const uint32_t n_ops_stream = rc_ops.OutSize();
+    memcpy(&streams[0], &n_ops_stream, sizeof(uint32_t));
+    rc_len.StartEncode();
+    rc_len.SetOutput(&streams[sizeof(uint32_t) + n_ops_stream]);
+    model_len.EncodeSymbol(&rc_len, 10);
+    rc_len.FinishEncode();
+
+    ASSERT_EQ(1, cset->columns[1]->buffer.Resize(streams.size(), false));
+    memcpy(cset->columns[1]->mutable_data(), streams.data(), streams.size());
+
+    std::vector<uint32_t> spans;
+    ASSERT_LT(transformer.ReferenceSpans(cset, spans), 0);
+    ASSERT_LT(transformer.Decompress(cset, field), 0);
+}
+
+TEST(NameTests, EncodeDecode) {
+    NameCompressor transformer;
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+
+    std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSetBuilderTensor<uint8_t> > builder = std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset);
+
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint32_t> dx(0, 30000);
+    std::uniform_int_distribution<uint32_t> dhex(0, 15);
+    const char hex[] = "0123456789abcdef";
+
+    uint32_t tile = 1101, y = 1000;
+    for(int i = 0; i < 20000; ++i) {
+        std::string name;
+        if(i % 1000 == 999) { builder->PadNull(); continue; }
+        if(i % 4 == 0) y += dx(eng) % 300;
+        if(i % 5000 == 4999) ++tile;
+
+        if(i < 15000) {
+            // Illumina with zero-padded and very long numbers.
+            name = "ST-E00106:108:H03M0ALXX:1:" + std::to_string(tile) + ":" + std::to_string(dx(eng)) + ":" + std::to_string(y);
+            if(i % 7 == 0) name += "/00" + std::to_string(i % 3) + "_12345678901234";
+        } else {
+            // Nanopore UUID.
+            for(int j = 0; j < 36; ++j)
+                name += (j == 8 || j == 13 || j == 18 || j == 23) ? '-' : hex[dhex(eng)];
+            if(i % 3 == 0) name += "_Basecall_1D_template";
+            // More tokens than PIL_NAME_MAX_TOKENS.
+            if(i % 11 == 0) for(int j = 0; j < 40; ++j) name += ":" + std::to_string(j);
+        }
+        ASSERT_EQ(1, builder->Append(reinterpret_cast<const uint8_t*>(name.data()), name.size()));
+    }
+
+    cset->columns[1]->ComputeChecksum();
+    const uint32_t n_in = cset->columns[1]->buffer.length();
+    ASSERT_GT(transformer.Compress(cset, field), 0);
+    ASSERT_EQ(PIL_COMPRESS_RC_ILLUMINA_NAME, cset->columns[1]->transformation_args.back()->ctype);
+    ASSERT_LT(cset->columns[1]->compressed_size, n_in / 3);
+
+    ASSERT_EQ(n_in, transformer.Decompress(cset, field));
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
+}
+
+TEST(PbwtTests, EncodeDecode) {
+    PbwtCompressor transformer;
+    // The models are drawn from the model pool and returned to it.
+    HugePageMemoryPool model_pool(default_memory_pool());
+    transformer.SetModelMemoryPool(&model_pool);
+
+    DictionaryFieldType field;
+    field.cstore = PIL_CSTORE_TENSOR;
+    field.ptype  = PIL_TYPE_UINT8;
+
+    std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+    std::shared_ptr<ColumnSetBuilderTensor<uint8_t> > builder = std::static_pointer_cast< ColumnSetBuilderTensor<uint8_t> >(cset);
+
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint32_t> dist(0, 999);
+
+    // Haplotypes are mosaics of a small set of founders with rare variants
+    // and occasional recombination.
+    const uint32_t n_haplotypes = 1002, n_founders = 16;
+    std::vector<uint32_t> copying(n_haplotypes);
+    for(uint32_t h = 0; h < n_haplotypes; ++h) copying[h] = h % n_founders;
+    std::vector<uint8_t> founders(n_founders), site;
+
+    for(int i = 0; i < 3000; ++i) {
+        if(i % 101 == 0) { builder->PadNull(); continue; }
+
+        // Sites with a different number of haplotypes reset the prefix array.
+        const uint32_t n = (i % 500 == 7) ? 37 : n_haplotypes;
+        for(uint32_t f = 0; f < n_founders; ++f) founders[f] = (dist(eng) < 50);
+        site.assign((n + 3) / 4, 0);
+        for(uint32_t h = 0; h < n; ++h) {
+            if(dist(eng) == 0) copying[h] = dist(eng) % n_founders;
+            uint8_t sym = founders[copying[h]];
+            if(dist(eng) == 0) sym = 2; // missing
+            if(h == n - 1 && (i % 3) == 0) sym = 3; // end of vector
+            site[h / 4] |= sym << ((h % 4) * 2);
+        }
+        ASSERT_EQ(1, builder->Append(site.data(), site.size()));
+    }
+
+    cset->columns[1]->ComputeChecksum();
+    const uint32_t n_in = cset->columns[1]->buffer.length();
+    ASSERT_GT(transformer.Compress(cset, field), 0);
+    ASSERT_EQ(PIL_ENCODE_PBWT, cset->columns[1]->transformation_args.back()->ctype);
+    ASSERT_LT(cset->columns[1]->compressed_size, n_in / 10);
+    ASSERT_GT(model_pool.max_memory(), 0);
+    ASSERT_EQ(0, model_pool.bytes_allocated());
+
+    ASSERT_EQ(n_in, transformer.Decompress(cset, field));
+    ASSERT_EQ(0, model_pool.bytes_allocated());
+    uint8_t digest[PIL_CHECKSUM_LENGTH]; memset(digest, 0, 16);
+    Checksum::Compute(cset->columns[1]->checksum_type, cset->columns[1]->mutable_data(), cset->columns[1]->buffer.length(), digest);
+    ASSERT_EQ(0, memcmp(cset->columns[1]->checksum, digest, 16));
+}
+
+TEST(NullityTests, CompressDecompress) {
+    ZstdCompressor zstd;
+    std::random_device rd;
+    std::mt19937 eng(rd());
+    std::uniform_int_distribution<uint32_t> distr(0, 999);
+
+    // All valid, all null, sparse nulls, and dense random. The record count
+    // is not a multiple of 32.
+    const PIL_NULLITY_TYPE expected[4] = {PIL_NULLITY_ALL_VALID, PIL_NULLITY_ALL_NULL, PIL_NULLITY_RUNS, PIL_NULLITY_BITMAP};
+    for(int k = 0; k < 4; ++k) {
+        std::shared_ptr<ColumnStore> cstore = std::make_shared<ColumnStore>();
+        std::shared_ptr<ColumnStoreBuilder<uint32_t> > builder = std::static_pointer_cast< ColumnStoreBuilder<uint32_t> >(cstore);
+
+        std::vector<bool> valid(100003);
+        for(size_t i = 0; i < valid.size(); ++i) {
+            switch(k) {
+            case(0): valid[i] = true; break;
+            case(1): valid[i] = false; break;
+            case(2): valid[i] = (distr(eng) != 0); break;
+            case(3): valid[i] = (distr(eng) < 500); break;
+            }
+            ASSERT_EQ(1, builder->AppendValidity(valid[i]));
+            ASSERT_EQ(1, builder->Append(i));
+        }
+        const uint32_t n_valid = cstore->CountValid();
+
+        ASSERT_GE(zstd.CompressNullity(cstore), 0);
+        ASSERT_EQ(expected[k], cstore->nullity_type);
+        ASSERT_EQ((100003 + 31) / 32 * sizeof(uint32_t), cstore->nullity_u);
+        ASSERT_EQ(100003 - n_valid, cstore->n_null);
+        if(k < 2) {
+            ASSERT_EQ(0, cstore->nullity_c);
+        }
+        if(k == 2) {
+            ASSERT_LT(cstore->nullity_c, cstore->nullity_u / 10);
+        }
+
+        ASSERT_EQ(cstore->nullity_u, zstd.DecompressNullity(cstore));
+        for(size_t i = 0; i < valid.size(); ++i) ASSERT_EQ(valid[i], cstore->IsValid(i));
+        ASSERT_EQ(n_valid, cstore->CountValid());
+    }
+}
+
+TEST(NullityTests, TensorOffsets) {
+    ZstdCompressor zstd;
+
+    // The offsets of a Tensor hold n + 1 entries for n records: only the
+    // records are counted.
+    for(int k = 0; k < 2; ++k) {
+        std::shared_ptr<ColumnSet> cset = std::make_shared<ColumnSet>();
+        std::shared_ptr<ColumnSetBuilderTensor<uint32_t> > builder = std::static_pointer_cast< ColumnSetBuilderTensor<uint32_t> >(cset);
+
+        std::vector<uint32_t> x = {1, 2, 3};
+        uint32_t n_null = 0;
+        for(uint32_t i = 0; i < 1000; ++i) {
+            if(k == 1 || (i % 100) == 0) { ASSERT_EQ(1, builder->PadNull()); ++n_null; }
+            else ASSERT_EQ(1, builder->Append(x));
+        }
+        std::shared_ptr<ColumnStore> offsets = cset->columns[0];
+        ASSERT_EQ(1001, offsets->n_records);
+        ASSERT_EQ(n_null, offsets->n_null);
+
+        ASSERT_GE(zstd.CompressNullity(offsets), 0);
+        ASSERT_EQ(n_null, offsets->n_null);
+        ASSERT_EQ(k == 1 ? PIL_NULLITY_ALL_NULL : PIL_NULLITY_RUNS, offsets->nullity_type);
+
+        ASSERT_EQ(offsets->nullity_u, zstd.DecompressNullity(offsets));
+        for(uint32_t i = 0; i < 1000; ++i) ASSERT_EQ(k == 0 && (i % 100) != 0, offsets->IsValid(i));
+    }
 }
 
 }
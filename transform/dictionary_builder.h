@@ -109,10 +109,6 @@ template <class T>
 int NumericDictionaryBuilder<T>::Encode(std::shared_ptr<ColumnStore> column, const bool force) {
    if(column.get() == nullptr) return(-1);
 
-   if(column->nullity.get() == nullptr) {
-       return(PIL_DICT_MISSING_NULLITY);
-   }
-
    if(column->n_elements * sizeof(T) != column->buffer.length()) {
        return(PIL_DICT_MALFORMED);
    }
@@ -188,7 +184,7 @@ int NumericDictionaryBuilder<T>::Encode(std::shared_ptr<ColumnStore> column, con
        column->buffer.UnsafeSetLength(column->n_records*sizeof(uint32_t));
        column->uncompressed_size = column->n_records*sizeof(uint32_t);
        column->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_ENCODE_DICT, n_in, column->n_records*sizeof(uint32_t)));
-       column->transformation_args.back()->ComputeChecksum(column->mutable_data(), column->uncompressed_size);
+       column->transformation_args.back()->ComputeChecksum(column->checksum_type, column->mutable_data(), column->uncompressed_size);
        delete[] d;
        return(1);
    }
@@ -200,17 +196,13 @@ template <class T>
 int NumericDictionaryBuilder<T>::Encode(std::shared_ptr<ColumnStore> column, std::shared_ptr<ColumnStore> strides, const bool force) {
    if(column.get() == nullptr) return(PIL_DICT_STORE_NULLPTR);
    if(strides.get() == nullptr) return(PIL_DICT_STORE_NULLPTR);
-
-   if(strides->nullity.get() == nullptr) {
-       return(PIL_DICT_MISSING_NULLITY);
-   }
+   // Batches with 64-bit offsets are too large to benefit from a dictionary.
+   if(strides->offset_width == sizeof(uint64_t)) return(0);
 
    if(column->n_elements * sizeof(T) != column->buffer.length()) {
        return(PIL_DICT_MALFORMED);
    }
 
-   if(strides->nullity.get() == nullptr) { return(PIL_DICT_MALFORMED); }
-
    typedef std::unordered_map<std::vector<T>, bool, VectorHasher<T>> map_type;
    map_type map;
    std::vector< std::vector<T> > list;
@@ -341,7 +333,7 @@ int NumericDictionaryBuilder<T>::Encode(std::shared_ptr<ColumnStore> column, std
     column->uncompressed_size = n_s*sizeof(uint32_t);
     column->buffer.UnsafeSetLength(n_s*sizeof(uint32_t));
     column->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_ENCODE_DICT, n_in, column->buffer.length()));
-    column->transformation_args.back()->ComputeChecksum(column->mutable_data(), column->buffer.length());
+    column->transformation_args.back()->ComputeChecksum(column->checksum_type, column->mutable_data(), column->buffer.length());
     //std::cerr << "DICT for string: shrink " << n_in << "->" << column->buffer.length() << std::endl;
     //std::cerr << "DICT meta=" << sz_list << "b" << std::endl;
     delete[] d;
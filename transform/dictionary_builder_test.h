@@ -312,15 +312,18 @@ TEST(DictionaryBuilderTests, FindSingleIntTensorGetIllegal) {
     ASSERT_EQ(-5, dict.Get<uint32_t>(0, ret));
 }
 
-TEST(DictionaryBuilderTests, TensorIllegalNoNullity) {
+TEST(DictionaryBuilderTests, TensorNoNullity) {
     std::shared_ptr< ColumnSetBuilderTensor<uint32_t> > cbuild = std::make_shared< ColumnSetBuilderTensor<uint32_t> >();
 
     std::vector<uint32_t> vals = {10,12,14,21};
     cbuild->Append(vals.data(), vals.size());
     cbuild->columns[0]->nullity = nullptr;
 
+    // A missing Nullity bitmap means every record is valid.
     NumericDictionaryBuilder<uint32_t> dict;
-    ASSERT_EQ(PIL_DICT_MISSING_NULLITY, dict.Encode(cbuild->columns[1], cbuild->columns[0], true));
+    ASSERT_EQ(1, dict.Encode(cbuild->columns[1], cbuild->columns[0], true));
+    ASSERT_EQ(1, dict.NumberRecords());
+    ASSERT_EQ(4, dict.NumberElements());
 }
 
 TEST(DictionaryBuilderTests, FindSingleIntTensorGetIllegalOutofBounds) {
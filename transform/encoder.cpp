@@ -15,20 +15,27 @@ int DeltaEncoder::Encode(std::shared_ptr<ColumnSet> cset, const DictionaryFieldT
             case(PIL_TYPE_INT8):
             case(PIL_TYPE_INT16):
             case(PIL_TYPE_INT32):
-            case(PIL_TYPE_INT64):
             case(PIL_TYPE_UINT8):
             case(PIL_TYPE_UINT16):
-            case(PIL_TYPE_UINT64):
             case(PIL_TYPE_FLOAT):
             case(PIL_TYPE_DOUBLE): return(-1);
             case(PIL_TYPE_UINT32):
                 compute_deltas_inplace(reinterpret_cast<uint32_t*>(tgt->mutable_data()), tgt->n_records, 0);
                 ret_status = 1;
                 break;
+            case(PIL_TYPE_INT64):
+            case(PIL_TYPE_UINT64):
+            {
+                // Signed values wrap around in their two's complement form.
+                uint64_t* values = reinterpret_cast<uint64_t*>(tgt->mutable_data());
+                for(int64_t j = (int64_t)tgt->n_records - 1; j > 0; --j) values[j] -= values[j - 1];
+                ret_status = 1;
+                break;
+            }
             }
             if(ret_status < 0) return(ret_status);
             tgt->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_ENCODE_DELTA, tgt->buffer.length(), tgt->buffer.length()));
-            tgt->transformation_args.back()->ComputeChecksum(tgt->buffer.mutable_data(), tgt->buffer.length());
+            tgt->transformation_args.back()->ComputeChecksum(tgt->checksum_type, tgt->buffer.mutable_data(), tgt->buffer.length());
         }
 
     } else if(field.cstore == PIL_CSTORE_TENSOR) {
@@ -53,7 +60,7 @@ int DeltaEncoder::Encode(std::shared_ptr<ColumnSet> cset, const DictionaryFieldT
         }
         if(ret_status < 0) return(ret_status);
         tgt->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_ENCODE_DELTA, tgt->buffer.length(), tgt->buffer.length()));
-        tgt->transformation_args.back()->ComputeChecksum(tgt->buffer.mutable_data(), tgt->buffer.length());
+        tgt->transformation_args.back()->ComputeChecksum(tgt->checksum_type, tgt->buffer.mutable_data(), tgt->buffer.length());
 
     } else {
         std::cerr << "unknown storage model" << std::endl;
@@ -65,12 +72,20 @@ int DeltaEncoder::Encode(std::shared_ptr<ColumnSet> cset, const DictionaryFieldT
 
 int DeltaEncoder::UnsafeEncode(std::shared_ptr<ColumnStore> cstore) {
     if(cstore.get() == nullptr) return(-4);
-    if(cstore->buffer.length() % sizeof(uint32_t) != 0) return(-5);
-    if(cstore->n_records * sizeof(uint32_t) != cstore->buffer.length()) return(-5);
 
-    compute_deltas_inplace(reinterpret_cast<uint32_t*>(cstore->mutable_data()), cstore->n_records, 0);
+    // Tensor offsets promoted to 64-bit.
+    if(cstore->offset_width == sizeof(uint64_t)) {
+        if(cstore->n_records * sizeof(uint64_t) != cstore->buffer.length()) return(-5);
+        uint64_t* values = reinterpret_cast<uint64_t*>(cstore->mutable_data());
+        for(int64_t i = (int64_t)cstore->n_records - 1; i > 0; --i) values[i] -= values[i - 1];
+    } else {
+        if(cstore->buffer.length() % sizeof(uint32_t) != 0) return(-5);
+        if(cstore->n_records * sizeof(uint32_t) != cstore->buffer.length()) return(-5);
+        compute_deltas_inplace(reinterpret_cast<uint32_t*>(cstore->mutable_data()), cstore->n_records, 0);
+    }
+
     cstore->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_ENCODE_DELTA, cstore->buffer.length(), cstore->buffer.length()));
-    cstore->transformation_args.back()->ComputeChecksum(cstore->buffer.mutable_data(), cstore->buffer.length());
+    cstore->transformation_args.back()->ComputeChecksum(cstore->checksum_type, cstore->buffer.mutable_data(), cstore->buffer.length());
 
     return(1);
 }
@@ -87,16 +102,22 @@ int DeltaEncoder::PrefixSum(std::shared_ptr<ColumnSet> cset, const DictionaryFie
             case(PIL_TYPE_INT8):
             case(PIL_TYPE_INT16):
             case(PIL_TYPE_INT32):
-            case(PIL_TYPE_INT64):
             case(PIL_TYPE_UINT8):
             case(PIL_TYPE_UINT16):
-            case(PIL_TYPE_UINT64):
             case(PIL_TYPE_FLOAT):
             case(PIL_TYPE_DOUBLE): return(-1);
             case(PIL_TYPE_UINT32):
                 compute_prefix_sum_inplace(reinterpret_cast<uint32_t*>(tgt->mutable_data()), tgt->n_records, 0);
                 ret_status = 1;
                 break;
+            case(PIL_TYPE_INT64):
+            case(PIL_TYPE_UINT64):
+            {
+                uint64_t* values = reinterpret_cast<uint64_t*>(tgt->mutable_data());
+                for(uint32_t j = 1; j < tgt->n_records; ++j) values[j] += values[j - 1];
+                ret_status = 1;
+                break;
+            }
             }
             if(ret_status < 0) return(ret_status);
         }
@@ -133,6 +154,15 @@ int DeltaEncoder::PrefixSum(std::shared_ptr<ColumnSet> cset, const DictionaryFie
 
 int DeltaEncoder::UnsafePrefixSum(std::shared_ptr<ColumnStore> cstore, const DictionaryFieldType& field) {
     if(cstore.get() == nullptr) return(-4);
+
+    // Tensor offsets promoted to 64-bit.
+    if(cstore->offset_width == sizeof(uint64_t)) {
+        if(cstore->n_records * sizeof(uint64_t) != cstore->buffer.length()) return(-5);
+        uint64_t* values = reinterpret_cast<uint64_t*>(cstore->mutable_data());
+        for(uint32_t i = 1; i < cstore->n_records; ++i) values[i] += values[i - 1];
+        return(1);
+    }
+
     if(cstore->buffer.length() % sizeof(uint32_t) != 0) return(-5);
     if(cstore->n_records * sizeof(uint32_t) != cstore->buffer.length()) return(-5);
 
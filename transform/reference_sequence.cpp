@@ -0,0 +1,369 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+#include "reference_sequence.h"
+#include "../third_party/xxhash/xxhash.h"
+
+namespace pil {
+
+ReferenceSequence::ReferenceSequence() : fd_(-1), data_(nullptr), n_data_(0) {}
+
+ReferenceSequence::~ReferenceSequence() { Close(); }
+
+int ReferenceSequence::Open(const std::string& fasta_path) {
+    Close();
+
+    int ret = ReadIndex(fasta_path + ".fai");
+    if(ret < 0) return(ret);
+
+    fd_ = open(fasta_path.c_str(), O_RDONLY);
+    if(fd_ < 0) return(-3);
+
+    struct stat st;
+    if(fstat(fd_, &st) != 0) { Close(); return(-4); }
+    n_data_ = st.st_size;
+    if(n_data_ == 0) { Close(); return(-4); }
+
+    void* map = mmap(nullptr, n_data_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(map == MAP_FAILED) { Close(); return(-5); }
+    data_ = reinterpret_cast<uint8_t*>(map);
+    // Reads are fetched in order of position so hint the kernel accordingly.
+    madvise(map, n_data_, MADV_WILLNEED);
+
+    // Make sure the index describes this file.
+    for(size_t i = 0; i < contigs.size(); ++i) {
+        if(contigs[i].line_bases <= 0) { Close(); return(-6); }
+        const int64_t n_lines = (contigs[i].length + contigs[i].line_bases - 1) / contigs[i].line_bases;
+        const int64_t last = contigs[i].offset + (n_lines - 1) * contigs[i].line_width + (contigs[i].length - (n_lines - 1) * contigs[i].line_bases);
+        if(contigs[i].length && last > (int64_t)n_data_) { Close(); return(-6); }
+    }
+
+    for(size_t i = 0; i < contigs.size(); ++i) contigs[i].hash = HashContig(contigs[i]);
+
+    return(1);
+}
+
+void ReferenceSequence::Close() {
+    if(data_ != nullptr) munmap(data_, n_data_);
+    if(fd_ >= 0) close(fd_);
+    data_ = nullptr;
+    n_data_ = 0;
+    fd_ = -1;
+}
+
+int ReferenceSequence::ReadIndex(const std::string& index_path) {
+    std::ifstream f(index_path);
+    if(f.good() == false) return(-1);
+
+    contigs.clear();
+    contig_map.clear();
+
+    std::string line;
+    while(std::getline(f, line)) {
+        if(line.size() == 0) continue;
+
+        // NAME LENGTH OFFSET LINEBASES LINEWIDTH
+        std::stringstream ss(line);
+        Contig contig;
+        if(!(ss >> contig.name >> contig.length >> contig.offset >> contig.line_bases >> contig.line_width))
+            return(-2);
+
+        if(contig_map.find(contig.name) != contig_map.end()) return(-2);
+        contig_map[contig.name] = contigs.size();
+        contigs.push_back(contig);
+    }
+
+    return(1);
+}
+
+int32_t ReferenceSequence::Find(const std::string& contig_name) const {
+    auto it = contig_map.find(contig_name);
+    if(it == contig_map.end()) return(-1);
+    return(it->second);
+}
+
+int64_t ReferenceSequence::Fetch(const uint32_t contig_id, const int64_t start, const int64_t length, uint8_t* out) const {
+    if(data_ == nullptr) return(-1);
+    if(contig_id >= contigs.size()) return(-2);
+    const Contig& c = contigs[contig_id];
+    if(start < 0 || length < 0 || start + length > c.length) return(-3);
+
+    // Copy line by line from the mapped file skipping the newline characters.
+    int64_t pos = start, n_out = 0;
+    while(n_out < length) {
+        const int64_t line   = pos / c.line_bases;
+        const int64_t col    = pos % c.line_bases;
+        const int64_t n_copy = std::min<int64_t>(c.line_bases - col, length - n_out);
+        memcpy(&out[n_out], &data_[c.offset + line * c.line_width + col], n_copy);
+        n_out += n_copy;
+        pos   += n_copy;
+    }
+
+    return(n_out);
+}
+
+uint64_t ReferenceSequence::HashContig(const Contig& c) const {
+    // Bases are mapped line by line into a staging buffer that is hashed
+    // whenever it is full.
+    uint8_t buffer[65536];
+    uint32_t n_buffer = 0;
+    XXH64_state_t* state = XXH64_createState();
+    XXH64_reset(state, 0);
+    for(int64_t pos = 0; pos < c.length; ) {
+        const int64_t n_line = std::min<int64_t>(c.line_bases, c.length - pos);
+        const uint8_t* line = &data_[c.offset + (pos / c.line_bases) * c.line_width];
+        for(int64_t j = 0; j < n_line; ++j) {
+            buffer[n_buffer++] = ReferenceBaseTable[line[j]];
+            if(n_buffer == sizeof(buffer)) {
+                XXH64_update(state, buffer, n_buffer);
+                n_buffer = 0;
+            }
+        }
+        pos += n_line;
+    }
+    XXH64_update(state, buffer, n_buffer);
+    const uint64_t hash = XXH64_digest(state);
+    XXH64_freeState(state);
+    return(hash);
+}
+
+uint64_t ReferenceSequence::Fingerprint() const {
+    XXH64_state_t* state = XXH64_createState();
+    XXH64_reset(state, 912732);
+    for(size_t i = 0; i < contigs.size(); ++i) {
+        XXH64_update(state, contigs[i].name.data(), contigs[i].name.size());
+        XXH64_update(state, &contigs[i].length, sizeof(int64_t));
+        XXH64_update(state, &contigs[i].hash, sizeof(uint64_t));
+    }
+    const uint64_t hash = XXH64_digest(state);
+    XXH64_freeState(state);
+    return(hash);
+}
+
+// Four decoded bases for every packed byte.
+struct PackedBaseTable {
+    PackedBaseTable() {
+        for(uint32_t v = 0; v < 256; ++v) {
+            for(uint32_t k = 0; k < 4; ++k) bases[v][k] = "ACGT"[(v >> (2*k)) & 3];
+        }
+    }
+
+    char bases[256][4];
+};
+
+PackedReference::PackedReference(const uint32_t block_bases) : block_bases(block_bases) {}
+
+void PackedReference::clear() {
+    contigs.clear();
+    blocks.clear();
+    packed.clear();
+    runs.clear();
+    contig_map.clear();
+}
+
+void PackedReference::PackBases(const char* bases, const uint32_t n_bases, uint8_t* packed,
+                                std::vector<uint32_t>& n_runs, std::vector<uint32_t>& mask_runs)
+{
+    n_runs.clear();
+    mask_runs.clear();
+    memset(packed, 0, (n_bases + 3) / 4);
+
+    // A run is open while its start is not UINT32_MAX.
+    uint32_t n_start = UINT32_MAX, mask_start = UINT32_MAX;
+    for(uint32_t i = 0; i < n_bases; ++i) {
+        const uint8_t c = bases[i];
+        const uint8_t code = ReferenceBaseTable[c];
+        const bool is_n = (code == 4), is_lower = (c >= 'a' && c <= 'z');
+
+        if(is_n && n_start == UINT32_MAX) n_start = i;
+        else if(is_n == false && n_start != UINT32_MAX) {
+            n_runs.push_back(n_start);
+            n_runs.push_back(i - n_start);
+            n_start = UINT32_MAX;
+        }
+        if(is_lower && mask_start == UINT32_MAX) mask_start = i;
+        else if(is_lower == false && mask_start != UINT32_MAX) {
+            mask_runs.push_back(mask_start);
+            mask_runs.push_back(i - mask_start);
+            mask_start = UINT32_MAX;
+        }
+
+        packed[i >> 2] |= (code & 3) << ((i & 3) << 1);
+    }
+    if(n_start != UINT32_MAX) { n_runs.push_back(n_start); n_runs.push_back(n_bases - n_start); }
+    if(mask_start != UINT32_MAX) { mask_runs.push_back(mask_start); mask_runs.push_back(n_bases - mask_start); }
+}
+
+int32_t PackedReference::AddContig(const std::string& name) {
+    if(contig_map.find(name) != contig_map.end()) return(-1);
+
+    Contig contig;
+    contig.name = name;
+    contig.first_block = blocks.size();
+    contig_map[name] = contigs.size();
+    contigs.push_back(contig);
+    return(contigs.size() - 1);
+}
+
+int PackedReference::AddBlock(const uint8_t* data, const uint32_t n_bases, const std::vector<uint32_t>& n_runs, const std::vector<uint32_t>& mask_runs) {
+    if(contigs.size() == 0 || n_bases == 0 || n_bases > block_bases) return(-1);
+    Contig& contig = contigs.back();
+    if(contig.n_blocks && blocks.back().n_bases != block_bases) return(-1);
+
+    Block block;
+    block.offset = packed.size();
+    block.n_bases = n_bases;
+    block.run_offset = runs.size() / 2;
+    block.n_n_runs = n_runs.size() / 2;
+    block.n_mask_runs = mask_runs.size() / 2;
+    packed.insert(packed.end(), data, data + (n_bases + 3) / 4);
+    runs.insert(runs.end(), n_runs.begin(), n_runs.end());
+    runs.insert(runs.end(), mask_runs.begin(), mask_runs.end());
+    blocks.push_back(block);
+
+    contig.length += n_bases;
+    ++contig.n_blocks;
+    return(1);
+}
+
+int32_t PackedReference::Find(const std::string& contig_name) const {
+    auto it = contig_map.find(contig_name);
+    if(it == contig_map.end()) return(-1);
+    return(it->second);
+}
+
+int64_t PackedReference::FetchRegion(const uint32_t contig_id, const int64_t start, const int64_t end, uint8_t* out) const {
+    static const PackedBaseTable table;
+
+    if(contig_id >= contigs.size()) return(-1);
+    const Contig& c = contigs[contig_id];
+    if(start < 0 || end < start || end > c.length) return(-2);
+
+    for(int64_t b = start / block_bases; b * block_bases < end; ++b) {
+        const Block& block = blocks[c.first_block + b];
+        const int64_t block_start = b * block_bases;
+        const uint32_t from = std::max(start, block_start) - block_start;
+        const uint32_t to = std::min<int64_t>(end, block_start + block.n_bases) - block_start;
+        // Bases [from, to) of the block are written from dst[0].
+        uint8_t* dst = out + (from + block_start - start);
+        const uint8_t* src = &packed[block.offset];
+
+        // Whole bytes are decoded 4 bases at a time.
+        uint32_t i = from;
+        for(; i < to && (i & 3); ++i) dst[i - from] = table.bases[src[i >> 2]][i & 3];
+        for(; i + 4 <= to; i += 4) memcpy(&dst[i - from], table.bases[src[i >> 2]], 4);
+        for(; i < to; ++i) dst[i - from] = table.bases[src[i >> 2]][i & 3];
+
+        // Exceptions overlapping the decoded range.
+        const uint32_t* r = &runs[2 * block.run_offset];
+        for(uint32_t k = 0; k < block.n_n_runs + block.n_mask_runs; ++k) {
+            const uint32_t run_from = std::max(r[2*k], from);
+            const uint32_t run_to = std::min(r[2*k] + r[2*k + 1], to);
+            if(run_from >= run_to) continue;
+            if(k < block.n_n_runs) memset(&dst[run_from - from], 'N', run_to - run_from);
+            else {
+                for(uint32_t j = run_from; j < run_to; ++j) dst[j - from] |= 0x20;
+            }
+        }
+    }
+
+    return(end - start);
+}
+
+int64_t PackedReference::FetchRegion(const std::string& contig_name, const int64_t start, const int64_t end, std::string& out) const {
+    const int32_t contig_id = Find(contig_name);
+    if(contig_id < 0) return(-1);
+    if(start < 0 || end < start) return(-2);
+    out.resize(end - start);
+    const int64_t ret = FetchRegion(contig_id, start, end, reinterpret_cast<uint8_t*>(&out[0]));
+    if(ret < 0) out.clear();
+    return(ret);
+}
+
+int PackedReference::Serialize(std::ostream& stream) const {
+    const uint32_t n_contigs = contigs.size();
+    stream.write(reinterpret_cast<const char*>(&block_bases), sizeof(uint32_t));
+    stream.write(reinterpret_cast<const char*>(&n_contigs), sizeof(uint32_t));
+    for(uint32_t i = 0; i < n_contigs; ++i) {
+        const uint32_t l_name = contigs[i].name.size();
+        stream.write(reinterpret_cast<const char*>(&l_name), sizeof(uint32_t));
+        stream.write(contigs[i].name.data(), l_name);
+        stream.write(reinterpret_cast<const char*>(&contigs[i].length), sizeof(int64_t));
+        stream.write(reinterpret_cast<const char*>(&contigs[i].first_block), sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char*>(&contigs[i].n_blocks), sizeof(uint32_t));
+    }
+
+    const uint64_t n_blocks = blocks.size(), n_packed = packed.size(), n_runs = runs.size();
+    stream.write(reinterpret_cast<const char*>(&n_blocks), sizeof(uint64_t));
+    stream.write(reinterpret_cast<const char*>(blocks.data()), n_blocks*sizeof(Block));
+    stream.write(reinterpret_cast<const char*>(&n_packed), sizeof(uint64_t));
+    stream.write(reinterpret_cast<const char*>(packed.data()), n_packed);
+    stream.write(reinterpret_cast<const char*>(&n_runs), sizeof(uint64_t));
+    stream.write(reinterpret_cast<const char*>(runs.data()), n_runs*sizeof(uint32_t));
+    return(stream.good());
+}
+
+int PackedReference::Deserialize(std::istream& stream) {
+    clear();
+    uint32_t n_contigs = 0;
+    stream.read(reinterpret_cast<char*>(&block_bases), sizeof(uint32_t));
+    stream.read(reinterpret_cast<char*>(&n_contigs), sizeof(uint32_t));
+    if(stream.good() == false || block_bases == 0 || block_bases % 4) return(-1);
+    for(uint32_t i = 0; i < n_contigs; ++i) {
+        Contig contig;
+        uint32_t l_name = 0;
+        stream.read(reinterpret_cast<char*>(&l_name), sizeof(uint32_t));
+        if(stream.good() == false) return(-1);
+        contig.name.resize(l_name);
+        stream.read(&contig.name[0], l_name);
+        stream.read(reinterpret_cast<char*>(&contig.length), sizeof(int64_t));
+        stream.read(reinterpret_cast<char*>(&contig.first_block), sizeof(uint32_t));
+        stream.read(reinterpret_cast<char*>(&contig.n_blocks), sizeof(uint32_t));
+        if(stream.good() == false) return(-1);
+        contig_map[contig.name] = contigs.size();
+        contigs.push_back(contig);
+    }
+
+    uint64_t n = 0;
+    stream.read(reinterpret_cast<char*>(&n), sizeof(uint64_t));
+    if(stream.good() == false) return(-1);
+    blocks.resize(n);
+    stream.read(reinterpret_cast<char*>(blocks.data()), n*sizeof(Block));
+    stream.read(reinterpret_cast<char*>(&n), sizeof(uint64_t));
+    if(stream.good() == false) return(-1);
+    packed.resize(n);
+    stream.read(reinterpret_cast<char*>(packed.data()), n);
+    stream.read(reinterpret_cast<char*>(&n), sizeof(uint64_t));
+    if(stream.good() == false) return(-1);
+    runs.resize(n);
+    stream.read(reinterpret_cast<char*>(runs.data()), n*sizeof(uint32_t));
+    if(stream.good() == false) return(-1);
+
+    // Make sure every contig and block refers to existing data.
+    for(size_t i = 0; i < blocks.size(); ++i) {
+        if(blocks[i].n_bases > block_bases || blocks[i].offset + (blocks[i].n_bases + 3) / 4 > packed.size()) return(-2);
+        if(2 * ((uint64_t)blocks[i].run_offset + blocks[i].n_n_runs + blocks[i].n_mask_runs) > runs.size()) return(-2);
+    }
+    // FetchRegion maps positions to blocks by division: every block but the
+    // last of a contig is full and the blocks cover the contig exactly.
+    for(size_t i = 0; i < contigs.size(); ++i) {
+        if((uint64_t)contigs[i].first_block + contigs[i].n_blocks > blocks.size()) return(-2);
+        int64_t length = 0;
+        for(uint32_t b = 0; b < contigs[i].n_blocks; ++b) {
+            const Block& block = blocks[contigs[i].first_block + b];
+            if(b + 1 < contigs[i].n_blocks && block.n_bases != block_bases) return(-2);
+            length += block.n_bases;
+        }
+        if(length != contigs[i].length) return(-2);
+    }
+    return(1);
+}
+
+}
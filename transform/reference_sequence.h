@@ -0,0 +1,219 @@
+#ifndef TRANSFORM_REFERENCE_SEQUENCE_H_
+#define TRANSFORM_REFERENCE_SEQUENCE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <unordered_map>
+
+#include "../column_store.h"
+
+namespace pil {
+
+// Maps reference bytes to the ACGTN alphabet used by the sequence codecs.
+// A: 65, a: 97 -> 0
+// C: 67, c: 99 -> 1
+// G: 71, g: 103 -> 2
+// T: 84, t: 116 -> 3
+// Anything else -> 4 (N)
+static const uint8_t ReferenceBaseTable[256] =
+{
+4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
+};
+
+// Read-only view of a FASTA file with a samtools-style .fai index. The file is
+// memory-mapped and subsequences are fetched directly from the mapping without
+// loading the contigs into memory.
+class ReferenceSequence {
+public:
+    struct Contig {
+        Contig() : length(0), offset(0), line_bases(0), line_width(0), hash(0){}
+
+        std::string name;
+        int64_t length; // Number of bases in the contig.
+        int64_t offset; // Byte offset of the first base in the FASTA file.
+        int32_t line_bases, line_width; // Bases per line and bytes per line (including newline).
+        uint64_t hash; // XXH64 of the bases mapped through ReferenceBaseTable.
+    };
+
+public:
+    ReferenceSequence();
+    ~ReferenceSequence();
+
+    /**<
+     * Open a FASTA file and its associated index. The index is expected at
+     * `fasta_path + ".fai"`. The content hash of every contig is computed
+     * once here by a sequential pass over the mapped file.
+     * @param fasta_path Path to the FASTA file.
+     * @return           Returns 1 if successful or a negative value otherwise.
+     */
+    int Open(const std::string& fasta_path);
+    void Close();
+
+    bool IsOpen() const { return(data_ != nullptr); }
+    uint32_t size() const { return(contigs.size()); }
+    const Contig& GetContig(const uint32_t contig_id) const { return(contigs[contig_id]); }
+
+    /**<
+     * Find the contig identifier for the provided contig name.
+     * @param contig_name
+     * @return Returns the contig identifier or -1 if not found.
+     */
+    int32_t Find(const std::string& contig_name) const;
+
+    /**<
+     * Copy the 0-based half-open subsequence [start, start + length) of the
+     * target contig into the destination. Bases are copied verbatim.
+     * @param contig_id Target contig identifier.
+     * @param start     0-based start position.
+     * @param length    Number of bases to copy.
+     * @param out       Destination buffer with room for at least `length` bytes.
+     * @return          Returns the number of bases copied or a negative value if the range is illegal.
+     */
+    int64_t Fetch(const uint32_t contig_id, const int64_t start, const int64_t length, uint8_t* out) const;
+
+    /**<
+     * Fingerprint of the contig names, lengths and content hashes. Stored
+     * with data encoded against this reference such that decoding with the
+     * wrong reference is detected, including a reference with the same
+     * layout but different bases. Like the CRAM M5 tag, the content hash is
+     * insensitive to case: bases are hashed in the ACGTN alphabet that the
+     * sequence codecs operate on.
+     * @return Returns the 64-bit fingerprint.
+     */
+    uint64_t Fingerprint() const;
+
+private:
+    int ReadIndex(const std::string& index_path);
+    uint64_t HashContig(const Contig& contig) const;
+
+public:
+    std::vector<Contig> contigs;
+    std::unordered_map<std::string, uint32_t> contig_map;
+
+private:
+    int fd_;
+    uint8_t* data_;
+    size_t n_data_;
+};
+
+// Default number of bases per block of a PackedReference.
+#define PIL_REFERENCE_BLOCK_BASES 65536
+
+// Reference sequence held in memory with 2 bits per base. The bases of every
+// contig are split into blocks of `block_bases` bases and packed 4 per byte
+// in the ACGT order of ReferenceBaseTable with the first base in the lowest
+// bits. Runs of N (or any other IUPAC code, which are stored as N) and runs
+// of soft-masked lowercase bases are kept as exceptions: (start, length)
+// pairs relative to the start of their block. Subsequences are fetched by
+// decoding only the blocks they overlap.
+class PackedReference {
+public:
+    struct Contig {
+        Contig() : length(0), first_block(0), n_blocks(0){}
+
+        std::string name;
+        int64_t length;
+        uint32_t first_block, n_blocks; // Range of the blocks of the contig.
+    };
+
+    struct Block {
+        uint64_t offset; // Byte offset of the packed bases.
+        uint32_t n_bases;
+        uint32_t run_offset; // Offset of the first exception pair in `runs`.
+        uint32_t n_n_runs, n_mask_runs; // N runs followed by mask runs.
+    };
+
+public:
+    PackedReference(const uint32_t block_bases = PIL_REFERENCE_BLOCK_BASES);
+
+    void clear();
+
+    /**<
+     * Pack a run of bases into 2 bits per base and collect its exceptions.
+     * @param bases     Source bases.
+     * @param n_bases   Number of bases.
+     * @param packed    Destination of (n_bases + 3) / 4 bytes.
+     * @param n_runs    Destination (start, length) pairs of N runs.
+     * @param mask_runs Destination (start, length) pairs of lowercase runs.
+     */
+    static void PackBases(const char* bases, const uint32_t n_bases, uint8_t* packed, std::vector<uint32_t>& n_runs, std::vector<uint32_t>& mask_runs);
+
+    /**<
+     * Start a new contig. Blocks are added to the last contig.
+     * @param name Unique name of the contig.
+     * @return     Returns the contig identifier or -1 if the name exists.
+     */
+    int32_t AddContig(const std::string& name);
+
+    /**<
+     * Append a block of packed bases to the last contig. Every block but the
+     * last of a contig must hold `block_bases` bases.
+     * @param packed    Packed bases as produced by PackBases.
+     * @param n_bases   Number of bases.
+     * @param n_runs    Exception pairs of N runs.
+     * @param mask_runs Exception pairs of lowercase runs.
+     * @return          Returns 1 if successful or -1 otherwise.
+     */
+    int AddBlock(const uint8_t* packed, const uint32_t n_bases, const std::vector<uint32_t>& n_runs, const std::vector<uint32_t>& mask_runs);
+
+    int32_t Find(const std::string& contig_name) const;
+
+    /**<
+     * Decode the 0-based half-open subsequence [start, end) of a contig.
+     * @param contig_id Target contig identifier.
+     * @param start     0-based start position.
+     * @param end       0-based end position (exclusive).
+     * @param out       Destination buffer with room for at least `end - start` bytes.
+     * @return          Returns the number of bases decoded or a negative value if the range is illegal.
+     */
+    int64_t FetchRegion(const uint32_t contig_id, const int64_t start, const int64_t end, uint8_t* out) const;
+    int64_t FetchRegion(const std::string& contig_name, const int64_t start, const int64_t end, std::string& out) const;
+
+    int Serialize(std::ostream& stream) const;
+    int Deserialize(std::istream& stream);
+
+public:
+    uint32_t block_bases; // Bases per block: a multiple of 4.
+    std::vector<Contig> contigs;
+    std::vector<Block> blocks;
+    std::vector<uint8_t> packed;
+    std::vector<uint32_t> runs;
+    std::unordered_map<std::string, uint32_t> contig_map;
+};
+
+// The alignment fields required by reference-based codecs. These ColumnSets
+// must be in their untransformed state when encoding or decoding data against
+// the reference: RNAME (uint32 contig identifiers in the reference order),
+// POS (1-based uint32 positions) and CIGAR (tensor of uint8 CIGAR text).
+struct ReferenceContext {
+    ReferenceContext() : rname_field("RNAME"), pos_field("POS"), cigar_field("CIGAR"){}
+
+    bool IsAvailable() const {
+        return(reference.get() != nullptr && reference->IsOpen() &&
+               rname.get() != nullptr && pos.get() != nullptr && cigar.get() != nullptr);
+    }
+
+    void clear() {
+        rname = nullptr;
+        pos   = nullptr;
+        cigar = nullptr;
+    }
+
+    std::string rname_field, pos_field, cigar_field;
+    std::shared_ptr<ReferenceSequence> reference;
+    std::shared_ptr<ColumnSet> rname, pos, cigar;
+};
+
+}
+
+#endif /* TRANSFORM_REFERENCE_SEQUENCE_H_ */
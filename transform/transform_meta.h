@@ -5,7 +5,7 @@
 #include <memory>
 
 #include "../pil.h"
-#include "variant_digest_manager.h"
+#include "../checksum.h"
 
 namespace pil {
 
@@ -18,7 +18,7 @@ struct TransformMetaTuple {
     int Serialize(std::ostream& stream) {
         stream.write(reinterpret_cast<char*>(&ptype),  sizeof(PIL_PRIMITIVE_TYPE));
         stream.write(reinterpret_cast<char*>(&n_data), sizeof(int32_t));
-        if(n_data) stream.write(reinterpret_cast<char*>(data), n_data);
+        if(n_data) stream.write(reinterpret_cast<char*>(data), n_data * PIL_PRIMITIVE_TYPE_WIDTHS[ptype]);
         return(1);
     }
 
@@ -28,27 +28,36 @@ struct TransformMetaTuple {
 };
 
 struct TransformMeta {
-    TransformMeta() : ctype(PIL_COMPRESS_NONE), u_sz(0), c_sz(0), n_tuples(0){ memset(md5_checksum, 0, 16); }
-    TransformMeta(PIL_COMPRESSION_TYPE p) : ctype(p), u_sz(0), c_sz(0), n_tuples(0){ memset(md5_checksum, 0, 16); }
-    TransformMeta(PIL_COMPRESSION_TYPE p, int64_t un_sz) : ctype(p), u_sz(un_sz), c_sz(0), n_tuples(0){ memset(md5_checksum, 0, 16); }
-    TransformMeta(PIL_COMPRESSION_TYPE p, int64_t un_sz, int64_t co_sz) : ctype(p), u_sz(un_sz), c_sz(co_sz), n_tuples(0){ memset(md5_checksum, 0, 16); }
+    TransformMeta() : ctype(PIL_COMPRESS_NONE), u_sz(0), c_sz(0), checksum_type(PIL_CHECKSUM_NONE), n_tuples(0){ memset(checksum, 0, PIL_CHECKSUM_LENGTH); }
+    TransformMeta(PIL_COMPRESSION_TYPE p) : ctype(p), u_sz(0), c_sz(0), checksum_type(PIL_CHECKSUM_NONE), n_tuples(0){ memset(checksum, 0, PIL_CHECKSUM_LENGTH); }
+    TransformMeta(PIL_COMPRESSION_TYPE p, int64_t un_sz) : ctype(p), u_sz(un_sz), c_sz(0), checksum_type(PIL_CHECKSUM_NONE), n_tuples(0){ memset(checksum, 0, PIL_CHECKSUM_LENGTH); }
+    TransformMeta(PIL_COMPRESSION_TYPE p, int64_t un_sz, int64_t co_sz) : ctype(p), u_sz(un_sz), c_sz(co_sz), checksum_type(PIL_CHECKSUM_NONE), n_tuples(0){ memset(checksum, 0, PIL_CHECKSUM_LENGTH); }
 
     int Serialize(std::ostream& stream) {
         stream.write(reinterpret_cast<char*>(&ctype), sizeof(PIL_COMPRESSION_TYPE));
         stream.write(reinterpret_cast<char*>(&u_sz),  sizeof(int64_t));
         stream.write(reinterpret_cast<char*>(&c_sz),  sizeof(int64_t));
-        stream.write(reinterpret_cast<char*>(md5_checksum), 16);
+        uint8_t c_type = checksum_type;
+        stream.write(reinterpret_cast<char*>(&c_type), sizeof(uint8_t));
+        stream.write(reinterpret_cast<char*>(checksum), PIL_CHECKSUM_LENGTH);
         n_tuples = tuples.size();
         stream.write(reinterpret_cast<char*>(&n_tuples), sizeof(int64_t));
         for(int i = 0; i < n_tuples; ++i) tuples[i]->Serialize(stream);
         return(1);
     }
 
-    void SetChecksum(const uint8_t* md5) { memcpy(md5_checksum, md5, 16); }
+    void SetChecksum(const PIL_CHECKSUM_TYPE type, const uint8_t* digest) {
+        checksum_type = type;
+        memcpy(checksum, digest, PIL_CHECKSUM_LENGTH);
+    }
 
-    int ComputeChecksum(const uint8_t* in, const uint32_t l_in) {
-        Digest::GenerateMd5(in, l_in, md5_checksum);
-        return(1);
+    int ComputeChecksum(const PIL_CHECKSUM_TYPE type, const uint8_t* in, const uint64_t l_in) {
+        checksum_type = type;
+        return(Checksum::Compute(type, in, l_in, checksum));
+    }
+
+    bool VerifyChecksum(const uint8_t* in, const uint64_t l_in) const {
+        return(Checksum::Verify(checksum_type, in, l_in, checksum));
     }
 
     // Todo:
@@ -56,7 +65,8 @@ struct TransformMeta {
 
     PIL_COMPRESSION_TYPE ctype;
     int64_t u_sz, c_sz; // uncompressed/compressed size of the referred columnstore
-    uint8_t md5_checksum[16]; // checksum for **COMPRESSED** data
+    PIL_CHECKSUM_TYPE checksum_type;
+    uint8_t checksum[PIL_CHECKSUM_LENGTH]; // checksum for **COMPRESSED** data
     int64_t n_tuples; // for serialization only
     std::vector< std::unique_ptr<TransformMetaTuple> > tuples;
 };
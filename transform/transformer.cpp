@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "transformer.h"
 #include "dictionary_builder.h"
 #include "encoder.h"
@@ -13,7 +15,7 @@
 
 namespace pil {
 
-int Transformer::Transform(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+int64_t Transformer::Transform(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
     if(Transformer::ValidTransformationOrder(field.transforms) == false) return(-1);
 
     // If there is no supplied transformation series then apply the default
@@ -21,17 +23,39 @@ int Transformer::Transform(std::shared_ptr<ColumnSet> cset, const DictionaryFiel
     if(field.transforms.size() == 0)
         return(AutoTransform(cset, field));
 
+    // Range coders address their input with 32-bit offsets: Tensor batches
+    // with 64-bit offsets are compressed with ZSTD instead.
+    const bool wide_offsets = HasWideOffsets(cset) ||
+        (std::find(field.transforms.begin(), field.transforms.end(), PIL_COMPRESS_REF_BASES) != field.transforms.end() &&
+         HasWideOffsets(ref_context.cigar));
+
     // Apply transformations
-    int ret = -1;
-    int ret_total = 0;
+    int64_t ret = -1;
+    int64_t ret_total = 0;
     for(size_t i = 0; i < field.transforms.size(); ++i) {
         switch(field.transforms[i]) {
         case(PIL_COMPRESS_AUTO): ret = AutoTransform(cset, field); break;
-        case(PIL_COMPRESS_ZSTD): break;
-        case(PIL_COMPRESS_NONE): break;
-        case(PIL_COMPRESS_RC_QUAL): ret = static_cast<QualityCompressor*>(this)->Compress(cset, field.cstore); break;
-        case(PIL_COMPRESS_RC_BASES): ret = static_cast<SequenceCompressor*>(this)->Compress(cset, field.cstore); break;
-        case(PIL_COMPRESS_RC_ILLUMINA_NAME): break;
+        case(PIL_COMPRESS_ZSTD): ret = static_cast<ZstdCompressor*>(this)->Compress(cset, field, field.compression_level ? field.compression_level : PIL_ZSTD_DEFAULT_LEVEL); break;
+        case(PIL_COMPRESS_NONE): ret = cset->GetMemoryUsage(); break;
+        case(PIL_COMPRESS_RC_QUAL):
+        case(PIL_COMPRESS_RC_BASES):
+        case(PIL_COMPRESS_RC_ILLUMINA_NAME):
+        case(PIL_COMPRESS_REF_BASES):
+        case(PIL_ENCODE_CIGAR_NIBBLE):
+        case(PIL_ENCODE_PBWT):
+            if(wide_offsets) {
+                ret = static_cast<ZstdCompressor*>(this)->Compress(cset, field, PIL_ZSTD_DEFAULT_LEVEL);
+                break;
+            }
+            switch(field.transforms[i]) {
+            case(PIL_COMPRESS_RC_QUAL): ret = static_cast<QualityCompressor*>(this)->Compress(cset, field.cstore); break;
+            case(PIL_COMPRESS_RC_BASES): ret = static_cast<SequenceCompressor*>(this)->Compress(cset, field.cstore); break;
+            case(PIL_COMPRESS_RC_ILLUMINA_NAME): ret = static_cast<NameCompressor*>(this)->Compress(cset, field); break;
+            case(PIL_COMPRESS_REF_BASES): ret = static_cast<ReferenceSequenceCompressor*>(this)->Compress(cset, field); break;
+            case(PIL_ENCODE_PBWT): ret = static_cast<PbwtCompressor*>(this)->Compress(cset, field); break;
+            default: ret = static_cast<CigarCompressor*>(this)->Compress(cset, field); break;
+            }
+            break;
         case(PIL_ENCODE_DICT): ret = DictionaryEncode(cset, field); break;
         case(PIL_ENCODE_DELTA): ret = static_cast<DeltaEncoder*>(this)->Encode(cset, field); break;
         case(PIL_ENCODE_DELTA_DELTA): break;
@@ -51,34 +75,13 @@ int Transformer::Transform(std::shared_ptr<ColumnSet> cset, const DictionaryFiel
             static_cast<DeltaEncoder*>(this)->UnsafeEncode(cset->columns[0]);
 
             // Compress the strides with ZSTD.
-            int64_t n_in = cset->columns[0]->buffer.length();
-            int ret1 = static_cast<ZstdCompressor*>(this)->Compress(
-                                   cset->columns[0]->buffer.mutable_data(),
-                                   cset->columns[0]->buffer.length(),
-                                   PIL_ZSTD_DEFAULT_LEVEL);
-
+            int64_t ret1 = static_cast<ZstdCompressor*>(this)->Compress(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
             if(ret1 < 0) return(-6); // compression failure
-
-            memcpy(cset->columns[0]->buffer.mutable_data(), buffer->mutable_data(), ret1);
-            cset->columns[0]->compressed_size = ret1;
-            cset->columns[0]->buffer.UnsafeSetLength(ret1);
-            cset->columns[0]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_ZSTD,n_in,ret1));
-            cset->columns[0]->transformation_args.back()->ComputeChecksum(cset->columns[0]->buffer.mutable_data(), ret1);
             ret_total += ret1;
 
             // Compress the Nullity bitmap
-            if(cset->columns[0]->nullity.get() == nullptr) return(-5); // malformed data
-
-            const uint32_t n_nullity = std::ceil((float)cset->columns[0]->n_records / 32);
-            int retNull = static_cast<ZstdCompressor*>(this)->Compress(
-                                         cset->columns[0]->nullity->mutable_data(),
-                                         n_nullity,
-                                         PIL_ZSTD_DEFAULT_LEVEL);
-
+            int retNull = static_cast<ZstdCompressor*>(this)->CompressNullity(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
             if(retNull < 0) return(-6); // compression failure
-            cset->columns[0]->nullity_u = n_nullity;
-            cset->columns[0]->nullity_c = retNull;
-            memcpy(cset->columns[0]->nullity->mutable_data(), buffer->mutable_data(), retNull);
             ret_total += retNull;
         }
 
@@ -87,7 +90,7 @@ int Transformer::Transform(std::shared_ptr<ColumnSet> cset, const DictionaryFiel
     return(ret_total);
 }
 
-int Transformer::AutoTransform(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+int64_t Transformer::AutoTransform(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
     if(cset.get() == nullptr) return(-1);
 
     if(field.cstore == PIL_CSTORE_COLUMN) return(AutoTransformColumns(cset, field));
@@ -95,14 +98,14 @@ int Transformer::AutoTransform(std::shared_ptr<ColumnSet> cset, const Dictionary
     else return(-2);
 }
 
-int Transformer::AutoTransformColumns(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+int64_t Transformer::AutoTransformColumns(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
     if(cset.get() == nullptr) return(-1);
     if(cset->size() == 0) return(1);
 
-    int ret = -1;
+    int64_t ret = -1;
     for(int i = 0; i < cset->size(); ++i) {
         if(cset->columns[i].get() == nullptr) return(-4);
-        int ret_i = AutoTransformColumn(cset->columns[i], field);
+        int64_t ret_i = AutoTransformColumn(cset->columns[i], field);
         if(ret_i < 0) return(-3);
         ret += ret_i;
     }
@@ -110,11 +113,11 @@ int Transformer::AutoTransformColumns(std::shared_ptr<ColumnSet> cset, const Dic
     return(ret);
 }
 
-int Transformer::AutoTransformColumn(std::shared_ptr<ColumnStore> cstore, const DictionaryFieldType& field) {
+int64_t Transformer::AutoTransformColumn(std::shared_ptr<ColumnStore> cstore, const DictionaryFieldType& field) {
     if(cstore.get() == nullptr) return(-4);
     if(cstore->n_records == 0) return(1);
 
-    int ret = 0;
+    int64_t ret = 0;
 
     // Attempt to Dictionary encode data. If successful then compress the
     // dictionary with ZSTD.
@@ -134,48 +137,28 @@ int Transformer::AutoTransformColumn(std::shared_ptr<ColumnStore> cstore, const
     }
 
     // Compress the Nullity bitmap.
-    // Not every ColumnStore has a Nullity bitmap. For example, Dictionary
-    // columns.
-    if(cstore->nullity.get() != nullptr) {
-       const uint32_t n_nullity = std::ceil((float)cstore->n_records / 32);
-       int retNull = static_cast<ZstdCompressor*>(this)->Compress(
-                          cstore->nullity->mutable_data(),
-                          n_nullity,
-                          PIL_ZSTD_DEFAULT_LEVEL);
-
-       cstore->nullity_u = n_nullity;
-       cstore->nullity_c = retNull;
-       ret += retNull;
-       memcpy(cstore->nullity->mutable_data(), buffer->mutable_data(), retNull);
-       //std::cerr << "nullity-zstd: " << n_nullity << "->" << retNull << " (" << (float)n_nullity/retNull << "-fold)" << std::endl;
-    }
+    // Not every ColumnStore has a Nullity bitmap: for example, Dictionary
+    // columns or columns without nulls. These are stored as all-valid.
+    int retNull = static_cast<ZstdCompressor*>(this)->CompressNullity(cstore, PIL_ZSTD_DEFAULT_LEVEL);
+    if(retNull < 0) return(-6); // compression failure
+    ret += retNull;
+    //std::cerr << "nullity-zstd: " << cstore->nullity_u << "->" << retNull << " (" << (float)cstore->nullity_u/retNull << "-fold)" << std::endl;
 
     // Compress the actual data with ZSTD.
-    int64_t n_in = cstore->buffer.length();
-    int ret2 = static_cast<ZstdCompressor*>(this)->Compress(
-           cstore->buffer.mutable_data(),
-           cstore->buffer.length(),
-           PIL_ZSTD_DEFAULT_LEVEL);
-
-    //std::cerr << "data-zstd: " << cstore->buffer.length() << "->" << ret2 << " (" << (float)cstore->buffer.length()/ret2 << "-fold)" << std::endl;
-
-    cstore->compressed_size = ret2;
-    cstore->buffer.UnsafeSetLength(ret2);
-    memcpy(cstore->buffer.mutable_data(), buffer->mutable_data(), ret2);
-    cstore->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_ZSTD, n_in, ret2));
-    cstore->transformation_args.back()->ComputeChecksum(cstore->buffer.mutable_data(), ret2);
+    int64_t ret2 = static_cast<ZstdCompressor*>(this)->Compress(cstore, PIL_ZSTD_DEFAULT_LEVEL);
+    if(ret2 < 0) return(-6); // compression failure
     ret += ret2;
 
     return(ret);
 }
 
-int Transformer::AutoTransformTensor(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
+int64_t Transformer::AutoTransformTensor(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field) {
     if(cset.get() == nullptr) return(-1);
     if(cset->n != 2) return(-5); // malformed data
     if(cset->columns[0].get() == nullptr) return(-5);
     if(cset->columns[1].get() == nullptr) return(-5);
 
-    int ret = 0;
+    int64_t ret = 0;
 
     // Attempt to dictionary encode the data given the strides.
     // If set then compress the dictionary and strides with ZSTD.
@@ -212,54 +195,19 @@ int Transformer::AutoTransformTensor(std::shared_ptr<ColumnSet> cset, const Dict
     static_cast<DeltaEncoder*>(this)->UnsafeEncode(cset->columns[0]);
 
     // Compress the strides with ZSTD.
-    int64_t n_in = cset->columns[0]->buffer.length();
-    int ret1 = static_cast<ZstdCompressor*>(this)->Compress(
-                           cset->columns[0]->buffer.mutable_data(),
-                           cset->columns[0]->buffer.length(),
-                           PIL_ZSTD_DEFAULT_LEVEL);
-
+    int64_t ret1 = static_cast<ZstdCompressor*>(this)->Compress(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
     if(ret1 < 0) return(-6); // compression failure
 
-    memcpy(cset->columns[0]->buffer.mutable_data(), buffer->mutable_data(), ret1);
-    cset->columns[0]->compressed_size = ret1;
-    cset->columns[0]->buffer.UnsafeSetLength(ret1);
-    cset->columns[0]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_ZSTD,n_in,ret1));
-    cset->columns[0]->transformation_args.back()->ComputeChecksum(cset->columns[0]->buffer.mutable_data(), ret1);
-
     // Compress the Nullity bitmap
-    if(cset->columns[0]->nullity.get() == nullptr) return(-5); // malformed data
-
-    const uint32_t n_nullity = std::ceil((float)cset->columns[0]->n_records / 32);
-    int retNull = static_cast<ZstdCompressor*>(this)->Compress(
-                                 cset->columns[0]->nullity->mutable_data(),
-                                 n_nullity,
-                                 PIL_ZSTD_DEFAULT_LEVEL);
-
+    int retNull = static_cast<ZstdCompressor*>(this)->CompressNullity(cset->columns[0], PIL_ZSTD_DEFAULT_LEVEL);
     if(retNull < 0) return(-6); // compression failure
-    cset->columns[0]->nullity_u = n_nullity;
-    cset->columns[0]->nullity_c = retNull;
-    memcpy(cset->columns[0]->nullity->mutable_data(), buffer->mutable_data(), retNull);
-    ret += retNull;
-    //std::cerr << "nullity-zstd: " << n_nullity << "->" << retNull << " (" << (float)n_nullity/retNull << "-fold)" << std::endl;
-    //std::cerr << "delta-zstd: " << cset->columns[0]->buffer.length() << "->" << ret1 << " (" << (float)cset->columns[0]->buffer.length()/ret1 << "-fold)" << std::endl;
+    //std::cerr << "nullity-zstd: " << cset->columns[0]->nullity_u << "->" << retNull << " (" << (float)cset->columns[0]->nullity_u/retNull << "-fold)" << std::endl;
 
     // Compress actual data with ZSTD: the data could possibly be dictionary
     // encoded (see above).
-    int64_t n_in1 = cset->columns[1]->buffer.length();
-    int ret2 = static_cast<ZstdCompressor*>(this)->Compress(
-                                  cset->columns[1]->buffer.mutable_data(),
-                                  cset->columns[1]->buffer.length(),
-                                  PIL_ZSTD_DEFAULT_LEVEL);
-
+    int64_t ret2 = static_cast<ZstdCompressor*>(this)->Compress(cset->columns[1], PIL_ZSTD_DEFAULT_LEVEL);
     if(ret2 < 0) return(-6); // compression failure
 
-    //std::cerr << "data-zstd: " << cset->columns[1]->buffer.length() << "->" << ret2 << " (" << (float)cset->columns[1]->buffer.length()/ret2 << "-fold)" << std::endl;
-    memcpy(cset->columns[1]->buffer.mutable_data(), buffer->mutable_data(), ret2);
-    cset->columns[1]->compressed_size = ret2;
-    cset->columns[1]->buffer.UnsafeSetLength(ret2);
-    cset->columns[1]->transformation_args.push_back(std::make_shared<TransformMeta>(PIL_COMPRESS_ZSTD,n_in1,ret2));
-    cset->columns[1]->transformation_args.back()->ComputeChecksum(cset->columns[1]->buffer.mutable_data(), ret2);
-
     ret += ret1 + ret2 + retNull;
     return(ret);
 }
@@ -5,13 +5,15 @@
 #include "../buffer.h"
 #include "../column_store.h"
 #include "../table_schemas.h"
+#include "reference_sequence.h"
+#include "zstd_dictionary.h"
 
 namespace pil {
 
 class Transformer {
 public:
-    Transformer() : pool_(default_memory_pool()){}
-    Transformer(std::shared_ptr<ResizableBuffer> data) : pool_(default_memory_pool()), buffer(data){}
+    Transformer() : pool_(default_memory_pool()), model_pool_(default_memory_pool()){}
+    Transformer(std::shared_ptr<ResizableBuffer> data) : pool_(default_memory_pool()), model_pool_(default_memory_pool()), buffer(data){}
 
     /**<
      * Primary entry-point for applying a Transformation series to a ColumnSet.
@@ -20,7 +22,36 @@ public:
      * @param field DictionaryFieldType describing the column store type and primitive type used.
      * @return      Positive values are a success and negative values are failures.
      */
-    int Transform(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+    int64_t Transform(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+
+    /**<
+     * Set the MemoryPool for scratch buffers. Scratch buffers are swapped
+     * into the transformed ColumnStores so they should come from the same
+     * pool as the ColumnSets being transformed.
+     * @param pool Target MemoryPool.
+     */
+    void SetMemoryPool(MemoryPool* pool) {
+        pool_ = pool;
+        buffer.reset();
+    }
+
+    /**<
+     * Set the MemoryPool for the context model tables of the range coders.
+     * These tables are several megabytes large and accessed at random, so
+     * they benefit from a pool backed by huge pages.
+     * @param pool Target MemoryPool.
+     */
+    void SetModelMemoryPool(MemoryPool* pool) { model_pool_ = pool; }
+
+    // Returns TRUE if the offsets of a Tensor-model ColumnSet are stored as
+    // 64-bit integers (see ColumnSetBuilderTensor::WidenOffsets).
+    static bool HasWideOffsets(std::shared_ptr<ColumnSet> cset) {
+        if(cset.get() == nullptr || cset->size() != 2 || cset->columns[0].get() == nullptr) return(false);
+        return(cset->columns[0]->offset_width == sizeof(uint64_t));
+    }
+
+    // Release the scratch buffer, e.g. before its MemoryPool is reset.
+    void ReleaseBuffers() { buffer.reset(); }
 
     /**<
      * Ascertain that the provided set of transformation parameters are legal.
@@ -61,30 +92,40 @@ public:
 
         n_found = 0;
         for(int i = 0; i < n_pos_last; ++i) {
-            n_found += (transforms[i] >= 0 && transforms[i] <= 5); // 0-5 is compression codecs
+            n_found += IsCompressionCodec(transforms[i]);
         }
         if(n_found) return false; // found illegal compression before
 
         for(int i = n_pos_last + 1; i < transforms.size(); ++i) {
-            n_found += (transforms[i] > 5); // >5 is encoding codecs
+            n_found += (IsCompressionCodec(transforms[i]) == false);
         }
         if(n_found) return false; // found illegal encoding after
 
         return true;
     }
 
-    int AutoTransform(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
-    int AutoTransformColumns(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
-    int AutoTransformColumn(std::shared_ptr<ColumnStore> cstore, const DictionaryFieldType& field);
-    int AutoTransformTensor(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+    int64_t AutoTransform(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+    int64_t AutoTransformColumns(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
+    int64_t AutoTransformColumn(std::shared_ptr<ColumnStore> cstore, const DictionaryFieldType& field);
+    int64_t AutoTransformTensor(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field);
 
     // Wrappers for Dictionary encoding.
     int DictionaryEncode(std::shared_ptr<ColumnSet> cset, const DictionaryFieldType& field, const bool force = false);
     int DictionaryEncode(std::shared_ptr<ColumnStore> cstore, const DictionaryFieldType& field, const bool force = false);
 
+public:
+    // Reference and alignment fields used by reference-based codecs. The
+    // ColumnSets are set by the caller before transforming the target field.
+    ReferenceContext ref_context;
+    // Trained ZSTD dictionary of the target field, if any. While untrained
+    // the buffers passed to ZSTD are sampled into it. Set by the caller
+    // before transforming the target field.
+    std::shared_ptr<ZstdDictionary> zstd_dictionary;
+
 protected:
     // Any memory is owned by the respective Buffer instance (or its parents).
     MemoryPool* pool_;
+    MemoryPool* model_pool_; // Pool for temporary codec model tables.
     std::shared_ptr<ResizableBuffer> buffer;
 };
 
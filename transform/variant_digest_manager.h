@@ -19,7 +19,7 @@ public:
 		MD5_Final(dst, &md5);
 	}
 
-	static void GenerateMd5(const uint8_t* data, const uint32_t l_data, uint8_t* dst){
+	static void GenerateMd5(const uint8_t* data, const uint64_t l_data, uint8_t* dst){
 	    // uint8_t hash[MD5_DIGEST_LENGTH];
         MD5_CTX md5;
         MD5_Init(&md5);
@@ -0,0 +1,135 @@
+#include <algorithm>
+
+#include <zstd.h>
+#include <zdict.h>
+
+#include "zstd_dictionary.h"
+
+// Upper limit on the number of samples taken from a single buffer such that
+// a few large buffers do not crowd out the small ones.
+#define PIL_ZSTD_DICT_MAX_SAMPLES_PER_BUFFER 8
+// Smallest dictionary accepted by ZDICT_trainFromBuffer.
+#define PIL_ZSTD_DICT_MIN_SIZE 256
+
+namespace pil {
+
+ZstdDictionary::ZstdDictionary() : abandoned(false), dict_id(0), n_batches(0), ddict(nullptr) {}
+
+ZstdDictionary::ZstdDictionary(const ZstdDictionaryOptions& options) :
+    options(options), abandoned(false), dict_id(0), n_batches(0), ddict(nullptr)
+{}
+
+ZstdDictionary::~ZstdDictionary() {
+    for(auto it = cdicts.begin(); it != cdicts.end(); ++it) ZSTD_freeCDict(it->second);
+    ZSTD_freeDDict(ddict);
+}
+
+uint32_t ZstdDictionary::AddSamples(const uint8_t* data, const uint32_t n_data) {
+    if(IsSampling() == false) return(0);
+    if(data == nullptr || n_data == 0 || options.sample_size == 0) return(0);
+
+    const uint32_t n_chunks = std::min<uint32_t>((n_data + options.sample_size - 1) / options.sample_size,
+                                                 PIL_ZSTD_DICT_MAX_SAMPLES_PER_BUFFER);
+    const uint32_t step = n_data / n_chunks;
+
+    uint32_t n_added = 0;
+    for(uint32_t i = 0; i < n_chunks; ++i) {
+        const uint32_t offset = i * step;
+        const uint32_t len = std::min<uint32_t>(options.sample_size, n_data - offset);
+        if(samples.size() + len > options.max_samples_bytes) break;
+
+        samples.insert(samples.end(), &data[offset], &data[offset + len]);
+        sample_sizes.push_back(len);
+        n_added += len;
+    }
+
+    return(n_added);
+}
+
+int ZstdDictionary::Train() {
+    if(IsTrained()) return(dictionary.size());
+
+    // Samples should be at least an order of magnitude larger than the
+    // dictionary.
+    const uint32_t n_dict = std::min<uint32_t>(options.dictionary_size, samples.size() / 8);
+    if(n_dict < PIL_ZSTD_DICT_MIN_SIZE) return(-2);
+
+    std::vector<uint8_t> dict(n_dict);
+    const size_t ret = ZDICT_trainFromBuffer(&dict[0], n_dict,
+                                             &samples[0], &sample_sizes[0],
+                                             sample_sizes.size());
+    if(ZDICT_isError(ret)) return(-3);
+
+    dict.resize(ret);
+    int ret_load = Load(&dict[0], dict.size());
+    if(ret_load < 0) return(ret_load);
+
+    // Release the samples.
+    std::vector<uint8_t>().swap(samples);
+    std::vector<size_t>().swap(sample_sizes);
+
+    return(dictionary.size());
+}
+
+int ZstdDictionary::FinishBatch() {
+    if(IsSampling() == false) return(0);
+    if(++n_batches < options.training_batches) return(0);
+
+    if(Train() > 0) return(1);
+
+    // Give up if there is no room for additional samples.
+    if(samples.size() + options.sample_size > options.max_samples_bytes) {
+        abandoned = true;
+        std::vector<uint8_t>().swap(samples);
+        std::vector<size_t>().swap(sample_sizes);
+        return(-1);
+    }
+
+    return(0);
+}
+
+int ZstdDictionary::Load(const uint8_t* data, const uint32_t n_data) {
+    if(data == nullptr || n_data == 0) return(-1);
+
+    for(auto it = cdicts.begin(); it != cdicts.end(); ++it) ZSTD_freeCDict(it->second);
+    cdicts.clear();
+    ZSTD_freeDDict(ddict);
+    ddict = nullptr;
+
+    dictionary.assign(data, data + n_data);
+    dict_id = ZSTD_getDictID_fromDict(&dictionary[0], dictionary.size());
+    // Frames compressed with a raw content dictionary do not record its
+    // identifier and could not be told apart from regular frames.
+    if(dict_id == 0) {
+        dictionary.clear();
+        return(-2);
+    }
+
+    return(1);
+}
+
+ZSTD_CDict* ZstdDictionary::GetCDict(const int compression_level) {
+    if(IsTrained() == false) return(nullptr);
+
+    auto it = cdicts.find(compression_level);
+    if(it != cdicts.end()) return(it->second);
+
+    ZSTD_CDict* cdict = ZSTD_createCDict(&dictionary[0], dictionary.size(), compression_level);
+    if(cdict != nullptr) cdicts[compression_level] = cdict;
+    return(cdict);
+}
+
+ZSTD_DDict* ZstdDictionary::GetDDict() {
+    if(IsTrained() == false) return(nullptr);
+    if(ddict == nullptr) ddict = ZSTD_createDDict(&dictionary[0], dictionary.size());
+    return(ddict);
+}
+
+int ZstdDictionary::Serialize(std::ostream& stream) const {
+    uint32_t n_dict = dictionary.size();
+    stream.write(reinterpret_cast<char*>(&n_dict), sizeof(uint32_t));
+    if(n_dict) stream.write(reinterpret_cast<const char*>(&dictionary[0]), n_dict);
+    return(stream.good());
+}
+
+}
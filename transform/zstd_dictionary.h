@@ -0,0 +1,102 @@
+#ifndef TRANSFORM_ZSTD_DICTIONARY_H_
+#define TRANSFORM_ZSTD_DICTIONARY_H_
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+
+// Opaque ZSTD handles (see zstd.h).
+typedef struct ZSTD_CDict_s ZSTD_CDict;
+typedef struct ZSTD_DDict_s ZSTD_DDict;
+
+namespace pil {
+
+// Parameters for training ZSTD dictionaries per field. Buffers passed to
+// ZSTD while the dictionary is untrained are sampled and a dictionary is
+// trained from the samples after `training_batches` batches. Subsequent
+// batches are compressed against the dictionary.
+struct ZstdDictionaryOptions {
+    ZstdDictionaryOptions() :
+        enabled(false), dictionary_size(16384), training_batches(2),
+        sample_size(4096), max_samples_bytes(100 * 16384)
+    {}
+
+    bool enabled;
+    uint32_t dictionary_size; // Upper limit of the trained dictionary.
+    uint32_t training_batches; // Number of batches to sample before training.
+    uint32_t sample_size; // Buffers are split into samples of at most this size.
+    uint32_t max_samples_bytes; // Upper limit of the collected samples.
+};
+
+// A trained ZSTD dictionary. The dictionary bytes are stored once per field
+// in the file meta data. Digested compression (per level) and decompression
+// dictionaries are created on first use.
+class ZstdDictionary {
+public:
+    ZstdDictionary();
+    explicit ZstdDictionary(const ZstdDictionaryOptions& options);
+    ~ZstdDictionary();
+    ZstdDictionary(const ZstdDictionary&) = delete;
+    ZstdDictionary& operator=(const ZstdDictionary&) = delete;
+
+    /**<
+     * Add training samples from the provided buffer. Large buffers are
+     * sampled at evenly spaced offsets. No-op if the dictionary is trained
+     * or the samples limit is reached.
+     * @param data   Source data.
+     * @param n_data Number of bytes in the source.
+     * @return       Returns the number of bytes added.
+     */
+    uint32_t AddSamples(const uint8_t* data, const uint32_t n_data);
+
+    /**<
+     * Train a dictionary from the collected samples with
+     * ZDICT_trainFromBuffer. The samples are released if successful.
+     * @return Returns the dictionary size or a negative value otherwise.
+     */
+    int Train();
+
+    /**<
+     * Mark the end of a batch and train the dictionary if enough batches
+     * have been sampled. Sampling stops if training fails with a full
+     * samples buffer.
+     * @return Returns 1 if a dictionary was trained, 0 if not, or a negative value if training was abandoned.
+     */
+    int FinishBatch();
+
+    /**<
+     * Load a previously trained dictionary such as one read back from the
+     * file meta data.
+     * @param data   Dictionary bytes.
+     * @param n_data Number of bytes.
+     * @return       Returns 1 if successful or a negative value otherwise.
+     */
+    int Load(const uint8_t* data, const uint32_t n_data);
+
+    inline bool IsTrained() const { return(dictionary.size() != 0); }
+    inline bool IsSampling() const { return(IsTrained() == false && abandoned == false); }
+    inline uint32_t GetId() const { return(dict_id); }
+    inline uint32_t size() const { return(dictionary.size()); }
+
+    ZSTD_CDict* GetCDict(const int compression_level);
+    ZSTD_DDict* GetDDict();
+
+    int Serialize(std::ostream& stream) const;
+
+public:
+    ZstdDictionaryOptions options;
+    std::vector<uint8_t> dictionary;
+
+private:
+    bool abandoned;
+    uint32_t dict_id, n_batches;
+    std::vector<uint8_t> samples;
+    std::vector<size_t> sample_sizes;
+    std::unordered_map<int, ZSTD_CDict*> cdicts;
+    ZSTD_DDict* ddict;
+};
+
+}
+
+#endif /* TRANSFORM_ZSTD_DICTIONARY_H_ */
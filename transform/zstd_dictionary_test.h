@@ -0,0 +1,81 @@
+#ifndef ZSTD_DICTIONARY_TEST_H_
+#define ZSTD_DICTIONARY_TEST_H_
+
+#include <random>
+#include <sstream>
+
+#include "compressor.h"
+#include "zstd_dictionary.h"
+#include <gtest/gtest.h>
+
+namespace pil {
+
+// Small ColumnStore of SAM-like optional tags.
+static std::shared_ptr<ColumnStore> ZstdDictionaryTestColumn(std::mt19937& eng) {
+    std::uniform_int_distribution<uint32_t> distr(0, 150);
+    std::shared_ptr<ColumnStore> cstore = std::make_shared<ColumnStore>();
+    std::shared_ptr<ColumnStoreBuilder<uint8_t> > builder = std::static_pointer_cast< ColumnStoreBuilder<uint8_t> >(cstore);
+    for(int i = 0; i < 8; ++i) {
+        std::string tags = "NM:i:" + std::to_string(distr(eng) % 5) +
+                           "\tMD:Z:" + std::to_string(distr(eng)) + "A" + std::to_string(distr(eng)) +
+                           "\tAS:i:" + std::to_string(distr(eng)) +
+                           "\tXS:i:0\tRG:Z:sample_read_group_1\n";
+        for(size_t j = 0; j < tags.size(); ++j) builder->Append(tags[j]);
+    }
+    cstore->ComputeChecksum();
+    return(cstore);
+}
+
+TEST(ZstdDictionaryTests, TrainCompressDecompress) {
+    std::mt19937 eng(1234);
+    ZstdDictionaryOptions options;
+    options.enabled = true;
+    options.training_batches = 4;
+    std::shared_ptr<ZstdDictionary> dict = std::make_shared<ZstdDictionary>(options);
+
+    // Buffers compressed while untrained are sampled.
+    ZstdCompressor zstd;
+    zstd.zstd_dictionary = dict;
+    for(int b = 0; b < 4; ++b) {
+        ASSERT_EQ(false, dict->IsTrained());
+        for(int i = 0; i < 100; ++i) ASSERT_GT(zstd.Compress(ZstdDictionaryTestColumn(eng), 1), 0);
+        ASSERT_EQ(b == 3, dict->FinishBatch() == 1);
+    }
+    ASSERT_EQ(true, dict->IsTrained());
+    ASSERT_NE(0, dict->GetId());
+
+    // Compare against compression without a dictionary.
+    std::shared_ptr<ColumnStore> cstore = ZstdDictionaryTestColumn(eng);
+    std::shared_ptr<ColumnStore> cstore_ref = ZstdDictionaryTestColumn(eng);
+    ZstdCompressor zstd_ref;
+    const int n_ref = zstd_ref.Compress(cstore_ref, 1);
+    const int n_dict = zstd.Compress(cstore, 1);
+    ASSERT_GT(n_ref, 0);
+    ASSERT_GT(n_dict, 0);
+    ASSERT_LT(n_dict, n_ref);
+
+    // Decompression requires the dictionary.
+    ZstdCompressor zstd2;
+    ASSERT_EQ(-2, zstd2.Decompress(cstore, cstore->transformation_args.back(), true));
+
+    // Load the dictionary as stored in the meta data.
+    std::stringstream ss;
+    ASSERT_EQ(1, dict->Serialize(ss));
+    const std::string stored = ss.str();
+    uint32_t n_stored = 0;
+    memcpy(&n_stored, stored.data(), sizeof(uint32_t));
+    ASSERT_EQ(dict->size(), n_stored);
+
+    zstd2.zstd_dictionary = std::make_shared<ZstdDictionary>();
+    ASSERT_EQ(1, zstd2.zstd_dictionary->Load(reinterpret_cast<const uint8_t*>(stored.data()) + sizeof(uint32_t), n_stored));
+    ASSERT_EQ(dict->GetId(), zstd2.zstd_dictionary->GetId());
+    ASSERT_GT(zstd2.Decompress(cstore, cstore->transformation_args.back(), true), 0);
+
+    uint8_t digest[PIL_CHECKSUM_LENGTH];
+    Checksum::Compute(cstore->checksum_type, cstore->mutable_data(), cstore->uncompressed_size, digest);
+    ASSERT_EQ(0, memcmp(digest, cstore->checksum, 16));
+}
+
+}
+
+#endif /* ZSTD_DICTIONARY_TEST_H_ */